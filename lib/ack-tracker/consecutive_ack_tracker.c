@@ -26,6 +26,8 @@
 #include "consecutive_ack_record_container.h"
 #include "bookmark.h"
 #include "syslog-ng.h"
+#include "timeutils/misc.h"
+#include <iv.h>
 
 typedef struct _ConsecutiveAckTracker
 {
@@ -35,6 +37,14 @@ typedef struct _ConsecutiveAckTracker
   GStaticMutex mutex;
   AckTrackerOnAllAcked on_all_acked;
   gboolean bookmark_saving_disabled;
+
+  /* bookmark-commit-interval(): the last acked bookmark is kept here and
+   * saved by commit_timer, instead of saving on every ack */
+  gint commit_interval;
+  struct iv_timer commit_timer;
+  gboolean commit_timer_running;
+  Bookmark pending_bookmark;
+  gboolean has_pending_bookmark;
 } ConsecutiveAckTracker;
 
 void
@@ -113,11 +123,48 @@ _is_bookmark_saving_enabled(ConsecutiveAckTracker *self)
 }
 
 static void
-_ack_record_save_bookmark(ConsecutiveAckRecord *ack_record)
+_drop_pending_bookmark(ConsecutiveAckTracker *self)
+{
+  if (!self->has_pending_bookmark)
+    return;
+
+  bookmark_destroy(&self->pending_bookmark);
+  self->has_pending_bookmark = FALSE;
+}
+
+static void
+_commit_pending_bookmark(ConsecutiveAckTracker *self)
+{
+  if (!self->has_pending_bookmark)
+    return;
+
+  bookmark_save(&self->pending_bookmark);
+  _drop_pending_bookmark(self);
+}
+
+static void
+_keep_pending_bookmark(ConsecutiveAckTracker *self, Bookmark *bookmark)
+{
+  _drop_pending_bookmark(self);
+
+  /* the pending copy takes over whatever the bookmark owns, the ack record
+   * is dropped right after this without destroying it */
+  self->pending_bookmark = *bookmark;
+  self->has_pending_bookmark = TRUE;
+  bookmark->destroy = NULL;
+}
+
+static void
+_ack_record_save_bookmark(ConsecutiveAckTracker *self, ConsecutiveAckRecord *ack_record)
 {
   Bookmark *bookmark = &(ack_record->super.bookmark);
 
-  bookmark_save(bookmark);
+  /* after deinit there is no timer to commit the position, late acks are
+   * saved right away */
+  if (self->commit_timer_running)
+    _keep_pending_bookmark(self, bookmark);
+  else
+    bookmark_save(bookmark);
 }
 
 static guint32
@@ -128,7 +175,7 @@ _ack_records_untrack_msg(ConsecutiveAckTracker *self, LogMessage *msg, AckType a
     {
       if (ack_type != AT_ABORTED && _is_bookmark_saving_enabled(self))
         {
-          _ack_record_save_bookmark(consecutive_ack_record_container_at(self->ack_records, ack_range_length - 1));
+          _ack_record_save_bookmark(self, consecutive_ack_record_container_at(self->ack_records, ack_range_length - 1));
         }
       consecutive_ack_record_container_drop(self->ack_records, ack_range_length);
     }
@@ -209,6 +256,7 @@ consecutive_ack_tracker_free(AckTracker *s)
       handler->user_data_free_fn(handler->user_data);
     }
 
+  _drop_pending_bookmark(self);
   g_static_mutex_free(&self->mutex);
 
   consecutive_ack_record_container_free(self->ack_records);
@@ -224,6 +272,65 @@ consecutive_ack_tracker_disable_bookmark_saving(AckTracker *s)
   consecutive_ack_tracker_lock(s);
   {
     self->bookmark_saving_disabled = TRUE;
+    _drop_pending_bookmark(self);
+  }
+  consecutive_ack_tracker_unlock(s);
+}
+
+static void
+_start_commit_timer(ConsecutiveAckTracker *self)
+{
+  iv_validate_now();
+  self->commit_timer.expires = iv_now;
+  timespec_add_msec(&self->commit_timer.expires, self->commit_interval);
+  iv_timer_register(&self->commit_timer);
+}
+
+static void
+_commit_timer_elapsed(void *cookie)
+{
+  ConsecutiveAckTracker *self = (ConsecutiveAckTracker *)cookie;
+
+  consecutive_ack_tracker_lock(&self->super);
+  {
+    _commit_pending_bookmark(self);
+  }
+  consecutive_ack_tracker_unlock(&self->super);
+
+  _start_commit_timer(self);
+}
+
+static gboolean
+consecutive_ack_tracker_init(AckTracker *s)
+{
+  ConsecutiveAckTracker *self = (ConsecutiveAckTracker *)s;
+
+  self->commit_interval = s->source->options->bookmark_commit_interval;
+  if (self->commit_interval <= 0)
+    return TRUE;
+
+  consecutive_ack_tracker_lock(s);
+  {
+    self->commit_timer_running = TRUE;
+  }
+  consecutive_ack_tracker_unlock(s);
+
+  _start_commit_timer(self);
+  return TRUE;
+}
+
+static void
+consecutive_ack_tracker_deinit(AckTracker *s)
+{
+  ConsecutiveAckTracker *self = (ConsecutiveAckTracker *)s;
+
+  if (iv_timer_registered(&self->commit_timer))
+    iv_timer_unregister(&self->commit_timer);
+
+  consecutive_ack_tracker_lock(s);
+  {
+    self->commit_timer_running = FALSE;
+    _commit_pending_bookmark(self);
   }
   consecutive_ack_tracker_unlock(s);
 }
@@ -236,6 +343,8 @@ _setup_callbacks(ConsecutiveAckTracker *self)
   self->super.manage_msg_ack = consecutive_ack_tracker_manage_msg_ack;
   self->super.disable_bookmark_saving = consecutive_ack_tracker_disable_bookmark_saving;
   self->super.free_fn = consecutive_ack_tracker_free;
+  self->super.init = consecutive_ack_tracker_init;
+  self->super.deinit = consecutive_ack_tracker_deinit;
 }
 
 static void
@@ -246,6 +355,11 @@ consecutive_ack_tracker_init_instance(ConsecutiveAckTracker *self, LogSource *so
   source->ack_tracker = (AckTracker *)self;
   self->ack_records = ack_records;
   g_static_mutex_init(&self->mutex);
+
+  IV_TIMER_INIT(&self->commit_timer);
+  self->commit_timer.cookie = self;
+  self->commit_timer.handler = _commit_timer_elapsed;
+
   _setup_callbacks(self);
 }
 
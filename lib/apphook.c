@@ -26,9 +26,11 @@
 #include "messages.h"
 #include "children.h"
 #include "dnscache.h"
+#include "logmatcher.h"
 #include "alarms.h"
 #include "stats/stats-registry.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
 #include "logsource.h"
 #include "logwriter.h"
 #include "afinter.h"
@@ -167,7 +169,6 @@ app_startup(void)
   crypto_init();
   hostname_global_init();
   dns_caching_global_init();
-  dns_caching_thread_init();
   afinter_global_init();
   child_manager_init();
   alarm_init();
@@ -182,6 +183,8 @@ app_startup(void)
   value_pairs_global_init();
   service_management_init();
   scratch_buffers_allocator_init();
+  log_msg_slab_thread_init();
+  log_matcher_thread_init();
   nondumpable_setlogger(nondumpable_allocator_msg_debug, nondumpable_allocator_msg_fatal);
   secret_storage_init();
   transport_factory_id_global_init();
@@ -216,6 +219,8 @@ app_shutdown(void)
   run_application_hook(AH_SHUTDOWN);
   main_loop_thread_resource_deinit();
   secret_storage_deinit();
+  log_matcher_thread_deinit();
+  log_msg_slab_thread_deinit();
   scratch_buffers_allocator_deinit();
   scratch_buffers_global_deinit();
   value_pairs_global_deinit();
@@ -228,7 +233,6 @@ app_shutdown(void)
   child_manager_deinit();
   g_list_foreach(application_hooks, (GFunc) g_free, NULL);
   g_list_free(application_hooks);
-  dns_caching_thread_deinit();
   dns_caching_global_deinit();
   hostname_global_deinit();
   crypto_deinit();
@@ -271,7 +275,8 @@ void
 app_thread_start(void)
 {
   scratch_buffers_allocator_init();
-  dns_caching_thread_init();
+  log_msg_slab_thread_init();
+  log_matcher_thread_init();
   main_loop_call_thread_init();
 }
 
@@ -279,6 +284,7 @@ void
 app_thread_stop(void)
 {
   main_loop_call_thread_deinit();
-  dns_caching_thread_deinit();
+  log_matcher_thread_deinit();
+  log_msg_slab_thread_deinit();
   scratch_buffers_allocator_deinit();
 }
@@ -186,6 +186,7 @@
 %token KW_BATCH_LINES                 10087
 %token KW_BATCH_TIMEOUT               10088
 %token KW_TRIM_LARGE_MESSAGES         10089
+%token KW_WORKER_PARTITION_KEY        10095
 
 %token KW_CHAIN_HOSTNAMES             10090
 %token KW_NORMALIZE_HOSTNAMES         10091
@@ -201,6 +202,7 @@
 
 %token KW_DNS_CACHE                   10120
 %token KW_DNS_CACHE_SIZE              10121
+%token KW_DNS_CACHE_RESOLVERS         10122
 
 %token KW_DNS_CACHE_EXPIRE            10130
 %token KW_DNS_CACHE_EXPIRE_FAILED     10131
@@ -215,6 +217,7 @@
 %token KW_FRAC_DIGITS                 10152
 
 %token KW_LOG_FIFO_SIZE               10160
+%token KW_LOG_FIFO_LOCKLESS           10161
 %token KW_LOG_FETCH_LIMIT             10162
 %token KW_LOG_IW_SIZE                 10163
 %token KW_LOG_PREFIX                  10164
@@ -229,6 +232,7 @@
 
 %token KW_READ_OLD_RECORDS            10304
 %token KW_USE_SYSLOGNG_PID            10305
+%token KW_BOOKMARK_COMMIT_INTERVAL    10306
 
 /* log statement options */
 %token KW_FLAGS                       10190
@@ -935,6 +939,7 @@ options_item
 	| KW_LOG_MSG_SIZE '(' positive_integer ')'	{ configuration->log_msg_size = $3; }
 	| KW_TRIM_LARGE_MESSAGES '(' yesno ')'	{ configuration->trim_large_messages = $3; }
 	| KW_KEEP_TIMESTAMP '(' yesno ')'	{ configuration->keep_timestamp = $3; }
+	| KW_BOOKMARK_COMMIT_INTERVAL '(' nonnegative_integer ')' { configuration->bookmark_commit_interval = $3; }
 	| KW_CREATE_DIRS '(' yesno ')'		{ configuration->create_dirs = $3; }
 	| KW_CUSTOM_DOMAIN '(' string ')'	{ configuration->custom_domain = g_strdup($3); free($3); }
 	| KW_FILE_TEMPLATE '(' string ')'	{ configuration->file_template_name = g_strdup($3); free($3); }
@@ -972,6 +977,8 @@ dns_cache_option
 	| KW_DNS_CACHE_EXPIRE_FAILED '(' positive_integer ')'
 	                                        { last_dns_cache_options->expire_failed = $3; }
 	| KW_DNS_CACHE_HOSTS '(' string ')'     { last_dns_cache_options->hosts = g_strdup($3); free($3); }
+	| KW_DNS_CACHE_RESOLVERS '(' nonnegative_integer ')'
+	                                        { last_dns_cache_options->resolvers = $3; }
         ;
 
 
@@ -1190,6 +1197,7 @@ dest_driver_option
         /* NOTE: plugins need to set "last_driver" in order to incorporate this rule in their grammar */
 
 	: KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ ((LogDestDriver *) last_driver)->log_fifo_size = $3; }
+	| KW_LOG_FIFO_LOCKLESS '(' yesno ')'		{ ((LogDestDriver *) last_driver)->log_fifo_lockless = $3; }
 	| KW_THROTTLE '(' nonnegative_integer ')'         { ((LogDestDriver *) last_driver)->throttle = $3; }
         | inner_dest
         | driver_option
@@ -1202,6 +1210,7 @@ threaded_dest_driver_batch_option
 
 threaded_dest_driver_workers_option
         : KW_WORKERS '(' positive_integer ')'  { log_threaded_dest_driver_set_num_workers(last_driver, $3); }
+        | KW_WORKER_PARTITION_KEY '(' template_content ')' { log_threaded_dest_driver_set_worker_partition_key_ref(last_driver, $3); }
         ;
 
 /* implies dest_driver_option */
@@ -1249,6 +1258,7 @@ source_option
 	| KW_KEEP_TIMESTAMP '(' yesno ')'	{ last_source_options->keep_timestamp = $3; }
 	| KW_READ_OLD_RECORDS '(' yesno ')'	{ last_source_options->read_old_records = $3; }
 	| KW_USE_SYSLOGNG_PID '(' yesno ')'	{ last_source_options->use_syslogng_pid = $3; }
+	| KW_BOOKMARK_COMMIT_INTERVAL '(' nonnegative_integer ')' { last_source_options->bookmark_commit_interval = $3; }
         | KW_TAGS '(' string_list ')'		{ log_source_options_set_tags(last_source_options, $3); }
         | { last_host_resolve_options = &last_source_options->host_resolve_options; } host_resolve_option
         ;
@@ -131,6 +131,7 @@ static CfgLexerKeyword main_keywords[] =
   { "use_uniqid",         KW_USE_UNIQID },
 
   { "log_fifo_size",      KW_LOG_FIFO_SIZE },
+  { "log_fifo_lockless",  KW_LOG_FIFO_LOCKLESS },
   { "log_fetch_limit",    KW_LOG_FETCH_LIMIT },
   { "log_iw_size",        KW_LOG_IW_SIZE },
   { "log_msg_size",       KW_LOG_MSG_SIZE },
@@ -159,16 +160,19 @@ static CfgLexerKeyword main_keywords[] =
   { "dns_cache_size",     KW_DNS_CACHE_SIZE },
   { "dns_cache_expire",   KW_DNS_CACHE_EXPIRE },
   { "dns_cache_expire_failed", KW_DNS_CACHE_EXPIRE_FAILED },
+  { "dns_cache_resolvers", KW_DNS_CACHE_RESOLVERS },
   { "pass_unix_credentials",   KW_PASS_UNIX_CREDENTIALS },
   { "persist_name",            KW_PERSIST_NAME, VERSION_VALUE_3_8 },
 
   { "retries",            KW_RETRIES },
   { "workers",            KW_WORKERS },
+  { "worker_partition_key", KW_WORKER_PARTITION_KEY },
   { "batch_lines",        KW_BATCH_LINES },
   { "batch_timeout",      KW_BATCH_TIMEOUT },
 
   { "read_old_records",   KW_READ_OLD_RECORDS},
   { "use_syslogng_pid",   KW_USE_SYSLOGNG_PID },
+  { "bookmark_commit_interval", KW_BOOKMARK_COMMIT_INTERVAL },
   { "fetch_no_data_delay", KW_FETCH_NO_DATA_DELAY},
   /* filter items */
   { "type",               KW_TYPE },
@@ -360,6 +360,7 @@ cfg_init(GlobalConfig *cfg)
   stats_reinit(&cfg->stats_options);
 
   dns_caching_update_options(&cfg->dns_cache_options);
+  dns_caching_init(cfg->state);
   hostname_reinit(cfg->custom_domain);
   host_resolve_options_init_globals(&cfg->host_resolve_options);
   log_template_options_init(&cfg->template_options, cfg);
@@ -384,6 +385,7 @@ cfg_deinit(GlobalConfig *cfg)
 {
   cfg_deinit_modules(cfg);
   rcptid_deinit();
+  dns_caching_deinit();
   return cfg_tree_stop(&cfg->tree);
 }
 
@@ -508,6 +510,7 @@ cfg_new(gint version)
 
   self->recv_time_zone = NULL;
   self->keep_timestamp = TRUE;
+  self->bookmark_commit_interval = 0;
 
   self->use_uniqid = FALSE;
 
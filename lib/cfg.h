@@ -98,6 +98,7 @@ struct _GlobalConfig
   gboolean use_uniqid;
 
   gboolean keep_timestamp;
+  gint bookmark_commit_interval;
 
   gchar *recv_time_zone;
   LogTemplateOptions template_options;
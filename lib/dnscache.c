@@ -23,9 +23,12 @@
  */
 
 #include "dnscache.h"
+#include "apphook.h"
 #include "messages.h"
+#include "serialize.h"
 #include "timeutils/cache.h"
-#include "tls-support.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
 
 #include <sys/types.h>
 #include <netinet/in.h>
@@ -63,6 +66,8 @@ struct _DNSCacheEntry
   gsize hostname_len;
   /* whether this entry is a positive (successful DNS lookup) or negative (failed DNS lookup, contains an IP address) match */
   gboolean positive;
+  /* a negative entry standing in for a lookup that has not finished yet */
+  gboolean pending;
 };
 
 struct _DNSCache
@@ -143,8 +148,9 @@ dns_cache_fill_key(DNSCacheKey *key, gint family, void *addr)
     }
 }
 
-static void
-dns_cache_store(DNSCache *self, gboolean persistent, gint family, void *addr, const gchar *hostname, gboolean positive)
+static DNSCacheEntry *
+dns_cache_store(DNSCache *self, gboolean persistent, gint family, void *addr, const gchar *hostname, gboolean positive,
+                time_t resolved)
 {
   DNSCacheEntry *entry;
   guint hash_size;
@@ -155,10 +161,11 @@ dns_cache_store(DNSCache *self, gboolean persistent, gint family, void *addr, co
   entry->hostname = g_strdup(hostname);
   entry->hostname_len = strlen(hostname);
   entry->positive = positive;
+  entry->pending = FALSE;
   INIT_IV_LIST_HEAD(&entry->list);
   if (!persistent)
     {
-      entry->resolved = cached_g_current_time_sec();
+      entry->resolved = resolved;
       iv_list_add(&entry->list, &self->cache_list);
     }
   else
@@ -180,18 +187,19 @@ dns_cache_store(DNSCache *self, gboolean persistent, gint family, void *addr, co
       /* remove oldest element */
       g_hash_table_remove(self->cache, &entry_to_remove->key);
     }
+  return entry;
 }
 
 void
 dns_cache_store_persistent(DNSCache *self, gint family, void *addr, const gchar *hostname)
 {
-  dns_cache_store(self, TRUE, family, addr, hostname, TRUE);
+  dns_cache_store(self, TRUE, family, addr, hostname, TRUE, 0);
 }
 
 void
 dns_cache_store_dynamic(DNSCache *self, gint family, void *addr, const gchar *hostname, gboolean positive)
 {
-  dns_cache_store(self, FALSE, family, addr, hostname, positive);
+  dns_cache_store(self, FALSE, family, addr, hostname, positive, cached_g_current_time_sec());
 }
 
 static void
@@ -286,6 +294,18 @@ dns_cache_check_hosts(DNSCache *self, glong t)
     }
 }
 
+static gboolean
+dns_cache_is_expired(DNSCache *self, time_t resolved, gboolean positive, time_t now)
+{
+  /* persistent entries have no resolution time and never expire */
+  if (!resolved)
+    return FALSE;
+
+  if (positive)
+    return resolved < now - self->options->expire;
+  return resolved < now - self->options->expire_failed;
+}
+
 /*
  * @hostname        is set to the stored hostname,
  * @positive        is set whether the match was a DNS match or failure
@@ -293,24 +313,18 @@ dns_cache_check_hosts(DNSCache *self, glong t)
  * Returns TRUE if the cache was able to serve the request (e.g. had a
  * matching entry at all).
  */
-gboolean
-dns_cache_lookup(DNSCache *self, gint family, void *addr, const gchar **hostname, gsize *hostname_len,
-                 gboolean *positive)
+static gboolean
+dns_cache_lookup_entry(DNSCache *self, gint family, void *addr, time_t now, const gchar **hostname,
+                       gsize *hostname_len, gboolean *positive)
 {
   DNSCacheKey key;
   DNSCacheEntry *entry;
-  time_t now;
-
-  now = cached_g_current_time_sec();
-  dns_cache_check_hosts(self, now);
 
   dns_cache_fill_key(&key, family, addr);
   entry = g_hash_table_lookup(self->cache, &key);
   if (entry)
     {
-      if (entry->resolved &&
-          ((entry->positive && entry->resolved < now - self->options->expire) ||
-           (!entry->positive && entry->resolved < now - self->options->expire_failed)))
+      if (dns_cache_is_expired(self, entry->resolved, entry->positive, now))
         {
           /* the entry is not persistent and is too old */
         }
@@ -327,6 +341,16 @@ dns_cache_lookup(DNSCache *self, gint family, void *addr, const gchar **hostname
   return FALSE;
 }
 
+gboolean
+dns_cache_lookup(DNSCache *self, gint family, void *addr, const gchar **hostname, gsize *hostname_len,
+                 gboolean *positive)
+{
+  time_t now = cached_g_current_time_sec();
+
+  dns_cache_check_hosts(self, now);
+  return dns_cache_lookup_entry(self, family, addr, now, hostname, hostname_len, positive);
+}
+
 DNSCache *
 dns_cache_new(const DNSCacheOptions *options)
 {
@@ -357,6 +381,7 @@ dns_cache_options_defaults(DNSCacheOptions *options)
   options->expire = 3600;
   options->expire_failed = 60;
   options->hosts = NULL;
+  options->resolvers = 0;
 }
 
 void
@@ -366,6 +391,7 @@ dns_cache_options_destroy(DNSCacheOptions *options)
   options->hosts = NULL;
 }
 
+
 /**************************************************************************
  * The global API that manages DNSCache instances on its own. Callers need
  * not be aware of underlying data structures and locking, they can simply
@@ -375,61 +401,312 @@ dns_cache_options_destroy(DNSCacheOptions *options)
  * detail.
  **************************************************************************/
 
-TLS_BLOCK_START
+/* The cache is shared by all threads.  It is split into shards by the
+ * address being looked up, each shard being a separate DNSCache with its
+ * own lock and its own share of cache_size.  A thread never holds the lock
+ * of more than one shard at a time.
+ *
+ * The hosts file is loaded once, into a separate DNSCache holding only its
+ * entries.  It is looked up before the shards, with a read lock, and is
+ * locked for writing only when the file is checked for changes.
+ *
+ * The hostname found by a lookup is copied to the buffer of the caller
+ * while the shard is locked, as the entry may be replaced by another
+ * thread right after the lock is released. */
+
+#define DNS_CACHE_SHARD_BITS 4
+#define DNS_CACHE_NUM_SHARDS (1 << DNS_CACHE_SHARD_BITS)
+
+/* misses are not queued while this many are waiting for a resolver, they
+ * are retried once their failed entry expires */
+#define DNS_CACHE_MAX_PENDING_RESOLVES 4096
+
+typedef struct _DNSCacheShard
 {
-  DNSCache *dns_cache;
-}
-TLS_BLOCK_END;
+  GStaticMutex lock;
+  DNSCache *cache;
+  DNSCacheOptions options;
+} DNSCacheShard;
 
-#define dns_cache __tls_deref(dns_cache)
+typedef struct _DNSResolveRequest
+{
+  GSockAddr *saddr;
+  DNSCacheKey key;
+  /* the formatted address, cached if the lookup fails */
+  gchar *address;
+  DNSCacheResolveFunc resolve;
+} DNSResolveRequest;
 
 /* DNS cache related options are global, independent of the configuration
  * (e.g.  GlobalConfig instance), and they are stored in the
  * "effective_dns_cache_options" variable below.
  *
- * The reasons for using the global variable are as explained below.
- *
- * Some notes:
- *   1) DNS cache contents are better retained between configuration reloads
- *   2) There are multiple DNSCache instances as they are per-thread data structs.
- *
- * The usual pattern would be:
- *    DNSCache->options -> DNSCacheOptions
- *
- * And options would be a reference and would point inside a DNSCacheOptions
- * instance contained within the GlobalConfig.
- *
- * The problem with this approach is that we don't want to recreate DNSCache
- * instances when reloading the configuration (as we want to keep their
- * config), and this would mean that we'd have to update the "options"
- * pointers in each of the existing instances.  And those instances are
- * per-thread variables, making it a bit more difficult to track them.
- *
- * For this reason, it was a lot simpler to use a global variable to hold
- * configuration options, one that can be updated as the configuration is
- * reloaded.  Then DNSCache instances transparently take the options changes
- * into account as they continue to resolve names.
- *
- * I could come up with even better solutions to this problem (like using a
- * layer above GlobalConfig, a state that encapsulates per-execution state
- * of syslog-ng), however, right now that would be an overkill and I want to
- * get the DNSCache refactors into the master tree.
+ * DNS cache contents are better retained between configuration reloads,
+ * so the shards are not recreated when the configuration changes, instead
+ * dns_caching_update_options() copies the new options into each shard,
+ * with the cache size divided between them.
  */
 
 static DNSCacheOptions effective_dns_cache_options;
-G_LOCK_DEFINE_STATIC(unused_dns_caches);
-static GList *unused_dns_caches;
+static DNSCacheShard dns_cache_shards[DNS_CACHE_NUM_SHARDS];
+
+static struct
+{
+  GStaticRWLock lock;
+  DNSCache *cache;
+  DNSCacheOptions options;
+} dns_cache_hosts;
+
+/* protects dns_resolver_pool itself, requests are pushed with the lock
+ * held so the pool is not freed under them */
+static GStaticMutex dns_resolver_pool_lock = G_STATIC_MUTEX_INIT;
+static GThreadPool *dns_resolver_pool;
+static gint dns_resolver_pool_stopping;
+
+static PersistState *dns_cache_persist_state;
+static gboolean dns_cache_restored;
+
+static struct
+{
+  StatsCounterItem *hits;
+  StatsCounterItem *misses;
+  StatsCounterItem *resolved;
+  StatsCounterItem *resolve_time;
+} dns_cache_stats;
+
+static DNSCacheShard *
+_get_shard(DNSCacheKey *key)
+{
+  /* the low bits of an IPv4 address are the most varied ones, mix them into the top bits */
+  guint32 hash = dns_cache_key_hash(key) * 2654435761U;
+
+  return &dns_cache_shards[hash >> (32 - DNS_CACHE_SHARD_BITS)];
+}
+
+static void
+_copy_hostname(gchar *hostname, gsize hostname_size, gsize *hostname_len,
+               const gchar *cached_hostname, gsize cached_hostname_len)
+{
+  *hostname_len = MIN(cached_hostname_len, hostname_size - 1);
+  memcpy(hostname, cached_hostname, *hostname_len);
+  hostname[*hostname_len] = 0;
+}
+
+static gboolean
+_lookup_hosts(gint family, void *addr, gchar *hostname, gsize hostname_size, gsize *hostname_len,
+              gboolean *positive)
+{
+  DNSCache *cache = dns_cache_hosts.cache;
+  time_t now = cached_g_current_time_sec();
+  const gchar *cached_hostname;
+  gsize cached_hostname_len;
+  gboolean found;
+
+  g_static_rw_lock_reader_lock(&dns_cache_hosts.lock);
+  if (G_UNLIKELY(cache->hosts_checktime != now))
+    {
+      g_static_rw_lock_reader_unlock(&dns_cache_hosts.lock);
+      g_static_rw_lock_writer_lock(&dns_cache_hosts.lock);
+      dns_cache_check_hosts(cache, now);
+      g_static_rw_lock_writer_unlock(&dns_cache_hosts.lock);
+      g_static_rw_lock_reader_lock(&dns_cache_hosts.lock);
+    }
+
+  found = dns_cache_lookup_entry(cache, family, addr, now, &cached_hostname, &cached_hostname_len, positive);
+  if (found)
+    _copy_hostname(hostname, hostname_size, hostname_len, cached_hostname, cached_hostname_len);
+  g_static_rw_lock_reader_unlock(&dns_cache_hosts.lock);
+
+  return found;
+}
+
+static gboolean
+_lookup_shard(gint family, void *addr, gchar *hostname, gsize hostname_size, gsize *hostname_len,
+              gboolean *positive)
+{
+  DNSCacheKey key;
+  DNSCacheShard *shard;
+  const gchar *cached_hostname;
+  gsize cached_hostname_len;
+  gboolean found;
+
+  dns_cache_fill_key(&key, family, addr);
+  shard = _get_shard(&key);
+
+  g_static_mutex_lock(&shard->lock);
+  found = dns_cache_lookup_entry(shard->cache, family, addr, cached_g_current_time_sec(),
+                                 &cached_hostname, &cached_hostname_len, positive);
+  if (found)
+    _copy_hostname(hostname, hostname_size, hostname_len, cached_hostname, cached_hostname_len);
+  g_static_mutex_unlock(&shard->lock);
+
+  return found;
+}
 
 gboolean
-dns_caching_lookup(gint family, void *addr, const gchar **hostname, gsize *hostname_len, gboolean *positive)
+dns_caching_lookup(gint family, void *addr, gchar *hostname, gsize hostname_size, gsize *hostname_len,
+                   gboolean *positive)
 {
-  return dns_cache_lookup(dns_cache, family, addr, hostname, hostname_len, positive);
+  gboolean found;
+
+  found = _lookup_hosts(family, addr, hostname, hostname_size, hostname_len, positive) ||
+          _lookup_shard(family, addr, hostname, hostname_size, hostname_len, positive);
+
+  stats_counter_inc(found ? dns_cache_stats.hits : dns_cache_stats.misses);
+  return found;
+}
+
+static void
+_store_dynamic(gint family, void *addr, const gchar *hostname, gboolean positive, gboolean pending)
+{
+  DNSCacheKey key;
+  DNSCacheShard *shard;
+  DNSCacheEntry *entry;
+
+  dns_cache_fill_key(&key, family, addr);
+  shard = _get_shard(&key);
+
+  g_static_mutex_lock(&shard->lock);
+  entry = dns_cache_store(shard->cache, FALSE, family, addr, hostname, positive, cached_g_current_time_sec());
+  entry->pending = pending;
+  g_static_mutex_unlock(&shard->lock);
 }
 
 void
 dns_caching_store(gint family, void *addr, const gchar *hostname, gboolean positive)
 {
-  dns_cache_store_dynamic(dns_cache, family, addr, hostname, positive);
+  _store_dynamic(family, addr, hostname, positive, FALSE);
+}
+
+void
+dns_caching_account_resolve_time(gint64 elapsed_usec)
+{
+  stats_counter_inc(dns_cache_stats.resolved);
+  stats_counter_add(dns_cache_stats.resolve_time, elapsed_usec);
+}
+
+static void
+_free_resolve_request(DNSResolveRequest *request)
+{
+  g_sockaddr_unref(request->saddr);
+  g_free(request->address);
+  g_free(request);
+}
+
+static void
+_resolve_request(gpointer data, gpointer user_data)
+{
+  DNSResolveRequest *request = (DNSResolveRequest *) data;
+  gchar buf[256];
+  const gchar *hostname = NULL;
+
+  if (!g_atomic_int_get(&dns_resolver_pool_stopping))
+    hostname = request->resolve(request->saddr, buf, sizeof(buf));
+
+  if (hostname)
+    dns_caching_store(request->key.family, &request->key.addr, hostname, TRUE);
+  else
+    dns_caching_store(request->key.family, &request->key.addr, request->address, FALSE);
+
+  _free_resolve_request(request);
+}
+
+/*
+ * Queues the lookup of @saddr to the resolver threads, if there are any.
+ * Until the lookup finishes, @address is returned by lookups as a failed
+ * match, so the same address is not queued again in the meantime.
+ *
+ * Returns FALSE if the caller has to resolve the address itself.
+ */
+gboolean
+dns_caching_resolve_async(GSockAddr *saddr, void *addr, const gchar *address, DNSCacheResolveFunc resolve)
+{
+  DNSResolveRequest *request;
+
+  g_static_mutex_lock(&dns_resolver_pool_lock);
+  if (!dns_resolver_pool || effective_dns_cache_options.resolvers == 0)
+    {
+      g_static_mutex_unlock(&dns_resolver_pool_lock);
+      return FALSE;
+    }
+
+  _store_dynamic(saddr->sa.sa_family, addr, address, FALSE, TRUE);
+  if (g_thread_pool_unprocessed(dns_resolver_pool) < DNS_CACHE_MAX_PENDING_RESOLVES)
+    {
+      request = g_new0(DNSResolveRequest, 1);
+      request->saddr = g_sockaddr_ref(saddr);
+      dns_cache_fill_key(&request->key, saddr->sa.sa_family, addr);
+      request->address = g_strdup(address);
+      request->resolve = resolve;
+      g_thread_pool_push(dns_resolver_pool, request, NULL);
+    }
+  g_static_mutex_unlock(&dns_resolver_pool_lock);
+  return TRUE;
+}
+
+static void
+_update_resolver_pool(gint resolvers)
+{
+  if (resolvers == 0)
+    return;
+
+  g_static_mutex_lock(&dns_resolver_pool_lock);
+  if (!dns_resolver_pool)
+    dns_resolver_pool = g_thread_pool_new(_resolve_request, NULL, resolvers, FALSE, NULL);
+  else
+    g_thread_pool_set_max_threads(dns_resolver_pool, resolvers, NULL);
+  g_static_mutex_unlock(&dns_resolver_pool_lock);
+}
+
+static void
+_stop_resolver_pool(void)
+{
+  GThreadPool *pool;
+
+  /* lookups started from now on resolve the address themselves */
+  g_static_mutex_lock(&dns_resolver_pool_lock);
+  pool = dns_resolver_pool;
+  dns_resolver_pool = NULL;
+  g_static_mutex_unlock(&dns_resolver_pool_lock);
+
+  if (!pool)
+    return;
+
+  /* pending requests are dropped without resolving them */
+  g_atomic_int_set(&dns_resolver_pool_stopping, TRUE);
+  g_thread_pool_free(pool, FALSE, TRUE);
+  g_atomic_int_set(&dns_resolver_pool_stopping, FALSE);
+}
+
+static void
+_update_shard_options(DNSCacheShard *shard, const DNSCacheOptions *options)
+{
+  g_static_mutex_lock(&shard->lock);
+  g_free(shard->options.hosts);
+  shard->options.cache_size = MAX(1, (options->cache_size + DNS_CACHE_NUM_SHARDS - 1) / DNS_CACHE_NUM_SHARDS);
+  shard->options.expire = options->expire;
+  shard->options.expire_failed = options->expire_failed;
+  /* hosts file entries are kept in dns_cache_hosts */
+  shard->options.hosts = NULL;
+  g_static_mutex_unlock(&shard->lock);
+}
+
+static void
+_update_hosts_options(const DNSCacheOptions *options)
+{
+  DNSCache *cache = dns_cache_hosts.cache;
+
+  g_static_rw_lock_writer_lock(&dns_cache_hosts.lock);
+  if (g_strcmp0(dns_cache_hosts.options.hosts, options->hosts) != 0)
+    {
+      g_free(dns_cache_hosts.options.hosts);
+      dns_cache_hosts.options.hosts = g_strdup(options->hosts);
+
+      /* reload on the next lookup, even if the new file is older */
+      cache->hosts_mtime = -1;
+      cache->hosts_checktime = 0;
+    }
+  g_static_rw_lock_writer_unlock(&dns_cache_hosts.lock);
 }
 
 void
@@ -444,49 +721,305 @@ dns_caching_update_options(const DNSCacheOptions *new_options)
   options->expire = new_options->expire;
   options->expire_failed = new_options->expire_failed;
   options->hosts = g_strdup(new_options->hosts);
+  options->resolvers = new_options->resolvers;
+
+  for (gint i = 0; i < DNS_CACHE_NUM_SHARDS; i++)
+    _update_shard_options(&dns_cache_shards[i], options);
+  _update_hosts_options(options);
+  _update_resolver_pool(options->resolvers);
 }
 
-void
-dns_caching_thread_init(void)
+/**************************************************************************
+ * Persisting the cache.
+ *
+ * Resolved entries are stored in the persist file when syslog-ng shuts
+ * down and are restored when it starts again, so that a
+ * restart does not need to resolve every address again.  As persist
+ * entries are limited in size, the entries are stored in chunks named
+ * "dns_cache.0", "dns_cache.1", and so on.  Hosts file entries are not
+ * persisted, they are loaded from the hosts file anyway, neither are the
+ * entries of lookups still waiting for a resolver.
+ **************************************************************************/
+
+#define DNS_CACHE_PERSIST_CHUNK_SIZE 8192
+#define DNS_CACHE_PERSIST_VERSION 1
+
+static void
+_format_chunk_persist_name(gchar *persist_name, gsize persist_name_size, gint index)
+{
+  g_snprintf(persist_name, persist_name_size, "dns_cache.%d", index);
+}
+
+static gsize
+_get_entry_addr_len(DNSCacheEntry *entry)
+{
+#if SYSLOG_NG_ENABLE_IPV6
+  if (entry->key.family == AF_INET6)
+    return sizeof(entry->key.addr.ip6);
+#endif
+  return sizeof(entry->key.addr.ip);
+}
+
+static void
+_serialize_entry(SerializeArchive *sa, DNSCacheEntry *entry)
+{
+  serialize_write_uint8(sa, entry->key.family == AF_INET ? 4 : 6);
+  serialize_write_uint8(sa, entry->positive);
+  serialize_write_uint64(sa, entry->resolved);
+  serialize_write_blob(sa, &entry->key.addr, _get_entry_addr_len(entry));
+  serialize_write_cstring(sa, entry->hostname, entry->hostname_len);
+}
+
+static void
+_store_chunk(PersistState *state, gint index, GString *chunk)
+{
+  gchar persist_name[32];
+
+  _format_chunk_persist_name(persist_name, sizeof(persist_name), index);
+  persist_state_alloc_string(state, persist_name, chunk->str, chunk->len);
+}
+
+static void
+_persist_entries(PersistState *state)
+{
+  GString *chunk = g_string_sized_new(DNS_CACHE_PERSIST_CHUNK_SIZE);
+  SerializeArchive *sa = serialize_string_archive_new(chunk);
+  gchar persist_name[32];
+  gint num_chunks = 0;
+
+  for (gint i = 0; i < DNS_CACHE_NUM_SHARDS; i++)
+    {
+      DNSCacheShard *shard = &dns_cache_shards[i];
+      struct iv_list_head *ilh;
+
+      g_static_mutex_lock(&shard->lock);
+      iv_list_for_each(ilh, &shard->cache->cache_list)
+      {
+        DNSCacheEntry *entry = iv_list_entry(ilh, DNSCacheEntry, list);
+        gsize entry_size = 2 + sizeof(guint64) + _get_entry_addr_len(entry) + sizeof(guint32) + entry->hostname_len;
+
+        if (entry->pending)
+          continue;
+
+        if (chunk->len > 0 && chunk->len + entry_size > DNS_CACHE_PERSIST_CHUNK_SIZE)
+          {
+            _store_chunk(state, num_chunks++, chunk);
+            g_string_truncate(chunk, 0);
+          }
+        if (chunk->len == 0)
+          serialize_write_uint8(sa, DNS_CACHE_PERSIST_VERSION);
+        _serialize_entry(sa, entry);
+      }
+      g_static_mutex_unlock(&shard->lock);
+    }
+  if (chunk->len > 0)
+    _store_chunk(state, num_chunks++, chunk);
+
+  /* drop the chunks left over from a larger cache */
+  for (gint i = num_chunks; ; i++)
+    {
+      _format_chunk_persist_name(persist_name, sizeof(persist_name), i);
+      if (!persist_state_remove_entry(state, persist_name))
+        break;
+    }
+
+  serialize_archive_free(sa);
+  g_string_free(chunk, TRUE);
+}
+
+static gboolean
+_restore_entry(SerializeArchive *sa, time_t now)
+{
+  DNSCacheKey key;
+  DNSCacheShard *shard;
+  guint8 family, positive;
+  guint64 resolved;
+  gsize addr_len;
+  gchar *hostname = NULL;
+
+  if (!serialize_read_uint8(sa, &family) ||
+      !serialize_read_uint8(sa, &positive) ||
+      !serialize_read_uint64(sa, &resolved))
+    return FALSE;
+
+  if (family == 4)
+    {
+      key.family = AF_INET;
+      addr_len = sizeof(key.addr.ip);
+    }
+#if SYSLOG_NG_ENABLE_IPV6
+  else if (family == 6)
+    {
+      key.family = AF_INET6;
+      addr_len = sizeof(key.addr.ip6);
+    }
+#endif
+  else
+    return FALSE;
+
+  if (!serialize_read_blob(sa, &key.addr, addr_len) ||
+      !serialize_read_cstring(sa, &hostname, NULL))
+    {
+      g_free(hostname);
+      return FALSE;
+    }
+
+  shard = _get_shard(&key);
+  g_static_mutex_lock(&shard->lock);
+  if (!dns_cache_is_expired(shard->cache, resolved, positive, now))
+    dns_cache_store(shard->cache, FALSE, key.family, &key.addr, hostname, positive, resolved);
+  g_static_mutex_unlock(&shard->lock);
+
+  g_free(hostname);
+  return TRUE;
+}
+
+static void
+_restore_chunk(gchar *chunk, gsize chunk_len, time_t now)
+{
+  SerializeArchive *sa = serialize_buffer_archive_new(chunk, chunk_len);
+  guint8 version = 0;
+
+  if (!serialize_read_uint8(sa, &version) || version != DNS_CACHE_PERSIST_VERSION)
+    {
+      msg_warning("Ignoring persisted DNS cache entries with an unsupported version",
+                  evt_tag_int("version", version));
+      goto exit;
+    }
+
+  while (serialize_buffer_archive_get_pos(sa) < chunk_len)
+    {
+      if (!_restore_entry(sa, now))
+        {
+          msg_warning("Error restoring persisted DNS cache entries, the rest of the chunk is ignored");
+          break;
+        }
+    }
+
+exit:
+  serialize_archive_free(sa);
+}
+
+static void
+_restore_entries(PersistState *state)
 {
-  g_assert(dns_cache == NULL);
+  time_t now = cached_g_current_time_sec();
+  gchar persist_name[32];
 
-  G_LOCK(unused_dns_caches);
-  if (unused_dns_caches)
+  for (gint i = 0; ; i++)
     {
-      dns_cache = unused_dns_caches->data;
-      unused_dns_caches = g_list_delete_link(unused_dns_caches, unused_dns_caches);
+      gchar *chunk;
+      gsize chunk_len;
+
+      _format_chunk_persist_name(persist_name, sizeof(persist_name), i);
+      chunk = persist_state_lookup_string(state, persist_name, &chunk_len, NULL);
+      if (!chunk)
+        break;
+
+      _restore_chunk(chunk, chunk_len, now);
+      g_free(chunk);
     }
-  G_UNLOCK(unused_dns_caches);
+}
+
+static void
+_register_stats(void)
+{
+  StatsClusterKey sc_key;
 
-  if (!dns_cache)
-    dns_cache = dns_cache_new(&effective_dns_cache_options);
+  stats_lock();
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_GLOBAL, "dns_cache", NULL, "hits");
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &dns_cache_stats.hits);
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_GLOBAL, "dns_cache", NULL, "misses");
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &dns_cache_stats.misses);
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_GLOBAL, "dns_cache", NULL, "resolved");
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &dns_cache_stats.resolved);
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_GLOBAL, "dns_cache", NULL, "resolve_time_usec");
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &dns_cache_stats.resolve_time);
+  stats_unlock();
 }
 
+static void
+_unregister_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_GLOBAL, "dns_cache", NULL, "hits");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &dns_cache_stats.hits);
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_GLOBAL, "dns_cache", NULL, "misses");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &dns_cache_stats.misses);
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_GLOBAL, "dns_cache", NULL, "resolved");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &dns_cache_stats.resolved);
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_GLOBAL, "dns_cache", NULL, "resolve_time_usec");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &dns_cache_stats.resolve_time);
+  stats_unlock();
+}
+
+/* @state may be NULL, in which case the cache is not persisted */
 void
-dns_caching_thread_deinit(void)
+dns_caching_init(PersistState *state)
 {
-  g_assert(dns_cache != NULL);
+  _register_stats();
 
-  G_LOCK(unused_dns_caches);
-  unused_dns_caches = g_list_prepend(unused_dns_caches, dns_cache);
-  G_UNLOCK(unused_dns_caches);
-  dns_cache = NULL;
+  dns_cache_persist_state = state;
+  if (state && !dns_cache_restored)
+    {
+      _restore_entries(state);
+      dns_cache_restored = TRUE;
+    }
+}
+
+void
+dns_caching_deinit(void)
+{
+  /* the persist file does not reclaim the space of replaced entries, so
+   * the cache is only stored once, not on every reload */
+  if (dns_cache_persist_state && app_is_shutting_down())
+    _persist_entries(dns_cache_persist_state);
+  dns_cache_persist_state = NULL;
+
+  _unregister_stats();
 }
 
 void
 dns_caching_global_init(void)
 {
   dns_cache_options_defaults(&effective_dns_cache_options);
+  for (gint i = 0; i < DNS_CACHE_NUM_SHARDS; i++)
+    {
+      DNSCacheShard *shard = &dns_cache_shards[i];
+
+      g_static_mutex_init(&shard->lock);
+      dns_cache_options_defaults(&shard->options);
+      _update_shard_options(shard, &effective_dns_cache_options);
+      shard->cache = dns_cache_new(&shard->options);
+    }
+
+  g_static_rw_lock_init(&dns_cache_hosts.lock);
+  dns_cache_options_defaults(&dns_cache_hosts.options);
+  dns_cache_hosts.cache = dns_cache_new(&dns_cache_hosts.options);
+  _update_hosts_options(&effective_dns_cache_options);
 }
 
 void
 dns_caching_global_deinit(void)
 {
-  G_LOCK(unused_dns_caches);
-  g_list_foreach(unused_dns_caches, (GFunc) dns_cache_free, NULL);
-  g_list_free(unused_dns_caches);
-  unused_dns_caches = NULL;
-  G_UNLOCK(unused_dns_caches);
+  _stop_resolver_pool();
+  for (gint i = 0; i < DNS_CACHE_NUM_SHARDS; i++)
+    {
+      DNSCacheShard *shard = &dns_cache_shards[i];
+
+      dns_cache_free(shard->cache);
+      shard->cache = NULL;
+      dns_cache_options_destroy(&shard->options);
+      g_static_mutex_free(&shard->lock);
+    }
+
+  dns_cache_free(dns_cache_hosts.cache);
+  dns_cache_hosts.cache = NULL;
+  dns_cache_options_destroy(&dns_cache_hosts.options);
+  g_static_rw_lock_free(&dns_cache_hosts.lock);
+
+  dns_cache_restored = FALSE;
   dns_cache_options_destroy(&effective_dns_cache_options);
 }
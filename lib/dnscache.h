@@ -27,6 +27,8 @@
 #define DNSCACHE_H_INCLUDED
 
 #include "syslog-ng.h"
+#include "gsockaddr.h"
+#include "persist-state.h"
 
 typedef struct
 {
@@ -34,6 +36,8 @@ typedef struct
   gint expire;
   gint expire_failed;
   gchar *hosts;
+  /* number of background threads resolving cache misses, 0 resolves them synchronously */
+  gint resolvers;
 } DNSCacheOptions;
 
 typedef struct _DNSCache DNSCache;
@@ -48,12 +52,17 @@ void dns_cache_free(DNSCache *self);
 void dns_cache_options_defaults(DNSCacheOptions *options);
 void dns_cache_options_destroy(DNSCacheOptions *options);
 
-gboolean dns_caching_lookup(gint family, void *addr, const gchar **hostname, gsize *hostname_len, gboolean *positive);
+typedef const gchar *(*DNSCacheResolveFunc)(GSockAddr *saddr, gchar *buf, gsize buf_len);
+
+gboolean dns_caching_lookup(gint family, void *addr, gchar *hostname, gsize hostname_size, gsize *hostname_len,
+                            gboolean *positive);
 void dns_caching_store(gint family, void *addr, const gchar *hostname, gboolean positive);
+gboolean dns_caching_resolve_async(GSockAddr *saddr, void *addr, const gchar *address, DNSCacheResolveFunc resolve);
+void dns_caching_account_resolve_time(gint64 elapsed_usec);
 void dns_caching_update_options(const DNSCacheOptions *dns_cache_options);
 
-void dns_caching_thread_init(void);
-void dns_caching_thread_deinit(void);
+void dns_caching_init(PersistState *state);
+void dns_caching_deinit(void);
 void dns_caching_global_init(void);
 void dns_caching_global_deinit(void);
 
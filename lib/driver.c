@@ -24,6 +24,7 @@
 
 #include "driver.h"
 #include "logqueue-fifo.h"
+#include "logqueue-ring.h"
 #include "afinter.h"
 #include "cfg-tree.h"
 #include "messages.h"
@@ -256,9 +257,13 @@ _create_memory_queue(LogDestDriver *self, const gchar *persist_name)
                        "flags(flow-control) option set.) To enable the new behaviour, update the @version string in "
                        "your configuration and consider lowering the value of log-fifo-size().");
 
+      if (self->log_fifo_lockless)
+        return log_queue_ring_legacy_new(log_fifo_size, persist_name);
       return log_queue_fifo_legacy_new(log_fifo_size, persist_name);
     }
 
+  if (self->log_fifo_lockless)
+    return log_queue_ring_new(log_fifo_size, persist_name);
   return log_queue_fifo_new(log_fifo_size, persist_name);
 }
 
@@ -272,7 +277,8 @@ log_dest_driver_acquire_memory_queue(LogDestDriver *self, const gchar *persist_n
   if (persist_name)
     queue = cfg_persist_config_fetch(cfg, persist_name);
 
-  if (queue && !log_queue_has_type(queue, log_queue_fifo_get_type()))
+  QueueType expected_type = self->log_fifo_lockless ? log_queue_ring_get_type() : log_queue_fifo_get_type();
+  if (queue && !log_queue_has_type(queue, expected_type))
     {
       log_queue_unref(queue);
       queue = NULL;
@@ -391,6 +397,7 @@ log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg)
   self->acquire_queue = log_dest_driver_acquire_memory_queue;
   self->release_queue = log_dest_driver_release_queue_method;
   self->log_fifo_size = -1;
+  self->log_fifo_lockless = FALSE;
   self->throttle = 0;
 }
 
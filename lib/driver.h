@@ -166,6 +166,7 @@ struct _LogDestDriver
   GList *queues;
 
   gint log_fifo_size;
+  gboolean log_fifo_lockless;
   gint throttle;
   StatsCounterItem *queued_global_messages;
 };
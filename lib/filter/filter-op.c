@@ -22,11 +22,26 @@
  *
  */
 #include "filter-op.h"
+#include "filter-re.h"
+#include "messages.h"
+#include "str-utils.h"
+
+typedef struct _FilterOrGroup
+{
+  NVHandle value_handle;
+  gint num_patterns;
+  LogMatcherSet *matchers;
+} FilterOrGroup;
 
 typedef struct _FilterOp
 {
   FilterExprNode super;
   FilterExprNode *left, *right;
+
+  /* nested OR nodes are evaluated by the topmost OR node of the chain */
+  gboolean chained;
+  GArray *or_groups;
+  GPtrArray *or_operands;
 } FilterOp;
 
 static gboolean
@@ -48,11 +63,14 @@ fop_init(FilterExprNode *s, GlobalConfig *cfg)
   return TRUE;
 }
 
+static void fop_or_free_groups(FilterOp *self);
+
 static void
 fop_free(FilterExprNode *s)
 {
   FilterOp *self = (FilterOp *) s;
 
+  fop_or_free_groups(self);
   filter_expr_unref(self->left);
   filter_expr_unref(self->right);
 }
@@ -74,16 +92,212 @@ fop_or_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalO
           || filter_expr_eval_with_context(self->right, msgs, num_msg, options)) ^ s->comp;
 }
 
+static gboolean
+fop_or_eval_group(FilterOrGroup *group, LogMessage *msg)
+{
+  NVTable *payload;
+  const gchar *value;
+  gssize len = 0;
+  gboolean rc;
+
+  payload = nv_table_ref(msg->payload);
+  value = log_msg_get_value(msg, group->value_handle, &len);
+  APPEND_ZERO(value, value, len);
+
+  msg_trace("match() evaluation started",
+            evt_tag_str("input", value),
+            evt_tag_int("patterns", group->num_patterns),
+            evt_tag_str("value", log_msg_get_value_name(group->value_handle, NULL)),
+            evt_tag_printf("msg", "%p", msg));
+  rc = log_matcher_set_match(group->matchers, msg, group->value_handle, value, len);
+
+  nv_table_unref(payload);
+  return rc;
+}
+
+/* the operands of an OR chain are free of side effects (see
+ * fop_or_optimize()), so the order of evaluation does not matter */
+static gboolean
+fop_or_eval_optimized(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
+{
+  FilterOp *self = (FilterOp *) s;
+  LogMessage *msg = msgs[num_msg - 1];
+
+  for (gint i = 0; i < self->or_groups->len; i++)
+    {
+      if (fop_or_eval_group(&g_array_index(self->or_groups, FilterOrGroup, i), msg))
+        return TRUE ^ s->comp;
+    }
+
+  for (gint i = 0; i < self->or_operands->len; i++)
+    {
+      if (filter_expr_eval_with_context(g_ptr_array_index(self->or_operands, i), msgs, num_msg, options))
+        return TRUE ^ s->comp;
+    }
+  return FALSE ^ s->comp;
+}
+
+static gboolean
+fop_is_chained_or(FilterExprNode *s)
+{
+  return s->free_fn == fop_free && ((FilterOp *) s)->chained;
+}
+
+static void
+fop_or_collect_operands(FilterExprNode *s, GPtrArray *operands)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  if (!fop_is_chained_or(self->left))
+    g_ptr_array_add(operands, self->left);
+  else
+    fop_or_collect_operands(self->left, operands);
+
+  if (!fop_is_chained_or(self->right))
+    g_ptr_array_add(operands, self->right);
+  else
+    fop_or_collect_operands(self->right, operands);
+}
+
+static gint
+fop_or_count_value_matches(GPtrArray *operands, NVHandle value_handle)
+{
+  gint count = 0;
+
+  for (gint i = 0; i < operands->len; i++)
+    {
+      FilterExprNode *operand = g_ptr_array_index(operands, i);
+
+      if (filter_re_is_plain_value_match(operand) && filter_re_get_value_handle(operand) == value_handle)
+        count++;
+    }
+  return count;
+}
+
+static FilterOrGroup *
+fop_or_lookup_group(FilterOp *self, NVHandle value_handle)
+{
+  for (gint i = 0; i < self->or_groups->len; i++)
+    {
+      FilterOrGroup *group = &g_array_index(self->or_groups, FilterOrGroup, i);
+
+      if (group->value_handle == value_handle)
+        return group;
+    }
+
+  FilterOrGroup group = { .value_handle = value_handle, .matchers = log_matcher_set_new() };
+
+  g_array_append_val(self->or_groups, group);
+  return &g_array_index(self->or_groups, FilterOrGroup, self->or_groups->len - 1);
+}
+
+static void
+fop_or_free_groups(FilterOp *self)
+{
+  if (!self->or_groups)
+    return;
+
+  for (gint i = 0; i < self->or_groups->len; i++)
+    log_matcher_set_free(g_array_index(self->or_groups, FilterOrGroup, i).matchers);
+  g_array_free(self->or_groups, TRUE);
+  g_ptr_array_free(self->or_operands, TRUE);
+  self->or_groups = NULL;
+  self->or_operands = NULL;
+  self->super.eval = fop_or_eval;
+}
+
+/*
+ * Matches against the same name-value pair in an OR chain, like
+ * message("foo") or message("bar") or message("baz*" type(glob)), are
+ * merged into a single LogMatcherSet, so the value is fetched and scanned
+ * once instead of once per pattern.
+ */
+static void
+fop_or_optimize(FilterOp *self)
+{
+  GPtrArray *operands;
+
+  fop_or_free_groups(self);
+
+  if (self->super.modify)
+    return;
+
+  operands = g_ptr_array_new();
+  fop_or_collect_operands(&self->super, operands);
+
+  self->or_groups = g_array_new(FALSE, FALSE, sizeof(FilterOrGroup));
+  self->or_operands = g_ptr_array_new();
+  for (gint i = 0; i < operands->len; i++)
+    {
+      FilterExprNode *operand = g_ptr_array_index(operands, i);
+
+      if (filter_re_is_plain_value_match(operand) &&
+          fop_or_count_value_matches(operands, filter_re_get_value_handle(operand)) > 1)
+        {
+          FilterOrGroup *group = fop_or_lookup_group(self, filter_re_get_value_handle(operand));
+
+          log_matcher_set_add(group->matchers, filter_re_get_matcher(operand));
+          group->num_patterns++;
+        }
+      else
+        {
+          g_ptr_array_add(self->or_operands, operand);
+        }
+    }
+  g_ptr_array_free(operands, TRUE);
+
+  if (self->or_groups->len == 0)
+    {
+      fop_or_free_groups(self);
+      return;
+    }
+
+  for (gint i = 0; i < self->or_groups->len; i++)
+    {
+      FilterOrGroup *group = &g_array_index(self->or_groups, FilterOrGroup, i);
+
+      log_matcher_set_compile(group->matchers);
+      msg_debug("Merging OR'd matches against the same value",
+                evt_tag_str("value", log_msg_get_value_name(group->value_handle, NULL)),
+                evt_tag_int("patterns", group->num_patterns));
+    }
+  self->super.eval = fop_or_eval_optimized;
+}
+
+static gboolean
+fop_or_init(FilterExprNode *s, GlobalConfig *cfg)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  if (!fop_init(s, cfg))
+    return FALSE;
+
+  if (!self->chained)
+    fop_or_optimize(self);
+  return TRUE;
+}
+
+static void
+fop_or_chain_operand(FilterExprNode *operand)
+{
+  if (operand->eval == fop_or_eval && !operand->comp)
+    ((FilterOp *) operand)->chained = TRUE;
+}
+
 FilterExprNode *
 fop_or_new(FilterExprNode *e1, FilterExprNode *e2)
 {
   FilterOp *self = g_new0(FilterOp, 1);
 
   fop_init_instance(self);
+  self->super.init = fop_or_init;
   self->super.eval = fop_or_eval;
   self->left = e1;
   self->right = e2;
   self->super.type = "OR";
+
+  fop_or_chain_operand(e1);
+  fop_or_chain_operand(e2);
   return &self->super;
 }
 
@@ -102,6 +102,30 @@ filter_re_get_matcher_options(FilterExprNode *s)
   return &self->matcher_options;
 }
 
+/* TRUE if the node matches a single name-value pair without negating the
+ * result or changing the message, e.g. it can be merged with similar nodes */
+gboolean
+filter_re_is_plain_value_match(FilterExprNode *s)
+{
+  return s->eval == filter_re_eval && !s->comp && !s->modify;
+}
+
+NVHandle
+filter_re_get_value_handle(FilterExprNode *s)
+{
+  FilterRE *self = (FilterRE *) s;
+
+  return self->value_handle;
+}
+
+LogMatcher *
+filter_re_get_matcher(FilterExprNode *s)
+{
+  FilterRE *self = (FilterRE *) s;
+
+  return self->matcher;
+}
+
 gboolean
 filter_re_compile_pattern(FilterExprNode *s, const gchar *re, GError **error)
 {
@@ -30,6 +30,9 @@
 
 LogMatcherOptions *filter_re_get_matcher_options(FilterExprNode *s);
 gboolean filter_re_compile_pattern(FilterExprNode *s, const gchar *re, GError **error);
+gboolean filter_re_is_plain_value_match(FilterExprNode *s);
+NVHandle filter_re_get_value_handle(FilterExprNode *s);
+LogMatcher *filter_re_get_matcher(FilterExprNode *s);
 
 FilterExprNode *filter_re_new(NVHandle value_handle);
 FilterExprNode *filter_source_new(void);
@@ -94,4 +94,48 @@ ParameterizedTest(FilterParams *params, filter_op, test_or_evaluation)
   testcase(msg, filter, params->expected_result);
 }
 
+ParameterizedTestParameters(filter_op, test_or_evaluation_of_merged_matches)
+{
+  static FilterParams test_data_list[] =
+  {
+    // literals
+    {.config_snippet = "message('PTHREAD' type(string) flags(prefix)) or message('foo' type(string))", .expected_result = TRUE },
+    {.config_snippet = "message('foo' type(string)) or message('support' type(string) flags(substring))", .expected_result = TRUE },
+    {.config_snippet = "message('foo' type(string)) or message('pthread support initialized' type(string) flags(icase))", .expected_result = TRUE },
+    {.config_snippet = "message('foo' type(string)) or message('support' type(string) flags(prefix))", .expected_result = FALSE },
+    {.config_snippet = "message('foo' type(string)) or message('PTHREAD' type(string))", .expected_result = FALSE },
+    {.config_snippet = "message('foo' type(string) flags(substring)) or message('pthread' type(string) flags(substring))", .expected_result = FALSE },
+
+    // regexps
+    {.config_snippet = "message('^foo') or message('supp?ort') or message('bar$')", .expected_result = TRUE },
+    {.config_snippet = "message('^foo') or message('^support') or message('bar$')", .expected_result = FALSE },
+    {.config_snippet = "message('^foo') or message('pthread' flags(icase))", .expected_result = TRUE },
+    {.config_snippet = "message('(foo)\\1') or message('(ini)tial')", .expected_result = TRUE },
+
+    // globs
+    {.config_snippet = "program('foo*' type(glob)) or program('open?pn' type(glob))", .expected_result = TRUE },
+    {.config_snippet = "program('foo*' type(glob)) or program('open' type(glob))", .expected_result = FALSE },
+    {.config_snippet = "program('foo*' type(glob)) or program('open.*' type(glob))", .expected_result = FALSE },
+
+    // mixed types, mixed values and non-mergeable operands
+    {.config_snippet = "message('foo' type(string)) or message('^PTH') or message('*init*' type(glob))", .expected_result = TRUE },
+    {.config_snippet = "message('foo' type(string)) or program('openvpn') or message('bar')", .expected_result = TRUE },
+    {.config_snippet = "message('foo' type(string)) or facility(2) or message('bar')", .expected_result = TRUE },
+    {.config_snippet = "message('foo' type(string)) or not message('bar') or message('baz')", .expected_result = TRUE },
+    {.config_snippet = "message('foo' type(string)) or not message('PTHREAD') or message('baz')", .expected_result = FALSE },
+    {.config_snippet = "message('foo') or (message('bar') or message('PTHREAD'))", .expected_result = TRUE },
+    {.config_snippet = "message('foo') or not (message('bar') or message('PTHREAD'))", .expected_result = FALSE },
+    {.config_snippet = "message('foo') or (message('bar') and message('PTHREAD'))", .expected_result = FALSE },
+  };
+
+  return cr_make_param_array(FilterParams, test_data_list, G_N_ELEMENTS(test_data_list));
+}
+
+ParameterizedTest(FilterParams *params, filter_op, test_or_evaluation_of_merged_matches)
+{
+  const gchar *msg = "<16> openvpn[2499]: PTHREAD support initialized";
+  FilterExprNode *filter = _compile_standalone_filter(params->config_snippet);
+  testcase(msg, filter, params->expected_result);
+}
+
 TestSuite(filter_op, .init = setup, .fini = teardown);
@@ -24,6 +24,227 @@
 #include "find-crlf.h"
 
 #include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FIND_CRLF_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define FIND_CRLF_HAVE_X86_SIMD 0
+#endif
+
+#if FIND_CRLF_HAVE_X86_SIMD
+
+/*
+ * SIMD implementations of the line terminator scanners.
+ *
+ * SSE2 is part of the x86_64 baseline, AVX2 is selected at runtime if the
+ * CPU supports it.  Both compare a complete vector of input against the
+ * terminator characters and turn the result into a bitmask, the position
+ * of the set bits are the positions of the terminators.
+ */
+
+static inline gsize
+_find_first_of3_scalar(const guchar *s, gsize n, guchar a, guchar b, guchar c)
+{
+  gsize i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (s[i] == a || s[i] == b || s[i] == c)
+        break;
+    }
+  return i;
+}
+
+static gsize
+_find_first_of3_sse2(const guchar *s, gsize n, guchar a, guchar b, guchar c)
+{
+  const __m128i va = _mm_set1_epi8(a);
+  const __m128i vb = _mm_set1_epi8(b);
+  const __m128i vc = _mm_set1_epi8(c);
+  gsize i;
+
+  for (i = 0; i + sizeof(__m128i) <= n; i += sizeof(__m128i))
+    {
+      __m128i chunk = _mm_loadu_si128((const __m128i *) (s + i));
+      __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va),
+                                                _mm_cmpeq_epi8(chunk, vb)),
+                                   _mm_cmpeq_epi8(chunk, vc));
+      guint32 mask = _mm_movemask_epi8(match);
+
+      if (mask)
+        return i + __builtin_ctz(mask);
+    }
+  return i + _find_first_of3_scalar(s + i, n - i, a, b, c);
+}
+
+__attribute__((target("avx2")))
+static gsize
+_find_first_of3_avx2(const guchar *s, gsize n, guchar a, guchar b, guchar c)
+{
+  const __m256i va = _mm256_set1_epi8(a);
+  const __m256i vb = _mm256_set1_epi8(b);
+  const __m256i vc = _mm256_set1_epi8(c);
+  gsize i;
+
+  for (i = 0; i + sizeof(__m256i) <= n; i += sizeof(__m256i))
+    {
+      __m256i chunk = _mm256_loadu_si256((const __m256i *) (s + i));
+      __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, va),
+                                                      _mm256_cmpeq_epi8(chunk, vb)),
+                                      _mm256_cmpeq_epi8(chunk, vc));
+      guint32 mask = _mm256_movemask_epi8(match);
+
+      if (mask)
+        return i + __builtin_ctz(mask);
+    }
+  return i + _find_first_of3_sse2(s + i, n - i, a, b, c);
+}
+
+/* stores the offsets of the bits set in @mask, returns FALSE if @offsets
+ * became full, in which case @scanned is set after the last offset stored */
+static inline gboolean
+_collect_eom_offsets(guint32 mask, gsize base, guint32 *offsets, gsize max_offsets, gsize *found, gsize *scanned)
+{
+  while (mask)
+    {
+      gsize ofs = base + __builtin_ctz(mask);
+
+      offsets[(*found)++] = ofs;
+      if (*found == max_offsets)
+        {
+          *scanned = ofs + 1;
+          return FALSE;
+        }
+      mask &= mask - 1;
+    }
+  return TRUE;
+}
+
+static gsize
+_find_eom_batch_tail(const guchar *s, gsize n, gsize base, guint32 *offsets, gsize max_offsets, gsize found,
+                     gsize *scanned)
+{
+  gsize i;
+
+  for (i = base; i < n; i++)
+    {
+      if (s[i] == '\n' || s[i] == '\0')
+        {
+          offsets[found++] = i;
+          if (found == max_offsets)
+            {
+              *scanned = i + 1;
+              return found;
+            }
+        }
+    }
+  *scanned = n;
+  return found;
+}
+
+static gsize
+_find_eom_batch_sse2(const guchar *s, gsize n, guint32 *offsets, gsize max_offsets, gsize *scanned)
+{
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i zero = _mm_setzero_si128();
+  gsize found = 0;
+  gsize i;
+
+  for (i = 0; i + sizeof(__m128i) <= n; i += sizeof(__m128i))
+    {
+      __m128i chunk = _mm_loadu_si128((const __m128i *) (s + i));
+      guint32 mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, nl), _mm_cmpeq_epi8(chunk, zero)));
+
+      if (!_collect_eom_offsets(mask, i, offsets, max_offsets, &found, scanned))
+        return found;
+    }
+  return _find_eom_batch_tail(s, n, i, offsets, max_offsets, found, scanned);
+}
+
+__attribute__((target("avx2")))
+static gsize
+_find_eom_batch_avx2(const guchar *s, gsize n, guint32 *offsets, gsize max_offsets, gsize *scanned)
+{
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const __m256i zero = _mm256_setzero_si256();
+  gsize found = 0;
+  gsize i;
+
+  for (i = 0; i + sizeof(__m256i) <= n; i += sizeof(__m256i))
+    {
+      __m256i chunk = _mm256_loadu_si256((const __m256i *) (s + i));
+      guint32 mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, nl),
+                                                          _mm256_cmpeq_epi8(chunk, zero)));
+
+      if (!_collect_eom_offsets(mask, i, offsets, max_offsets, &found, scanned))
+        return found;
+    }
+  return _find_eom_batch_tail(s, n, i, offsets, max_offsets, found, scanned);
+}
+
+typedef gsize (*FindFirstOf3Func)(const guchar *s, gsize n, guchar a, guchar b, guchar c);
+typedef gsize (*FindEOMBatchFunc)(const guchar *s, gsize n, guint32 *offsets, gsize max_offsets, gsize *scanned);
+
+static FindFirstOf3Func find_first_of3;
+static FindEOMBatchFunc find_eom_batch_impl;
+
+/* NOTE: the selection is idempotent, so it does not matter if multiple
+ * threads happen to run it concurrently */
+static void
+_select_implementation(void)
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    {
+      find_eom_batch_impl = _find_eom_batch_avx2;
+      find_first_of3 = _find_first_of3_avx2;
+    }
+  else
+    {
+      find_eom_batch_impl = _find_eom_batch_sse2;
+      find_first_of3 = _find_first_of3_sse2;
+    }
+}
+
+static inline gsize
+_find_first_of3(const guchar *s, gsize n, guchar a, guchar b, guchar c)
+{
+  if (G_UNLIKELY(!find_first_of3))
+    _select_implementation();
+  return find_first_of3(s, n, a, b, c);
+}
+
+gchar *
+find_cr_or_lf(gchar *s, gsize n)
+{
+  gsize ofs = _find_first_of3((const guchar *) s, n, '\r', '\n', '\0');
+
+  if (ofs == n || s[ofs] == '\0')
+    return NULL;
+  return s + ofs;
+}
+
+const guchar *
+find_eom(const guchar *s, gsize n)
+{
+  gsize ofs = _find_first_of3(s, n, '\n', '\0', '\0');
+
+  if (ofs == n)
+    return NULL;
+  return s + ofs;
+}
+
+gsize
+find_eom_batch(const guchar *s, gsize n, guint32 *offsets, gsize max_offsets, gsize *scanned)
+{
+  if (G_UNLIKELY(!find_eom_batch_impl))
+    _select_implementation();
+  return find_eom_batch_impl(s, n, offsets, max_offsets, scanned);
+}
+
+#else
+
 /**
  * This is an optimized version of finding either a CR or LF or NUL
  * character in a buffer.  It is used to find these line terminators in
@@ -97,3 +318,91 @@ find_cr_or_lf(gchar *s, gsize n)
 
   return NULL;
 }
+
+/**
+ * Find the character terminating the buffer.
+ *
+ * NOTE: when looking for the end-of-message here, it either needs to be
+ * terminated via NUL or via NL, when terminating via NL we have to make
+ * sure that there's no NUL left in the message. This function iterates over
+ * the input data and returns a pointer to the first occurrence of NL or NUL.
+ *
+ * It uses an algorithm similar to what there's in libc memchr/strchr.
+ **/
+const guchar *
+find_eom(const guchar *s, gsize n)
+{
+  const guchar *char_ptr;
+  const gulong *longword_ptr;
+  gulong longword, magic_bits, charmask;
+  gchar c;
+
+  c = '\n';
+
+  /* align input to long boundary */
+  for (char_ptr = s; n > 0 && ((gulong) char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr, n--)
+    {
+      if (*char_ptr == c || *char_ptr == '\0')
+        return char_ptr;
+    }
+
+  longword_ptr = (gulong *) char_ptr;
+
+#if GLIB_SIZEOF_LONG == 8
+  magic_bits = 0x7efefefefefefeffL;
+#elif GLIB_SIZEOF_LONG == 4
+  magic_bits = 0x7efefeffL;
+#else
+#error "unknown architecture"
+#endif
+  memset(&charmask, c, sizeof(charmask));
+
+  while (n > sizeof(longword))
+    {
+      longword = *longword_ptr++;
+      if ((((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0 ||
+          ((((longword ^ charmask) + magic_bits) ^ ~(longword ^ charmask)) & ~magic_bits) != 0)
+        {
+          gint i;
+
+          char_ptr = (const guchar *) (longword_ptr - 1);
+
+          for (i = 0; i < sizeof(longword); i++)
+            {
+              if (*char_ptr == c || *char_ptr == '\0')
+                return char_ptr;
+              char_ptr++;
+            }
+        }
+      n -= sizeof(longword);
+    }
+
+  char_ptr = (const guchar *) longword_ptr;
+
+  while (n-- > 0)
+    {
+      if (*char_ptr == c || *char_ptr == '\0')
+        return char_ptr;
+      ++char_ptr;
+    }
+
+  return NULL;
+}
+
+gsize
+find_eom_batch(const guchar *s, gsize n, guint32 *offsets, gsize max_offsets, gsize *scanned)
+{
+  const guchar *p = s;
+  const guchar *eom;
+  gsize found = 0;
+
+  while (found < max_offsets && (eom = find_eom(p, n - (p - s))))
+    {
+      offsets[found++] = eom - s;
+      p = eom + 1;
+    }
+  *scanned = (found == max_offsets) ? (gsize) (p - s) : n;
+  return found;
+}
+
+#endif
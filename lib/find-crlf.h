@@ -27,5 +27,10 @@
 #include "syslog-ng.h"
 
 gchar *find_cr_or_lf(gchar *s, gsize n);
+const guchar *find_eom(const guchar *s, gsize n);
+
+/* collects the offsets of up to @max_offsets EOM characters (NL or NUL)
+ * in a single pass, @scanned is set to the number of bytes processed */
+gsize find_eom_batch(const guchar *s, gsize n, guint32 *offsets, gsize max_offsets, gsize *scanned);
 
 #endif
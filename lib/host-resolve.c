@@ -340,6 +340,23 @@ sockaddr_to_dnscache_key(GSockAddr *saddr)
     }
 }
 
+/* can be called from the resolver threads of the DNS cache too */
+static const gchar *
+resolve_address(GSockAddr *saddr, gchar *buf, gsize buf_len)
+{
+  gint64 start = g_get_monotonic_time();
+  const gchar *hname;
+
+#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
+  hname = resolve_address_using_getnameinfo(saddr, buf, buf_len);
+#else
+  hname = resolve_address_using_gethostbyaddr(saddr, buf, buf_len);
+#endif
+
+  dns_caching_account_resolve_time(g_get_monotonic_time() - start);
+  return hname;
+}
+
 static const gchar *
 resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
                                            const HostResolveOptions *host_resolve_options)
@@ -356,17 +373,22 @@ resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
 
   if (host_resolve_options->use_dns_cache)
     {
-      if (dns_caching_lookup(saddr->sa.sa_family, dnscache_key, (const gchar **) &hname, &hname_len, &positive))
-        return hostname_apply_options_fqdn(hname_len, result_len, hname, positive, host_resolve_options);
+      if (dns_caching_lookup(saddr->sa.sa_family, dnscache_key, hostname_buffer, sizeof(hostname_buffer), &hname_len,
+                             &positive))
+        return hostname_apply_options_fqdn(hname_len, result_len, hostname_buffer, positive, host_resolve_options);
     }
 
   if (!hname && host_resolve_options->use_dns && host_resolve_options->use_dns != 2)
     {
-#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
-      hname = resolve_address_using_getnameinfo(saddr, hostname_buffer, sizeof(hostname_buffer));
-#else
-      hname = resolve_address_using_gethostbyaddr(saddr, hostname_buffer, sizeof(hostname_buffer));
-#endif
+      if (host_resolve_options->use_dns_cache)
+        {
+          /* the address is used until a resolver thread of the cache finds the hostname */
+          hname = g_sockaddr_format(saddr, hostname_buffer, sizeof(hostname_buffer), GSA_ADDRESS_ONLY);
+          if (dns_caching_resolve_async(saddr, dnscache_key, hname, resolve_address))
+            return hostname_apply_options_fqdn(-1, result_len, hname, FALSE, host_resolve_options);
+        }
+
+      hname = resolve_address(saddr, hostname_buffer, sizeof(hostname_buffer));
       positive = (hname != NULL);
     }
 
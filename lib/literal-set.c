@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "literal-set.h"
+
+#include <string.h>
+
+/* the transition table is num_states * num_classes entries, bail out
+ * instead of allocating huge tables for huge sets */
+#define LITERAL_SET_MAX_TABLE_SIZE (4 * 1024 * 1024)
+
+#define LITERAL_SET_NO_STATE G_MAXUINT32
+
+enum
+{
+  LSF_EXACT = 0x01,
+  LSF_PREFIX = 0x02,
+  LSF_SUBSTRING = 0x04,
+};
+
+typedef struct _LiteralSetEntry
+{
+  gchar *literal;
+  gsize literal_len;
+  LiteralSetMode mode;
+} LiteralSetEntry;
+
+/*
+ * Every state corresponds to a node of the trie built from the literals,
+ * depth being the length of the literal prefix it represents.  EXACT and
+ * PREFIX flags only apply to the node itself, as those literals match only
+ * if the trie was followed from the start of the string, SUBSTRING is
+ * inherited along the failure links.
+ */
+typedef struct _LiteralSetState
+{
+  guint32 depth;
+  guint32 flags;
+} LiteralSetState;
+
+struct _LiteralSet
+{
+  gboolean icase;
+  GArray *entries;
+  gboolean has_substrings;
+
+  guint16 classes[256];
+  guint32 num_classes;
+  GArray *states;
+  GArray *transitions;
+};
+
+static void
+_assign_classes(LiteralSet *self)
+{
+  memset(self->classes, 0, sizeof(self->classes));
+
+  /* class 0 is shared by all the characters that do not occur in any of the literals */
+  self->num_classes = 1;
+  for (gint i = 0; i < self->entries->len; i++)
+    {
+      LiteralSetEntry *entry = &g_array_index(self->entries, LiteralSetEntry, i);
+
+      for (gsize j = 0; j < entry->literal_len; j++)
+        {
+          guchar c = entry->literal[j];
+
+          if (self->classes[c])
+            continue;
+
+          if (self->icase)
+            {
+              self->classes[g_ascii_tolower(c)] = self->num_classes;
+              self->classes[g_ascii_toupper(c)] = self->num_classes;
+            }
+          else
+            {
+              self->classes[c] = self->num_classes;
+            }
+          self->num_classes++;
+        }
+    }
+}
+
+static inline guint32 *
+_transition(LiteralSet *self, guint32 state, guint32 class)
+{
+  return &g_array_index(self->transitions, guint32, state * self->num_classes + class);
+}
+
+static guint32
+_add_state(LiteralSet *self, guint32 depth)
+{
+  LiteralSetState state = { .depth = depth, .flags = 0 };
+  guint32 index = self->states->len;
+
+  g_array_append_val(self->states, state);
+  g_array_set_size(self->transitions, (index + 1) * self->num_classes);
+  for (guint32 class = 0; class < self->num_classes; class++)
+    *_transition(self, index, class) = LITERAL_SET_NO_STATE;
+  return index;
+}
+
+static gboolean
+_build_trie(LiteralSet *self)
+{
+  _add_state(self, 0);
+  for (gint i = 0; i < self->entries->len; i++)
+    {
+      LiteralSetEntry *entry = &g_array_index(self->entries, LiteralSetEntry, i);
+      guint32 state = 0;
+
+      for (gsize j = 0; j < entry->literal_len; j++)
+        {
+          guint32 *next = _transition(self, state, self->classes[(guchar) entry->literal[j]]);
+
+          if (*next == LITERAL_SET_NO_STATE)
+            {
+              if ((gsize) (self->states->len + 1) * self->num_classes > LITERAL_SET_MAX_TABLE_SIZE)
+                return FALSE;
+
+              guint32 new_state = _add_state(self, j + 1);
+
+              /* _add_state() might have moved the table */
+              next = _transition(self, state, self->classes[(guchar) entry->literal[j]]);
+              *next = new_state;
+            }
+          state = *next;
+        }
+
+      switch (entry->mode)
+        {
+        case LSM_EXACT:
+          g_array_index(self->states, LiteralSetState, state).flags |= LSF_EXACT;
+          break;
+        case LSM_PREFIX:
+          g_array_index(self->states, LiteralSetState, state).flags |= LSF_PREFIX;
+          break;
+        case LSM_SUBSTRING:
+          g_array_index(self->states, LiteralSetState, state).flags |= LSF_SUBSTRING;
+          break;
+        default:
+          g_assert_not_reached();
+        }
+    }
+  return TRUE;
+}
+
+/* fills in the missing transitions by following the failure links, in
+ * breadth-first order so that the failure state of a node is always
+ * complete by the time the node itself is processed */
+static void
+_build_dfa(LiteralSet *self)
+{
+  guint32 *failure = g_new0(guint32, self->states->len);
+  guint32 *queue = g_new(guint32, self->states->len);
+  guint32 head = 0, tail = 0;
+
+  for (guint32 class = 0; class < self->num_classes; class++)
+    {
+      guint32 *next = _transition(self, 0, class);
+
+      if (*next == LITERAL_SET_NO_STATE)
+        {
+          *next = 0;
+        }
+      else
+        {
+          failure[*next] = 0;
+          queue[tail++] = *next;
+        }
+    }
+
+  while (head < tail)
+    {
+      guint32 state = queue[head++];
+
+      for (guint32 class = 0; class < self->num_classes; class++)
+        {
+          guint32 *next = _transition(self, state, class);
+          guint32 fallback = *_transition(self, failure[state], class);
+
+          if (*next == LITERAL_SET_NO_STATE)
+            {
+              *next = fallback;
+              continue;
+            }
+
+          failure[*next] = fallback;
+          g_array_index(self->states, LiteralSetState, *next).flags |=
+            g_array_index(self->states, LiteralSetState, fallback).flags & LSF_SUBSTRING;
+          queue[tail++] = *next;
+        }
+    }
+
+  g_free(queue);
+  g_free(failure);
+}
+
+gboolean
+literal_set_compile(LiteralSet *self)
+{
+  g_array_set_size(self->states, 0);
+  g_array_set_size(self->transitions, 0);
+
+  _assign_classes(self);
+  if (!_build_trie(self))
+    return FALSE;
+
+  _build_dfa(self);
+  return TRUE;
+}
+
+gboolean
+literal_set_match(LiteralSet *self, const gchar *value, gsize value_len)
+{
+  LiteralSetState *states = (LiteralSetState *) self->states->data;
+  guint32 *transitions = (guint32 *) self->transitions->data;
+  guint32 state = 0;
+
+  /* empty literals */
+  if (states[0].flags & (LSF_PREFIX + LSF_SUBSTRING))
+    return TRUE;
+
+  for (gsize i = 0; i < value_len; i++)
+    {
+      state = transitions[state * self->num_classes + self->classes[(guchar) value[i]]];
+
+      if (states[state].flags & LSF_SUBSTRING)
+        return TRUE;
+
+      if (states[state].depth == i + 1)
+        {
+          if (states[state].flags & LSF_PREFIX)
+            return TRUE;
+        }
+      else if (!self->has_substrings)
+        {
+          /* we left the trie, only substrings could match from here */
+          return FALSE;
+        }
+    }
+
+  return states[state].depth == value_len && (states[state].flags & LSF_EXACT);
+}
+
+void
+literal_set_add(LiteralSet *self, const gchar *literal, gsize literal_len, LiteralSetMode mode)
+{
+  LiteralSetEntry entry =
+  {
+    .literal = g_strndup(literal, literal_len),
+    .literal_len = literal_len,
+    .mode = mode,
+  };
+
+  g_array_append_val(self->entries, entry);
+  if (mode == LSM_SUBSTRING)
+    self->has_substrings = TRUE;
+}
+
+LiteralSet *
+literal_set_new(gboolean icase)
+{
+  LiteralSet *self = g_new0(LiteralSet, 1);
+
+  self->icase = icase;
+  self->entries = g_array_new(FALSE, FALSE, sizeof(LiteralSetEntry));
+  self->states = g_array_new(FALSE, FALSE, sizeof(LiteralSetState));
+  self->transitions = g_array_new(FALSE, FALSE, sizeof(guint32));
+  return self;
+}
+
+void
+literal_set_free(LiteralSet *self)
+{
+  for (gint i = 0; i < self->entries->len; i++)
+    g_free(g_array_index(self->entries, LiteralSetEntry, i).literal);
+  g_array_free(self->entries, TRUE);
+  g_array_free(self->states, TRUE);
+  g_array_free(self->transitions, TRUE);
+  g_free(self);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef LITERAL_SET_H_INCLUDED
+#define LITERAL_SET_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/*
+ * LiteralSet matches a string against a set of literals in a single pass,
+ * using an Aho-Corasick automaton that is turned into a DFA at compile
+ * time.  Each literal can be matched against the whole string, its prefix
+ * or any of its substrings.
+ */
+typedef enum
+{
+  LSM_EXACT,
+  LSM_PREFIX,
+  LSM_SUBSTRING,
+} LiteralSetMode;
+
+typedef struct _LiteralSet LiteralSet;
+
+void literal_set_add(LiteralSet *self, const gchar *literal, gsize literal_len, LiteralSetMode mode);
+gboolean literal_set_compile(LiteralSet *self);
+gboolean literal_set_match(LiteralSet *self, const gchar *value, gsize value_len);
+
+LiteralSet *literal_set_new(gboolean icase);
+void literal_set_free(LiteralSet *self);
+
+#endif
@@ -28,7 +28,11 @@
 #include "str-utils.h"
 #include "scratch-buffers.h"
 #include "compat/string.h"
-#include "compat/pcre.h"
+#include "tls-support.h"
+#include "literal-set.h"
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
 
 static gboolean
 _shall_set_values_indirectly(NVHandle value_handle)
@@ -236,14 +240,11 @@ log_matcher_glob_compile(LogMatcher *s, const gchar *pattern, GError **error)
  * a crash
  */
 static gboolean
-log_matcher_glob_match(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len)
+log_matcher_glob_is_valid_input(LogMessage *msg, const gchar *value, gssize value_len)
 {
-  LogMatcherGlob *self =  (LogMatcherGlob *) s;
-
   if (G_LIKELY((msg->flags & LF_UTF8) || g_utf8_validate(value, value_len, NULL)))
     {
       static gboolean warned = FALSE;
-      gchar *buf;
 
       if (G_UNLIKELY(!warned && (msg->flags & LF_UTF8) == 0))
         {
@@ -251,8 +252,7 @@ log_matcher_glob_match(LogMatcher *s, LogMessage *msg, gint value_handle, const
                       evt_tag_printf("value", "%.*s", (gint) value_len, value));
           warned = TRUE;
         }
-      APPEND_ZERO(buf, value, value_len);
-      return g_pattern_match(self->pattern, value_len, buf, NULL);
+      return TRUE;
     }
   else
     {
@@ -262,6 +262,19 @@ log_matcher_glob_match(LogMatcher *s, LogMessage *msg, gint value_handle, const
   return FALSE;
 }
 
+static gboolean
+log_matcher_glob_match(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len)
+{
+  LogMatcherGlob *self =  (LogMatcherGlob *) s;
+  gchar *buf;
+
+  if (!log_matcher_glob_is_valid_input(msg, value, value_len))
+    return FALSE;
+
+  APPEND_ZERO(buf, value, value_len);
+  return g_pattern_match(self->pattern, value_len, buf, NULL);
+}
+
 static void
 log_matcher_glob_free(LogMatcher *s)
 {
@@ -284,94 +297,147 @@ log_matcher_glob_new(const LogMatcherOptions *options)
   return &self->super;
 }
 
-/* libpcre support */
+/* libpcre2 support */
+
+/* match data is shared by all matchers running in the same thread, and is
+ * grown to the largest number of capture groups used by them */
+TLS_BLOCK_START
+{
+  pcre2_match_data *pcre_match_data;
+  guint32 pcre_match_data_size;
+}
+TLS_BLOCK_END;
+
+#define pcre_match_data __tls_deref(pcre_match_data)
+#define pcre_match_data_size __tls_deref(pcre_match_data_size)
 
 typedef struct _LogMatcherPcreRe
 {
   LogMatcher super;
-  pcre *pattern;
-  pcre_extra *extra;
-  gint match_options;
+  pcre2_code *pattern;
+  guint32 match_options;
+
+  /* cached at compile time, the ovector size is capped to RE_MAX_MATCHES */
+  guint32 ovector_size;
+  guint32 name_count;
+  guint32 name_entry_size;
+  PCRE2_SPTR name_table;
+
   gchar *nv_prefix;
   gint nv_prefix_len;
 } LogMatcherPcreRe;
 
+static pcre2_match_data *
+_get_match_data(guint32 ovector_size)
+{
+  if (pcre_match_data_size < ovector_size)
+    {
+      pcre2_match_data_free(pcre_match_data);
+      pcre_match_data = pcre2_match_data_create(ovector_size, NULL);
+      pcre_match_data_size = ovector_size;
+    }
+  return pcre_match_data;
+}
+
+void
+log_matcher_thread_init(void)
+{
+  _get_match_data(1);
+}
+
+void
+log_matcher_thread_deinit(void)
+{
+  pcre2_match_data_free(pcre_match_data);
+  pcre_match_data = NULL;
+  pcre_match_data_size = 0;
+}
+
 static gboolean
 _compile_pcre_regexp(LogMatcherPcreRe *self, const gchar *re, GError **error)
 {
   gint rc;
-  const gchar *errptr;
-  gint erroffset;
-  gint flags = 0;
+  PCRE2_SIZE erroffset;
+  guint32 flags = 0;
+  pcre2_compile_context *compile_context = NULL;
 
   g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
 
   if (self->super.flags & LMF_ICASE)
-    flags |= PCRE_CASELESS;
+    flags |= PCRE2_CASELESS;
 
   if (self->super.flags & LMF_NEWLINE)
     {
-      if (!PCRE_NEWLINE_ANYCRLF)
-        msg_warning("syslog-ng was compiled against an old PCRE which doesn't support the 'newline' flag");
-      flags |= PCRE_NEWLINE_ANYCRLF;
+      compile_context = pcre2_compile_context_create(NULL);
+      pcre2_set_newline(compile_context, PCRE2_NEWLINE_ANYCRLF);
     }
   if (self->super.flags & LMF_UTF8)
     {
-      gint support;
-      flags |= PCRE_UTF8 | PCRE_NO_UTF8_CHECK;
-      self->match_options |= PCRE_NO_UTF8_CHECK;
+      guint32 support;
+      flags |= PCRE2_UTF | PCRE2_NO_UTF_CHECK;
+      self->match_options |= PCRE2_NO_UTF_CHECK;
 
-      pcre_config(PCRE_CONFIG_UTF8, &support);
+      pcre2_config(PCRE2_CONFIG_UNICODE, &support);
       if (!support)
         {
           g_set_error(error, LOG_TEMPLATE_ERROR, 0, "PCRE library is compiled without UTF8 support and utf8 flag was present");
-          return FALSE;
-        }
-
-      pcre_config(PCRE_CONFIG_UNICODE_PROPERTIES, &support);
-      if (!support)
-        {
-          g_set_error(error, LOG_TEMPLATE_ERROR, 0,
-                      "PCRE library is compiled without UTF8 properties support and utf8 flag was present");
+          pcre2_compile_context_free(compile_context);
           return FALSE;
         }
     }
   if (self->super.flags & LMF_DUPNAMES)
-    {
-      if (!PCRE_DUPNAMES)
-        msg_warning("syslog-ng was compiled against an old PCRE which doesn't support the 'dupnames' flag");
-      flags |= PCRE_DUPNAMES;
-    }
+    flags |= PCRE2_DUPNAMES;
 
   /* compile the regexp */
-  self->pattern = pcre_compile2(re, flags, &rc, &errptr, &erroffset, NULL);
+  self->pattern = pcre2_compile((PCRE2_SPTR) re, PCRE2_ZERO_TERMINATED, flags, &rc, &erroffset, compile_context);
+  pcre2_compile_context_free(compile_context);
   if (!self->pattern)
     {
+      PCRE2_UCHAR errmsg[256];
+
+      pcre2_get_error_message(rc, errmsg, sizeof(errmsg));
       g_set_error(error, LOG_TEMPLATE_ERROR, 0, "Failed to compile PCRE expression >>>%s<<< `%s' at character %d",
-                  re, errptr, erroffset);
+                  re, (gchar *) errmsg, (gint) erroffset);
       return FALSE;
     }
   return TRUE;
 }
 
-static gboolean
-_study_pcre_regexp(LogMatcherPcreRe *self, const gchar *re, GError **error)
+static void
+_jit_compile_pcre_regexp(LogMatcherPcreRe *self, const gchar *re)
+{
+  gint rc;
+
+  if (self->super.flags & LMF_DISABLE_JIT)
+    return;
+
+  /* the interpreter is used automatically if JIT is not available */
+  rc = pcre2_jit_compile(self->pattern, PCRE2_JIT_COMPLETE);
+  if (rc < 0 && rc != PCRE2_ERROR_JIT_BADOPTION)
+    {
+      PCRE2_UCHAR errmsg[256];
+
+      pcre2_get_error_message(rc, errmsg, sizeof(errmsg));
+      msg_debug("Failed to JIT compile regular expression, using the interpreter",
+                evt_tag_str("regexp", re),
+                evt_tag_str("error", (gchar *) errmsg));
+    }
+}
+
+static void
+_cache_pattern_info(LogMatcherPcreRe *self)
 {
-  const gchar *errptr;
-  gint options = 0;
+  guint32 capture_count = 0;
 
-  if ((self->super.flags & LMF_DISABLE_JIT) == 0)
-    options |= PCRE_STUDY_JIT_COMPILE;
+  pcre2_pattern_info(self->pattern, PCRE2_INFO_CAPTURECOUNT, &capture_count);
+  self->ovector_size = MIN(capture_count, RE_MAX_MATCHES) + 1;
 
-  /* optimize regexp */
-  self->extra = pcre_study(self->pattern, options, &errptr);
-  if (errptr != NULL)
+  pcre2_pattern_info(self->pattern, PCRE2_INFO_NAMECOUNT, &self->name_count);
+  if (self->name_count > 0)
     {
-      g_set_error(error, LOG_TEMPLATE_ERROR, 0, "Failed to optimize regular expression >>>%s<<< `%s'",
-                  re, errptr);
-      return FALSE;
+      pcre2_pattern_info(self->pattern, PCRE2_INFO_NAMETABLE, &self->name_table);
+      pcre2_pattern_info(self->pattern, PCRE2_INFO_NAMEENTRYSIZE, &self->name_entry_size);
     }
-  return TRUE;
 }
 
 static gboolean
@@ -385,25 +451,24 @@ log_matcher_pcre_re_compile(LogMatcher *s, const gchar *re, GError **error)
   if (!_compile_pcre_regexp(self, re, error))
     return FALSE;
 
-  if (!_study_pcre_regexp(self, re, error))
-    return FALSE;
-
+  _jit_compile_pcre_regexp(self, re);
+  _cache_pattern_info(self);
   return TRUE;
 }
 
 static void
-log_matcher_pcre_re_feed_backrefs(LogMatcher *s, LogMessage *msg, gint value_handle, int *matches, gint match_num,
-                                  const gchar *value)
+log_matcher_pcre_re_feed_backrefs(LogMatcher *s, LogMessage *msg, gint value_handle, PCRE2_SIZE *matches,
+                                  gint match_num, const gchar *value)
 {
   gint i;
   gboolean indirect = _shall_set_values_indirectly(value_handle);
 
   for (i = 0; i < (RE_MAX_MATCHES) && i < match_num; i++)
     {
-      gint begin_index = matches[2 * i];
-      gint end_index = matches[2 * i + 1];
+      PCRE2_SIZE begin_index = matches[2 * i];
+      PCRE2_SIZE end_index = matches[2 * i + 1];
 
-      if (begin_index < 0 || end_index < 0)
+      if (begin_index == PCRE2_UNSET || end_index == PCRE2_UNSET)
         continue;
 
       if (indirect)
@@ -418,8 +483,8 @@ log_matcher_pcre_re_feed_backrefs(LogMatcher *s, LogMessage *msg, gint value_han
 }
 
 static inline void
-log_matcher_pcre_re_feed_value_by_name(LogMatcherPcreRe *s, LogMessage *msg, GString *formatted_name, gchar *tabptr,
-                                       const gchar *value, gint begin_index, gint end_index)
+log_matcher_pcre_re_feed_value_by_name(LogMatcherPcreRe *s, LogMessage *msg, GString *formatted_name,
+                                       const gchar *tabptr, const gchar *value, gint begin_index, gint end_index)
 {
   if(s->nv_prefix != NULL)
     {
@@ -438,39 +503,34 @@ log_matcher_pcre_re_feed_value_by_name(LogMatcherPcreRe *s, LogMessage *msg, GSt
 }
 
 static void
-log_matcher_pcre_re_feed_named_substrings(LogMatcher *s, LogMessage *msg, int *matches, const gchar *value)
+log_matcher_pcre_re_feed_named_substrings(LogMatcher *s, LogMessage *msg, PCRE2_SIZE *matches, gint match_num,
+                                          const gchar *value)
 {
-  gchar *name_table = NULL;
-  gint i = 0;
-  gint namecount = 0;
-  gint name_entry_size = 0;
   LogMatcherPcreRe *self = (LogMatcherPcreRe *) s;
+  const gchar *tabptr;
+  guint32 i;
+
+  if (self->name_count == 0)
+    return;
 
-  pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_NAMECOUNT, &namecount);
-  if (namecount > 0)
+  /* each entry of the name table is the number of the group in two bytes,
+   * followed by the name of the group */
+  GString *formatted_name = scratch_buffers_alloc();
+  tabptr = (const gchar *) self->name_table;
+  for (i = 0; i < self->name_count; i++, tabptr += self->name_entry_size)
     {
-      gchar *tabptr;
-      /* Before we can access the substrings, we must extract the table for
-         translating names to numbers, and the size of each entry in the table.
-       */
-      pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_NAMETABLE, &name_table);
-      pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_NAMEENTRYSIZE, &name_entry_size);
-      /* Now we can scan the table and, for each entry, print the number, the name,
-         and the substring itself.
-       */
-      GString *formatted_name = scratch_buffers_alloc();
-      tabptr = name_table;
-      for (i = 0; i < namecount; i++, tabptr += name_entry_size)
-        {
-          int n = (tabptr[0] << 8) | tabptr[1];
-          gint begin_index = matches[2 * n];
-          gint end_index = matches[2 * n + 1];
+      gint n = ((guchar) tabptr[0] << 8) | (guchar) tabptr[1];
 
-          if (begin_index < 0 || end_index < 0)
-            continue;
+      if (n >= match_num)
+        continue;
 
-          log_matcher_pcre_re_feed_value_by_name(self, msg, formatted_name, tabptr, value, begin_index, end_index);
-        }
+      PCRE2_SIZE begin_index = matches[2 * n];
+      PCRE2_SIZE end_index = matches[2 * n + 1];
+
+      if (begin_index == PCRE2_UNSET || end_index == PCRE2_UNSET)
+        continue;
+
+      log_matcher_pcre_re_feed_value_by_name(self, msg, formatted_name, tabptr, value, begin_index, end_index);
     }
 }
 
@@ -478,29 +538,19 @@ static gboolean
 log_matcher_pcre_re_match(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len)
 {
   LogMatcherPcreRe *self = (LogMatcherPcreRe *) s;
-  gint *matches;
-  gsize matches_size;
-  gint num_matches;
+  pcre2_match_data *match_data = _get_match_data(self->ovector_size);
+  PCRE2_SIZE *matches;
   gint rc;
 
   if (value_len == -1)
     value_len = strlen(value);
 
-  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &num_matches) < 0)
-    g_assert_not_reached();
-  if (num_matches > RE_MAX_MATCHES)
-    num_matches = RE_MAX_MATCHES;
-
-  matches_size = 3 * (num_matches + 1);
-  matches = g_alloca(matches_size * sizeof(gint));
-
-  rc = pcre_exec(self->pattern, self->extra,
-                 value, value_len, 0, self->match_options, matches, matches_size);
+  rc = pcre2_match(self->pattern, (PCRE2_SPTR) value, value_len, 0, self->match_options, match_data, NULL);
   if (rc < 0)
     {
       switch (rc)
         {
-        case PCRE_ERROR_NOMATCH:
+        case PCRE2_ERROR_NOMATCH:
           break;
 
         default:
@@ -523,8 +573,9 @@ log_matcher_pcre_re_match(LogMatcher *s, LogMessage *msg, gint value_handle, con
         }
       if ((s->flags & LMF_STORE_MATCHES))
         {
+          matches = pcre2_get_ovector_pointer(match_data);
           log_matcher_pcre_re_feed_backrefs(s, msg, value_handle, matches, rc, value);
-          log_matcher_pcre_re_feed_named_substrings(s, msg, matches, value);
+          log_matcher_pcre_re_feed_named_substrings(s, msg, matches, rc, value);
         }
     }
   return TRUE;
@@ -535,28 +586,15 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
                             LogTemplate *replacement, gssize *new_length)
 {
   LogMatcherPcreRe *self = (LogMatcherPcreRe *) s;
+  pcre2_match_data *match_data;
+  PCRE2_SIZE *matches;
   GString *new_value = NULL;
-  gint *matches;
-  gsize matches_size;
-  gint num_matches;
   gint rc;
-  gint start_offset, last_offset;
-  gint options;
+  PCRE2_SIZE start_offset, last_offset;
+  PCRE2_SIZE match_begin, match_end;
+  guint32 options;
   gboolean last_match_was_empty;
 
-  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &num_matches) < 0)
-    g_assert_not_reached();
-  if (num_matches > RE_MAX_MATCHES)
-    num_matches = RE_MAX_MATCHES;
-
-  matches_size = 3 * (num_matches + 1);
-  matches = g_alloca(matches_size * sizeof(gint));
-
-  /* we need zero initialized offsets for the last match as the
-   * algorithm tries uses that as the base position */
-
-  matches[0] = matches[1] = matches[2] = 0;
-
   if (value_len == -1)
     value_len = strlen(value);
 
@@ -571,7 +609,7 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
        * advanced).
        *
        * A zero-length match can be as simple as "a*" which will be
-       * returned unless PCRE_NOTEMPTY is specified.
+       * returned unless PCRE2_NOTEMPTY is specified.
        *
        * By supporting zero-length matches, we basically make it
        * possible to insert replacement between each incoming
@@ -592,17 +630,20 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
            * to see if a non-empty match can be found.
            */
 
-          options = PCRE_NOTEMPTY | PCRE_ANCHORED;
+          options = PCRE2_NOTEMPTY | PCRE2_ANCHORED;
         }
       else
         {
           options = 0;
         }
 
-      rc = pcre_exec(self->pattern, self->extra,
-                     value, value_len,
-                     start_offset, (self->match_options | options), matches, matches_size);
-      if (rc < 0 && rc != PCRE_ERROR_NOMATCH)
+      /* the match data is per-thread: it is fetched again in every
+       * iteration, as the replacement template may run other matchers */
+      match_data = _get_match_data(self->ovector_size);
+      matches = pcre2_get_ovector_pointer(match_data);
+      rc = pcre2_match(self->pattern, (PCRE2_SPTR) value, value_len,
+                       start_offset, (self->match_options | options), match_data, NULL);
+      if (rc < 0 && rc != PCRE2_ERROR_NOMATCH)
         {
           msg_error("Error while matching regexp",
                     evt_tag_int("error_code", rc));
@@ -610,7 +651,7 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
         }
       else if (rc < 0)
         {
-          if ((options & PCRE_NOTEMPTY) == 0)
+          if ((options & PCRE2_NOTEMPTY) == 0)
             {
               /* we didn't match, even when we permitted to match the
                * empty string. Nothing to find here, bail out */
@@ -632,23 +673,25 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
              captures to RE_MAX_MATCHES */
 
           if (rc == 0)
-            rc = matches_size / 3;
+            rc = self->ovector_size;
 
+          match_begin = matches[0];
+          match_end = matches[1];
           log_matcher_pcre_re_feed_backrefs(s, msg, value_handle, matches, rc, value);
-          log_matcher_pcre_re_feed_named_substrings(s, msg, matches, value);
+          log_matcher_pcre_re_feed_named_substrings(s, msg, matches, rc, value);
 
           if (!new_value)
             new_value = g_string_sized_new(value_len);
           /* append non-matching portion */
-          g_string_append_len(new_value, &value[last_offset], matches[0] - last_offset);
+          g_string_append_len(new_value, &value[last_offset], match_begin - last_offset);
           /* replacement */
           log_template_append_format(replacement, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, new_value);
 
-          last_match_was_empty = (matches[0] == matches[1]);
-          start_offset = last_offset = matches[1];
+          last_match_was_empty = (match_begin == match_end);
+          start_offset = last_offset = match_end;
         }
     }
-  while (self->super.flags & LMF_GLOBAL && start_offset < value_len);
+  while (self->super.flags & LMF_GLOBAL && start_offset < (PCRE2_SIZE) value_len);
 
   if (new_value)
     {
@@ -665,8 +708,8 @@ static void
 log_matcher_pcre_re_free(LogMatcher *s)
 {
   LogMatcherPcreRe *self = (LogMatcherPcreRe *) s;
-  pcre_free_study(self->extra);
-  pcre_free(self->pattern);
+  pcre2_code_free(self->pattern);
+  g_free(self->nv_prefix);
   log_matcher_free_method(s);
 }
 
@@ -758,6 +801,353 @@ log_matcher_unref(LogMatcher *s)
     }
 }
 
+/*
+ * LogMatcherSet evaluates a disjunction of matchers against the same
+ * value.  String matchers are merged into a literal set (one per case
+ * sensitivity), regexps with identical compile flags are joined into a
+ * single alternation and globs are translated into one anchored regexp, so
+ * the value is scanned once per engine instead of once per pattern.
+ * Matchers that can't be merged are evaluated one-by-one.
+ */
+#define LOG_MATCHER_SET_PCRE_FLAGS (LMF_ICASE | LMF_NEWLINE | LMF_UTF8 | LMF_DUPNAMES | LMF_DISABLE_JIT)
+
+typedef struct _LogMatcherSetRegexp
+{
+  gint flags;
+  GPtrArray *members;
+  LogMatcher *combined;
+} LogMatcherSetRegexp;
+
+struct _LogMatcherSet
+{
+  GPtrArray *strings;
+  GPtrArray *globs;
+  GPtrArray *regexps;
+  GPtrArray *matchers;
+
+  LiteralSet *literals[2];
+  LogMatcher *combined_globs;
+};
+
+static gboolean
+_is_string_matcher(LogMatcher *matcher)
+{
+  return matcher->compile == log_matcher_string_compile;
+}
+
+static gboolean
+_is_glob_matcher(LogMatcher *matcher)
+{
+  return matcher->compile == log_matcher_glob_compile;
+}
+
+static gboolean
+_is_pcre_matcher(LogMatcher *matcher)
+{
+  return matcher->compile == log_matcher_pcre_re_compile;
+}
+
+/* the regexp is embedded into an alternation, so we refuse anything that
+ * refers to group numbers or would not stay confined to its own branch */
+static gboolean
+_can_combine_regexp(const gchar *re)
+{
+  for (const gchar *p = re; *p; p++)
+    {
+      if (*p == '\\')
+        {
+          p++;
+          if (*p == '\0' || strchr("Qgk", *p) || (*p >= '1' && *p <= '9'))
+            return FALSE;
+        }
+      else if (*p == '(' && p[1] == '*')
+        {
+          return FALSE;
+        }
+      else if (*p == '(' && p[1] == '?')
+        {
+          if (p[2] == 'P' && p[3] == '<')
+            continue;
+          if (p[2] == '\0' || !strchr(":=!<>|#", p[2]))
+            return FALSE;
+        }
+    }
+  return TRUE;
+}
+
+static gboolean
+_can_combine_pcre_matcher(LogMatcher *matcher)
+{
+  LogMatcherPcreRe *pcre_matcher = (LogMatcherPcreRe *) matcher;
+
+  return (matcher->flags & LMF_STORE_MATCHES) == 0 &&
+         pcre_matcher->nv_prefix == NULL &&
+         _can_combine_regexp(matcher->pattern);
+}
+
+static LogMatcherSetRegexp *
+_lookup_regexp_group(LogMatcherSet *self, gint flags)
+{
+  LogMatcherSetRegexp *group;
+
+  for (gint i = 0; i < self->regexps->len; i++)
+    {
+      group = g_ptr_array_index(self->regexps, i);
+      if (group->flags == flags)
+        return group;
+    }
+
+  group = g_new0(LogMatcherSetRegexp, 1);
+  group->flags = flags;
+  group->members = g_ptr_array_new_with_free_func((GDestroyNotify) log_matcher_unref);
+  g_ptr_array_add(self->regexps, group);
+  return group;
+}
+
+static void
+_free_regexp_group(LogMatcherSetRegexp *group)
+{
+  g_ptr_array_free(group->members, TRUE);
+  if (group->combined)
+    log_matcher_unref(group->combined);
+  g_free(group);
+}
+
+void
+log_matcher_set_add(LogMatcherSet *self, LogMatcher *matcher)
+{
+  log_matcher_ref(matcher);
+
+  if (_is_string_matcher(matcher))
+    g_ptr_array_add(self->strings, matcher);
+  else if (_is_glob_matcher(matcher))
+    g_ptr_array_add(self->globs, matcher);
+  else if (_is_pcre_matcher(matcher) && _can_combine_pcre_matcher(matcher))
+    g_ptr_array_add(_lookup_regexp_group(self, matcher->flags & LOG_MATCHER_SET_PCRE_FLAGS)->members, matcher);
+  else
+    g_ptr_array_add(self->matchers, matcher);
+}
+
+static void
+_fall_back_to_individual_matchers(LogMatcherSet *self, GPtrArray *members)
+{
+  for (gint i = 0; i < members->len; i++)
+    g_ptr_array_add(self->matchers, log_matcher_ref(g_ptr_array_index(members, i)));
+}
+
+static LogMatcher *
+_compile_combined_regexp(const gchar *re, gint flags)
+{
+  LogMatcherOptions options;
+  LogMatcher *combined;
+  GError *error = NULL;
+
+  log_matcher_options_defaults(&options);
+  options.flags = flags | LMF_MATCH_ONLY;
+  combined = log_matcher_pcre_re_new(&options);
+
+  if (!log_matcher_compile(combined, re, &error))
+    {
+      msg_debug("Failed to compile combined regexp, evaluating patterns one-by-one",
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      log_matcher_unref(combined);
+      return NULL;
+    }
+  return combined;
+}
+
+static LiteralSetMode
+_get_literal_set_mode(LogMatcher *matcher)
+{
+  if (matcher->flags & LMF_PREFIX)
+    return LSM_PREFIX;
+  if (matcher->flags & LMF_SUBSTRING)
+    return LSM_SUBSTRING;
+  return LSM_EXACT;
+}
+
+static void
+_compile_literals(LogMatcherSet *self, gboolean icase)
+{
+  LiteralSet *literals = literal_set_new(icase);
+  GPtrArray *members = g_ptr_array_new();
+
+  for (gint i = 0; i < self->strings->len; i++)
+    {
+      LogMatcher *matcher = g_ptr_array_index(self->strings, i);
+
+      if (!!(matcher->flags & LMF_ICASE) != icase)
+        continue;
+
+      literal_set_add(literals, matcher->pattern, strlen(matcher->pattern), _get_literal_set_mode(matcher));
+      g_ptr_array_add(members, matcher);
+    }
+
+  if (members->len >= 2 && literal_set_compile(literals))
+    {
+      self->literals[icase] = literals;
+    }
+  else
+    {
+      _fall_back_to_individual_matchers(self, members);
+      literal_set_free(literals);
+    }
+  g_ptr_array_free(members, TRUE);
+}
+
+static void
+_compile_regexp_group(LogMatcherSet *self, LogMatcherSetRegexp *group)
+{
+  GString *re;
+
+  if (group->members->len < 2)
+    {
+      _fall_back_to_individual_matchers(self, group->members);
+      return;
+    }
+
+  re = g_string_sized_new(128);
+  for (gint i = 0; i < group->members->len; i++)
+    {
+      LogMatcher *matcher = g_ptr_array_index(group->members, i);
+
+      g_string_append_printf(re, "%s(?:%s)", i > 0 ? "|" : "", matcher->pattern);
+    }
+
+  group->combined = _compile_combined_regexp(re->str, group->flags);
+  if (!group->combined)
+    _fall_back_to_individual_matchers(self, group->members);
+  g_string_free(re, TRUE);
+}
+
+/* GPatternSpec only knows about '*' and '?', everything else is literal */
+static void
+_append_glob_as_regexp(GString *re, const gchar *glob)
+{
+  for (const gchar *p = glob; *p; p++)
+    {
+      if (*p == '*')
+        g_string_append(re, ".*");
+      else if (*p == '?')
+        g_string_append_c(re, '.');
+      else if (g_ascii_isalnum(*p) || (guchar) *p >= 0x80)
+        g_string_append_c(re, *p);
+      else
+        {
+          g_string_append_c(re, '\\');
+          g_string_append_c(re, *p);
+        }
+    }
+}
+
+static void
+_compile_globs(LogMatcherSet *self)
+{
+  GString *re;
+
+  if (self->globs->len < 2)
+    {
+      _fall_back_to_individual_matchers(self, self->globs);
+      return;
+    }
+
+  re = g_string_new("(?s)\\A(?:");
+  for (gint i = 0; i < self->globs->len; i++)
+    {
+      LogMatcher *matcher = g_ptr_array_index(self->globs, i);
+
+      if (i > 0)
+        g_string_append_c(re, '|');
+      _append_glob_as_regexp(re, matcher->pattern);
+    }
+  g_string_append(re, ")\\z");
+
+  self->combined_globs = _compile_combined_regexp(re->str, LMF_UTF8);
+  if (!self->combined_globs)
+    _fall_back_to_individual_matchers(self, self->globs);
+  g_string_free(re, TRUE);
+}
+
+void
+log_matcher_set_compile(LogMatcherSet *self)
+{
+  _compile_literals(self, FALSE);
+  _compile_literals(self, TRUE);
+
+  for (gint i = 0; i < self->regexps->len; i++)
+    _compile_regexp_group(self, g_ptr_array_index(self->regexps, i));
+
+  _compile_globs(self);
+}
+
+gboolean
+log_matcher_set_match(LogMatcherSet *self, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len)
+{
+  if (value_len < 0)
+    value_len = strlen(value);
+
+  if (self->literals[FALSE] || self->literals[TRUE])
+    {
+      /* the string matcher stops at the first NUL character */
+      gsize literal_len = strnlen(value, value_len);
+
+      if (self->literals[FALSE] && literal_set_match(self->literals[FALSE], value, literal_len))
+        return TRUE;
+      if (self->literals[TRUE] && literal_set_match(self->literals[TRUE], value, literal_len))
+        return TRUE;
+    }
+
+  for (gint i = 0; i < self->regexps->len; i++)
+    {
+      LogMatcherSetRegexp *group = g_ptr_array_index(self->regexps, i);
+
+      if (group->combined && log_matcher_match(group->combined, msg, value_handle, value, value_len))
+        return TRUE;
+    }
+
+  if (self->combined_globs &&
+      log_matcher_glob_is_valid_input(msg, value, value_len) &&
+      log_matcher_match(self->combined_globs, msg, value_handle, value, value_len))
+    return TRUE;
+
+  for (gint i = 0; i < self->matchers->len; i++)
+    {
+      if (log_matcher_match(g_ptr_array_index(self->matchers, i), msg, value_handle, value, value_len))
+        return TRUE;
+    }
+  return FALSE;
+}
+
+LogMatcherSet *
+log_matcher_set_new(void)
+{
+  LogMatcherSet *self = g_new0(LogMatcherSet, 1);
+
+  self->strings = g_ptr_array_new_with_free_func((GDestroyNotify) log_matcher_unref);
+  self->globs = g_ptr_array_new_with_free_func((GDestroyNotify) log_matcher_unref);
+  self->regexps = g_ptr_array_new_with_free_func((GDestroyNotify) _free_regexp_group);
+  self->matchers = g_ptr_array_new_with_free_func((GDestroyNotify) log_matcher_unref);
+  return self;
+}
+
+void
+log_matcher_set_free(LogMatcherSet *self)
+{
+  for (gint i = 0; i < G_N_ELEMENTS(self->literals); i++)
+    {
+      if (self->literals[i])
+        literal_set_free(self->literals[i]);
+    }
+  if (self->combined_globs)
+    log_matcher_unref(self->combined_globs);
+  g_ptr_array_free(self->strings, TRUE);
+  g_ptr_array_free(self->globs, TRUE);
+  g_ptr_array_free(self->regexps, TRUE);
+  g_ptr_array_free(self->matchers, TRUE);
+  g_free(self);
+}
+
 gboolean
 log_matcher_options_set_type(LogMatcherOptions *options, const gchar *type)
 {
@@ -125,4 +125,16 @@ void log_matcher_options_destroy(LogMatcherOptions *options);
 
 void log_matcher_pcre_set_nv_prefix(LogMatcher *s, const gchar *prefix);
 
+typedef struct _LogMatcherSet LogMatcherSet;
+
+void log_matcher_set_add(LogMatcherSet *self, LogMatcher *matcher);
+void log_matcher_set_compile(LogMatcherSet *self);
+gboolean log_matcher_set_match(LogMatcherSet *self, LogMessage *msg, gint value_handle, const gchar *value,
+                               gssize value_len);
+LogMatcherSet *log_matcher_set_new(void);
+void log_matcher_set_free(LogMatcherSet *self);
+
+void log_matcher_thread_init(void);
+void log_matcher_thread_deinit(void);
+
 #endif
@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logmsg/logmsg-slab.h"
+#include "apphook.h"
+#include "atomic-gssize.h"
+#include "tls-support.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+
+#include <string.h>
+
+/* size classes are powers of two between 256 bytes and 64kB, including the block header */
+#define LOG_MSG_SLAB_MIN_SHIFT 8
+#define LOG_MSG_SLAB_MAX_SHIFT 16
+#define LOG_MSG_SLAB_NUM_CLASSES (LOG_MSG_SLAB_MAX_SHIFT - LOG_MSG_SLAB_MIN_SHIFT + 1)
+
+/* the number of free bytes a thread keeps in a single size class, the rest is returned to the system */
+#define LOG_MSG_SLAB_MAX_CACHED_BYTES (256 * 1024)
+
+/* hits and misses are published to the global counters once per this many allocations */
+#define LOG_MSG_SLAB_STATS_BATCH 256
+
+typedef struct _LogMsgSlabCache LogMsgSlabCache;
+typedef struct _LogMsgSlabBlock LogMsgSlabBlock;
+
+struct _LogMsgSlabBlock
+{
+  /* NULL if the block was allocated using g_malloc() directly */
+  LogMsgSlabCache *owner;
+  gsize usable_size;
+  /* the user data starts here, the link is only used while the block is free */
+  LogMsgSlabBlock *next;
+};
+
+#define LOG_MSG_SLAB_HEADER_SIZE (G_STRUCT_OFFSET(LogMsgSlabBlock, next))
+
+struct _LogMsgSlabCache
+{
+  /* blocks freed by other threads, pushed using CAS and taken by the owner
+   * as a whole, &log_msg_slab_orphaned once the owner thread has exited */
+  gpointer remote_frees;
+
+  /* blocks of this cache not freed yet, counted by the owner thread */
+  gssize outstanding_blocks;
+  /* the owner thread publishes the number of blocks still outstanding when
+   * it exits, the cache is freed by whoever brings this to zero */
+  atomic_gssize orphaned_blocks;
+
+  LogMsgSlabBlock *free_blocks[LOG_MSG_SLAB_NUM_CLASSES];
+  gsize free_bytes[LOG_MSG_SLAB_NUM_CLASSES];
+
+  gint hits;
+  gint misses;
+};
+
+static LogMsgSlabBlock log_msg_slab_orphaned;
+
+static StatsCounterItem *count_slab_hits;
+static StatsCounterItem *count_slab_misses;
+
+/* maintained from the first allocation on and exported as an external
+ * counter, so blocks allocated before the stats are registered are
+ * accounted for when they are released */
+static atomic_gssize slab_resident_bytes;
+
+TLS_BLOCK_START
+{
+  LogMsgSlabCache *log_msg_slab_cache;
+}
+TLS_BLOCK_END;
+
+#define log_msg_slab_cache __tls_deref(log_msg_slab_cache)
+
+static inline gpointer
+_block_get_data(LogMsgSlabBlock *block)
+{
+  return ((gchar *) block) + LOG_MSG_SLAB_HEADER_SIZE;
+}
+
+static inline LogMsgSlabBlock *
+_block_from_data(gpointer data)
+{
+  return (LogMsgSlabBlock *) (((gchar *) data) - LOG_MSG_SLAB_HEADER_SIZE);
+}
+
+static inline gsize
+_class_block_size(gint size_class)
+{
+  return ((gsize) 1) << (size_class + LOG_MSG_SLAB_MIN_SHIFT);
+}
+
+/* returns -1 if the allocation does not fit into any of the size classes */
+static inline gint
+_size_to_class(gsize size)
+{
+  gsize block_size = size + LOG_MSG_SLAB_HEADER_SIZE;
+
+  if (block_size > _class_block_size(LOG_MSG_SLAB_NUM_CLASSES - 1))
+    return -1;
+  if (block_size <= _class_block_size(0))
+    return 0;
+  return g_bit_storage(block_size - 1) - LOG_MSG_SLAB_MIN_SHIFT;
+}
+
+static inline gint
+_block_get_class(LogMsgSlabBlock *block)
+{
+  return g_bit_storage(block->usable_size + LOG_MSG_SLAB_HEADER_SIZE - 1) - LOG_MSG_SLAB_MIN_SHIFT;
+}
+
+static LogMsgSlabBlock *
+_alloc_unowned_block(gsize size)
+{
+  LogMsgSlabBlock *block = g_malloc(LOG_MSG_SLAB_HEADER_SIZE + size);
+
+  block->owner = NULL;
+  block->usable_size = size;
+  stats_counter_inc(count_slab_misses);
+  return block;
+}
+
+static void
+_cache_publish_stats(LogMsgSlabCache *self)
+{
+  stats_counter_add(count_slab_hits, self->hits);
+  stats_counter_add(count_slab_misses, self->misses);
+  self->hits = 0;
+  self->misses = 0;
+}
+
+static void
+_release_block(LogMsgSlabBlock *block)
+{
+  atomic_gssize_sub(&slab_resident_bytes, block->usable_size + LOG_MSG_SLAB_HEADER_SIZE);
+  g_free(block);
+}
+
+/* swaps the remote free list with @replacement and returns the blocks that were on it */
+static LogMsgSlabBlock *
+_cache_take_remote_frees(LogMsgSlabCache *self, LogMsgSlabBlock *replacement)
+{
+  gpointer head;
+
+  do
+    head = g_atomic_pointer_get(&self->remote_frees);
+  while (!g_atomic_pointer_compare_and_exchange(&self->remote_frees, head, replacement));
+  return head;
+}
+
+static void
+_cache_put_block(LogMsgSlabCache *self, LogMsgSlabBlock *block)
+{
+  gint size_class = _block_get_class(block);
+  gsize block_size = _class_block_size(size_class);
+
+  self->outstanding_blocks--;
+  if (self->free_bytes[size_class] + block_size > LOG_MSG_SLAB_MAX_CACHED_BYTES)
+    {
+      _release_block(block);
+      return;
+    }
+  block->next = self->free_blocks[size_class];
+  self->free_blocks[size_class] = block;
+  self->free_bytes[size_class] += block_size;
+}
+
+static void
+_cache_reclaim_remote_frees(LogMsgSlabCache *self)
+{
+  if (!g_atomic_pointer_get(&self->remote_frees))
+    return;
+
+  LogMsgSlabBlock *block = _cache_take_remote_frees(self, NULL);
+  while (block)
+    {
+      LogMsgSlabBlock *next = block->next;
+
+      _cache_put_block(self, block);
+      block = next;
+    }
+}
+
+static LogMsgSlabBlock *
+_cache_alloc_block(LogMsgSlabCache *self, gint size_class)
+{
+  LogMsgSlabBlock *block;
+
+  if (!self->free_blocks[size_class])
+    _cache_reclaim_remote_frees(self);
+
+  block = self->free_blocks[size_class];
+  if (block)
+    {
+      self->free_blocks[size_class] = block->next;
+      self->free_bytes[size_class] -= _class_block_size(size_class);
+      self->hits++;
+    }
+  else
+    {
+      gsize block_size = _class_block_size(size_class);
+
+      block = g_malloc(block_size);
+      block->owner = self;
+      block->usable_size = block_size - LOG_MSG_SLAB_HEADER_SIZE;
+      atomic_gssize_add(&slab_resident_bytes, block_size);
+      self->misses++;
+    }
+  self->outstanding_blocks++;
+
+  if (self->hits + self->misses >= LOG_MSG_SLAB_STATS_BATCH)
+    _cache_publish_stats(self);
+  return block;
+}
+
+/* the owner thread of the cache has exited, the block is released right away */
+static void
+_free_orphaned_block(LogMsgSlabBlock *block)
+{
+  LogMsgSlabCache *owner = block->owner;
+
+  _release_block(block);
+  if (atomic_gssize_dec(&owner->orphaned_blocks) == 1)
+    g_free(owner);
+}
+
+static void
+_push_remote_free(LogMsgSlabBlock *block)
+{
+  LogMsgSlabCache *owner = block->owner;
+  gpointer head;
+
+  do
+    {
+      head = g_atomic_pointer_get(&owner->remote_frees);
+      if (head == &log_msg_slab_orphaned)
+        {
+          _free_orphaned_block(block);
+          return;
+        }
+      block->next = head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange(&owner->remote_frees, head, block));
+}
+
+gpointer
+log_msg_slab_alloc(gsize size, gsize *usable_size)
+{
+  LogMsgSlabCache *cache = log_msg_slab_cache;
+  gint size_class = _size_to_class(size);
+  LogMsgSlabBlock *block;
+
+  if (cache && size_class >= 0)
+    block = _cache_alloc_block(cache, size_class);
+  else
+    block = _alloc_unowned_block(size);
+
+  if (usable_size)
+    *usable_size = block->usable_size;
+  return _block_get_data(block);
+}
+
+void
+log_msg_slab_free(gpointer data)
+{
+  if (!data)
+    return;
+
+  LogMsgSlabBlock *block = _block_from_data(data);
+
+  if (!block->owner)
+    g_free(block);
+  else if (block->owner == log_msg_slab_cache)
+    _cache_put_block(block->owner, block);
+  else
+    _push_remote_free(block);
+}
+
+gpointer
+log_msg_slab_realloc(gpointer data, gsize size, gsize *usable_size)
+{
+  if (!data)
+    return log_msg_slab_alloc(size, usable_size);
+
+  LogMsgSlabBlock *block = _block_from_data(data);
+
+  if (size <= block->usable_size)
+    {
+      if (usable_size)
+        *usable_size = block->usable_size;
+      return data;
+    }
+
+  if (!block->owner && (!log_msg_slab_cache || _size_to_class(size) < 0))
+    {
+      block = g_realloc(block, LOG_MSG_SLAB_HEADER_SIZE + size);
+      block->usable_size = size;
+      if (usable_size)
+        *usable_size = size;
+      return _block_get_data(block);
+    }
+
+  gpointer new_data = log_msg_slab_alloc(size, usable_size);
+  memcpy(new_data, data, block->usable_size);
+  log_msg_slab_free(data);
+  return new_data;
+}
+
+void
+log_msg_slab_thread_init(void)
+{
+  if (log_msg_slab_cache)
+    return;
+
+  log_msg_slab_cache = g_new0(LogMsgSlabCache, 1);
+}
+
+void
+log_msg_slab_thread_deinit(void)
+{
+  LogMsgSlabCache *self = log_msg_slab_cache;
+
+  if (!self)
+    return;
+
+  log_msg_slab_cache = NULL;
+  _cache_publish_stats(self);
+
+  for (gint size_class = 0; size_class < LOG_MSG_SLAB_NUM_CLASSES; size_class++)
+    {
+      LogMsgSlabBlock *block = self->free_blocks[size_class];
+
+      while (block)
+        {
+          LogMsgSlabBlock *next = block->next;
+
+          _release_block(block);
+          block = next;
+        }
+    }
+
+  /* from now on, blocks still in use are released by the thread freeing them */
+  LogMsgSlabBlock *block = _cache_take_remote_frees(self, &log_msg_slab_orphaned);
+  while (block)
+    {
+      LogMsgSlabBlock *next = block->next;
+
+      self->outstanding_blocks--;
+      _release_block(block);
+      block = next;
+    }
+
+  /* blocks freed since the list was orphaned have already decremented the
+   * counter, if it drops to zero here then all of them were released */
+  if (atomic_gssize_add(&self->orphaned_blocks, self->outstanding_blocks) + self->outstanding_blocks == 0)
+    g_free(self);
+}
+
+static void
+log_msg_slab_register_stats(void)
+{
+  stats_lock();
+  StatsClusterKey sc_key;
+  stats_cluster_logpipe_key_set(&sc_key, SCS_GLOBAL, "msg_slab_hits", NULL );
+  stats_register_counter(1, &sc_key, SC_TYPE_PROCESSED, &count_slab_hits);
+
+  stats_cluster_logpipe_key_set(&sc_key, SCS_GLOBAL, "msg_slab_misses", NULL );
+  stats_register_counter(1, &sc_key, SC_TYPE_PROCESSED, &count_slab_misses);
+
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, "msg_slab_resident_bytes", NULL);
+  stats_register_external_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &slab_resident_bytes);
+  stats_unlock();
+}
+
+void
+log_msg_slab_global_init(void)
+{
+  register_application_hook(AH_RUNNING, (ApplicationHookFunc) log_msg_slab_register_stats, NULL, AHM_RUN_ONCE);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_SLAB_H_INCLUDED
+#define LOGMSG_SLAB_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Size-classed allocator for LogMessage instances and NVTable payloads.
+ *
+ * Every thread that called log_msg_slab_thread_init() keeps a cache of
+ * free blocks per size class, allocations and frees of its own blocks
+ * don't synchronize with other threads.  Blocks freed by another thread
+ * are pushed to the lock-free remote free list of the owning thread,
+ * which takes them back the next time it runs out of blocks.
+ *
+ * Blocks allocated by threads without a cache and blocks larger than the
+ * largest size class are allocated using g_malloc().  Memory returned by
+ * these functions must be released using log_msg_slab_free().
+ */
+gpointer log_msg_slab_alloc(gsize size, gsize *usable_size);
+gpointer log_msg_slab_realloc(gpointer data, gsize size, gsize *usable_size);
+void log_msg_slab_free(gpointer data);
+
+void log_msg_slab_thread_init(void);
+void log_msg_slab_thread_deinit(void);
+void log_msg_slab_global_init(void);
+
+#endif
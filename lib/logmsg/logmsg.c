@@ -30,6 +30,7 @@
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-slab.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster-single.h"
 #include "template/templates.h"
@@ -1197,7 +1198,7 @@ log_msg_alloc(gsize payload_size)
 {
   LogMessage *msg;
   gsize payload_space = payload_size ? nv_table_get_alloc_size(LM_V_MAX, 16, payload_size) : 0;
-  gsize alloc_size, payload_ofs = 0;
+  gsize alloc_size, usable_size, payload_ofs = 0;
 
   /* NOTE: logmsg_node_max is updated from parallel threads without locking. */
   gint nodes = (volatile gint) logmsg_queue_node_max;
@@ -1210,12 +1211,17 @@ log_msg_alloc(gsize payload_size)
       payload_ofs = alloc_size;
       alloc_size += payload_space;
     }
-  msg = g_malloc(alloc_size);
+  msg = log_msg_slab_alloc(alloc_size, &usable_size);
 
   memset(msg, 0, sizeof(LogMessage));
 
   if (payload_size)
-    msg->payload = nv_table_init_borrowed(((gchar *) msg) + payload_ofs, payload_space, LM_V_MAX);
+    {
+      /* the rest of the size class is given to the payload */
+      payload_space += usable_size - alloc_size;
+      alloc_size = usable_size;
+      msg->payload = nv_table_init_borrowed(((gchar *) msg) + payload_ofs, payload_space, LM_V_MAX);
+    }
 
   msg->num_nodes = nodes;
   msg->allocated_bytes = alloc_size + payload_space;
@@ -1429,7 +1435,7 @@ log_msg_free(LogMessage *self)
 
   stats_counter_sub(count_allocated_bytes, self->allocated_bytes);
 
-  g_free(self);
+  log_msg_slab_free(self);
 }
 
 /**
@@ -1879,6 +1885,7 @@ void
 log_msg_global_init(void)
 {
   log_msg_registry_init();
+  log_msg_slab_global_init();
 
   /* NOTE: we always initialize counters as they are on stats-level(0),
    * however we need to defer that as the stats subsystem may not be
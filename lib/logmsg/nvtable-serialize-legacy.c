@@ -26,6 +26,7 @@
 
 #include "nvtable-serialize-legacy.h"
 #include "nvtable-serialize-endianutils.h"
+#include "logmsg-slab.h"
 #include "syslog-ng.h"
 #include <string.h>
 
@@ -283,36 +284,36 @@ nv_table_deserialize_22(SerializeArchive *sa)
   if (memcmp(&magic, NV_TABLE_MAGIC_V2, 4) != 0)
     return NULL;
 
-  res = (NVTable *)g_malloc(sizeof(NVTable));
+  res = (NVTable *)log_msg_slab_alloc(sizeof(NVTable), NULL);
 
   if (!serialize_read_uint16(sa, &old_res))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
   res->size = old_res << NV_TABLE_OLD_SCALE;
 
   if (!serialize_read_uint16(sa, &old_res))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
   res->used = old_res << NV_TABLE_OLD_SCALE;
 
   if (!serialize_read_uint16(sa, &res->index_size))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
   if (!serialize_read_uint8(sa, &res->num_static_entries))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
   res->size = _calculate_new_size(res);
-  res = (NVTable *)g_realloc(res, res->size);
+  res = (NVTable *)log_msg_slab_realloc(res, res->size, NULL);
   if(!res)
     return NULL;
 
@@ -321,14 +322,14 @@ nv_table_deserialize_22(SerializeArchive *sa)
 
   if (!_deserialize_struct_22(sa, res))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
   different_endianness = (is_big_endian != (flags & NVT_SF_BE));
   if (!_deserialize_blob_v22(sa, res, nv_table_get_top(res), different_endianness))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
@@ -351,7 +352,7 @@ static inline guint32 *_get_legacy_dynamic_entries(OldNVTable *old)
 static NVTable *
 _create_new_nvtable_from_legacy_nvtable(OldNVTable *old)
 {
-  NVTable *res = g_try_malloc(_calculate_new_size_from_legacy_nvtable(old));
+  NVTable *res = log_msg_slab_alloc(_calculate_new_size_from_legacy_nvtable(old), NULL);
   NVIndexEntry *dyn_entries;
   guint32 *old_entries;
   int i;
@@ -447,7 +448,7 @@ nv_table_deserialize_legacy(SerializeArchive *sa)
     }
   g_free(tmp);
 
-  res = (NVTable *)g_try_realloc(res, res->size);
+  res = (NVTable *)log_msg_slab_realloc(res, res->size, NULL);
 
   if (!res)
     return NULL;
@@ -457,7 +458,7 @@ nv_table_deserialize_legacy(SerializeArchive *sa)
 
   if (!_deserialize_blob_v22(sa, res, nv_table_get_top(res), swap_bytes))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
@@ -27,6 +27,7 @@
 #include "logmsg/nvtable-serialize.h"
 #include "logmsg/nvtable-serialize-endianutils.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
 #include "messages.h"
 
 #include <stdlib.h>
@@ -125,7 +126,7 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
   if (size > NV_TABLE_MAX_BYTES)
     goto error;
 
-  res = (NVTable *) g_malloc(size);
+  res = (NVTable *) log_msg_slab_alloc(size, NULL);
   res->size = size;
 
   if (!serialize_read_uint32(sa, &res->used))
@@ -156,7 +157,7 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
 
 error:
   if (res)
-    g_free(res);
+    log_msg_slab_free(res);
   return FALSE;
 }
 
@@ -195,7 +196,7 @@ nv_table_deserialize(LogMessageSerializationState *state)
 
 error:
   if (res)
-    g_free(res);
+    log_msg_slab_free(res);
   return NULL;
 }
 
@@ -22,6 +22,7 @@
  *
  */
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-slab.h"
 #include "messages.h"
 
 #include <string.h>
@@ -679,6 +680,13 @@ nv_table_init(NVTable *self, gsize alloc_length, gint num_static_entries)
   memset(&self->static_entries[0], 0, self->num_static_entries * sizeof(self->static_entries[0]));
 }
 
+/* the slack at the end of the allocation is made available to the NVTable */
+static inline gsize
+_nv_table_usable_size(gsize usable_size)
+{
+  return MIN(usable_size & ~3, NV_TABLE_MAX_BYTES);
+}
+
 NVTable *
 nv_table_new(gint num_static_entries, gint index_size_hint, gint init_length)
 {
@@ -686,7 +694,8 @@ nv_table_new(gint num_static_entries, gint index_size_hint, gint init_length)
   gsize alloc_length;
 
   alloc_length = nv_table_get_alloc_size(num_static_entries, index_size_hint, init_length);
-  self = (NVTable *) g_malloc(alloc_length);
+  self = (NVTable *) log_msg_slab_alloc(alloc_length, &alloc_length);
+  alloc_length = _nv_table_usable_size(alloc_length);
 
   nv_table_init(self, alloc_length, num_static_entries);
   return self;
@@ -720,9 +729,11 @@ nv_table_realloc(NVTable *self, NVTable **new)
 
   if (self->ref_cnt == 1 && !self->borrowed)
     {
-      *new = self = g_realloc(self, new_size);
+      gsize usable_size;
 
-      self->size = new_size;
+      *new = self = log_msg_slab_realloc(self, new_size, &usable_size);
+
+      self->size = _nv_table_usable_size(usable_size);
       /* move the downwards growing region to the end of the new buffer */
       memmove(NV_TABLE_ADDR(self, self->size - self->used),
               NV_TABLE_ADDR(self, old_size - self->used),
@@ -730,14 +741,16 @@ nv_table_realloc(NVTable *self, NVTable **new)
     }
   else
     {
-      *new = g_malloc(new_size);
+      gsize usable_size;
+
+      *new = log_msg_slab_alloc(new_size, &usable_size);
 
       /* we only copy the header first */
       memcpy(*new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->index_size *
              sizeof(NVIndexEntry));
       (*new)->ref_cnt = 1;
       (*new)->borrowed = FALSE;
-      (*new)->size = new_size;
+      (*new)->size = _nv_table_usable_size(usable_size);
 
       memmove(NV_TABLE_ADDR((*new), (*new)->size - (*new)->used),
               NV_TABLE_ADDR(self, old_size - self->used),
@@ -760,7 +773,7 @@ nv_table_unref(NVTable *self)
 {
   if ((--self->ref_cnt == 0) && !self->borrowed)
     {
-      g_free(self);
+      log_msg_slab_free(self);
     }
 }
 
@@ -775,6 +788,7 @@ NVTable *
 nv_table_clone(NVTable *self, gint additional_space)
 {
   NVTable *new;
+  gsize usable_size;
   gint new_size;
 
   if (nv_table_get_bottom(self) - nv_table_get_ofs_table_top(self) < additional_space)
@@ -785,10 +799,10 @@ nv_table_clone(NVTable *self, gint additional_space)
   if (new_size > NV_TABLE_MAX_BYTES)
     new_size = NV_TABLE_MAX_BYTES;
 
-  new = g_malloc(new_size);
+  new = log_msg_slab_alloc(new_size, &usable_size);
   memcpy(new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->index_size *
          sizeof(NVIndexEntry));
-  new->size = new_size;
+  new->size = _nv_table_usable_size(usable_size);
   new->ref_cnt = 1;
   new->borrowed = FALSE;
 
@@ -846,11 +860,11 @@ _compact_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entr
 NVTable *
 nv_table_compact(NVTable *self)
 {
-  gint new_size = self->size;
-  NVTable *new = g_malloc(new_size);
+  gsize usable_size;
+  NVTable *new = log_msg_slab_alloc(self->size, &usable_size);
   gpointer args[2] = { self, new };
 
-  nv_table_init(new, new_size, self->num_static_entries);
+  nv_table_init(new, _nv_table_usable_size(usable_size), self->num_static_entries);
 
   nv_table_foreach_entry(self, _compact_foreach_entry, args);
   return new;
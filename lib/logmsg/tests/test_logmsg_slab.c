@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logmsg/logmsg-slab.h"
+#include "apphook.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include <criterion/criterion.h>
+
+#include <string.h>
+
+#define NUM_BLOCKS 64
+
+static gpointer
+_free_block_thread(gpointer data)
+{
+  log_msg_slab_free(data);
+  return NULL;
+}
+
+static gpointer
+_alloc_block_thread(gpointer data)
+{
+  log_msg_slab_thread_init();
+  gpointer block = log_msg_slab_alloc(GPOINTER_TO_SIZE(data), NULL);
+  memset(block, 'x', GPOINTER_TO_SIZE(data));
+  log_msg_slab_thread_deinit();
+  return block;
+}
+
+static void
+_free_in_other_thread(gpointer block)
+{
+  GThread *thread = g_thread_new("slab-free", _free_block_thread, block);
+  g_thread_join(thread);
+}
+
+static gpointer
+_alloc_in_other_thread(gsize size)
+{
+  GThread *thread = g_thread_new("slab-alloc", _alloc_block_thread, GSIZE_TO_POINTER(size));
+  return g_thread_join(thread);
+}
+
+Test(logmsg_slab, freed_blocks_are_reused_by_the_allocating_thread)
+{
+  gsize usable_size;
+  gpointer block = log_msg_slab_alloc(1000, &usable_size);
+
+  cr_assert_geq(usable_size, 1000);
+  memset(block, 'x', usable_size);
+  log_msg_slab_free(block);
+
+  gpointer reused = log_msg_slab_alloc(1000, NULL);
+  cr_assert_eq(reused, block);
+  log_msg_slab_free(reused);
+}
+
+Test(logmsg_slab, blocks_of_different_size_classes_are_not_mixed)
+{
+  gpointer small = log_msg_slab_alloc(100, NULL);
+  log_msg_slab_free(small);
+
+  gpointer large = log_msg_slab_alloc(10000, NULL);
+  cr_assert_neq(large, small);
+  log_msg_slab_free(large);
+}
+
+Test(logmsg_slab, blocks_freed_by_other_threads_are_returned_to_the_owner)
+{
+  gpointer blocks[NUM_BLOCKS];
+
+  for (gint i = 0; i < NUM_BLOCKS; i++)
+    blocks[i] = log_msg_slab_alloc(500, NULL);
+  for (gint i = 0; i < NUM_BLOCKS; i++)
+    _free_in_other_thread(blocks[i]);
+
+  /* the remote frees are taken back once the local free list runs empty */
+  for (gint i = 0; i < NUM_BLOCKS; i++)
+    {
+      gpointer block = log_msg_slab_alloc(500, NULL);
+      gboolean reused = FALSE;
+
+      for (gint j = 0; j < NUM_BLOCKS; j++)
+        reused |= (blocks[j] == block);
+      cr_assert(reused, "block was not reused after a remote free, i=%d", i);
+      blocks[i] = block;
+    }
+
+  for (gint i = 0; i < NUM_BLOCKS; i++)
+    log_msg_slab_free(blocks[i]);
+}
+
+Test(logmsg_slab, blocks_can_be_freed_after_their_thread_has_exited)
+{
+  gpointer block = _alloc_in_other_thread(2000);
+
+  cr_assert_eq(((gchar *) block)[1999], 'x');
+  log_msg_slab_free(block);
+}
+
+Test(logmsg_slab, realloc_keeps_the_contents)
+{
+  gsize usable_size;
+  gchar *block = log_msg_slab_alloc(300, NULL);
+
+  memset(block, 'x', 300);
+  block = log_msg_slab_realloc(block, 3000, &usable_size);
+  cr_assert_geq(usable_size, 3000);
+  cr_assert_eq(block[0], 'x');
+  cr_assert_eq(block[299], 'x');
+
+  /* beyond the largest size class */
+  block = log_msg_slab_realloc(block, 1024 * 1024, &usable_size);
+  cr_assert_eq(usable_size, 1024 * 1024);
+  cr_assert_eq(block[299], 'x');
+  log_msg_slab_free(block);
+}
+
+Test(logmsg_slab, threads_without_a_cache_use_the_system_allocator)
+{
+  log_msg_slab_thread_deinit();
+
+  gsize usable_size;
+  gpointer block = log_msg_slab_alloc(1000, &usable_size);
+
+  cr_assert_eq(usable_size, 1000);
+  log_msg_slab_free(block);
+
+  log_msg_slab_thread_init();
+}
+
+static gssize
+_get_resident_bytes(void)
+{
+  StatsClusterKey sc_key;
+  StatsCounterItem *counter;
+  gssize value;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, "msg_slab_resident_bytes", NULL);
+  counter = stats_get_counter(&sc_key, SC_TYPE_SINGLE_VALUE);
+  cr_assert_not_null(counter);
+  value = stats_counter_get(counter);
+  stats_unlock();
+
+  return value;
+}
+
+Test(logmsg_slab, resident_bytes_include_blocks_allocated_before_the_stats_are_registered)
+{
+  StatsOptions stats_options = { .level = 1 };
+  gpointer block = log_msg_slab_alloc(1000, NULL);
+
+  app_startup();
+  stats_reinit(&stats_options);
+  app_running();
+
+  cr_assert_geq(_get_resident_bytes(), 1024);
+
+  /* releases every block cached by this thread */
+  log_msg_slab_free(block);
+  log_msg_slab_thread_deinit();
+  cr_assert_eq(_get_resident_bytes(), 0);
+
+  app_shutdown();
+}
+
+static void
+setup(void)
+{
+  log_msg_slab_thread_init();
+}
+
+static void
+teardown(void)
+{
+  log_msg_slab_thread_deinit();
+}
+
+TestSuite(logmsg_slab, .init = setup, .fini = teardown);
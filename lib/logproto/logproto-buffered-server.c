@@ -577,6 +577,11 @@ log_proto_buffered_server_prepare(LogProtoServer *s, GIOCondition *cond, gint *t
 {
   LogProtoBufferedServer *self = (LogProtoBufferedServer *) s;
 
+  /* the transport already holds input (e.g. a batch of datagrams), which
+   * would not be signalled by poll() */
+  if (log_transport_has_pending_input(self->super.transport))
+    return LPPA_FORCE_SCHEDULE_FETCH;
+
   *cond = self->super.transport->cond;
 
   /* if there's no pending I/O in the transport layer, then we want to do a read */
@@ -649,6 +654,47 @@ log_proto_buffered_server_read_data(LogProtoBufferedServer *self, gpointer buffe
   return rc;
 }
 
+static inline gboolean
+log_proto_buffered_server_can_read_mapped_input(LogProtoBufferedServer *self)
+{
+  /* pending_raw_stream_pos + pending_raw_buffer_size is only the input
+   * offset of the next byte if the input is read as is */
+  return self->map_input &&
+         self->convert == (GIConv) -1 &&
+         self->read_data == log_proto_buffered_server_read_data_method;
+}
+
+/* Copies the newly available input out of the mapping of the transport,
+ * instead of read()ing it.  If that fails, e.g. because the file was
+ * truncated under the mapping, the input is read() from then on. */
+static gint
+log_proto_buffered_server_read_mapped_data(LogProtoBufferedServer *self, LogProtoBufferedServerState *state,
+                                           gpointer buffer, gsize count)
+{
+  gint64 offset = state->pending_raw_stream_pos + state->pending_raw_buffer_size;
+  gssize rc;
+
+  log_transport_aux_data_reinit(&self->buffer_aux);
+  rc = log_transport_read_mapped(self->super.transport, offset, buffer, count);
+  if (rc == 0)
+    {
+      /* nothing new, a truncated file is detected by the file poller */
+      errno = EAGAIN;
+      return -1;
+    }
+  else if (rc > 0)
+    {
+      return rc;
+    }
+
+  msg_notice("Error reading mapped input, falling back to reading it",
+             evt_tag_int(EVT_TAG_FD, self->super.transport->fd),
+             evt_tag_error(EVT_TAG_OSERROR));
+  self->map_input = FALSE;
+  lseek(self->super.transport->fd, offset, SEEK_SET);
+  return log_proto_buffered_server_read_data(self, buffer, count);
+}
+
 static GIOStatus
 log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
 {
@@ -680,7 +726,10 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
   if (avail == 0)
     goto exit;
 
-  rc = log_proto_buffered_server_read_data(self, raw_buffer + state->raw_buffer_leftover_size, avail);
+  if (log_proto_buffered_server_can_read_mapped_input(self))
+    rc = log_proto_buffered_server_read_mapped_data(self, state, raw_buffer, avail);
+  else
+    rc = log_proto_buffered_server_read_data(self, raw_buffer + state->raw_buffer_leftover_size, avail);
   if (rc < 0)
     {
       if (errno == EAGAIN)
@@ -963,4 +1012,5 @@ log_proto_buffered_server_init(LogProtoBufferedServer *self, LogTransport *trans
     self->convert = (GIConv) -1;
   self->stream_based = TRUE;
   self->pos_tracking = log_proto_server_is_position_tracked(&self->super);
+  self->map_input = log_transport_can_read_mapped(transport) && !options->encoding && self->pos_tracking;
 }
@@ -83,7 +83,11 @@ struct _LogProtoBufferedServer
                stream_based:1,
 
                no_multi_read:1,
-               flush_partial_message:1;
+               flush_partial_message:1,
+
+               /* fill the buffer through log_transport_read_mapped() instead of
+                * reading, the transport supports it and no conversion is needed */
+               map_input:1;
   gint fetch_state;
   GIOStatus io_status;
   LogProtoBufferedServerState *state1;
@@ -70,6 +70,12 @@ log_proto_client_options_set_timeout(LogProtoClientOptions *options, gint timeou
   options->timeout = timeout;
 }
 
+void
+log_proto_client_options_set_batch_lines(LogProtoClientOptions *options, gint batch_lines)
+{
+  options->batch_lines = batch_lines;
+}
+
 gint
 log_proto_client_options_get_timeout(LogProtoClientOptions *options)
 {
@@ -81,6 +87,7 @@ log_proto_client_options_defaults(LogProtoClientOptions *options)
 {
   options->drop_input = FALSE;
   options->timeout = 0;
+  options->batch_lines = 0;
 }
 
 void
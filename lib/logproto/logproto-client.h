@@ -36,6 +36,7 @@ typedef struct _LogProtoClientOptions
 {
   gboolean drop_input;
   gint timeout;
+  gint batch_lines;
 } LogProtoClientOptions;
 
 typedef union _LogProtoClientOptionsStorage
@@ -56,6 +57,7 @@ typedef struct
 
 void log_proto_client_options_set_drop_input(LogProtoClientOptions *options, gboolean drop_input);
 void log_proto_client_options_set_timeout(LogProtoClientOptions *options, gint timeout);
+void log_proto_client_options_set_batch_lines(LogProtoClientOptions *options, gint batch_lines);
 gint log_proto_client_options_get_timeout(LogProtoClientOptions *options);
 
 void log_proto_client_options_defaults(LogProtoClientOptions *options);
@@ -28,19 +28,20 @@
 #define LPFCS_FRAME_SEND    0
 #define LPFCS_MESSAGE_SEND  1
 
+#define LPFC_FRAME_HDR_SIZE 9
+
 typedef struct _LogProtoFramedClient
 {
   LogProtoTextClient super;
-  guchar frame_hdr_buf[9];
+  guchar frame_hdr_buf[LPFC_FRAME_HDR_SIZE];
+
+  /* batching mode: one frame header for each message in the batch */
+  guchar *frame_hdr_bufs;
 } LogProtoFramedClient;
 
-static LogProtoStatus
-log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, gsize msg_len, gboolean *consumed)
+static gsize
+_truncate_msg_len(guchar *msg, gsize msg_len)
 {
-  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
-  gint frame_hdr_len;
-  LogProtoStatus status;
-
   if (msg_len > 9999999)
     {
       static const guchar *warn_msg;
@@ -53,6 +54,17 @@ log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg,
         }
       msg_len = 9999999;
     }
+  return msg_len;
+}
+
+static LogProtoStatus
+log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
+  gint frame_hdr_len;
+  LogProtoStatus status;
+
+  msg_len = _truncate_msg_len(msg, msg_len);
 
   status = LPS_SUCCESS;
   while (status == LPS_SUCCESS && !(*consumed) && self->super.partial == NULL)
@@ -75,6 +87,41 @@ log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg,
   return status;
 }
 
+/* each message takes two chunks in the batch: the frame header and the payload */
+static LogProtoStatus
+log_proto_framed_client_post_batched(LogProtoClient *s, LogMessage *logmsg, guchar *msg, gsize msg_len,
+                                     gboolean *consumed)
+{
+  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
+  guchar *frame_hdr;
+  gint frame_hdr_len;
+
+  *consumed = FALSE;
+  msg_len = _truncate_msg_len(msg, msg_len);
+
+  LogProtoStatus status = log_proto_text_client_batch_make_room(s, 2);
+  if (status != LPS_SUCCESS)
+    return status;
+
+  frame_hdr = &self->frame_hdr_bufs[(self->super.batch.count / 2) * LPFC_FRAME_HDR_SIZE];
+  frame_hdr_len = g_snprintf((gchar *) frame_hdr, LPFC_FRAME_HDR_SIZE, "%" G_GSIZE_FORMAT" ", msg_len);
+
+  log_proto_text_client_batch_add(s, frame_hdr, frame_hdr_len, NULL, FALSE);
+  log_proto_text_client_batch_add(s, msg, msg_len, (GDestroyNotify) g_free, TRUE);
+  *consumed = TRUE;
+
+  return log_proto_text_client_batch_commit(s);
+}
+
+static void
+log_proto_framed_client_free(LogProtoClient *s)
+{
+  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
+
+  g_free(self->frame_hdr_bufs);
+  log_proto_text_client_free(s);
+}
+
 LogProtoClient *
 log_proto_framed_client_new(LogTransport *transport, const LogProtoClientOptions *options)
 {
@@ -82,6 +129,14 @@ log_proto_framed_client_new(LogTransport *transport, const LogProtoClientOptions
 
   log_proto_text_client_init(&self->super, transport, options);
   self->super.super.post = log_proto_framed_client_post;
+  self->super.super.free_fn = log_proto_framed_client_free;
   self->super.state = LPFCS_FRAME_SEND;
+
+  if (options->batch_lines > 1)
+    {
+      log_proto_text_client_init_batch(&self->super, options->batch_lines * 2);
+      self->frame_hdr_bufs = g_malloc0((self->super.batch.size / 2) * LPFC_FRAME_HDR_SIZE);
+      self->super.super.post = log_proto_framed_client_post_batched;
+    }
   return &self->super.super;
 }
@@ -29,6 +29,7 @@
 #include "persist-state.h"
 #include "transport/transport-aux-data.h"
 #include "ack-tracker/bookmark.h"
+#include "find-crlf.h"
 
 typedef struct _LogProtoServer LogProtoServer;
 typedef struct _LogProtoServerOptions LogProtoServerOptions;
@@ -235,6 +236,4 @@ log_proto_server_factory_construct(LogProtoServerFactory *self, LogTransport *tr
 
 LogProtoServerFactory *log_proto_server_get_factory(PluginContext *context, const gchar *name);
 
-const guchar *find_eom(const guchar *s, gsize n);
-
 #endif
@@ -25,6 +25,7 @@
 #include "messages.h"
 
 #include <errno.h>
+#include <limits.h>
 
 static gboolean
 log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, gint *timeout)
@@ -38,7 +39,7 @@ log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, g
   if (*cond == 0)
     *cond = G_IO_OUT;
 
-  const gboolean pending_write = self->partial != NULL;
+  const gboolean pending_write = self->partial != NULL || self->batch.count > self->batch.first;
 
   if (!pending_write && s->options->timeout > 0)
     *timeout = s->options->timeout;
@@ -73,12 +74,80 @@ log_proto_text_client_drop_input(LogProtoClient *s)
   return LPS_SUCCESS;
 }
 
+static gboolean
+_batch_has_room(LogProtoTextClient *self, gint num_chunks)
+{
+  return self->batch.count + num_chunks <= self->batch.size;
+}
+
+/*
+ * Writes out the collected chunks with a single writev() call. Chunks that
+ * were fully written are freed, the partially written one is adjusted in
+ * place, so the next flush continues where this one left off. Messages are
+ * acked once their last chunk is out.
+ */
+static LogProtoStatus
+log_proto_text_client_flush_batch(LogProtoTextClient *self)
+{
+  gint num_chunks = self->batch.count - self->batch.first;
+  gint completed_messages = 0;
+  gssize rc;
+
+  if (num_chunks == 0)
+    return LPS_SUCCESS;
+
+  rc = log_transport_writev(self->super.transport, &self->batch.iov[self->batch.first], num_chunks);
+  if (rc < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR)
+        {
+          msg_error("I/O error occurred while writing",
+                    evt_tag_int("fd", self->super.transport->fd),
+                    evt_tag_error(EVT_TAG_OSERROR));
+          return LPS_ERROR;
+        }
+      return LPS_SUCCESS;
+    }
+
+  while (self->batch.first < self->batch.count && rc >= (gssize) self->batch.iov[self->batch.first].iov_len)
+    {
+      LogProtoTextClientChunk *chunk = &self->batch.chunks[self->batch.first];
+
+      rc -= self->batch.iov[self->batch.first].iov_len;
+      if (chunk->data_free)
+        chunk->data_free(chunk->data);
+      if (chunk->completes_message)
+        completed_messages++;
+      self->batch.first++;
+    }
+
+  if (rc > 0)
+    {
+      struct iovec *iov = &self->batch.iov[self->batch.first];
+
+      iov->iov_base = (guchar *) iov->iov_base + rc;
+      iov->iov_len -= rc;
+    }
+
+  if (completed_messages)
+    log_proto_client_msg_ack(&self->super, completed_messages);
+
+  if (self->batch.first < self->batch.count)
+    return LPS_PARTIAL;
+
+  self->batch.first = self->batch.count = 0;
+  return LPS_SUCCESS;
+}
+
 static LogProtoStatus
 log_proto_text_client_flush(LogProtoClient *s)
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
   gint rc;
 
+  if (log_proto_text_client_is_batching(self))
+    return log_proto_text_client_flush_batch(self);
+
   if (!self->partial)
     {
       return LPS_SUCCESS;
@@ -136,6 +205,69 @@ log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len
   return log_proto_text_client_flush(s);
 }
 
+/* Makes sure that @num_chunks chunks can be added to the batch, flushing
+ * the batch if needed. Returns LPS_PARTIAL if there's still no room. */
+LogProtoStatus
+log_proto_text_client_batch_make_room(LogProtoClient *s, gint num_chunks)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+  LogProtoStatus status;
+
+  if (_batch_has_room(self, num_chunks))
+    return LPS_SUCCESS;
+
+  status = log_proto_text_client_flush_batch(self);
+  if (status == LPS_ERROR)
+    return status;
+
+  return _batch_has_room(self, num_chunks) ? LPS_SUCCESS : LPS_PARTIAL;
+}
+
+void
+log_proto_text_client_batch_add(LogProtoClient *s, guchar *data, gsize data_len, GDestroyNotify data_free,
+                                gboolean completes_message)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+  gint pos = self->batch.count;
+
+  g_assert(_batch_has_room(self, 1));
+
+  self->batch.iov[pos].iov_base = data;
+  self->batch.iov[pos].iov_len = data_len;
+  self->batch.chunks[pos].data = data;
+  self->batch.chunks[pos].data_free = data_free;
+  self->batch.chunks[pos].completes_message = completes_message;
+  self->batch.count++;
+}
+
+/* writes the batch once it is full, otherwise it is left to the next
+ * log_proto_client_flush() */
+LogProtoStatus
+log_proto_text_client_batch_commit(LogProtoClient *s)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+
+  if (_batch_has_room(self, 1))
+    return LPS_SUCCESS;
+
+  return log_proto_text_client_flush_batch(self);
+}
+
+static LogProtoStatus
+log_proto_text_client_post_batched(LogProtoClient *s, LogMessage *logmsg, guchar *msg, gsize msg_len,
+                                   gboolean *consumed)
+{
+  *consumed = FALSE;
+
+  LogProtoStatus status = log_proto_text_client_batch_make_room(s, 1);
+  if (status != LPS_SUCCESS)
+    return status;
+
+  log_proto_text_client_batch_add(s, msg, msg_len, (GDestroyNotify) g_free, TRUE);
+  *consumed = TRUE;
+
+  return log_proto_text_client_batch_commit(s);
+}
 
 /*
  * log_proto_text_client_post:
@@ -189,9 +321,34 @@ log_proto_text_client_free(LogProtoClient *s)
   if (self->partial_free)
     self->partial_free(self->partial);
   self->partial = NULL;
+
+  for (gint i = self->batch.first; i < self->batch.count; i++)
+    {
+      if (self->batch.chunks[i].data_free)
+        self->batch.chunks[i].data_free(self->batch.chunks[i].data);
+    }
+  g_free(self->batch.iov);
+  g_free(self->batch.chunks);
   log_proto_client_free_method(s);
 };
 
+/* @num_chunks is the number of iovec entries, a single message may take
+ * more than one (e.g. the frame header and the payload) */
+void
+log_proto_text_client_init_batch(LogProtoTextClient *self, gint num_chunks)
+{
+#ifdef IOV_MAX
+  if (num_chunks > IOV_MAX)
+    /* limit the batch size according to the current platform */
+    num_chunks = IOV_MAX;
+#endif
+
+  g_assert(self->batch.size == 0);
+  self->batch.size = num_chunks;
+  self->batch.iov = g_new0(struct iovec, num_chunks);
+  self->batch.chunks = g_new0(LogProtoTextClientChunk, num_chunks);
+}
+
 void
 log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport, const LogProtoClientOptions *options)
 {
@@ -212,5 +369,10 @@ log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *
   LogProtoTextClient *self = g_new0(LogProtoTextClient, 1);
 
   log_proto_text_client_init(self, transport, options);
+  if (options->batch_lines > 1)
+    {
+      log_proto_text_client_init_batch(self, options->batch_lines);
+      self->super.post = log_proto_text_client_post_batched;
+    }
   return &self->super;
 }
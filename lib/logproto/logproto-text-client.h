@@ -26,6 +26,15 @@
 
 #include "logproto-client.h"
 
+#include <sys/uio.h>
+
+typedef struct _LogProtoTextClientChunk
+{
+  guchar *data;
+  GDestroyNotify data_free;
+  gboolean completes_message;
+} LogProtoTextClientChunk;
+
 typedef struct _LogProtoTextClient
 {
   LogProtoClient super;
@@ -33,12 +42,35 @@ typedef struct _LogProtoTextClient
   guchar *partial;
   GDestroyNotify partial_free;
   gsize partial_len, partial_pos;
+
+  /* batching mode: chunks are collected in an iovec and written with a
+   * single log_transport_writev() call, see batch-lines() */
+  struct
+  {
+    struct iovec *iov;
+    LogProtoTextClientChunk *chunks;
+    gint size;
+    gint count;
+    gint first;
+  } batch;
 } LogProtoTextClient;
 
+static inline gboolean
+log_proto_text_client_is_batching(LogProtoTextClient *self)
+{
+  return self->batch.size > 0;
+}
+
 LogProtoStatus log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len,
                                                   GDestroyNotify msg_free, gint next_state);
+LogProtoStatus log_proto_text_client_batch_make_room(LogProtoClient *s, gint num_chunks);
+void log_proto_text_client_batch_add(LogProtoClient *s, guchar *data, gsize data_len, GDestroyNotify data_free,
+                                     gboolean completes_message);
+LogProtoStatus log_proto_text_client_batch_commit(LogProtoClient *s);
+void log_proto_text_client_init_batch(LogProtoTextClient *self, gint num_chunks);
 void log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport,
                                 const LogProtoClientOptions *options);
+void log_proto_text_client_free(LogProtoClient *s);
 LogProtoClient *log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *options);
 
 #define log_proto_text_client_free_method log_proto_client_free_method
@@ -169,6 +169,56 @@ log_proto_text_server_get_raw_size_of_buffer(LogProtoTextServer *self, const guc
     }
 }
 
+static inline void
+log_proto_text_server_reset_eol_batch(LogProtoTextServer *self)
+{
+  self->eol_batch.len = self->eol_batch.index = 0;
+  self->eol_batch.scan_end = 0;
+}
+
+/*
+ * Returns the first EOL character in the buffer between @from and @end.
+ *
+ * The buffer is scanned in batches: a single pass collects the positions
+ * of up to LPT_EOL_BATCH_SIZE EOL characters, the following lines are
+ * served from the collected positions.  The positions remain valid as
+ * long as the contents of the buffer are not moved, see
+ * log_proto_text_server_reset_eol_batch() calls.
+ */
+static const guchar *
+log_proto_text_server_find_eol(LogProtoTextServer *self, gsize from, gsize end)
+{
+  guint32 *positions = self->eol_batch.positions;
+  gsize scan_start, scanned;
+  gint i;
+
+  while (self->eol_batch.index < self->eol_batch.len && positions[self->eol_batch.index] < from)
+    self->eol_batch.index++;
+
+  if (self->eol_batch.index < self->eol_batch.len)
+    {
+      if (positions[self->eol_batch.index] >= end)
+        return NULL;
+      return self->super.buffer + positions[self->eol_batch.index];
+    }
+
+  /* no EOL between from and scan_end, continue the scan from there */
+  scan_start = MAX(from, self->eol_batch.scan_end);
+  if (scan_start >= end)
+    return NULL;
+
+  self->eol_batch.len = find_eom_batch(self->super.buffer + scan_start, end - scan_start,
+                                       positions, LPT_EOL_BATCH_SIZE, &scanned);
+  for (i = 0; i < self->eol_batch.len; i++)
+    positions[i] += scan_start;
+  self->eol_batch.index = 0;
+  self->eol_batch.scan_end = scan_start + scanned;
+
+  if (self->eol_batch.len == 0)
+    return NULL;
+  return self->super.buffer + positions[0];
+}
+
 static gint
 log_proto_text_server_accumulate_line_method(LogProtoTextServer *self, const guchar *msg, gsize msg_len,
                                              gssize consumed_len)
@@ -187,6 +237,7 @@ log_proto_text_server_split_buffer(LogProtoTextServer *self, LogProtoBufferedSer
    */
 
   memmove(self->super.buffer, buffer_start, buffer_bytes);
+  log_proto_text_server_reset_eol_batch(self);
   state->pending_buffer_pos = 0;
   state->pending_buffer_end = buffer_bytes;
 
@@ -231,7 +282,7 @@ log_proto_text_server_try_extract(LogProtoTextServer *self, LogProtoBufferedServ
        * read further data, or the buffer already contains a
        * complete line */
 
-      eom = find_eom(self->super.buffer + next_line_pos, state->pending_buffer_end - next_line_pos);
+      eom = log_proto_text_server_find_eol(self, next_line_pos, state->pending_buffer_end);
       if (eom)
         next_eol_pos = eom - self->super.buffer;
     }
@@ -327,6 +378,7 @@ log_proto_text_server_yield_whole_buffer_as_message(LogProtoTextServer *self, Lo
   *msg_len = buffer_bytes;
   self->consumed_len = -1;
   state->pending_buffer_pos = (*msg) + (*msg_len) - self->super.buffer;
+  log_proto_text_server_reset_eol_batch(self);
 }
 
 static inline const guchar *
@@ -345,7 +397,9 @@ log_proto_text_server_locate_next_eol(LogProtoTextServer *self, LogProtoBuffered
     }
   else
     {
-      eol = find_eom(buffer_start + self->consumed_len + 1, buffer_bytes - self->consumed_len - 1);
+      gsize buffer_pos = buffer_start - self->super.buffer;
+
+      eol = log_proto_text_server_find_eol(self, buffer_pos + self->consumed_len + 1, buffer_pos + buffer_bytes);
     }
   return eol;
 }
@@ -373,6 +427,11 @@ log_proto_text_server_fetch_from_buffer(LogProtoBufferedServer *s, const guchar
   LogProtoBufferedServerState *state = log_proto_buffered_server_get_state(&self->super);
   gboolean result = FALSE;
 
+  /* the buffer was refilled from its beginning, positions collected
+   * earlier are not valid anymore */
+  if (state->pending_buffer_pos == 0)
+    log_proto_text_server_reset_eol_batch(self);
+
   const guchar *eol = log_proto_text_server_locate_next_eol(self, state, buffer_start, buffer_bytes);
 
   if (!eol)
@@ -415,6 +474,7 @@ log_proto_text_server_flush(LogProtoBufferedServer *s)
   LogProtoTextServer *self = (LogProtoTextServer *) s;
   self->consumed_len = -1;
   self->cached_eol_pos = 0;
+  log_proto_text_server_reset_eol_batch(self);
 }
 
 void
@@ -38,6 +38,8 @@ enum
 #define LPT_CONSUME_PARTIAL_AMOUNT_MASK      ~0xFF
 #define LPT_CONSUME_PARTIALLY(drop_length) (LPT_CONSUME_LINE | ((drop_length) << LPT_CONSUME_PARTIAL_AMOUNT_SHIFT))
 
+#define LPT_EOL_BATCH_SIZE 128
+
 typedef struct _LogProtoTextServer LogProtoTextServer;
 struct _LogProtoTextServer
 {
@@ -55,6 +57,15 @@ struct _LogProtoTextServer
 
   gint32 consumed_len;
   gint32 cached_eol_pos;
+
+  /* EOL positions collected by a single scan of the buffer, so that
+   * subsequent lines don't need to be scanned again */
+  struct
+  {
+    guint32 positions[LPT_EOL_BATCH_SIZE];
+    gint len, index;
+    guint32 scan_end;
+  } eol_batch;
 };
 
 /* LogProtoTextServer
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "mock-transport.h"
+#include "logproto/logproto-text-client.h"
+#include "logproto/logproto-framed-client.h"
+
+#include <criterion/criterion.h>
+#include <string.h>
+
+#define BATCH_SIZE 10
+
+static gint messages_acked;
+
+static void
+_ack_callback(gint num_acked, gpointer user_data)
+{
+  messages_acked += num_acked;
+}
+
+static LogProtoClient *
+_construct_batching_client(LogProtoClient *(*construct)(LogTransport *, const LogProtoClientOptions *),
+                           LogTransport *transport, LogProtoClientOptions *options)
+{
+  LogProtoClientFlowControlFuncs flow_control_funcs =
+  {
+    .ack_callback = _ack_callback,
+  };
+  LogProtoClient *client;
+
+  log_proto_client_options_defaults(options);
+  log_proto_client_options_set_batch_lines(options, BATCH_SIZE);
+  client = construct(transport, options);
+  log_proto_client_set_client_flow_control(client, &flow_control_funcs);
+  messages_acked = 0;
+  return client;
+}
+
+static void
+_post_message(LogProtoClient *client, const gchar *payload, LogProtoStatus expected_status)
+{
+  gboolean consumed = FALSE;
+  LogProtoStatus status;
+
+  status = log_proto_client_post(client, NULL, (guchar *) g_strdup(payload), strlen(payload), &consumed);
+  cr_assert_eq(status, expected_status, "status=%d", status);
+  cr_assert(consumed);
+}
+
+Test(log_proto, text_client_batching_collects_messages_until_flush)
+{
+  LogProtoClientOptions options;
+  LogTransport *transport = log_transport_mock_stream_new(NULL, 0);
+  LogProtoClient *client = _construct_batching_client(log_proto_text_client_new, transport, &options);
+  gchar output[1024] = {0};
+
+  for (gint i = 0; i < BATCH_SIZE - 1; i++)
+    _post_message(client, "message\n", LPS_SUCCESS);
+
+  cr_assert_eq(log_transport_mock_read_from_write_buffer((LogTransportMock *) transport, output, sizeof(output)), 0);
+  cr_assert_eq(messages_acked, 0);
+
+  cr_assert_eq(log_proto_client_flush(client), LPS_SUCCESS);
+  cr_assert_eq(log_transport_mock_read_from_write_buffer((LogTransportMock *) transport, output, sizeof(output)),
+               (BATCH_SIZE - 1) * strlen("message\n"));
+  cr_assert_eq(messages_acked, BATCH_SIZE - 1);
+
+  log_proto_client_free(client);
+}
+
+Test(log_proto, text_client_batching_writes_automatically_once_the_batch_is_full)
+{
+  LogProtoClientOptions options;
+  LogTransport *transport = log_transport_mock_stream_new(NULL, 0);
+  LogProtoClient *client = _construct_batching_client(log_proto_text_client_new, transport, &options);
+  gchar output[1024] = {0};
+
+  for (gint i = 0; i < BATCH_SIZE; i++)
+    _post_message(client, "message\n", LPS_SUCCESS);
+
+  cr_assert_eq(log_transport_mock_read_from_write_buffer((LogTransportMock *) transport, output, sizeof(output)),
+               BATCH_SIZE * strlen("message\n"));
+  cr_assert_eq(messages_acked, BATCH_SIZE);
+
+  log_proto_client_free(client);
+}
+
+Test(log_proto, text_client_batching_acks_only_fully_written_messages)
+{
+  LogProtoClientOptions options;
+  LogTransport *transport = log_transport_mock_stream_new(NULL, 0);
+  LogProtoClient *client = _construct_batching_client(log_proto_text_client_new, transport, &options);
+  gchar output[1024] = {0};
+  LogProtoStatus status;
+
+  log_transport_mock_set_write_chunk_limit((LogTransportMock *) transport, 12);
+
+  _post_message(client, "0123456789\n", LPS_SUCCESS);
+  _post_message(client, "abcdefghij\n", LPS_SUCCESS);
+
+  /* the first message and one byte of the second one */
+  cr_assert_eq(log_proto_client_flush(client), LPS_PARTIAL);
+  cr_assert_eq(messages_acked, 1);
+
+  while ((status = log_proto_client_flush(client)) == LPS_PARTIAL)
+    ;
+  cr_assert_eq(status, LPS_SUCCESS);
+  cr_assert_eq(messages_acked, 2);
+
+  log_transport_mock_read_from_write_buffer((LogTransportMock *) transport, output, sizeof(output));
+  cr_assert_str_eq(output, "0123456789\nabcdefghij\n");
+
+  log_proto_client_free(client);
+}
+
+Test(log_proto, framed_client_batching_sends_frame_headers_for_each_message)
+{
+  LogProtoClientOptions options;
+  LogTransport *transport = log_transport_mock_stream_new(NULL, 0);
+  LogProtoClient *client = _construct_batching_client(log_proto_framed_client_new, transport, &options);
+  gchar output[1024] = {0};
+
+  _post_message(client, "foo", LPS_SUCCESS);
+  _post_message(client, "barbaz", LPS_SUCCESS);
+  cr_assert_eq(log_proto_client_flush(client), LPS_SUCCESS);
+
+  log_transport_mock_read_from_write_buffer((LogTransportMock *) transport, output, sizeof(output));
+  cr_assert_str_eq(output, "3 foo6 barbaz");
+  cr_assert_eq(messages_acked, 2);
+
+  log_proto_client_free(client);
+}
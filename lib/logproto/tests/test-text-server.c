@@ -26,8 +26,13 @@
 #include "proto_lib.h"
 #include "msg_parse_lib.h"
 #include "logproto/logproto-text-server.h"
+#include "transport/transport-file.h"
+#include "ack-tracker/ack_tracker_factory.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <criterion/criterion.h>
 
@@ -290,6 +295,33 @@ Test(log_proto, test_log_proto_text_server_multi_read)
   log_proto_server_free(proto);
 }
 
+Test(log_proto, test_log_proto_text_server_returns_many_lines_from_a_single_read)
+{
+  GString *input = g_string_new("");
+  LogProtoServer *proto;
+  gint i;
+
+  /* more lines than what fits into a single batch of EOL positions */
+  for (i = 0; i < 3 * LPT_EOL_BATCH_SIZE; i++)
+    g_string_append_printf(input, "line%d\n", i);
+
+  proto_server_options.max_msg_size = input->len + 1;
+  proto = log_proto_text_server_new(log_transport_mock_stream_new(input->str, input->len, LTM_EOF),
+                                    get_inited_proto_server_options());
+
+  for (i = 0; i < 3 * LPT_EOL_BATCH_SIZE; i++)
+    {
+      gchar expected[32];
+
+      g_snprintf(expected, sizeof(expected), "line%d", i);
+      assert_proto_server_fetch(proto, expected, -1);
+    }
+  assert_proto_server_fetch_failure(proto, LPS_EOF, NULL);
+
+  log_proto_server_free(proto);
+  g_string_free(input, TRUE);
+}
+
 Test(log_proto, test_log_proto_text_server_multi_read_not_allowed, .disabled = true)
 {
   /* FIXME: */
@@ -565,3 +597,50 @@ Test(log_proto, test_log_proto_text_server_rewinding_the_initial_line_results_in
   test_log_proto_text_server_rewinding_the_initial_line_results_in_an_empty_message(log_transport_mock_stream_new);
   test_log_proto_text_server_rewinding_the_initial_line_results_in_an_empty_message(log_transport_mock_records_new);
 }
+
+static void
+_append_to_file(gint fd, const gchar *data)
+{
+  cr_assert_eq(write(fd, data, strlen(data)), strlen(data));
+}
+
+Test(log_proto, test_log_proto_text_server_reads_mapped_file)
+{
+  gchar filename[] = "test_text_server_mapped_XXXXXX";
+  gint fd = mkstemp(filename);
+  gint append_fd = open(filename, O_WRONLY | O_APPEND);
+  LogTransport *transport;
+  LogProtoServer *proto;
+
+  cr_assert(fd >= 0 && append_fd >= 0);
+  _append_to_file(append_fd,
+                  "01234567\n"
+                  "0123456789ABCDE\n"
+                  "abc");
+
+  transport = log_transport_file_new(fd);
+  transport->read = log_transport_file_read_and_ignore_eof_method;
+  transport->read_mapped = log_transport_file_read_mapped_method;
+  log_proto_server_options_set_ack_tracker_factory(&proto_server_options, consecutive_ack_tracker_factory_new());
+  proto = construct_test_proto(transport);
+
+  assert_proto_server_fetch(proto, "01234567", -1);
+  cr_assert(((LogProtoBufferedServer *) proto)->map_input);
+  assert_proto_server_fetch(proto, "0123456789ABCDE", -1);
+  assert_proto_server_fetch_ignored_eof(proto);
+
+  /* the partial line is completed, the next one starts beyond the first buffer */
+  _append_to_file(append_fd,
+                  "def\n"
+                  "ghijklmnopqrstuvwxyz0123456789\n");
+  assert_proto_server_fetch(proto, "abcdef", -1);
+  assert_proto_server_fetch(proto, "ghijklmnopqrstuvwxyz0123456789", -1);
+  assert_proto_server_fetch_ignored_eof(proto);
+
+  /* the file position is kept in sync for the file change poller */
+  cr_assert_eq(lseek(fd, 0, SEEK_CUR), lseek(append_fd, 0, SEEK_END));
+
+  log_proto_server_free(proto);
+  close(append_fd);
+  unlink(filename);
+}
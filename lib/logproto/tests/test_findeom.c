@@ -24,6 +24,7 @@
 #include "logproto/logproto-server.h"
 #include "logmsg/logmsg.h"
 #include <stdlib.h>
+#include <string.h>
 
 #include <criterion/parameterized.h>
 #include <criterion/criterion.h>
@@ -129,3 +130,54 @@ ParameterizedTest(struct testcase_tuple *tup, findeom, test_failed)
                  "EOM returned is not NULL, which was expected. eom_ofs=%d, eom=%s\n",
                  tup->eom_ofs, eom);
 }
+
+Test(findeom, test_long_buffers)
+{
+  guchar buffer[256];
+  gsize eom_ofs;
+
+  for (eom_ofs = 0; eom_ofs < sizeof(buffer); eom_ofs++)
+    {
+      memset(buffer, 'a', sizeof(buffer));
+      cr_assert_null(find_eom(buffer, sizeof(buffer)));
+
+      buffer[eom_ofs] = '\n';
+      cr_assert_eq(find_eom(buffer, sizeof(buffer)), buffer + eom_ofs);
+      cr_assert_null(find_eom(buffer, eom_ofs));
+
+      buffer[eom_ofs] = '\0';
+      cr_assert_eq(find_eom(buffer, sizeof(buffer)), buffer + eom_ofs);
+    }
+}
+
+Test(findeom, test_batch_collects_all_eom_positions)
+{
+  const guchar *msg = (const guchar *) "foo\nbar\n\nbaz qux quux corge grault garply waldo fred plugh\nxyzzy\0thud";
+  gsize msg_len = 69;
+  guint32 offsets[16];
+  gsize scanned;
+
+  cr_assert_eq(find_eom_batch(msg, msg_len, offsets, G_N_ELEMENTS(offsets), &scanned), 5);
+  cr_assert_eq(scanned, msg_len);
+  cr_assert_eq(offsets[0], 3);
+  cr_assert_eq(offsets[1], 7);
+  cr_assert_eq(offsets[2], 8);
+  cr_assert_eq(offsets[3], 58);
+  cr_assert_eq(offsets[4], 64);
+}
+
+Test(findeom, test_batch_stops_when_offsets_are_full)
+{
+  const guchar *msg = (const guchar *) "foo\nbar\nbaz\n";
+  guint32 offsets[2];
+  gsize scanned;
+
+  cr_assert_eq(find_eom_batch(msg, 12, offsets, G_N_ELEMENTS(offsets), &scanned), 2);
+  cr_assert_eq(offsets[0], 3);
+  cr_assert_eq(offsets[1], 7);
+  cr_assert_eq(scanned, 8);
+
+  cr_assert_eq(find_eom_batch(msg + scanned, 12 - scanned, offsets, G_N_ELEMENTS(offsets), &scanned), 1);
+  cr_assert_eq(offsets[0], 3);
+  cr_assert_eq(scanned, 4);
+}
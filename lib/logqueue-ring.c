@@ -0,0 +1,627 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logqueue-ring.h"
+#include "logpipe.h"
+#include "messages.h"
+#include "atomic-gssize.h"
+#include "mainloop-worker.h"
+
+#include <iv_list.h>
+
+QueueType log_queue_ring_type = "RING";
+
+/*
+ * LogQueueRing is an alternative to LogQueueFifo, that replaces the locked
+ * wait-queue with a bounded, lock-free multi-producer/single-consumer ring
+ * of LogMessageQueueNode pointers (the algorithm is Dmitry Vyukov's bounded
+ * queue, each slot carries a sequence number that tells producers and the
+ * consumer whose turn it is).
+ *
+ * This means that items flow in this sequence:
+ *
+ *    input threads -> ring (lock-free) -> output queue (single-threaded)
+ *
+ * Fastpath is:
+ *   - input threads reserving a slot in the ring with a single CAS and
+ *     publishing the node by bumping the slot's sequence number
+ *
+ *   - the output thread taking nodes out of the ring, without any locks
+ *
+ * Slowpath:
+ *   - the ring is full (it can only happen with flow-controlled messages
+ *     as the ring is at least log_fifo_size long, or if log_fifo_size is
+ *     larger than the maximum ring size), the message is put to a locked
+ *     overflow queue. As long as the overflow queue is not empty, every
+ *     producer uses it, so that the order of messages coming from the same
+ *     thread is kept.
+ *
+ *   - waking up the output thread: this happens once per input batch (just
+ *     like in LogQueueFifo) and takes LogQueue->lock for the duration of
+ *     log_queue_push_notify().
+ *
+ * Threading assumptions:
+ *   - the head of the queue, the output queue and the backlog are only
+ *     manipulated from the output thread
+ *   - the ring's tail and the overflow queue are manipulated from the input threads
+ *
+ */
+
+#define LOG_QUEUE_RING_MIN_CAPACITY 64
+#define LOG_QUEUE_RING_MAX_CAPACITY 65536
+
+typedef struct _LogQueueRingSlot
+{
+  atomic_gssize sequence;
+  LogMessageQueueNode *node;
+} LogQueueRingSlot;
+
+typedef struct _InputNotifier
+{
+  WorkerBatchCallback cb;
+  gboolean finish_cb_registered;
+} InputNotifier;
+
+typedef struct _LogQueueRing
+{
+  LogQueue super;
+
+  LogQueueRingSlot *slots;
+  gssize capacity;
+  gssize mask;
+
+  /* producer side */
+  atomic_gssize enqueue_pos;
+
+  /* consumer side, only touched by the output thread */
+  gssize dequeue_pos;
+
+  /* protected by super.lock, overflow_len can be read without it */
+  struct iv_list_head overflow_queue;
+  atomic_gssize overflow_len;
+
+  /* output thread only */
+  struct iv_list_head output_queue;
+  struct iv_list_head backlog_queue; /* entries that were sent but not acked yet */
+  gint backlog_len;
+
+  /* number of items in the ring + overflow queue + output queue */
+  atomic_gssize len;
+  atomic_gssize non_flow_controlled_len;
+
+  gint log_fifo_size;
+
+  /* legacy: flow-controlled messages are included in the log_fifo_size limit */
+  gboolean use_legacy_fifo_size;
+
+  InputNotifier input_notifiers[0];
+} LogQueueRing;
+
+static gssize
+_calculate_capacity(gint log_fifo_size)
+{
+  gssize capacity = LOG_QUEUE_RING_MIN_CAPACITY;
+
+  while (capacity < log_fifo_size && capacity < LOG_QUEUE_RING_MAX_CAPACITY)
+    capacity <<= 1;
+  return capacity;
+}
+
+static gboolean
+_ring_try_enqueue(LogQueueRing *self, LogMessageQueueNode *node)
+{
+  gssize pos = atomic_gssize_get(&self->enqueue_pos);
+
+  while (TRUE)
+    {
+      LogQueueRingSlot *slot = &self->slots[pos & self->mask];
+      gssize diff = atomic_gssize_get(&slot->sequence) - pos;
+
+      if (diff == 0)
+        {
+          if (atomic_gssize_compare_and_exchange(&self->enqueue_pos, pos, pos + 1))
+            {
+              slot->node = node;
+              /* publish the node to the consumer */
+              atomic_gssize_set(&slot->sequence, pos + 1);
+              return TRUE;
+            }
+        }
+      else if (diff < 0)
+        {
+          /* the consumer has not yet freed up this slot, the ring is full */
+          return FALSE;
+        }
+      pos = atomic_gssize_get(&self->enqueue_pos);
+    }
+}
+
+/* output thread only */
+static LogMessageQueueNode *
+_ring_try_dequeue(LogQueueRing *self)
+{
+  LogQueueRingSlot *slot = &self->slots[self->dequeue_pos & self->mask];
+  LogMessageQueueNode *node;
+
+  if (atomic_gssize_get(&slot->sequence) - (self->dequeue_pos + 1) < 0)
+    return NULL;
+
+  node = slot->node;
+  slot->node = NULL;
+  /* hand the slot back to the producers for the next round */
+  atomic_gssize_set(&slot->sequence, self->dequeue_pos + self->capacity);
+  self->dequeue_pos++;
+  return node;
+}
+
+static void
+_overflow_enqueue(LogQueueRing *self, LogMessageQueueNode *node)
+{
+  g_static_mutex_lock(&self->super.lock);
+  iv_list_add_tail(&node->list, &self->overflow_queue);
+  atomic_gssize_inc(&self->overflow_len);
+  g_static_mutex_unlock(&self->super.lock);
+}
+
+/* output thread only */
+static void
+_move_overflow_to_output(LogQueueRing *self)
+{
+  if (atomic_gssize_get(&self->overflow_len) == 0)
+    return;
+
+  g_static_mutex_lock(&self->super.lock);
+  iv_list_splice_tail_init(&self->overflow_queue, &self->output_queue);
+  atomic_gssize_set(&self->overflow_len, 0);
+  g_static_mutex_unlock(&self->super.lock);
+}
+
+static LogMessageQueueNode *
+_take_first_from_output(LogQueueRing *self)
+{
+  LogMessageQueueNode *node;
+
+  if (iv_list_empty(&self->output_queue))
+    return NULL;
+
+  node = iv_list_entry(self->output_queue.next, LogMessageQueueNode, list);
+  iv_list_del_init(&node->list);
+  return node;
+}
+
+/* output thread only
+ *
+ * The output queue holds items that were put back (push_head, rewind) and
+ * items moved over from the overflow queue, all of them are older than the
+ * ones in the ring, so it is always consumed first. The overflow queue is
+ * only consulted once the ring is depleted.
+ */
+static LogMessageQueueNode *
+_dequeue_node(LogQueueRing *self)
+{
+  LogMessageQueueNode *node;
+
+  node = _take_first_from_output(self);
+  if (node)
+    return node;
+
+  node = _ring_try_dequeue(self);
+  if (node)
+    return node;
+
+  /* a producer may have reserved the head slot without publishing it yet,
+   * the items behind it must not be overtaken by the overflow queue */
+  if (atomic_gssize_get(&self->enqueue_pos) != self->dequeue_pos)
+    return NULL;
+
+  _move_overflow_to_output(self);
+  return _take_first_from_output(self);
+}
+
+static gint64
+log_queue_ring_get_length(LogQueue *s)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+
+  return atomic_gssize_get(&self->len);
+}
+
+/* NOTE: this is inherently racy, can only be called if log processing is suspended (e.g. reload time) */
+static gboolean
+log_queue_ring_keep_on_reload(LogQueue *s)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  return log_queue_ring_get_length(s) > 0 || self->backlog_len > 0;
+}
+
+static inline void
+_account_queued_node(LogQueueRing *self, LogMessageQueueNode *node)
+{
+  atomic_gssize_inc(&self->len);
+  if (!node->flow_control_requested)
+    atomic_gssize_inc(&self->non_flow_controlled_len);
+}
+
+static inline void
+_account_dequeued_node(LogQueueRing *self, LogMessageQueueNode *node)
+{
+  atomic_gssize_dec(&self->len);
+  if (!node->flow_control_requested)
+    atomic_gssize_dec(&self->non_flow_controlled_len);
+}
+
+/* Reserves room for a new message in the length counters. The increment
+ * and the limit check is a single atomic operation, so unlike
+ * LogQueueFifo there is no race that would let us go above log_fifo_size. */
+static gboolean
+_reserve_room_for_message(LogQueueRing *self, const LogPathOptions *path_options)
+{
+  if (G_UNLIKELY(self->use_legacy_fifo_size))
+    {
+      if (atomic_gssize_inc(&self->len) >= self->log_fifo_size)
+        {
+          atomic_gssize_dec(&self->len);
+          return FALSE;
+        }
+      if (!path_options->flow_control_requested)
+        atomic_gssize_inc(&self->non_flow_controlled_len);
+      return TRUE;
+    }
+
+  if (!path_options->flow_control_requested)
+    {
+      if (atomic_gssize_inc(&self->non_flow_controlled_len) >= self->log_fifo_size)
+        {
+          atomic_gssize_dec(&self->non_flow_controlled_len);
+          return FALSE;
+        }
+    }
+  atomic_gssize_inc(&self->len);
+  return TRUE;
+}
+
+static inline void
+_drop_message(LogMessage *msg, const LogPathOptions *path_options)
+{
+  if (path_options->flow_control_requested)
+    {
+      log_msg_drop(msg, path_options, AT_SUSPENDED);
+      return;
+    }
+
+  log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+/* registered as a batch callback, called when the input worker thread
+ * finishes its job: wakes up the output thread, if it is waiting for
+ * messages */
+static gpointer
+log_queue_ring_notify_output(gpointer user_data)
+{
+  LogQueueRing *self = (LogQueueRing *) user_data;
+  gint thread_id;
+
+  thread_id = main_loop_worker_get_thread_id();
+
+  g_assert(thread_id >= 0);
+
+  g_static_mutex_lock(&self->super.lock);
+  log_queue_push_notify(&self->super);
+  g_static_mutex_unlock(&self->super.lock);
+  self->input_notifiers[thread_id].finish_cb_registered = FALSE;
+  log_queue_unref(&self->super);
+  return NULL;
+}
+
+static void
+_schedule_notify(LogQueueRing *self)
+{
+  gint thread_id = main_loop_worker_get_thread_id();
+
+  g_assert(thread_id < 0 || log_queue_max_threads > thread_id);
+
+  if (thread_id < 0)
+    {
+      /* not a worker thread, there's no batch to wait for */
+      g_static_mutex_lock(&self->super.lock);
+      log_queue_push_notify(&self->super);
+      g_static_mutex_unlock(&self->super.lock);
+      return;
+    }
+
+  if (!self->input_notifiers[thread_id].finish_cb_registered)
+    {
+      /* One reference should be held, while the callback is registered
+       * avoiding use-after-free situation */
+      main_loop_worker_register_batch_callback(&self->input_notifiers[thread_id].cb);
+      self->input_notifiers[thread_id].finish_cb_registered = TRUE;
+      log_queue_ref(&self->super);
+    }
+}
+
+/*
+ * Can be called from any number of input threads in parallel.
+ *
+ * NOTE: It consumes the reference passed by the caller.
+ */
+static void
+log_queue_ring_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  LogMessageQueueNode *node;
+
+  if (!_reserve_room_for_message(self, path_options))
+    {
+      stats_counter_inc(self->super.dropped_messages);
+      _drop_message(msg, path_options);
+
+      msg_debug("Destination queue full, dropping message",
+                evt_tag_int("queue_len", log_queue_ring_get_length(&self->super)),
+                evt_tag_int("log_fifo_size", self->log_fifo_size),
+                evt_tag_str("persist_name", self->super.persist_name));
+      return;
+    }
+
+  /* stats are updated before the node is published, as the consumer may
+   * pop (and free) the message right after that */
+  log_queue_queued_messages_inc(&self->super);
+  log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
+
+  node = log_msg_alloc_queue_node(msg, path_options);
+  if (atomic_gssize_get(&self->overflow_len) > 0 || !_ring_try_enqueue(self, node))
+    _overflow_enqueue(self, node);
+
+  log_msg_unref(msg);
+  _schedule_notify(self);
+}
+
+/*
+ * Put an item back to the front of the queue.
+ *
+ * This is assumed to be called only from the output thread.
+ *
+ * NOTE: It consumes the reference passed by the caller.
+ */
+static void
+log_queue_ring_push_head(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  LogMessageQueueNode *node;
+
+  /* no limit checks, see log_queue_fifo_push_head() */
+  node = log_msg_alloc_dynamic_queue_node(msg, path_options);
+  iv_list_add(&node->list, &self->output_queue);
+  _account_queued_node(self, node);
+
+  log_msg_unref(msg);
+
+  log_queue_queued_messages_inc(&self->super);
+  log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
+}
+
+/*
+ * Can only run from the output thread.
+ *
+ * NOTE: this returns a reference which the caller must take care to free.
+ */
+static LogMessage *
+log_queue_ring_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  LogMessageQueueNode *node;
+  LogMessage *msg;
+
+  node = _dequeue_node(self);
+  if (!node)
+    return NULL;
+
+  msg = node->msg;
+  path_options->ack_needed = node->ack_needed;
+  _account_dequeued_node(self, node);
+
+  log_queue_queued_messages_dec(&self->super);
+  log_queue_memory_usage_sub(&self->super, log_msg_get_size(msg));
+
+  if (self->super.use_backlog)
+    {
+      log_msg_ref(msg);
+      iv_list_add_tail(&node->list, &self->backlog_queue);
+      self->backlog_len++;
+    }
+  else
+    {
+      log_msg_free_queue_node(node);
+    }
+
+  return msg;
+}
+
+/*
+ * Can only run from the output thread.
+ */
+static void
+log_queue_ring_ack_backlog(LogQueue *s, gint rewind_count)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint pos;
+
+  for (pos = 0; pos < rewind_count && self->backlog_len > 0; pos++)
+    {
+      LogMessageQueueNode *node;
+      LogMessage *msg;
+
+      node = iv_list_entry(self->backlog_queue.next, LogMessageQueueNode, list);
+      msg = node->msg;
+
+      iv_list_del(&node->list);
+      self->backlog_len--;
+
+      path_options.ack_needed = node->ack_needed;
+      log_msg_ack(msg, &path_options, AT_PROCESSED);
+      log_msg_free_queue_node(node);
+      log_msg_unref(msg);
+    }
+}
+
+static void
+_requeue_from_backlog(LogQueueRing *self, LogMessageQueueNode *node)
+{
+  iv_list_del_init(&node->list);
+  iv_list_add(&node->list, &self->output_queue);
+  self->backlog_len--;
+
+  _account_queued_node(self, node);
+  log_queue_queued_messages_inc(&self->super);
+  log_queue_memory_usage_add(&self->super, log_msg_get_size(node->msg));
+}
+
+/*
+ * Move items on our backlog back to the front of the output queue,
+ * regardless of log_fifo_size.
+ *
+ * NOTE: this is assumed to be called from the output thread.
+ */
+static void
+log_queue_ring_rewind_backlog(LogQueue *s, guint rewind_count)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  guint pos;
+
+  if (rewind_count > self->backlog_len)
+    rewind_count = self->backlog_len;
+
+  for (pos = 0; pos < rewind_count; pos++)
+    {
+      LogMessageQueueNode *node = iv_list_entry(self->backlog_queue.prev, LogMessageQueueNode, list);
+      _requeue_from_backlog(self, node);
+    }
+}
+
+static void
+log_queue_ring_rewind_backlog_all(LogQueue *s)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+
+  log_queue_ring_rewind_backlog(s, self->backlog_len);
+}
+
+static void
+_free_node(LogMessageQueueNode *node)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = node->msg;
+
+  path_options.ack_needed = node->ack_needed;
+  log_msg_free_queue_node(node);
+  log_msg_ack(msg, &path_options, AT_ABORTED);
+  log_msg_unref(msg);
+}
+
+static void
+_free_list(struct iv_list_head *q)
+{
+  while (!iv_list_empty(q))
+    {
+      LogMessageQueueNode *node;
+
+      node = iv_list_entry(q->next, LogMessageQueueNode, list);
+      iv_list_del(&node->list);
+      _free_node(node);
+    }
+}
+
+static void
+log_queue_ring_free(LogQueue *s)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  LogMessageQueueNode *node;
+  gint i;
+
+  for (i = 0; i < log_queue_max_threads; i++)
+    g_assert(self->input_notifiers[i].finish_cb_registered == FALSE);
+
+  _free_list(&self->output_queue);
+  while ((node = _ring_try_dequeue(self)))
+    _free_node(node);
+  _free_list(&self->overflow_queue);
+  _free_list(&self->backlog_queue);
+  g_free(self->slots);
+  log_queue_free_method(s);
+}
+
+LogQueue *
+log_queue_ring_new(gint log_fifo_size, const gchar *persist_name)
+{
+  LogQueueRing *self;
+  gint i;
+
+  self = g_malloc0(sizeof(LogQueueRing) + log_queue_max_threads * sizeof(self->input_notifiers[0]));
+
+  log_queue_init_instance(&self->super, persist_name);
+  self->super.type = log_queue_ring_type;
+  self->super.use_backlog = FALSE;
+  self->super.get_length = log_queue_ring_get_length;
+  self->super.keep_on_reload = log_queue_ring_keep_on_reload;
+  self->super.push_tail = log_queue_ring_push_tail;
+  self->super.push_head = log_queue_ring_push_head;
+  self->super.pop_head = log_queue_ring_pop_head;
+  self->super.ack_backlog = log_queue_ring_ack_backlog;
+  self->super.rewind_backlog = log_queue_ring_rewind_backlog;
+  self->super.rewind_backlog_all = log_queue_ring_rewind_backlog_all;
+
+  self->super.free_fn = log_queue_ring_free;
+
+  self->capacity = _calculate_capacity(log_fifo_size);
+  self->mask = self->capacity - 1;
+  self->slots = g_new0(LogQueueRingSlot, self->capacity);
+  for (i = 0; i < self->capacity; i++)
+    atomic_gssize_set(&self->slots[i].sequence, i);
+
+  for (i = 0; i < log_queue_max_threads; i++)
+    {
+      worker_batch_callback_init(&self->input_notifiers[i].cb);
+      self->input_notifiers[i].cb.func = log_queue_ring_notify_output;
+      self->input_notifiers[i].cb.user_data = self;
+    }
+  INIT_IV_LIST_HEAD(&self->overflow_queue);
+  INIT_IV_LIST_HEAD(&self->output_queue);
+  INIT_IV_LIST_HEAD(&self->backlog_queue);
+
+  self->log_fifo_size = log_fifo_size;
+  return &self->super;
+}
+
+LogQueue *
+log_queue_ring_legacy_new(gint log_fifo_size, const gchar *persist_name)
+{
+  LogQueueRing *self = (LogQueueRing *) log_queue_ring_new(log_fifo_size, persist_name);
+  self->use_legacy_fifo_size = TRUE;
+  return &self->super;
+}
+
+QueueType
+log_queue_ring_get_type(void)
+{
+  return log_queue_ring_type;
+}
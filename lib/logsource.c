@@ -763,6 +763,7 @@ log_source_options_defaults(LogSourceOptions *options)
   options->host_override_len = -1;
   options->tags = NULL;
   options->read_old_records = TRUE;
+  options->bookmark_commit_interval = -1;
   host_resolve_options_defaults(&options->host_resolve_options);
 }
 
@@ -782,6 +783,8 @@ log_source_options_init(LogSourceOptions *options, GlobalConfig *cfg, const gcha
     options->chain_hostnames = cfg->chain_hostnames;
   if (options->keep_timestamp == -1)
     options->keep_timestamp = cfg->keep_timestamp;
+  if (options->bookmark_commit_interval == -1)
+    options->bookmark_commit_interval = cfg->bookmark_commit_interval;
   options->group_name = group_name;
 
   source_group_name = g_strdup_printf(".source.%s", group_name);
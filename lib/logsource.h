@@ -45,6 +45,7 @@ typedef struct _LogSourceOptions
   LogTagId source_group_tag;
   gboolean read_old_records;
   gboolean use_syslogng_pid;
+  gint bookmark_commit_interval;
   GArray *tags;
   GList *source_queue_callbacks;
   gint stats_level;
@@ -598,6 +598,22 @@ log_threaded_dest_worker_wakeup_when_suspended(LogThreadedDestWorker *self)
     _perform_work(self);
 }
 
+/* Processes the result of a batch that was completed asynchronously, e.g.
+ * from an I/O callback of the worker, instead of being returned by
+ * insert() or flush().  batch_size has to cover the messages the result
+ * applies to.
+ *
+ * NOTE: runs in the worker thread, but never from within insert()/flush() */
+void
+log_threaded_dest_worker_process_async_result(LogThreadedDestWorker *self, LogThreadedResult result)
+{
+  _process_result(self, result);
+
+  log_queue_reset_parallel_push(self->queue);
+  _stop_watches(self);
+  _schedule_restart(self);
+}
+
 static void
 _flush_timer_cb(gpointer data)
 {
@@ -840,6 +856,15 @@ log_threaded_dest_driver_set_num_workers(LogDriver *s, gint num_workers)
   self->num_workers = num_workers;
 }
 
+void
+log_threaded_dest_driver_set_worker_partition_key_ref(LogDriver *s, LogTemplate *worker_partition_key)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
+
+  log_template_unref(self->worker_partition_key);
+  self->worker_partition_key = worker_partition_key;
+}
+
 /* compatibility bridge between LogThreadedDestWorker */
 
 static gboolean
@@ -960,13 +985,64 @@ log_threaded_dest_driver_set_max_retries_on_error(LogDriver *s, gint max_retries
   self->retries_on_error_max = max_retries;
 }
 
+/* FNV-1a, we need a hash that only depends on the key itself, so that the
+ * same key is mapped to the same worker in each source thread */
+static guint32
+_hash_partition_key(const gchar *key, gssize key_len)
+{
+  guint32 hash = 2166136261U;
+
+  for (gssize i = 0; i < key_len; i++)
+    {
+      hash ^= (guchar) key[i];
+      hash *= 16777619U;
+    }
+  return hash;
+}
+
+static gint
+_partition_worker_index(LogThreadedDestDriver *self, LogMessage *msg)
+{
+  guint32 hash;
+
+  if (log_template_is_trivial(self->worker_partition_key))
+    {
+      gssize key_len = 0;
+      const gchar *key = log_template_get_trivial_value(self->worker_partition_key, msg, &key_len);
+
+      hash = _hash_partition_key(key, key_len);
+    }
+  else
+    {
+      /* the sequence number is only assigned by the worker, once the
+       * message is taken out of its queue */
+      LogTemplateEvalOptions options = {self->template_options, LTZ_SEND, 0, NULL};
+      ScratchBuffersMarker marker;
+      GString *key = scratch_buffers_alloc_and_mark(&marker);
+
+      log_template_format(self->worker_partition_key, msg, &options, key);
+      hash = _hash_partition_key(key->str, key->len);
+      scratch_buffers_reclaim_marked(marker);
+    }
+  return hash % self->num_workers;
+}
+
+/* runs in the source threads without any locking: round-robin is
+ * best-effort anyway, while with worker-partition-key() the worker only
+ * depends on the message, keeping messages with the same key in order */
 LogThreadedDestWorker *
 _lookup_worker(LogThreadedDestDriver *self, LogMessage *msg)
 {
-  gint worker_index = self->last_worker % self->num_workers;
-  self->last_worker++;
+  gint worker_index;
+
+  if (self->num_workers == 1)
+    return self->workers[0];
 
-  /* here would come the lookup mechanism that maps msg -> worker that doesn't exist yet. */
+  if (self->worker_partition_key)
+    return self->workers[_partition_worker_index(self, msg)];
+
+  worker_index = self->last_worker % self->num_workers;
+  self->last_worker++;
   return self->workers[worker_index];
 }
 
@@ -1195,6 +1271,7 @@ log_threaded_dest_driver_free(LogPipe *s)
   LogThreadedDestDriver *self = (LogThreadedDestDriver *)s;
 
   log_threaded_dest_worker_free_method(&self->worker.instance);
+  log_template_unref(self->worker_partition_key);
   g_mutex_free(self->lock);
   g_free(self->workers);
   log_dest_driver_free((LogPipe *)self);
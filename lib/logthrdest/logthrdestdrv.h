@@ -32,6 +32,7 @@
 #include "logqueue.h"
 #include "mainloop-worker.h"
 #include "seqnum.h"
+#include "template/templates.h"
 
 #include <iv.h>
 #include <iv_event.h>
@@ -143,6 +144,10 @@ struct _LogThreadedDestDriver
   gint num_workers;
   gint created_workers;
   guint last_worker;
+  LogTemplate *worker_partition_key;
+  /* the template options of the driver, used to format worker_partition_key
+   * the same way as the other templates of the driver */
+  LogTemplateOptions *template_options;
 
   gint stats_source;
 
@@ -224,6 +229,7 @@ void log_threaded_dest_worker_ack_messages(LogThreadedDestWorker *self, gint bat
 void log_threaded_dest_worker_drop_messages(LogThreadedDestWorker *self, gint batch_size);
 void log_threaded_dest_worker_rewind_messages(LogThreadedDestWorker *self, gint batch_size);
 void log_threaded_dest_worker_wakeup_when_suspended(LogThreadedDestWorker *self);
+void log_threaded_dest_worker_process_async_result(LogThreadedDestWorker *self, LogThreadedResult result);
 gboolean log_threaded_dest_worker_init_method(LogThreadedDestWorker *self);
 void log_threaded_dest_worker_deinit_method(LogThreadedDestWorker *self);
 void log_threaded_dest_worker_init_instance(LogThreadedDestWorker *self,
@@ -246,6 +252,7 @@ void log_threaded_dest_driver_free(LogPipe *s);
 
 void log_threaded_dest_driver_set_max_retries_on_error(LogDriver *s, gint max_retries);
 void log_threaded_dest_driver_set_num_workers(LogDriver *s, gint num_workers);
+void log_threaded_dest_driver_set_worker_partition_key_ref(LogDriver *s, LogTemplate *worker_partition_key);
 void log_threaded_dest_driver_set_batch_lines(LogDriver *s, gint batch_lines);
 void log_threaded_dest_driver_set_batch_timeout(LogDriver *s, gint batch_timeout);
 void log_threaded_dest_driver_set_time_reopen(LogDriver *s, time_t time_reopen);
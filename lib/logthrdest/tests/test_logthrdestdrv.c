@@ -29,6 +29,8 @@
 #include "stopwatch.h"
 #include "cr_template.h"
 
+#include <stdlib.h>
+
 typedef struct TestThreadedDestDriver
 {
   LogThreadedDestDriver super;
@@ -771,6 +773,117 @@ Test(logthrdestdrv, test_explicit_ack_accept)
   cr_assert(dd->super.shared_seq_num == 11, "%d", dd->super.shared_seq_num);
 }
 
+#define PARTITIONED_WORKERS 4
+#define PARTITION_KEYS 8
+
+typedef struct TestPartitionedWorker
+{
+  LogThreadedDestWorker super;
+  GHashTable *last_pid_by_host;
+  gboolean out_of_order;
+} TestPartitionedWorker;
+
+static const gchar *
+_generate_partitioned_persist_name(const LogPipe *s)
+{
+  return "persist-name-partitioned";
+}
+
+static const gchar *
+_format_partitioned_stats_instance(LogThreadedDestDriver *s)
+{
+  return "stats-name-partitioned";
+}
+
+static LogThreadedResult
+_insert_partitioned(LogThreadedDestWorker *s, LogMessage *msg)
+{
+  TestPartitionedWorker *self = (TestPartitionedWorker *) s;
+  const gchar *host = log_msg_get_value(msg, LM_V_HOST, NULL);
+  gint pid = atoi(log_msg_get_value(msg, LM_V_PID, NULL));
+  gpointer last_pid;
+
+  if (g_hash_table_lookup_extended(self->last_pid_by_host, host, NULL, &last_pid) &&
+      GPOINTER_TO_INT(last_pid) >= pid)
+    self->out_of_order = TRUE;
+
+  g_hash_table_insert(self->last_pid_by_host, g_strdup(host), GINT_TO_POINTER(pid));
+  return LTR_SUCCESS;
+}
+
+static void
+_free_partitioned_worker(LogThreadedDestWorker *s)
+{
+  TestPartitionedWorker *self = (TestPartitionedWorker *) s;
+
+  g_hash_table_destroy(self->last_pid_by_host);
+  log_threaded_dest_worker_free_method(s);
+}
+
+static LogThreadedDestWorker *
+_construct_partitioned_worker(LogThreadedDestDriver *o, gint worker_index)
+{
+  TestPartitionedWorker *self = g_new0(TestPartitionedWorker, 1);
+
+  log_threaded_dest_worker_init_instance(&self->super, o, worker_index);
+  self->super.insert = _insert_partitioned;
+  self->super.free_fn = _free_partitioned_worker;
+  self->last_pid_by_host = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  return &self->super;
+}
+
+Test(logthrdestdrv, worker_partition_key_maps_each_key_to_a_single_worker_in_order)
+{
+  GlobalConfig *cfg = main_loop_get_current_config(main_loop);
+  LogThreadedDestDriver *driver = &test_threaded_dd_new(cfg)->super;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+  gint num_messages = 10 * PARTITION_KEYS;
+  gchar buf[32];
+
+  driver->super.super.super.generate_persist_name = _generate_partitioned_persist_name;
+  driver->format_stats_instance = _format_partitioned_stats_instance;
+  driver->worker.construct = _construct_partitioned_worker;
+  log_threaded_dest_driver_set_num_workers(&driver->super.super, PARTITIONED_WORKERS);
+  log_threaded_dest_driver_set_worker_partition_key_ref(&driver->super.super, compile_template("$HOST", FALSE));
+
+  cr_assert(log_pipe_init(&driver->super.super.super));
+  cr_assert(log_pipe_on_config_inited(&driver->super.super.super));
+
+  for (gint i = 0; i < num_messages; i++)
+    {
+      LogMessage *msg = create_sample_message();
+
+      g_snprintf(buf, sizeof(buf), "host%d", i % PARTITION_KEYS);
+      log_msg_set_value(msg, LM_V_HOST, buf, -1);
+      g_snprintf(buf, sizeof(buf), "%d", i);
+      log_msg_set_value(msg, LM_V_PID, buf, -1);
+      log_pipe_queue(&driver->super.super.super, msg, &path_options);
+    }
+  _spin_for_counter_value(driver->written_messages, num_messages);
+
+  for (gint key = 0; key < PARTITION_KEYS; key++)
+    {
+      gint owners = 0;
+
+      g_snprintf(buf, sizeof(buf), "host%d", key);
+      for (gint i = 0; i < PARTITIONED_WORKERS; i++)
+        {
+          TestPartitionedWorker *worker = (TestPartitionedWorker *) driver->workers[i];
+
+          if (g_hash_table_contains(worker->last_pid_by_host, buf))
+            owners++;
+        }
+      cr_assert_eq(owners, 1, "messages of %s were delivered by %d workers", buf, owners);
+    }
+
+  for (gint i = 0; i < PARTITIONED_WORKERS; i++)
+    cr_assert_not(((TestPartitionedWorker *) driver->workers[i])->out_of_order);
+
+  main_loop_sync_worker_startup_and_teardown();
+  log_pipe_deinit(&driver->super.super.super);
+  log_pipe_unref(&driver->super.super.super);
+}
+
 MainLoopOptions main_loop_options = {0};
 
 static void
@@ -25,6 +25,7 @@
 #include "parser/parser-expr.h"
 #include "template/templates.h"
 #include "logmatcher.h"
+#include "stats/stats-cluster-single.h"
 
 #include <string.h>
 
@@ -36,6 +37,50 @@ log_parser_set_template(LogParser *self, LogTemplate *template)
   self->template = template;
 }
 
+void
+log_parser_input_init(LogParserInput *self, LogParser *parser, LogMessage *msg, const gchar *input, gsize input_len)
+{
+  gssize message_len;
+  const gchar *message = log_msg_get_value(msg, LM_V_MESSAGE, &message_len);
+
+  self->parser = parser;
+  self->value = input;
+  self->value_len = input_len;
+  self->ref_handle = (input == message && input_len == (gsize) message_len) ? LM_V_MESSAGE : LM_V_NONE;
+}
+
+static gboolean
+_is_referencable(LogParserInput *self, NVHandle handle, const gchar *value, gsize value_len)
+{
+  if (self->ref_handle == LM_V_NONE || !log_msg_is_handle_settable_with_an_indirect_value(handle))
+    return FALSE;
+
+  /* the value must lie within the input and be addressable by a reference */
+  if (value < self->value || value + value_len > self->value + self->value_len)
+    return FALSE;
+  return value + value_len - self->value <= G_MAXUINT16;
+}
+
+void
+log_parser_input_set_value(LogParserInput *self, LogMessage *msg, NVHandle handle,
+                           const gchar *value, gssize value_len)
+{
+  if (value_len < 0)
+    value_len = strlen(value);
+
+  if (_is_referencable(self, handle, value, value_len))
+    {
+      log_msg_set_value_indirect(msg, handle, self->ref_handle, 0, value - self->value, value_len);
+      stats_counter_add(self->parser->indirect_bytes_saved, value_len);
+      return;
+    }
+
+  /* once the input itself is overwritten, later values can't refer to it */
+  if (handle == self->ref_handle)
+    self->ref_handle = LM_V_NONE;
+  log_msg_set_value(msg, handle, value, value_len);
+}
+
 gboolean
 log_parser_process_message(LogParser *self, LogMessage **pmsg, const LogPathOptions *path_options)
 {
@@ -122,6 +167,9 @@ log_parser_init_method(LogPipe *s)
   StatsClusterKey sc_key;
   stats_cluster_logpipe_key_set(&sc_key, SCS_PARSER, self->name, NULL );
   stats_register_counter(1, &sc_key, SC_TYPE_DISCARDED, &self->super.discarded_messages);
+
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_PARSER, self->name, NULL, "indirect_bytes_saved");
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->indirect_bytes_saved);
   stats_unlock();
 
   return TRUE;
@@ -136,6 +184,9 @@ log_parser_free_method(LogPipe *s)
   StatsClusterKey sc_key;
   stats_cluster_logpipe_key_set(&sc_key, SCS_PARSER, self->name, NULL );
   stats_unregister_counter(&sc_key, SC_TYPE_DISCARDED, &self->super.discarded_messages);
+
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_PARSER, self->name, NULL, "indirect_bytes_saved");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->indirect_bytes_saved);
   stats_unlock();
 
   g_free(self->name);
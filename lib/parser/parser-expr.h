@@ -41,8 +41,29 @@ struct _LogParser
   gboolean (*process)(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input,
                       gsize input_len);
   gchar *name;
+  StatsCounterItem *indirect_bytes_saved;
 };
 
+/*
+ * LogParserInput wraps the input of a process() call.  Values set through
+ * it that are verbatim parts of the input are stored as references to
+ * $MESSAGE instead of copies, as long as the input is the current value of
+ * $MESSAGE.  The number of bytes not copied this way is counted in the
+ * indirect_bytes_saved counter of the parser.
+ */
+typedef struct _LogParserInput
+{
+  LogParser *parser;
+  const gchar *value;
+  gsize value_len;
+  NVHandle ref_handle;
+} LogParserInput;
+
+void log_parser_input_init(LogParserInput *self, LogParser *parser, LogMessage *msg,
+                           const gchar *input, gsize input_len);
+void log_parser_input_set_value(LogParserInput *self, LogMessage *msg, NVHandle handle,
+                                const gchar *value, gssize value_len);
+
 static inline gboolean
 log_parser_deinit_method(LogPipe *s)
 {
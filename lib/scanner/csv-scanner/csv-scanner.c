@@ -28,6 +28,13 @@
 
 #include <string.h>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CSV_SCANNER_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define CSV_SCANNER_HAVE_X86_SIMD 0
+#endif
+
 /************************************************************************
  * CSVScannerOptions
  ************************************************************************/
@@ -322,6 +329,285 @@ _translate_value(CSVScanner *self)
   _translate_null_value(self);
 }
 
+/************************************************************************
+ * Column slices
+ *
+ * Most columns are copied verbatim from the input: they are either
+ * unquoted, or quoted without escape sequences in them.  These are only
+ * located in the input, using a bitmap of the delimiter characters and
+ * another one with the characters that are special in quoted values (the
+ * closing quotes and the backslash), both built once for the whole
+ * input.  Columns that need unescaping or were concatenated from multiple
+ * parts fall back to the character by character parser above.
+ ************************************************************************/
+
+#define CSV_BITMAP_WORD_BITS 64
+
+/* the bitmaps are classified with SSE2 for at most this many delimiter and
+ * quote characters, the fast path is not used beyond that */
+#define CSV_SLICE_MAX_CHARS 4
+
+enum
+{
+  CSV_CLASS_DELIMITER,
+  CSV_CLASS_QUOTED_SPECIAL,
+  CSV_CLASS_MAX
+};
+
+static gboolean
+_slices_supported(CSVScanner *self)
+{
+  CSVScannerOptions *options = self->options;
+
+  return !options->string_delimiters &&
+         options->delimiters && options->delimiters[0] &&
+         strlen(options->delimiters) <= CSV_SLICE_MAX_CHARS &&
+         strlen(options->quotes_end) + 1 <= CSV_SLICE_MAX_CHARS;
+}
+
+static inline gsize
+_bitmap_words(CSVScanner *self)
+{
+  return self->input_len / CSV_BITMAP_WORD_BITS + 1;
+}
+
+static inline const guint64 *
+_bitmap(CSVScanner *self, gint class)
+{
+  return ((const guint64 *) self->bitmaps->str) + class * _bitmap_words(self);
+}
+
+static inline gboolean
+_bitmap_test(const guint64 *bitmap, gsize pos)
+{
+  return (bitmap[pos / CSV_BITMAP_WORD_BITS] >> (pos % CSV_BITMAP_WORD_BITS)) & 1;
+}
+
+/* returns the first position at or after @pos with its bit set, or
+ * input_len if there is none */
+static inline gsize
+_bitmap_find_next(CSVScanner *self, const guint64 *bitmap, gsize pos)
+{
+  gsize nwords = _bitmap_words(self);
+  gsize w = pos / CSV_BITMAP_WORD_BITS;
+  guint64 word;
+
+  if (pos >= self->input_len)
+    return self->input_len;
+
+  word = bitmap[w] & (~G_GUINT64_CONSTANT(0) << (pos % CSV_BITMAP_WORD_BITS));
+  while (!word)
+    {
+      if (++w >= nwords)
+        return self->input_len;
+      word = bitmap[w];
+    }
+  return MIN(w * CSV_BITMAP_WORD_BITS + __builtin_ctzll(word), self->input_len);
+}
+
+/* the characters of the classes, padded by repeating the first one */
+static void
+_class_chars(CSVScanner *self, gchar chars[CSV_CLASS_MAX][CSV_SLICE_MAX_CHARS])
+{
+  const gchar *delimiters = self->options->delimiters;
+  const gchar *quotes_end = self->options->quotes_end;
+  gsize len, i;
+
+  len = strlen(delimiters);
+  for (i = 0; i < CSV_SLICE_MAX_CHARS; i++)
+    chars[CSV_CLASS_DELIMITER][i] = delimiters[i < len ? i : 0];
+
+  /* the backslash is only special with escape-backslash, otherwise it
+   * repeats the closing quotes */
+  chars[CSV_CLASS_QUOTED_SPECIAL][0] = '\\';
+  len = strlen(quotes_end);
+  for (i = 0; i < len; i++)
+    chars[CSV_CLASS_QUOTED_SPECIAL][i + 1] = quotes_end[i];
+  for (i = len + 1; i < CSV_SLICE_MAX_CHARS; i++)
+    chars[CSV_CLASS_QUOTED_SPECIAL][i] = '\\';
+  if (self->options->dialect != CSV_SCANNER_ESCAPE_BACKSLASH)
+    {
+      for (i = 0; i < CSV_SLICE_MAX_CHARS; i++)
+        chars[CSV_CLASS_QUOTED_SPECIAL][i] = len ? quotes_end[i < len ? i : 0] : 0;
+    }
+}
+
+static void
+_classify_scalar(CSVScanner *self, gsize from, gchar chars[CSV_CLASS_MAX][CSV_SLICE_MAX_CHARS],
+                 guint64 *bitmaps[CSV_CLASS_MAX])
+{
+  gsize pos;
+  gint class, i;
+
+  for (pos = from; pos < self->input_len; pos++)
+    {
+      gchar c = self->input[pos];
+
+      for (class = 0; class < CSV_CLASS_MAX; class++)
+        {
+          for (i = 0; i < CSV_SLICE_MAX_CHARS; i++)
+            {
+              if (c == chars[class][i])
+                {
+                  bitmaps[class][pos / CSV_BITMAP_WORD_BITS] |= G_GUINT64_CONSTANT(1) << (pos % CSV_BITMAP_WORD_BITS);
+                  break;
+                }
+            }
+        }
+    }
+}
+
+#if CSV_SCANNER_HAVE_X86_SIMD
+
+static inline guint32
+_match_sse2(__m128i chunk, const __m128i vchars[CSV_SLICE_MAX_CHARS])
+{
+  __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, vchars[0]),
+                                            _mm_cmpeq_epi8(chunk, vchars[1])),
+                               _mm_or_si128(_mm_cmpeq_epi8(chunk, vchars[2]),
+                                            _mm_cmpeq_epi8(chunk, vchars[3])));
+
+  return (guint32) _mm_movemask_epi8(match);
+}
+
+/* classifies the input in blocks of 64 bytes, returns the position where
+ * the scalar implementation should continue */
+static gsize
+_classify_sse2(CSVScanner *self, gchar chars[CSV_CLASS_MAX][CSV_SLICE_MAX_CHARS], guint64 *bitmaps[CSV_CLASS_MAX])
+{
+  __m128i vchars[CSV_CLASS_MAX][CSV_SLICE_MAX_CHARS];
+  gsize pos, i;
+  gint class;
+
+  for (class = 0; class < CSV_CLASS_MAX; class++)
+    for (i = 0; i < CSV_SLICE_MAX_CHARS; i++)
+      vchars[class][i] = _mm_set1_epi8(chars[class][i]);
+
+  for (pos = 0; pos + CSV_BITMAP_WORD_BITS <= self->input_len; pos += CSV_BITMAP_WORD_BITS)
+    {
+      guint64 masks[CSV_CLASS_MAX] = { 0 };
+
+      for (i = 0; i < CSV_BITMAP_WORD_BITS / sizeof(__m128i); i++)
+        {
+          __m128i chunk = _mm_loadu_si128((const __m128i *) (self->input + pos + i * sizeof(__m128i)));
+
+          for (class = 0; class < CSV_CLASS_MAX; class++)
+            masks[class] |= (guint64) _match_sse2(chunk, vchars[class]) << (i * sizeof(__m128i));
+        }
+      for (class = 0; class < CSV_CLASS_MAX; class++)
+        bitmaps[class][pos / CSV_BITMAP_WORD_BITS] = masks[class];
+    }
+  return pos;
+}
+
+#endif
+
+static void
+_classify_input(CSVScanner *self)
+{
+  gchar chars[CSV_CLASS_MAX][CSV_SLICE_MAX_CHARS];
+  guint64 *bitmaps[CSV_CLASS_MAX];
+  gsize nwords = _bitmap_words(self);
+  gsize from = 0;
+  gint class;
+
+  self->bitmaps = scratch_buffers_alloc();
+  g_string_set_size(self->bitmaps, CSV_CLASS_MAX * nwords * sizeof(guint64));
+  memset(self->bitmaps->str, 0, self->bitmaps->len);
+  for (class = 0; class < CSV_CLASS_MAX; class++)
+    bitmaps[class] = ((guint64 *) self->bitmaps->str) + class * nwords;
+
+  _class_chars(self, chars);
+#if CSV_SCANNER_HAVE_X86_SIMD
+  from = _classify_sse2(self, chars, bitmaps);
+#endif
+  _classify_scalar(self, from, chars, bitmaps);
+}
+
+/* locates the end of a quoted value, returns FALSE if it contains escape
+ * sequences or is followed by something else than a delimiter */
+static gboolean
+_locate_quoted_slice(CSVScanner *self, gsize start, gsize *end, gsize *next)
+{
+  const guint64 *specials = _bitmap(self, CSV_CLASS_QUOTED_SPECIAL);
+  gsize pos = start;
+
+  while ((pos = _bitmap_find_next(self, specials, pos)) < self->input_len)
+    {
+      gchar c = self->input[pos];
+
+      if (self->options->dialect == CSV_SCANNER_ESCAPE_BACKSLASH && c == '\\')
+        {
+          if (pos + 1 < self->input_len)
+            return FALSE;
+        }
+      else if (c == self->current_quote)
+        {
+          if (self->options->dialect == CSV_SCANNER_ESCAPE_DOUBLE_CHAR && self->input[pos + 1] == self->current_quote)
+            return FALSE;
+
+          *end = pos++;
+          if (pos == self->input_len)
+            *next = pos;
+          else if (_bitmap_test(_bitmap(self, CSV_CLASS_DELIMITER), pos))
+            *next = pos + 1;
+          else
+            return FALSE;
+          return TRUE;
+        }
+      pos++;
+    }
+
+  /* unterminated quote, the value extends to the end of the input */
+  *end = *next = self->input_len;
+  return TRUE;
+}
+
+static gboolean
+_parse_value_as_slice(CSVScanner *self)
+{
+  const gchar *saved_src = self->src;
+  gsize start, end, next;
+
+  if (!self->bitmaps)
+    _classify_input(self);
+
+  _parse_opening_quote_character(self);
+  _parse_left_whitespace(self);
+
+  start = self->src - self->input;
+  if (self->current_quote)
+    {
+      if (!_locate_quoted_slice(self, start, &end, &next))
+        {
+          self->src = saved_src;
+          return FALSE;
+        }
+      self->current_quote = 0;
+    }
+  else
+    {
+      end = _bitmap_find_next(self, _bitmap(self, CSV_CLASS_DELIMITER), start);
+      next = end < self->input_len ? end + 1 : end;
+    }
+
+  if (self->options->flags & CSV_SCANNER_STRIP_WHITESPACE)
+    {
+      while (end > start && _is_whitespace_char(self->input + end - 1))
+        end--;
+    }
+
+  self->current_slice = self->input + start;
+  self->current_slice_len = end - start;
+  if (self->options->null_value &&
+      strlen(self->options->null_value) == self->current_slice_len &&
+      memcmp(self->current_slice, self->options->null_value, self->current_slice_len) == 0)
+    self->current_slice_len = 0;
+
+  self->src = self->input + next;
+  return TRUE;
+}
+
 static gboolean
 _is_last_column(CSVScanner *self)
 {
@@ -332,6 +618,8 @@ static gboolean
 _switch_to_next_column(CSVScanner *self)
 {
   g_string_truncate(self->current_value, 0);
+  self->current_slice = NULL;
+  self->current_value_filled = FALSE;
 
   switch (self->state)
     {
@@ -366,8 +654,9 @@ csv_scanner_scan_next(CSVScanner *self)
 
   if (_is_last_column(self) && (self->options->flags & CSV_SCANNER_GREEDY))
     {
-      g_string_assign(self->current_value, self->src);
-      self->src += self->current_value->len;
+      self->current_slice = self->src;
+      self->current_slice_len = self->input + self->input_len - self->src;
+      self->src += self->current_slice_len;
       self->state = CSV_STATE_GREEDY_COLUMN;
       return TRUE;
     }
@@ -377,6 +666,10 @@ csv_scanner_scan_next(CSVScanner *self)
       self->state = CSV_STATE_PARTIAL_INPUT;
       return FALSE;
     }
+  else if (_slices_supported(self) && _parse_value_as_slice(self))
+    {
+      return TRUE;
+    }
   else
     {
       _parse_opening_quote_character(self);
@@ -413,6 +706,8 @@ csv_scanner_init(CSVScanner *scanner, CSVScannerOptions *options, const gchar *i
 {
   memset(scanner, 0, sizeof(*scanner));
   scanner->state = CSV_STATE_INITIAL;
+  scanner->input = input;
+  scanner->input_len = strlen(input);
   scanner->src = input;
   scanner->current_value = scratch_buffers_alloc();
   scanner->current_column = NULL;
@@ -427,15 +722,35 @@ csv_scanner_deinit(CSVScanner *self)
 const gchar *
 csv_scanner_get_current_value(CSVScanner *self)
 {
+  if (self->current_slice && !self->current_value_filled)
+    {
+      g_string_assign_len(self->current_value, self->current_slice, self->current_slice_len);
+      self->current_value_filled = TRUE;
+    }
   return self->current_value->str;
 }
 
 gint
 csv_scanner_get_current_value_len(CSVScanner *self)
 {
+  if (self->current_slice)
+    return self->current_slice_len;
   return self->current_value->len;
 }
 
+/* returns TRUE if the current value is a verbatim part of the input,
+ * starting at @ofs, in which case it can be referenced instead of copied */
+gboolean
+csv_scanner_get_current_value_slice(CSVScanner *self, gsize *ofs, gsize *len)
+{
+  if (!self->current_slice)
+    return FALSE;
+
+  *ofs = self->current_slice - self->input;
+  *len = self->current_slice_len;
+  return TRUE;
+}
+
 gchar *
 csv_scanner_dup_current_value(CSVScanner *self)
 {
@@ -76,9 +76,21 @@ typedef struct
     CSV_STATE_FINISH,
   } state;
   GList *current_column;
+  const gchar *input;
+  gsize input_len;
   const gchar *src;
   GString *current_value;
   gchar current_quote;
+
+  /* if the current value did not need unescaping, it is not copied into
+   * current_value, only located in the input: current_value is filled on
+   * demand */
+  const gchar *current_slice;
+  gsize current_slice_len;
+  gboolean current_value_filled;
+
+  /* delimiter and quote bitmaps of the input, see csv-scanner.c */
+  GString *bitmaps;
 } CSVScanner;
 
 const gchar *csv_scanner_get_current_name(CSVScanner *pstate);
@@ -87,6 +99,7 @@ gint csv_scanner_get_current_value_len(CSVScanner *self);
 gboolean csv_scanner_scan_next(CSVScanner *pstate);
 gboolean csv_scanner_is_scan_complete(CSVScanner *pstate);
 gchar *csv_scanner_dup_current_value(CSVScanner *self);
+gboolean csv_scanner_get_current_value_slice(CSVScanner *self, gsize *ofs, gsize *len);
 
 void csv_scanner_init(CSVScanner *pstate, CSVScannerOptions *options, const gchar *input);
 void csv_scanner_deinit(CSVScanner *pstate);
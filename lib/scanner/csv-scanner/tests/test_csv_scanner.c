@@ -69,6 +69,16 @@ _column_nv_equals(const gchar *name, const gchar *value)
   return _column_name_equals(name) && strcmp(csv_scanner_get_current_value(&scanner), value) == 0;
 }
 
+static gboolean
+_column_is_slice_of_input(const gchar *input, const gchar *value)
+{
+  gsize ofs, len;
+
+  if (!csv_scanner_get_current_value_slice(&scanner, &ofs, &len))
+    return FALSE;
+  return len == strlen(value) && strncmp(input + ofs, value, len) == 0;
+}
+
 static gboolean
 _scan_complete(void)
 {
@@ -190,6 +200,63 @@ Test(csv_scanner, greedy_column)
   csv_scanner_deinit(&scanner);
 }
 
+Test(csv_scanner, columns_without_escapes_are_slices_of_the_input)
+{
+  const gchar *columns[] = { "foo", "bar", "baz", "qux", NULL };
+  const gchar *input = " val1 ,' val2 ',\"va\"\"l3\",\"val4\"";
+
+  csv_scanner_init(&scanner, _default_options(columns), input);
+
+  cr_expect(_scan_next());
+  cr_expect(_column_nv_equals("foo", "val1"));
+  cr_expect(_column_is_slice_of_input(input, "val1"));
+
+  cr_expect(_scan_next());
+  cr_expect(_column_nv_equals("bar", "val2"));
+  cr_expect(_column_is_slice_of_input(input, "val2"));
+
+  /* needs unescaping, copied */
+  cr_expect(_scan_next());
+  cr_expect(_column_nv_equals("baz", "va\"l3"));
+  cr_expect(!_column_is_slice_of_input(input, "va\"l3"));
+
+  cr_expect(_scan_next());
+  cr_expect(_column_nv_equals("qux", "val4"));
+  cr_expect(_column_is_slice_of_input(input, "val4"));
+
+  cr_expect(!_scan_next());
+  cr_expect(_scan_complete());
+  csv_scanner_deinit(&scanner);
+}
+
+Test(csv_scanner, columns_spanning_multiple_64_byte_blocks)
+{
+  const gchar *columns[] = { "foo", "bar", "baz", NULL };
+  GString *input = g_string_new("");
+  gchar *long_value = g_strnfill(100, 'x');
+
+  g_string_append_printf(input, "%s,\"%s\",%s", long_value, long_value, long_value);
+  csv_scanner_init(&scanner, _default_options(columns), input->str);
+
+  cr_expect(_scan_next());
+  cr_expect(_column_nv_equals("foo", long_value));
+  cr_expect(_column_is_slice_of_input(input->str, long_value));
+
+  cr_expect(_scan_next());
+  cr_expect(_column_nv_equals("bar", long_value));
+  cr_expect(_column_is_slice_of_input(input->str, long_value));
+
+  cr_expect(_scan_next());
+  cr_expect(_column_nv_equals("baz", long_value));
+  cr_expect(csv_scanner_get_current_value_len(&scanner) == 100);
+
+  cr_expect(!_scan_next());
+  cr_expect(_scan_complete());
+  csv_scanner_deinit(&scanner);
+  g_free(long_value);
+  g_string_free(input, TRUE);
+}
+
 static void
 setup(void)
 {
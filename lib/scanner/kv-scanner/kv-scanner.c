@@ -26,6 +26,35 @@
 #include "scratch-buffers.h"
 #include <string.h>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define KV_SCANNER_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define KV_SCANNER_HAVE_X86_SIMD 0
+#endif
+
+/*
+ * The input is classified once, before the first key is looked up: a
+ * bitmap is built for each character class the scanner is interested in,
+ * with one bit per input byte.  Locating separators, walking over keys and
+ * spaces and finding the possible end of unquoted values then becomes a
+ * matter of finding set or clear bits in these bitmaps, 64 bytes at a
+ * time, instead of testing the input character by character.
+ */
+enum
+{
+  /* the value separator, e.g. '=' */
+  KV_CLASS_SEPARATOR,
+  KV_CLASS_SPACE,
+  KV_CLASS_KEY_CHAR,
+  /* characters that may end an unquoted value: space, the first character
+   * of the pair separator and the stop character */
+  KV_CLASS_DELIMITER,
+  KV_CLASS_MAX
+};
+
+#define KV_BITMAP_WORD_BITS 64
+
 static inline gboolean
 _is_valid_key_character(gchar c)
 {
@@ -37,30 +66,201 @@ _is_valid_key_character(gchar c)
          (c == '-');
 }
 
-static inline const gchar *
-_locate_separator(KVScanner *self, const gchar *start)
+static inline gsize
+_bitmap_words(KVScanner *self)
 {
-  return strchr(start, self->value_separator);
+  return self->input_len / KV_BITMAP_WORD_BITS + 1;
 }
 
-static inline void
-_locate_start_of_key(KVScanner *self, const gchar *end_of_key, const gchar **start_of_key)
+static inline const guint64 *
+_bitmap(KVScanner *self, gint class)
 {
-  const gchar *input = &self->input[self->input_pos];
-  const gchar *cur;
+  return ((const guint64 *) self->bitmaps->str) + class * _bitmap_words(self);
+}
+
+static inline gboolean
+_bitmap_test(const guint64 *bitmap, gsize pos)
+{
+  return (bitmap[pos / KV_BITMAP_WORD_BITS] >> (pos % KV_BITMAP_WORD_BITS)) & 1;
+}
+
+/* returns the first position at or after @pos that has its bit equal to
+ * @set, or input_len if there is none. Bits past the end of the input
+ * are clear. */
+static inline gsize
+_bitmap_find_next(KVScanner *self, const guint64 *bitmap, gsize pos, gboolean set)
+{
+  gsize nwords = _bitmap_words(self);
+  gsize w = pos / KV_BITMAP_WORD_BITS;
+  guint64 word;
+
+  if (pos >= self->input_len)
+    return self->input_len;
 
-  cur = end_of_key;
-  while (cur > input && self->is_valid_key_character(*(cur - 1)))
-    cur--;
-  *start_of_key = cur;
+  word = (set ? bitmap[w] : ~bitmap[w]) & (~G_GUINT64_CONSTANT(0) << (pos % KV_BITMAP_WORD_BITS));
+  while (!word)
+    {
+      if (++w >= nwords)
+        return self->input_len;
+      word = set ? bitmap[w] : ~bitmap[w];
+    }
+  return MIN(w * KV_BITMAP_WORD_BITS + __builtin_ctzll(word), self->input_len);
 }
 
-static inline void
-_locate_end_of_key(KVScanner *self, const gchar *separator, const gchar **end_of_key)
+/* returns the start of the run of set bits that ends right before @pos,
+ * without going below @lower */
+static inline gsize
+_bitmap_find_run_start(const guint64 *bitmap, gsize pos, gsize lower)
 {
-  const gchar *input = &self->input[self->input_pos];
-  const gchar *cur;
+  while (pos > lower)
+    {
+      gsize w = (pos - 1) / KV_BITMAP_WORD_BITS;
+      gsize bit = (pos - 1) % KV_BITMAP_WORD_BITS;
+      guint64 below_pos = bit == KV_BITMAP_WORD_BITS - 1
+                          ? ~G_GUINT64_CONSTANT(0)
+                          : (G_GUINT64_CONSTANT(1) << (bit + 1)) - 1;
+      guint64 clear = ~bitmap[w] & below_pos;
+
+      if (clear)
+        return MAX(w * KV_BITMAP_WORD_BITS + (KV_BITMAP_WORD_BITS - 1 - __builtin_clzll(clear)) + 1, lower);
+      pos = w * KV_BITMAP_WORD_BITS;
+    }
+  return lower;
+}
+
+static inline gchar
+_delimiter_char_or_space(gchar c)
+{
+  return c ? c : ' ';
+}
+
+static void
+_classify_scalar(KVScanner *self, gsize from, guint64 *bitmaps[KV_CLASS_MAX])
+{
+  gchar pair_separator_char = _delimiter_char_or_space(self->pair_separator[0]);
+  gchar stop_char = _delimiter_char_or_space(self->stop_char);
+  gsize pos;
+
+  for (pos = from; pos < self->input_len; pos++)
+    {
+      gchar c = self->input[pos];
+      guint64 bit = G_GUINT64_CONSTANT(1) << (pos % KV_BITMAP_WORD_BITS);
+      gsize w = pos / KV_BITMAP_WORD_BITS;
+
+      if (c == self->value_separator)
+        bitmaps[KV_CLASS_SEPARATOR][w] |= bit;
+      if (c == ' ')
+        bitmaps[KV_CLASS_SPACE][w] |= bit;
+      if (self->is_valid_key_character(c))
+        bitmaps[KV_CLASS_KEY_CHAR][w] |= bit;
+      if (c == ' ' || c == pair_separator_char || c == stop_char)
+        bitmaps[KV_CLASS_DELIMITER][w] |= bit;
+    }
+}
+
+#if KV_SCANNER_HAVE_X86_SIMD
+
+/* compares to an inclusive character range, using the signed comparison
+ * SSE2 has by shifting the range to start at -128 */
+static inline __m128i
+_sse2_in_range(__m128i chunk, gchar first, gchar last)
+{
+  __m128i shifted = _mm_sub_epi8(chunk, _mm_set1_epi8((gchar) (first + 128)));
+  return _mm_cmplt_epi8(shifted, _mm_set1_epi8((gchar) (last - first + 1 - 128)));
+}
+
+static inline guint64
+_sse2_key_char_mask(__m128i chunk)
+{
+  __m128i match = _mm_or_si128(_mm_or_si128(_sse2_in_range(chunk, 'a', 'z'),
+                                            _sse2_in_range(chunk, 'A', 'Z')),
+                               _mm_or_si128(_sse2_in_range(chunk, '0', '9'),
+                                            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')),
+                                                         _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('.')),
+                                                             _mm_cmpeq_epi8(chunk, _mm_set1_epi8('-'))))));
+  return (guint32) _mm_movemask_epi8(match);
+}
 
+/* classifies the input in blocks of 64 bytes, returns the position where
+ * the scalar classifier has to take over */
+static gsize
+_classify_sse2(KVScanner *self, guint64 *bitmaps[KV_CLASS_MAX])
+{
+  const __m128i separator = _mm_set1_epi8(self->value_separator);
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i pair_separator = _mm_set1_epi8(_delimiter_char_or_space(self->pair_separator[0]));
+  const __m128i stop_char = _mm_set1_epi8(_delimiter_char_or_space(self->stop_char));
+  gboolean default_key_chars = self->is_valid_key_character == _is_valid_key_character;
+  gsize pos;
+
+  if (!default_key_chars)
+    return 0;
+
+  for (pos = 0; pos + KV_BITMAP_WORD_BITS <= self->input_len; pos += KV_BITMAP_WORD_BITS)
+    {
+      guint64 masks[KV_CLASS_MAX] = { 0 };
+      gsize w = pos / KV_BITMAP_WORD_BITS;
+      gint i, class;
+
+      for (i = 0; i < KV_BITMAP_WORD_BITS / sizeof(__m128i); i++)
+        {
+          __m128i chunk = _mm_loadu_si128((const __m128i *) (self->input + pos + i * sizeof(__m128i)));
+          __m128i spaces = _mm_cmpeq_epi8(chunk, space);
+          gint shift = i * sizeof(__m128i);
+
+          masks[KV_CLASS_SEPARATOR] |= (guint64) (guint32) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, separator)) << shift;
+          masks[KV_CLASS_SPACE] |= (guint64) (guint32) _mm_movemask_epi8(spaces) << shift;
+          masks[KV_CLASS_KEY_CHAR] |= _sse2_key_char_mask(chunk) << shift;
+          masks[KV_CLASS_DELIMITER] |= (guint64) (guint32)
+                                       _mm_movemask_epi8(_mm_or_si128(spaces,
+                                                                      _mm_or_si128(_mm_cmpeq_epi8(chunk, pair_separator),
+                                                                          _mm_cmpeq_epi8(chunk, stop_char)))) << shift;
+        }
+      for (class = 0; class < KV_CLASS_MAX; class++)
+        bitmaps[class][w] = masks[class];
+    }
+  return pos;
+}
+
+#endif
+
+static void
+_classify_input(KVScanner *self)
+{
+  guint64 *bitmaps[KV_CLASS_MAX];
+  gsize nwords, from = 0;
+  gint class;
+
+  self->input_len = strlen(self->input);
+  nwords = _bitmap_words(self);
+
+  g_string_set_size(self->bitmaps, KV_CLASS_MAX * nwords * sizeof(guint64));
+  memset(self->bitmaps->str, 0, self->bitmaps->len);
+  for (class = 0; class < KV_CLASS_MAX; class++)
+    bitmaps[class] = ((guint64 *) self->bitmaps->str) + class * nwords;
+
+#if KV_SCANNER_HAVE_X86_SIMD
+  from = _classify_sse2(self, bitmaps);
+#endif
+  _classify_scalar(self, from, bitmaps);
+  self->input_classified = TRUE;
+}
+
+static inline gsize
+_locate_separator(KVScanner *self, gsize start)
+{
+  return _bitmap_find_next(self, _bitmap(self, KV_CLASS_SEPARATOR), start, TRUE);
+}
+
+static inline gsize
+_locate_start_of_key(KVScanner *self, gsize end_of_key)
+{
+  return _bitmap_find_run_start(_bitmap(self, KV_CLASS_KEY_CHAR), end_of_key, self->input_pos);
+}
+
+static inline gsize
+_locate_end_of_key(KVScanner *self, gsize separator)
+{
   /* this function locates the character pointing right next to the end of
    * the key, e.g. with this input
    *   foo   = bar
@@ -68,10 +268,7 @@ _locate_end_of_key(KVScanner *self, const gchar *separator, const gchar **end_of
    * it would start with the '=' sign and skip spaces backwards, to locate
    * the space right next to "foo" */
 
-  cur = separator;
-  while (cur > input && (*(cur - 1)) == ' ')
-    cur--;
-  *end_of_key = cur;
+  return _bitmap_find_run_start(_bitmap(self, KV_CLASS_SPACE), separator, self->input_pos);
 }
 
 static inline gboolean
@@ -122,19 +319,19 @@ static gboolean
 _extract_key(KVScanner *self)
 {
   const gchar *input = &self->input[self->input_pos];
-  const gchar *start_of_key, *end_of_key;
-  const gchar *separator;
+  gsize start_of_key, end_of_key;
+  gsize separator;
 
-  separator = _locate_separator(self, input);
-  while (separator)
+  separator = _locate_separator(self, self->input_pos);
+  while (separator < self->input_len)
     {
-      _locate_end_of_key(self, separator, &end_of_key);
-      _locate_start_of_key(self, end_of_key, &start_of_key);
+      end_of_key = _locate_end_of_key(self, separator);
+      start_of_key = _locate_start_of_key(self, end_of_key);
 
-      if (_extract_key_from_positions(self, start_of_key, end_of_key))
+      if (_extract_key_from_positions(self, &self->input[start_of_key], &self->input[end_of_key]))
         {
-          _extract_stray_word(self, input, start_of_key - input);
-          self->input_pos = separator - self->input + 1;
+          _extract_stray_word(self, input, start_of_key - self->input_pos);
+          self->input_pos = separator + 1;
           return TRUE;
         }
       separator = _locate_separator(self, separator + 1);
@@ -152,14 +349,12 @@ _is_quoted(const gchar *input)
 static gboolean
 _key_follows(KVScanner *self, const gchar *cur)
 {
-  const gchar *key = cur;
+  gsize pos = cur - self->input;
+  gsize end_of_key, next;
 
-  while (self->is_valid_key_character(*key))
-    key++;
-
-  while (*key == ' ')
-    key++;
-  return (key != cur) && (*key == self->value_separator);
+  end_of_key = _bitmap_find_next(self, _bitmap(self, KV_CLASS_KEY_CHAR), pos, FALSE);
+  next = _bitmap_find_next(self, _bitmap(self, KV_CLASS_SPACE), end_of_key, FALSE);
+  return (end_of_key != pos) && next < self->input_len && _bitmap_test(_bitmap(self, KV_CLASS_SEPARATOR), next);
 }
 
 static inline void
@@ -253,6 +448,35 @@ _skip_initial_spaces(KVScanner *self)
   self->input_pos = input - self->input;
 }
 
+/* unquoted values end at the first delimiter character that
+ * _match_delimiter() accepts, these are looked up using the bitmap instead
+ * of running the generic decoder character by character */
+static void
+_decode_unquoted_value(KVScanner *self)
+{
+  const guint64 *delimiters = _bitmap(self, KV_CLASS_DELIMITER);
+  gsize start = self->input_pos;
+  gsize pos;
+
+  self->value_is_slice = TRUE;
+  self->value_ofs = start;
+  for (pos = _bitmap_find_next(self, delimiters, start, TRUE);
+       pos < self->input_len;
+       pos = _bitmap_find_next(self, delimiters, pos + 1, TRUE))
+    {
+      const gchar *end;
+
+      if (_match_delimiter(&self->input[pos], &end, self))
+        {
+          g_string_assign_len(self->value, &self->input[start], pos - start);
+          self->input_pos = end - self->input;
+          return;
+        }
+    }
+  g_string_assign_len(self->value, &self->input[start], self->input_len - start);
+  self->input_pos = self->input_len;
+}
+
 static inline void
 _decode_value(KVScanner *self)
 {
@@ -266,6 +490,12 @@ _decode_value(KVScanner *self)
   };
 
   self->value_was_quoted = _is_quoted(input);
+  if (!self->value_was_quoted)
+    {
+      _decode_unquoted_value(self);
+      return;
+    }
+
   if (str_repr_decode_with_options(self->value, input, &end, &options))
     {
       self->input_pos = end - self->input;
@@ -288,6 +518,7 @@ static void
 _extract_value(KVScanner *self)
 {
   self->value_was_quoted = FALSE;
+  self->value_is_slice = FALSE;
   _skip_initial_spaces(self);
   _decode_value(self);
 }
@@ -299,7 +530,10 @@ _transform_value(KVScanner *self)
     {
       g_string_truncate(self->decoded_value, 0);
       if (self->transform_value(self))
-        g_string_assign_len(self->value, self->decoded_value->str, self->decoded_value->len);
+        {
+          g_string_assign_len(self->value, self->decoded_value->str, self->decoded_value->len);
+          self->value_is_slice = FALSE;
+        }
     }
 }
 
@@ -311,6 +545,9 @@ kv_scanner_scan_next(KVScanner *s)
   if (_should_stop(self))
     return FALSE;
 
+  if (!self->input_classified)
+    _classify_input(self);
+
   if (!_extract_key(self))
     return FALSE;
 
@@ -335,6 +572,7 @@ kv_scanner_init(KVScanner *self, gchar value_separator, const gchar *pair_separa
   self->key = scratch_buffers_alloc();
   self->value = scratch_buffers_alloc();
   self->decoded_value = scratch_buffers_alloc();
+  self->bitmaps = scratch_buffers_alloc();
   if (extract_stray_words)
     self->stray_words = scratch_buffers_alloc();
   self->value_separator = value_separator;
@@ -37,11 +37,18 @@ struct _KVScanner
 {
   const gchar *input;
   gsize input_pos;
+  gsize input_len;
+  /* per character class bitmaps of the input, see kv-scanner.c */
+  GString *bitmaps;
+  gboolean input_classified;
   GString *key;
   GString *value;
   GString *decoded_value;
   GString *stray_words;
   gboolean value_was_quoted;
+  /* set if the current value is a verbatim copy of the input at value_ofs */
+  gboolean value_is_slice;
+  gsize value_ofs;
   gchar value_separator;
   const gchar *pair_separator;
   gsize pair_separator_len;
@@ -60,6 +67,7 @@ kv_scanner_input(KVScanner *self, const gchar *input)
 {
   self->input = input;
   self->input_pos = 0;
+  self->input_classified = FALSE;
   if (self->stray_words)
     g_string_truncate(self->stray_words, 0);
 }
@@ -76,6 +84,19 @@ kv_scanner_get_current_value(KVScanner *self)
   return self->value->str;
 }
 
+/* returns TRUE if the current value was copied verbatim from the input,
+ * starting at @ofs, so it can be referenced instead of copied again */
+static inline gboolean
+kv_scanner_get_current_value_slice(KVScanner *self, gsize *ofs, gsize *len)
+{
+  if (!self->value_is_slice)
+    return FALSE;
+
+  *ofs = self->value_ofs;
+  *len = self->value->len;
+  return TRUE;
+}
+
 static inline const gchar *
 kv_scanner_get_stray_words(KVScanner *self)
 {
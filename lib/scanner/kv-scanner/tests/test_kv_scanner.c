@@ -342,6 +342,24 @@ Test(kv_scanner, spaces_between_values_are_ignored)
   { "key3", "value3" });
 }
 
+Test(kv_scanner, keys_and_values_spanning_multiple_64_byte_blocks)
+{
+  /* the input is classified in blocks of 64 bytes, make sure keys, spaces
+   * and values crossing block boundaries are handled */
+  _EXPECT_KV_PAIRS("date=2021-06-01 time=12:00:01 devname=FG100D devid=FG100D3G00000000 "
+                   "a_very_long_key_name_that_crosses_the_boundary_of_the_classified_blocks"
+                   "                                                                  = value "
+                   "stray words before key=\"quoted value spanning multiple blocks, still in one piece\" "
+                   "last=one",
+  { "date", "2021-06-01" },
+  { "time", "12:00:01" },
+  { "devname", "FG100D" },
+  { "devid", "FG100D3G00000000" },
+  { "a_very_long_key_name_that_crosses_the_boundary_of_the_classified_blocks", "value stray words before" },
+  { "key", "quoted value spanning multiple blocks, still in one piece" },
+  { "last", "one" });
+}
+
 Test(kv_scanner, comma_separated_values)
 {
   _EXPECT_KV_PAIRS("key1=value1, key2=value2, key3=value3",
@@ -27,5 +27,6 @@
 
 typedef struct _LogTemplateOptions LogTemplateOptions;
 typedef struct _LogTemplate LogTemplate;
+typedef struct _LogTemplateProgram LogTemplateProgram;
 
 #endif
@@ -24,6 +24,7 @@
 
 #include "eval.h"
 #include "repr.h"
+#include "program.h"
 #include "macros.h"
 #include "escaping.h"
 #include "cfg.h"
@@ -32,20 +33,26 @@ void
 log_template_append_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
                                         LogTemplateEvalOptions *options, GString *result)
 {
-  GList *p;
-  LogTemplateElem *e;
+  LogTemplateProgram *program = self->program;
+  gsize start_len = result->len;
+  gint i;
 
   if (!options->opts)
     options->opts = &self->cfg->template_options;
 
-  for (p = self->compiled_template; p; p = g_list_next(p))
+  if (!program)
+    return;
+
+  log_template_program_reserve(program, result);
+  for (i = 0; i < program->num_instrs; i++)
     {
+      const LogTemplateInstr *instr = &program->instrs[i];
       gint msg_ndx;
 
-      e = (LogTemplateElem *) p->data;
-      if (e->text)
+      if (instr->opcode == LTI_LITERAL)
         {
-          g_string_append_len(result, e->text, e->text_len);
+          g_string_append_len(result, instr->text, instr->text_len);
+          continue;
         }
 
       /* NOTE: msg_ref is 1 larger than the index specified by the user in
@@ -54,61 +61,87 @@ log_template_append_format_with_context(LogTemplate *self, LogMessage **messages
        *
        * msg_ref == 0 means that the user didn't specify msg_ref
        * msg_ref >= 1 means that the user supplied the given msg_ref, 1 is equal to @0 */
-      if (e->msg_ref > num_messages)
+      if (instr->msg_ref > num_messages)
         continue;
-      msg_ndx = num_messages - e->msg_ref;
+      msg_ndx = num_messages - instr->msg_ref;
 
       /* value and macro can't understand a context, assume that no msg_ref means @0 */
-      if (e->msg_ref == 0)
+      if (instr->msg_ref == 0)
         msg_ndx--;
 
-      switch (e->type)
+      switch (instr->opcode)
+        {
+        case LTI_VALUE:
         {
-        case LTE_VALUE:
+          gssize value_len = -1;
+          const gchar *value = log_msg_get_value(messages[msg_ndx], instr->value_handle, &value_len);
+
+          if (value && value[0])
+            g_string_append_len(result, value, value_len);
+          else if (instr->text)
+            g_string_append_len(result, instr->text, instr->text_len);
+          break;
+        }
+        case LTI_VALUE_ESCAPED:
         {
-          const gchar *value = NULL;
           gssize value_len = -1;
+          const gchar *value = log_msg_get_value(messages[msg_ndx], instr->value_handle, &value_len);
 
-          value = log_msg_get_value(messages[msg_ndx], e->value_handle, &value_len);
           if (value && value[0])
-            result_append(result, value, value_len, self->escape);
-          else if (e->default_value)
-            result_append(result, e->default_value, -1, self->escape);
+            result_append(result, value, value_len, TRUE);
+          else if (instr->text)
+            result_append(result, instr->text, instr->text_len, TRUE);
+          break;
+        }
+        case LTI_MACRO_VALUE:
+        {
+          gssize value_len = 0;
+          const gchar *value = log_msg_get_value(messages[msg_ndx], instr->value_handle, &value_len);
+
+          if (value_len > 0)
+            g_string_append_len(result, value, value_len);
+          else if (instr->text)
+            g_string_append_len(result, instr->text, instr->text_len);
+          break;
+        }
+        case LTI_MACRO_VALUE_ESCAPED:
+        {
+          gssize value_len = 0;
+          const gchar *value = log_msg_get_value(messages[msg_ndx], instr->value_handle, &value_len);
+
+          if (value_len > 0)
+            result_append(result, value, value_len, TRUE);
+          else if (instr->text)
+            g_string_append_len(result, instr->text, instr->text_len);
           break;
         }
-        case LTE_MACRO:
+        case LTI_MACRO:
         {
           gint len = result->len;
 
-          if (e->macro)
-            {
-              log_macro_expand(result, e->macro, self->escape, options, messages[msg_ndx]);
-              if (len == result->len && e->default_value)
-                g_string_append(result, e->default_value);
-            }
+          log_macro_expand(result, instr->macro, self->escape, options, messages[msg_ndx]);
+          if (len == result->len && instr->text)
+            g_string_append_len(result, instr->text, instr->text_len);
           break;
         }
-        case LTE_FUNC:
+        case LTI_FUNC:
         {
-          if (1)
-            {
-              LogTemplateInvokeArgs args =
-              {
-                e->msg_ref ? &messages[msg_ndx] : messages,
-                e->msg_ref ? 1 : num_messages,
-                options,
-              };
-
-
-              /* if a function call is called with an msg_ref, we only
-               * pass that given logmsg to argument resolution, otherwise
-               * we pass the whole set so the arguments can individually
-               * specify which message they want to resolve from
-               */
-              if (e->func.ops->eval)
-                e->func.ops->eval(e->func.ops, e->func.state, &args);
-              e->func.ops->call(e->func.ops, e->func.state, &args, result);
-            }
+          LogTemplateElem *e = instr->func;
+          LogTemplateInvokeArgs args =
+          {
+            e->msg_ref ? &messages[msg_ndx] : messages,
+            e->msg_ref ? 1 : num_messages,
+            options,
+          };
+
+          /* if a function call is called with an msg_ref, we only
+           * pass that given logmsg to argument resolution, otherwise
+           * we pass the whole set so the arguments can individually
+           * specify which message they want to resolve from
+           */
+          if (e->func.ops->eval)
+            e->func.ops->eval(e->func.ops, e->func.state, &args);
+          e->func.ops->call(e->func.ops, e->func.state, &args, result);
           break;
         }
         default:
@@ -116,6 +149,7 @@ log_template_append_format_with_context(LogTemplate *self, LogMessage **messages
           break;
         }
     }
+  log_template_program_update_size_hint(program, result->len - start_len);
 }
 
 void
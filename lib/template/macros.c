@@ -268,6 +268,37 @@ _is_message_dest_an_ip_address(const LogMessage *msg)
   return FALSE;
 }
 
+/* complete timestamps are formatted through the per-thread cache in
+ * timeutils/format.c, which only needs the zone offset, not the broken
+ * down time */
+static gboolean
+log_macro_expand_formatted_timestamp(GString *result, gint id, LogTemplateEvalOptions *options,
+                                     const UnixTime *stamp, glong zone_offset)
+{
+  gint frac_digits = options->opts->frac_digits;
+
+  switch (id)
+    {
+    case M_DATE:
+      append_format_unix_time(stamp, result, TS_FMT_BSD, zone_offset, frac_digits);
+      return TRUE;
+    case M_STAMP:
+      append_format_unix_time(stamp, result, options->opts->ts_format, zone_offset, frac_digits);
+      return TRUE;
+    case M_ISODATE:
+      append_format_unix_time(stamp, result, TS_FMT_ISO, zone_offset, frac_digits);
+      return TRUE;
+    case M_FULLDATE:
+      append_format_unix_time(stamp, result, TS_FMT_FULL, zone_offset, frac_digits);
+      return TRUE;
+    case M_UNIXTIME:
+      append_format_unix_time(stamp, result, TS_FMT_UNIX, zone_offset, frac_digits);
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
 static void
 log_macro_expand_date_time(GString *result, gint id, gboolean escape,
                            LogTemplateEvalOptions *options, const LogMessage *msg)
@@ -320,9 +351,12 @@ log_macro_expand_date_time(GString *result, gint id, gboolean escape,
    *   local timezone
    */
   WallClockTime wct;
+  glong zone_offset = time_zone_info_get_offset(options->opts->time_zone_info[options->tz], stamp->ut_sec);
+
+  if (log_macro_expand_formatted_timestamp(result, id, options, stamp, zone_offset))
+    return;
 
-  convert_unix_time_to_wall_clock_time_with_tz_override(stamp, &wct,
-                                                        time_zone_info_get_offset(options->opts->time_zone_info[options->tz], stamp->ut_sec));
+  convert_unix_time_to_wall_clock_time_with_tz_override(stamp, &wct, zone_offset);
   switch (id)
     {
     case M_WEEK_DAY_ABBREV:
@@ -391,24 +425,6 @@ log_macro_expand_date_time(GString *result, gint id, gboolean escape,
     case M_AMPM:
       g_string_append(result, wct.wct_hour < 12 ? "AM" : "PM");
       break;
-    case M_DATE:
-      append_format_wall_clock_time(&wct, result, TS_FMT_BSD, options->opts->frac_digits);
-      break;
-    case M_STAMP:
-      if (options->opts->ts_format == TS_FMT_UNIX)
-        append_format_unix_time(stamp, result, TS_FMT_UNIX, wct.wct_gmtoff, options->opts->frac_digits);
-      else
-        append_format_wall_clock_time(&wct, result, options->opts->ts_format, options->opts->frac_digits);
-      break;
-    case M_ISODATE:
-      append_format_wall_clock_time(&wct, result, TS_FMT_ISO, options->opts->frac_digits);
-      break;
-    case M_FULLDATE:
-      append_format_wall_clock_time(&wct, result, TS_FMT_FULL, options->opts->frac_digits);
-      break;
-    case M_UNIXTIME:
-      append_format_unix_time(stamp, result, TS_FMT_UNIX, wct.wct_gmtoff, options->opts->frac_digits);
-      break;
     case M_TZ:
     case M_TZOFFSET:
       append_format_zone_info(result, wct.wct_gmtoff);
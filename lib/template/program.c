@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "template/program.h"
+
+#include <string.h>
+
+/* while the program is being built, literal instructions store an offset
+ * into the literal buffer, as it may be reallocated as it grows */
+static void
+_emit_literal(GArray *instrs, GString *literals, const gchar *text, gsize text_len)
+{
+  LogTemplateInstr *last = instrs->len > 0 ? &g_array_index(instrs, LogTemplateInstr, instrs->len - 1) : NULL;
+
+  if (text_len == 0)
+    return;
+
+  if (last && last->opcode == LTI_LITERAL)
+    {
+      last->text_len += text_len;
+    }
+  else
+    {
+      LogTemplateInstr instr =
+      {
+        .opcode = LTI_LITERAL,
+        .text = GSIZE_TO_POINTER(literals->len),
+        .text_len = text_len,
+      };
+
+      g_array_append_val(instrs, instr);
+    }
+  g_string_append_len(literals, text, text_len);
+}
+
+static void
+_lower_value(LogTemplateInstr *instr, NVHandle value_handle, gboolean escape)
+{
+  instr->opcode = escape ? LTI_VALUE_ESCAPED : LTI_VALUE;
+  instr->value_handle = value_handle;
+}
+
+/* Only $MSG/$MESSAGE is a plain name-value lookup among the macros, so
+ * that is the only one lowered to a lookup.  $PROGRAM, $PID, $MSGID and
+ * the like are no macros, they are compiled to values in the first place.
+ * The rest is left to log_macro_expand(): $HOST depends on the
+ * LF_CHAINED_HOSTNAME flag of each message, $SEQNUM and $CONTEXT_ID on
+ * the eval options, and the date, facility and SDATA macros are formatted
+ * values, the switch in log_macro_expand() is cheap compared to them. */
+static void
+_lower_macro(LogTemplateInstr *instr, guint macro, gboolean escape)
+{
+  if (macro == M_MESSAGE)
+    {
+      instr->opcode = escape ? LTI_MACRO_VALUE_ESCAPED : LTI_MACRO_VALUE;
+      instr->value_handle = LM_V_MESSAGE;
+      return;
+    }
+
+  instr->opcode = LTI_MACRO;
+  instr->macro = macro;
+}
+
+static void
+_emit_elem(GArray *instrs, GString *literals, LogTemplateElem *e, gboolean escape)
+{
+  LogTemplateInstr instr =
+  {
+    .msg_ref = e->msg_ref,
+    .text = e->default_value,
+    .text_len = e->default_value ? strlen(e->default_value) : 0,
+  };
+
+  _emit_literal(instrs, literals, e->text, e->text_len);
+
+  switch (e->type)
+    {
+    case LTE_VALUE:
+      _lower_value(&instr, e->value_handle, escape);
+      break;
+    case LTE_MACRO:
+      if (e->macro == M_NONE)
+        return;
+      _lower_macro(&instr, e->macro, escape);
+      break;
+    case LTE_FUNC:
+      instr.opcode = LTI_FUNC;
+      instr.func = e;
+      break;
+    default:
+      g_assert_not_reached();
+    }
+  g_array_append_val(instrs, instr);
+}
+
+LogTemplateProgram *
+log_template_program_new(GList *compiled_template, gboolean escape)
+{
+  LogTemplateProgram *self = g_new0(LogTemplateProgram, 1);
+  GArray *instrs = g_array_new(FALSE, FALSE, sizeof(LogTemplateInstr));
+  GString *literals = g_string_sized_new(64);
+
+  for (GList *p = compiled_template; p; p = g_list_next(p))
+    _emit_elem(instrs, literals, (LogTemplateElem *) p->data, escape);
+
+  self->literals = g_string_free(literals, FALSE);
+  for (gint i = 0; i < instrs->len; i++)
+    {
+      LogTemplateInstr *instr = &g_array_index(instrs, LogTemplateInstr, i);
+
+      if (instr->opcode == LTI_LITERAL)
+        instr->text = self->literals + GPOINTER_TO_SIZE(instr->text);
+    }
+
+  self->num_instrs = instrs->len;
+  self->instrs = (LogTemplateInstr *) g_array_free(instrs, FALSE);
+  return self;
+}
+
+void
+log_template_program_free(LogTemplateProgram *self)
+{
+  g_free(self->instrs);
+  g_free(self->literals);
+  g_free(self);
+}
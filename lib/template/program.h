@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef TEMPLATE_PROGRAM_H_INCLUDED
+#define TEMPLATE_PROGRAM_H_INCLUDED
+
+#include "template/repr.h"
+
+/*
+ * The list of LogTemplateElem instances is lowered into a flat array of
+ * instructions once the template is compiled: the literal text of adjacent
+ * elements is folded into a single instruction, macros that are plain
+ * name-value lookups are resolved to their handles and the escaping
+ * decision is made at compile time instead of for every value.
+ */
+enum
+{
+  LTI_LITERAL,
+  LTI_VALUE,
+  LTI_VALUE_ESCAPED,
+  LTI_MACRO_VALUE,
+  LTI_MACRO_VALUE_ESCAPED,
+  LTI_MACRO,
+  LTI_FUNC,
+};
+
+typedef struct _LogTemplateInstr
+{
+  guint8 opcode;
+  guint16 msg_ref;
+
+  /* the text of LTI_LITERAL, the default value of the rest (can be NULL) */
+  const gchar *text;
+  gsize text_len;
+  union
+  {
+    guint macro;
+    NVHandle value_handle;
+    LogTemplateElem *func;
+  };
+} LogTemplateInstr;
+
+struct _LogTemplateProgram
+{
+  LogTemplateInstr *instrs;
+  gint num_instrs;
+  gchar *literals;
+
+  /* the longest output produced so far, used to pre-size the result */
+  gint size_hint;
+};
+
+static inline void
+log_template_program_reserve(LogTemplateProgram *self, GString *result)
+{
+  gsize len = result->len;
+  gsize size_hint = g_atomic_int_get(&self->size_hint);
+
+  if (result->allocated_len > len + size_hint)
+    return;
+
+  g_string_set_size(result, len + size_hint);
+  g_string_truncate(result, len);
+}
+
+static inline void
+log_template_program_update_size_hint(LogTemplateProgram *self, gsize output_len)
+{
+  if (output_len > (gsize) g_atomic_int_get(&self->size_hint) && output_len <= G_MAXINT)
+    g_atomic_int_set(&self->size_hint, output_len);
+}
+
+LogTemplateProgram *log_template_program_new(GList *compiled_template, gboolean escape);
+void log_template_program_free(LogTemplateProgram *self);
+
+#endif
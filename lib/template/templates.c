@@ -23,6 +23,7 @@
  */
 #include "template/templates.h"
 #include "template/repr.h"
+#include "template/program.h"
 #include "template/compiler.h"
 #include "template/macros.h"
 #include "template/escaping.h"
@@ -141,9 +142,20 @@ _calculate_triviality(LogTemplate *self)
     }
 }
 
+static void
+log_template_lower_compiled(LogTemplate *self)
+{
+  if (self->program)
+    log_template_program_free(self->program);
+  self->program = log_template_program_new(self->compiled_template, self->escape);
+}
+
 static void
 log_template_reset_compiled(LogTemplate *self)
 {
+  if (self->program)
+    log_template_program_free(self->program);
+  self->program = NULL;
   log_template_elem_free_list(self->compiled_template);
   self->compiled_template = NULL;
   self->trivial = FALSE;
@@ -166,6 +178,7 @@ log_template_compile(LogTemplate *self, const gchar *template, GError **error)
   result = log_template_compiler_compile(&compiler, &self->compiled_template, error);
   log_template_compiler_clear(&compiler);
 
+  log_template_lower_compiled(self);
   self->trivial = _calculate_triviality(self);
   return result;
 }
@@ -179,6 +192,7 @@ log_template_compile_literal_string(LogTemplate *self, const gchar *literal)
   self->compiled_template = g_list_append(self->compiled_template,
                                           log_template_elem_new_macro(literal, M_NONE, NULL, 0));
 
+  log_template_lower_compiled(self);
   self->trivial = _calculate_triviality(self);
 }
 
@@ -186,6 +200,13 @@ void
 log_template_set_escape(LogTemplate *self, gboolean enable)
 {
   self->escape = enable;
+
+  /* escaping is decided when the template is lowered */
+  if (self->program)
+    {
+      log_template_lower_compiled(self);
+      self->trivial = _calculate_triviality(self);
+    }
 }
 
 gboolean
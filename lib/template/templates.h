@@ -58,6 +58,7 @@ struct _LogTemplate
   gchar *name;
   gchar *template;
   GList *compiled_template;
+  LogTemplateProgram *program;
   GlobalConfig *cfg;
   guint escape:1, def_inline:1, trivial:1;
   TypeHint type_hint;
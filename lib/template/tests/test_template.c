@@ -316,6 +316,38 @@ Test(template, test_escaping)
                                        TRUE, "\\\"value\\\"");
 }
 
+Test(template, test_escaping_message)
+{
+  LogMessage *msg = create_sample_message();
+
+  log_msg_set_value(msg, LM_V_MESSAGE, "\"quoted\" message", -1);
+  assert_template_format_with_escaping_msg("$MSG", TRUE, "\\\"quoted\\\" message", msg);
+  assert_template_format_with_escaping_msg("${MESSAGE}", FALSE, "\"quoted\" message", msg);
+
+  log_msg_set_value(msg, LM_V_MESSAGE, "", -1);
+  assert_template_format_with_escaping_msg("${MSG:-\"none\"}", TRUE, "\"none\"", msg);
+
+  log_msg_unref(msg);
+}
+
+Test(template, test_escaping_can_be_enabled_after_compilation)
+{
+  LogMessage *msg = create_sample_message();
+  GString *result = g_string_new("");
+  LogTemplate *template = compile_template("${APP.QVALUE} $MSG", FALSE);
+
+  log_template_format(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_str_eq(result->str, "\"value\" árvíztűrőtükörfúrógép");
+
+  log_template_set_escape(template, TRUE);
+  log_template_format(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_str_eq(result->str, "\\\"value\\\" árvíztűrőtükörfúrógép");
+
+  log_template_unref(template);
+  g_string_free(result, TRUE);
+  log_msg_unref(msg);
+}
+
 Test(template, test_user_template_function)
 {
   LogTemplate *template;
@@ -26,6 +26,7 @@
 
 #include "logqueue.h"
 #include "logqueue-fifo.h"
+#include "logqueue-ring.h"
 #include "logpipe.h"
 #include "apphook.h"
 #include "plugin.h"
@@ -424,3 +425,110 @@ Test(logqueue, log_queue_fifo_should_drop_only_non_flow_controlled_messages_thre
   _unregister_stats_counters(q);
   log_queue_unref(q);
 }
+
+Test(logqueue, log_queue_ring_should_drop_only_non_flow_controlled_messages,
+     .description = "Flow-controlled messages should never be dropped, even if they do not fit in the ring")
+{
+  LogPathOptions flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  flow_controlled_path.flow_control_requested = TRUE;
+
+  LogPathOptions non_flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  non_flow_controlled_path.flow_control_requested = FALSE;
+
+  gint fifo_size = 5;
+  LogQueue *q = log_queue_ring_new(fifo_size, NULL);
+  log_queue_set_use_backlog(q, TRUE);
+  _register_stats_counters(q);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  /* the ring has room for 64 items at least, these go to the overflow queue */
+  feed_empty_messages(q, &flow_controlled_path, 100);
+  feed_empty_messages(q, &non_flow_controlled_path, fifo_size);
+
+  feed_empty_messages(q, &non_flow_controlled_path, 1);
+  feed_empty_messages(q, &flow_controlled_path, fifo_size);
+  feed_empty_messages(q, &non_flow_controlled_path, 2);
+  feed_empty_messages(q, &flow_controlled_path, fifo_size);
+
+  cr_assert_eq(stats_counter_get(q->dropped_messages), 3);
+  cr_assert_eq(log_queue_get_length(q), 100 + 3 * fifo_size);
+
+  gint queued_messages = stats_counter_get(q->queued_messages);
+  send_some_messages(q, queued_messages);
+  cr_assert_eq(log_queue_get_length(q), 0);
+  log_queue_ack_backlog(q, queued_messages);
+
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  _unregister_stats_counters(q);
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_ring_rewind_backlog_and_memory_usage)
+{
+  LogQueue *q = log_queue_ring_new(OVERFLOW_SIZE, NULL);
+  log_queue_set_use_backlog(q, TRUE);
+  _register_stats_counters(q);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 1);
+  gint size_when_single_msg = stats_counter_get(q->memory_usage);
+
+  feed_some_messages(q, 9);
+  cr_assert_eq(stats_counter_get(q->memory_usage), 10*size_when_single_msg);
+
+  send_some_messages(q, 10);
+  cr_assert_eq(stats_counter_get(q->memory_usage), 0);
+  cr_assert_eq(log_queue_get_length(q), 0);
+
+  log_queue_rewind_backlog(q, 4);
+  cr_assert_eq(log_queue_get_length(q), 4);
+  log_queue_rewind_backlog_all(q);
+  cr_assert_eq(log_queue_get_length(q), 10);
+  cr_assert_eq(stats_counter_get(q->memory_usage), 10*size_when_single_msg);
+
+  send_some_messages(q, 10);
+  log_queue_ack_backlog(q, 10);
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  _unregister_stats_counters(q);
+  log_queue_unref(q);
+}
+
+Test(logqueue, test_ring_with_threads)
+{
+  LogQueue *q;
+  GThread *thread_feed[FEEDERS], *thread_consume;
+  GThread *other_threads[FEEDERS];
+  gint i, j;
+
+  log_queue_set_max_threads(FEEDERS);
+  for (i = 0; i < TEST_RUNS; i++)
+    {
+      q = log_queue_ring_new(MESSAGES_SUM, NULL);
+      log_queue_set_use_backlog(q, TRUE);
+
+      for (j = 0; j < FEEDERS; j++)
+        {
+          other_threads[j] = g_thread_create(_output_thread, NULL, TRUE, NULL);
+          thread_feed[j] = g_thread_create(_threaded_feed, q, TRUE, NULL);
+        }
+
+      thread_consume = g_thread_create(_threaded_consume, q, TRUE, NULL);
+
+      for (j = 0; j < FEEDERS; j++)
+        {
+          g_thread_join(thread_feed[j]);
+          g_thread_join(other_threads[j]);
+        }
+      cr_assert_null(g_thread_join(thread_consume));
+
+      log_queue_unref(q);
+    }
+}
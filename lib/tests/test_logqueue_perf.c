@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/stopwatch.h"
+
+#include "logqueue.h"
+#include "logqueue-fifo.h"
+#include "logqueue-ring.h"
+#include "apphook.h"
+#include "mainloop-worker.h"
+
+#include <iv.h>
+
+/* kept small, as this runs as part of make check */
+#define MAX_FEEDERS 8
+#define MESSAGES_PER_FEEDER 10000
+#define FEED_BATCH_SIZE 100
+
+typedef LogQueue *(*LogQueueConstructor)(gint log_fifo_size, const gchar *persist_name);
+
+typedef struct _FeedContext
+{
+  LogQueue *queue;
+  LogMessage *template;
+} FeedContext;
+
+static gpointer
+_feed_thread(gpointer user_data)
+{
+  FeedContext *ctx = (FeedContext *) user_data;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint i;
+
+  iv_init();
+  main_loop_worker_thread_start(NULL);
+
+  for (i = 0; i < MESSAGES_PER_FEEDER; i++)
+    {
+      LogMessage *msg = log_msg_clone_cow(ctx->template, &path_options);
+
+      log_queue_push_tail(ctx->queue, msg, &path_options);
+      if ((i % FEED_BATCH_SIZE) == 0)
+        main_loop_worker_invoke_batch_callbacks();
+    }
+  main_loop_worker_invoke_batch_callbacks();
+
+  main_loop_worker_thread_stop();
+  iv_deinit();
+  return NULL;
+}
+
+static void
+_consume_messages(LogQueue *q, gint num_messages)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint consumed = 0;
+
+  while (consumed < num_messages)
+    {
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      if (!msg)
+        {
+          g_thread_yield();
+          continue;
+        }
+
+      log_msg_ack(msg, &path_options, AT_PROCESSED);
+      log_msg_unref(msg);
+      consumed++;
+    }
+}
+
+static void
+_measure_contention(const gchar *name, LogQueueConstructor construct, gint num_feeders)
+{
+  GThread *feeders[MAX_FEEDERS];
+  FeedContext ctx;
+  gint num_messages = num_feeders * MESSAGES_PER_FEEDER;
+  gint i;
+
+  log_queue_set_max_threads(num_feeders);
+  ctx.queue = construct(num_messages, NULL);
+  ctx.template = log_msg_new_empty();
+
+  start_stopwatch();
+  for (i = 0; i < num_feeders; i++)
+    feeders[i] = g_thread_create(_feed_thread, &ctx, TRUE, NULL);
+
+  _consume_messages(ctx.queue, num_messages);
+
+  for (i = 0; i < num_feeders; i++)
+    g_thread_join(feeders[i]);
+  stop_stopwatch_and_display_result(num_messages, "      %-6s feeders: %2d", name, num_feeders);
+
+  cr_assert_eq(log_queue_get_length(ctx.queue), 0);
+
+  log_msg_unref(ctx.template);
+  log_queue_unref(ctx.queue);
+}
+
+Test(logqueue_perf, test_fifo_and_ring_contention)
+{
+  gint num_feeders;
+
+  for (num_feeders = 1; num_feeders <= MAX_FEEDERS; num_feeders *= 2)
+    {
+      _measure_contention("fifo", log_queue_fifo_new, num_feeders);
+      _measure_contention("ring", log_queue_ring_new, num_feeders);
+    }
+}
+
+TestSuite(logqueue_perf, .init = app_startup, .fini = app_shutdown);
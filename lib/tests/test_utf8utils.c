@@ -54,6 +54,20 @@ ParameterizedTestParameters(test_utf8utils, test_escaped_binary)
     {"\"text\"", "\\\"te\\xt\\\"", "\"x", -1},
     {"\xc3""\xa1 non zero terminated", "\\xc3", NULL, 1},
     {"\xc3""\xa1 non zero terminated", "á", NULL, 2},
+    /* longer than a vector, runs of safe characters are copied in one go */
+    {
+      "a line longer than 32 bytes, with a \"quote\" and a\ttab in the middle",
+      "a line longer than 32 bytes, with a \\\"quote\\\" and a\\ttab in the middle", "\"", -1
+    },
+    {
+      "0123456789abcdefghijklmnopqrstuvwxyz0123456789árvíztűrőtükörfúrógép\xad",
+      "0123456789abcdefghijklmnopqrstuvwxyz0123456789árvíztűrőtükörfúrógép\\xad", NULL, -1
+    },
+    {
+      "more unsafe characters than the vectorized scanner handles: a=b,c;d:e",
+      "more unsafe characters than the vectorized scanner handles\\: a\\=b\\,c\\;d\\:e", "=,;:", -1
+    },
+    {"0123456789abcdefghijklmnopqrstuvwxyz\0after NUL", "0123456789abcdefghijklmnopqrstuvwxyz\\x00aft", NULL, 40},
   };
 
   return cr_make_param_array(StringValueList, string_value_list,
@@ -88,6 +102,14 @@ ParameterizedTestParameters(test_utf8utils, test_escaped_text)
     {"Á\xadÉ", "Á\\\\xadÉ", NULL, -1},
     {"\"text\"", "\\\"text\\\"", "\"", -1},
     {"\"text\"", "\\\"te\\xt\\\"", "\"x", -1},
+    {
+      "a line longer than 32 bytes, with a \"quote\" and a\x01""control in the middle",
+      "a line longer than 32 bytes, with a \\\"quote\\\" and a\\u0001control in the middle", "\"", -1
+    },
+    {
+      "0123456789abcdefghijklmnopqrstuvwxyz0123456789árvíztűrőtükörfúrógép\xad",
+      "0123456789abcdefghijklmnopqrstuvwxyz0123456789árvíztűrőtükörfúrógép\\\\xad", NULL, -1
+    },
   };
 
   return cr_make_param_array(StringValueList, string_value_list,
@@ -90,10 +90,8 @@ convert_unix_time_to_wall_clock_time(const UnixTime *src, WallClockTime *dst)
   convert_unix_time_to_wall_clock_time_with_tz_override(src, dst, -1);
 }
 
-/* the timezone information overrides what is present in the timestamp, e.g.
- * it will _convert_ the timestamp to a destination timezone */
-void
-convert_unix_time_to_wall_clock_time_with_tz_override(const UnixTime *src, WallClockTime *dst, gint gmtoff_override)
+gint
+get_unix_time_gmtoff_with_tz_override(const UnixTime *src, gint gmtoff_override)
 {
   gint gmtoff = gmtoff_override;
 
@@ -101,6 +99,15 @@ convert_unix_time_to_wall_clock_time_with_tz_override(const UnixTime *src, WallC
     gmtoff = src->ut_gmtoff;
   if (gmtoff == -1)
     gmtoff = get_local_timezone_ofs(src->ut_sec);
+  return gmtoff;
+}
+
+/* the timezone information overrides what is present in the timestamp, e.g.
+ * it will _convert_ the timestamp to a destination timezone */
+void
+convert_unix_time_to_wall_clock_time_with_tz_override(const UnixTime *src, WallClockTime *dst, gint gmtoff_override)
+{
+  gint gmtoff = get_unix_time_gmtoff_with_tz_override(src, gmtoff_override);
 
   time_t t = src->ut_sec + gmtoff;
   cached_gmtime_wct(&t, dst);
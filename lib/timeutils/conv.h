@@ -47,6 +47,8 @@ void convert_and_normalize_wall_clock_time_to_unix_time(WallClockTime *src, Unix
 void convert_and_normalize_wall_clock_time_to_unix_time_with_tz_hint(WallClockTime *src, UnixTime *dst,
     long gmtoff_hint);
 
+gint get_unix_time_gmtoff_with_tz_override(const UnixTime *src, gint gmtoff_override);
+
 void convert_unix_time_to_wall_clock_time(const UnixTime *src, WallClockTime *dst);
 void convert_unix_time_to_wall_clock_time_with_tz_override(const UnixTime *src, WallClockTime *dst,
                                                            gint gmtoff_override);
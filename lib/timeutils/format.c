@@ -26,6 +26,36 @@
 #include "timeutils/names.h"
 #include "timeutils/conv.h"
 #include "str-format.h"
+#include "tls-support.h"
+
+#include <string.h>
+
+#define FORMATTED_TIMESTAMP_CACHE_WAYS 2
+#define FORMATTED_TIMESTAMP_MAX_LEN 48
+
+/* the second resolution part of a formatted timestamp: the fractions of
+ * the second are patched in between the prefix and the suffix */
+typedef struct _FormattedTimestamp
+{
+  gint64 sec;
+  gint gmtoff;
+  gboolean valid;
+  guint8 prefix_len;
+  guint8 suffix_len;
+  gchar text[FORMATTED_TIMESTAMP_MAX_LEN];
+} FormattedTimestamp;
+
+/* indexed by TS_FMT_BSD, TS_FMT_ISO and TS_FMT_FULL, UNIX timestamps are
+ * cheap enough to be formatted from scratch */
+TLS_BLOCK_START
+{
+  FormattedTimestamp formatted_timestamps[TS_FMT_UNIX][FORMATTED_TIMESTAMP_CACHE_WAYS];
+  gint formatted_timestamps_victim[TS_FMT_UNIX];
+}
+TLS_BLOCK_END;
+
+#define formatted_timestamps __tls_deref(formatted_timestamps)
+#define formatted_timestamps_victim __tls_deref(formatted_timestamps_victim)
 
 static void
 _append_frac_digits(glong usecs, GString *target, gint frac_digits)
@@ -55,45 +85,9 @@ append_format_zone_info(GString *target, glong gmtoff)
   format_uint32_padded(target, 2, '0', 10, ((gmtoff < 0 ? -gmtoff : gmtoff) % 3600) / 60);
 }
 
-void
-append_format_unix_time(const UnixTime *ut, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
-{
-  WallClockTime wct = WALL_CLOCK_TIME_INIT;
-
-  if (ts_format == TS_FMT_UNIX)
-    {
-      format_uint32_padded(target, 0, 0, 10, (int) ut->ut_sec);
-      _append_frac_digits(ut->ut_usec, target, frac_digits);
-    }
-  else
-    {
-      convert_unix_time_to_wall_clock_time_with_tz_override(ut, &wct, zone_offset);
-      append_format_wall_clock_time(&wct, target, ts_format, frac_digits);
-    }
-}
-
-void
-format_unix_time(const UnixTime *stamp, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
-{
-  g_string_truncate(target, 0);
-  append_format_unix_time(stamp, target, ts_format, zone_offset, frac_digits);
-}
-
-/**
- * unix_time_format:
- * @stamp: Timestamp to format
- * @target: Target storage for formatted timestamp
- * @ts_format: Specifies basic timestamp format (TS_FMT_BSD, TS_FMT_ISO)
- * @zone_offset: Specifies custom zone offset if @tz_convert == TZ_CNV_CUSTOM
- *
- * Emits the formatted version of @stamp into @target as specified by
- * @ts_format and @tz_convert.
- **/
-void
-append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts_format, gint frac_digits)
+static void
+_append_wall_clock_time_seconds(const WallClockTime *wct, GString *target, gint ts_format)
 {
-  UnixTime ut = UNIX_TIME_INIT;
-
   switch (ts_format)
     {
     case TS_FMT_BSD:
@@ -106,7 +100,6 @@ append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts
       format_uint32_padded(target, 2, '0', 10, wct->wct_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, wct->wct_sec);
-      _append_frac_digits(wct->wct_usec, target, frac_digits);
       break;
     case TS_FMT_ISO:
       format_uint32_padded(target, 0, 0, 10, wct->wct_year + 1900);
@@ -120,9 +113,6 @@ append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts
       format_uint32_padded(target, 2, '0', 10, wct->wct_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, wct->wct_sec);
-
-      _append_frac_digits(wct->wct_usec, target, frac_digits);
-      append_format_zone_info(target, wct->wct_gmtoff);
       break;
     case TS_FMT_FULL:
       format_uint32_padded(target, 0, 0, 10, wct->wct_year + 1900);
@@ -136,15 +126,142 @@ append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts
       format_uint32_padded(target, 2, '0', 10, wct->wct_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, wct->wct_sec);
-
-      _append_frac_digits(wct->wct_usec, target, frac_digits);
-      break;
-    case TS_FMT_UNIX:
-      convert_wall_clock_time_to_unix_time(wct, &ut);
-      append_format_unix_time(&ut, target, TS_FMT_UNIX, wct->wct_gmtoff, frac_digits);
       break;
     default:
       g_assert_not_reached();
       break;
     }
 }
+
+static void
+_append_wall_clock_time_suffix(const WallClockTime *wct, GString *target, gint ts_format)
+{
+  if (ts_format == TS_FMT_ISO)
+    append_format_zone_info(target, wct->wct_gmtoff);
+}
+
+static gboolean
+_format_timestamp_into_cache(FormattedTimestamp *entry, const UnixTime *ut, GString *target, gint ts_format,
+                             gint gmtoff)
+{
+  WallClockTime wct = WALL_CLOCK_TIME_INIT;
+  gsize start = target->len;
+  gsize prefix_len, len;
+
+  /* the target is used as a scratch area, so we don't need to allocate */
+  convert_unix_time_to_wall_clock_time_with_tz_override(ut, &wct, gmtoff);
+  _append_wall_clock_time_seconds(&wct, target, ts_format);
+  prefix_len = target->len - start;
+  _append_wall_clock_time_suffix(&wct, target, ts_format);
+  len = target->len - start;
+
+  if (len > sizeof(entry->text))
+    {
+      g_string_truncate(target, start);
+      return FALSE;
+    }
+
+  memcpy(entry->text, target->str + start, len);
+  g_string_truncate(target, start);
+  entry->prefix_len = prefix_len;
+  entry->suffix_len = len - prefix_len;
+  entry->sec = ut->ut_sec;
+  entry->gmtoff = gmtoff;
+  entry->valid = TRUE;
+  return TRUE;
+}
+
+static FormattedTimestamp *
+_lookup_formatted_timestamp(const UnixTime *ut, GString *target, gint ts_format, gint gmtoff)
+{
+  FormattedTimestamp *entries = formatted_timestamps[ts_format];
+  gint victim;
+
+  for (gint i = 0; i < FORMATTED_TIMESTAMP_CACHE_WAYS; i++)
+    {
+      if (entries[i].valid && entries[i].sec == ut->ut_sec && entries[i].gmtoff == gmtoff)
+        {
+          formatted_timestamps_victim[ts_format] = (i + 1) % FORMATTED_TIMESTAMP_CACHE_WAYS;
+          return &entries[i];
+        }
+    }
+
+  victim = formatted_timestamps_victim[ts_format];
+  if (!_format_timestamp_into_cache(&entries[victim], ut, target, ts_format, gmtoff))
+    return NULL;
+
+  formatted_timestamps_victim[ts_format] = (victim + 1) % FORMATTED_TIMESTAMP_CACHE_WAYS;
+  return &entries[victim];
+}
+
+/* timestamps in the same second (and zone) share everything but the
+ * fractions of the second, so that part is formatted once per thread and
+ * reused by all templates and destinations */
+static void
+_append_format_unix_time_cached(const UnixTime *ut, GString *target, gint ts_format, glong zone_offset,
+                                gint frac_digits)
+{
+  gint gmtoff = get_unix_time_gmtoff_with_tz_override(ut, zone_offset);
+  FormattedTimestamp *entry = _lookup_formatted_timestamp(ut, target, ts_format, gmtoff);
+
+  if (!entry)
+    {
+      WallClockTime wct = WALL_CLOCK_TIME_INIT;
+
+      convert_unix_time_to_wall_clock_time_with_tz_override(ut, &wct, gmtoff);
+      append_format_wall_clock_time(&wct, target, ts_format, frac_digits);
+      return;
+    }
+
+  g_string_append_len(target, entry->text, entry->prefix_len);
+  _append_frac_digits(ut->ut_usec, target, frac_digits);
+  g_string_append_len(target, entry->text + entry->prefix_len, entry->suffix_len);
+}
+
+void
+append_format_unix_time(const UnixTime *ut, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+{
+  if (ts_format == TS_FMT_UNIX)
+    {
+      format_uint32_padded(target, 0, 0, 10, (int) ut->ut_sec);
+      _append_frac_digits(ut->ut_usec, target, frac_digits);
+    }
+  else
+    {
+      _append_format_unix_time_cached(ut, target, ts_format, zone_offset, frac_digits);
+    }
+}
+
+void
+format_unix_time(const UnixTime *stamp, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+{
+  g_string_truncate(target, 0);
+  append_format_unix_time(stamp, target, ts_format, zone_offset, frac_digits);
+}
+
+/**
+ * unix_time_format:
+ * @stamp: Timestamp to format
+ * @target: Target storage for formatted timestamp
+ * @ts_format: Specifies basic timestamp format (TS_FMT_BSD, TS_FMT_ISO)
+ * @zone_offset: Specifies custom zone offset if @tz_convert == TZ_CNV_CUSTOM
+ *
+ * Emits the formatted version of @stamp into @target as specified by
+ * @ts_format and @tz_convert.
+ **/
+void
+append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts_format, gint frac_digits)
+{
+  UnixTime ut = UNIX_TIME_INIT;
+
+  if (ts_format == TS_FMT_UNIX)
+    {
+      convert_wall_clock_time_to_unix_time(wct, &ut);
+      append_format_unix_time(&ut, target, TS_FMT_UNIX, wct->wct_gmtoff, frac_digits);
+      return;
+    }
+
+  _append_wall_clock_time_seconds(wct, target, ts_format);
+  _append_frac_digits(wct->wct_usec, target, frac_digits);
+  _append_wall_clock_time_suffix(wct, target, ts_format);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "timeutils/unixtime.h"
+#include "timeutils/format.h"
+#include <criterion/criterion.h>
+
+#include <string.h>
+
+static void
+_assert_formatted_unix_time(const UnixTime *ut, gint ts_format, glong zone_offset, gint frac_digits,
+                            const gchar *expected)
+{
+  GString *result = g_string_new("prefix ");
+
+  append_format_unix_time(ut, result, ts_format, zone_offset, frac_digits);
+  cr_assert_str_eq(result->str + strlen("prefix "), expected);
+  g_string_free(result, TRUE);
+}
+
+Test(format, timestamps_in_the_same_second_differ_in_their_fractions_only)
+{
+  UnixTime ut = { .ut_sec = 1547920728, .ut_usec = 123456, .ut_gmtoff = 3600 };
+
+  _assert_formatted_unix_time(&ut, TS_FMT_ISO, -1, 3, "2019-01-19T18:58:48.123+01:00");
+  ut.ut_usec = 654321;
+  _assert_formatted_unix_time(&ut, TS_FMT_ISO, -1, 3, "2019-01-19T18:58:48.654+01:00");
+  _assert_formatted_unix_time(&ut, TS_FMT_ISO, -1, 6, "2019-01-19T18:58:48.654321+01:00");
+  _assert_formatted_unix_time(&ut, TS_FMT_ISO, -1, 0, "2019-01-19T18:58:48+01:00");
+  _assert_formatted_unix_time(&ut, TS_FMT_BSD, -1, 3, "Jan 19 18:58:48.654");
+  _assert_formatted_unix_time(&ut, TS_FMT_FULL, -1, 0, "2019 Jan 19 18:58:48");
+  _assert_formatted_unix_time(&ut, TS_FMT_UNIX, -1, 3, "1547920728.654");
+}
+
+Test(format, cached_timestamps_are_keyed_by_second_and_zone_offset)
+{
+  UnixTime ut = { .ut_sec = 1547920728, .ut_usec = 0, .ut_gmtoff = 3600 };
+
+  _assert_formatted_unix_time(&ut, TS_FMT_ISO, -1, 0, "2019-01-19T18:58:48+01:00");
+  _assert_formatted_unix_time(&ut, TS_FMT_ISO, 0, 0, "2019-01-19T17:58:48+00:00");
+  _assert_formatted_unix_time(&ut, TS_FMT_ISO, -7200, 0, "2019-01-19T15:58:48-02:00");
+  _assert_formatted_unix_time(&ut, TS_FMT_ISO, -1, 0, "2019-01-19T18:58:48+01:00");
+
+  ut.ut_sec++;
+  _assert_formatted_unix_time(&ut, TS_FMT_ISO, -1, 0, "2019-01-19T18:58:49+01:00");
+  _assert_formatted_unix_time(&ut, TS_FMT_ISO, 0, 0, "2019-01-19T17:58:49+00:00");
+}
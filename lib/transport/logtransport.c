@@ -38,11 +38,35 @@ log_transport_free_method(LogTransport *s)
     }
 }
 
+/* fallback for transports that have no native vectored write: the chunks
+ * are written one-by-one until the first short write */
+gssize
+log_transport_writev_method(LogTransport *self, struct iovec *iov, gint iov_count)
+{
+  gssize sum = 0;
+
+  for (gint i = 0; i < iov_count; i++)
+    {
+      gssize rc = log_transport_write(self, iov[i].iov_base, iov[i].iov_len);
+
+      if (rc < 0)
+        return sum > 0 ? sum : rc;
+
+      sum += rc;
+      if ((gsize) rc != iov[i].iov_len)
+        break;
+    }
+  return sum;
+}
+
 void
 log_transport_init_instance(LogTransport *self, gint fd)
 {
   self->fd = fd;
   self->cond = 0;
+  self->writev = log_transport_writev_method;
+  self->has_pending_input = NULL;
+  self->read_mapped = NULL;
   self->free_fn = log_transport_free_method;
 }
 
@@ -28,6 +28,8 @@
 #include "syslog-ng.h"
 #include "transport/transport-aux-data.h"
 
+#include <sys/uio.h>
+
 typedef struct _LogTransport LogTransport;
 
 struct _LogTransport
@@ -38,6 +40,13 @@ struct _LogTransport
   gssize (*read)(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux);
   gssize (*write)(LogTransport *self, const gpointer buf, gsize count);
   gssize (*writev)(LogTransport *self, struct iovec *iov, gint iov_count);
+  /* optional: TRUE if the transport has already received input that was
+   * not yet returned by read(), e.g. batched datagrams */
+  gboolean (*has_pending_input)(LogTransport *self);
+  /* optional: reads the input at the given stream offset by copying it
+   * out of a memory mapping, returns the number of bytes stored in buf
+   * (at most count), 0 if no new input is available */
+  gssize (*read_mapped)(LogTransport *self, gint64 offset, gpointer buf, gsize count);
   void (*free_fn)(LogTransport *self);
 };
 
@@ -59,6 +68,27 @@ log_transport_read(LogTransport *self, gpointer buf, gsize count, LogTransportAu
   return self->read(self, buf, count, aux);
 }
 
+static inline gboolean
+log_transport_has_pending_input(LogTransport *self)
+{
+  if (!self->has_pending_input)
+    return FALSE;
+  return self->has_pending_input(self);
+}
+
+static inline gboolean
+log_transport_can_read_mapped(LogTransport *self)
+{
+  return self->read_mapped != NULL;
+}
+
+static inline gssize
+log_transport_read_mapped(LogTransport *self, gint64 offset, gpointer buf, gsize count)
+{
+  return self->read_mapped(self, offset, buf, count);
+}
+
+gssize log_transport_writev_method(LogTransport *s, struct iovec *iov, gint iov_count);
 void log_transport_init_instance(LogTransport *s, gint fd);
 void log_transport_free_method(LogTransport *s);
 void log_transport_free(LogTransport *s);
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "transport/transport-udp-socket.h"
+#include "fdhelpers.h"
+#include "apphook.h"
+
+#include <criterion/criterion.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+static gint
+_create_bound_udp_socket(void)
+{
+  struct sockaddr_in sin = { 0 };
+  gint fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  cr_assert_geq(fd, 0);
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  cr_assert_eq(bind(fd, (struct sockaddr *) &sin, sizeof(sin)), 0);
+  g_fd_set_nonblock(fd, TRUE);
+  return fd;
+}
+
+static void
+_send_datagram(gint sender_fd, gint receiver_fd, const gchar *payload)
+{
+  struct sockaddr_storage ss;
+  socklen_t sslen = sizeof(ss);
+
+  cr_assert_eq(getsockname(receiver_fd, (struct sockaddr *) &ss, &sslen), 0);
+  cr_assert_eq(sendto(sender_fd, payload, strlen(payload), 0, (struct sockaddr *) &ss, sslen), strlen(payload));
+}
+
+static guint16
+_get_port(gint fd)
+{
+  struct sockaddr_in sin;
+  socklen_t sinlen = sizeof(sin);
+
+  cr_assert_eq(getsockname(fd, (struct sockaddr *) &sin, &sinlen), 0);
+  return ntohs(sin.sin_port);
+}
+
+static void
+_assert_next_datagram(LogTransport *transport, const gchar *expected_payload, gint expected_sender_fd)
+{
+  LogTransportAuxData aux;
+  gchar buf[256];
+  gssize rc;
+
+  log_transport_aux_data_init(&aux);
+  rc = log_transport_read(transport, buf, sizeof(buf), &aux);
+  cr_assert_eq(rc, strlen(expected_payload));
+  cr_assert(memcmp(buf, expected_payload, rc) == 0);
+
+  cr_assert_not_null(aux.peer_addr);
+  cr_assert_eq(g_sockaddr_get_port(aux.peer_addr), _get_port(expected_sender_fd));
+  cr_assert_not_null(aux.local_addr);
+  cr_assert_eq(aux.proto, IPPROTO_UDP);
+  log_transport_aux_data_destroy(&aux);
+}
+
+Test(udp_socket, datagrams_are_returned_one_by_one_with_their_own_aux_data)
+{
+  gint receiver_fd = _create_bound_udp_socket();
+  gint sender1_fd = _create_bound_udp_socket();
+  gint sender2_fd = _create_bound_udp_socket();
+  LogTransport *transport = log_transport_udp_socket_new(receiver_fd);
+  LogTransportAuxData aux;
+  gchar buf[256];
+
+  _send_datagram(sender1_fd, receiver_fd, "first");
+  _send_datagram(sender2_fd, receiver_fd, "second");
+  _send_datagram(sender1_fd, receiver_fd, "third");
+
+  _assert_next_datagram(transport, "first", sender1_fd);
+  _assert_next_datagram(transport, "second", sender2_fd);
+  _assert_next_datagram(transport, "third", sender1_fd);
+  cr_assert_not(log_transport_has_pending_input(transport));
+
+  log_transport_aux_data_init(&aux);
+  cr_assert_eq(log_transport_read(transport, buf, sizeof(buf), &aux), -1);
+  cr_assert_eq(errno, EAGAIN);
+  log_transport_aux_data_destroy(&aux);
+
+  log_transport_free(transport);
+  close(sender1_fd);
+  close(sender2_fd);
+}
+
+#if SYSLOG_NG_HAVE_RECVMMSG
+
+Test(udp_socket, batched_datagrams_are_reported_as_pending_input)
+{
+  gint receiver_fd = _create_bound_udp_socket();
+  gint sender_fd = _create_bound_udp_socket();
+  LogTransport *transport = log_transport_udp_socket_new(receiver_fd);
+
+  _send_datagram(sender_fd, receiver_fd, "first");
+  _send_datagram(sender_fd, receiver_fd, "second");
+
+  cr_assert_not(log_transport_has_pending_input(transport));
+  _assert_next_datagram(transport, "first", sender_fd);
+  cr_assert(log_transport_has_pending_input(transport));
+  _assert_next_datagram(transport, "second", sender_fd);
+  cr_assert_not(log_transport_has_pending_input(transport));
+
+  log_transport_free(transport);
+  close(sender_fd);
+}
+
+#endif
+
+TestSuite(udp_socket, .init = app_startup, .fini = app_shutdown);
@@ -22,10 +22,34 @@
  */
 
 #include "transport-file.h"
+#include "tls-support.h"
 
 #include <errno.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* the file is mapped in windows of this size, so a sequential reader
+ * needs a new mmap() call only rarely */
+#define FILE_MAPPING_WINDOW_SIZE (16 * 1024 * 1024)
+
+/* set while the current thread copies out of a mapping: accessing pages
+ * beyond the end of a file that was truncated after it was mapped raises
+ * SIGBUS, which is turned into a failed copy instead of a crash.  It is
+ * volatile, as the stores around memcpy() would be dead otherwise. */
+TLS_BLOCK_START
+{
+  sigjmp_buf *volatile mapping_fault_jump;
+}
+TLS_BLOCK_END;
+
+#define mapping_fault_jump __tls_deref(mapping_fault_jump)
+
+static struct sigaction previous_sigbus_action;
 
 gssize
 log_transport_file_read_method(LogTransport *self, gpointer buf, gsize buflen, LogTransportAuxData *aux)
@@ -80,6 +104,156 @@ log_transport_file_writev_method(LogTransport *self, struct iovec *iov, gint iov
   return rc;
 }
 
+static void
+_unmap_file(LogTransportFile *self)
+{
+  if (!self->mapping)
+    return;
+
+  munmap(self->mapping, self->mapping_len);
+  self->mapping = NULL;
+  self->mapping_offset = 0;
+  self->mapping_len = 0;
+}
+
+static inline gboolean
+_mapping_covers(LogTransportFile *self, gint64 offset, gsize count)
+{
+  return self->mapping &&
+         offset >= self->mapping_offset &&
+         offset + count <= self->mapping_offset + self->mapping_len;
+}
+
+static void
+_handle_mapping_fault(gint signum)
+{
+  if (mapping_fault_jump)
+    siglongjmp(*mapping_fault_jump, 1);
+
+  /* not a fault of ours: deliver it the way it would have been without
+   * our handler once we return */
+  sigaction(SIGBUS, &previous_sigbus_action, NULL);
+  raise(signum);
+}
+
+static void
+_install_mapping_fault_handler(void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter(&initialized))
+    {
+      struct sigaction sa;
+
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_handler = _handle_mapping_fault;
+      sigemptyset(&sa.sa_mask);
+      sigaction(SIGBUS, &sa, &previous_sigbus_action);
+      g_once_init_leave(&initialized, 1);
+    }
+}
+
+static gboolean
+_remap_file(LogTransportFile *self, gint64 offset, gsize count)
+{
+  gint64 page_size = sysconf(_SC_PAGESIZE);
+  gint64 mapping_offset = offset - offset % page_size;
+  gsize mapping_len = MAX(FILE_MAPPING_WINDOW_SIZE, offset - mapping_offset + count);
+  guchar *mapping;
+
+  mapping_len = (mapping_len + page_size - 1) / page_size * page_size;
+
+  /* the window may extend beyond the end of the file: those pages are
+   * only touched once the file has grown, as the caller is limited to
+   * the current file size */
+  mapping = mmap(NULL, mapping_len, PROT_READ, MAP_SHARED, self->super.fd, mapping_offset);
+  if (mapping == MAP_FAILED)
+    return FALSE;
+
+  _install_mapping_fault_handler();
+
+#ifdef MADV_SEQUENTIAL
+  madvise(mapping, mapping_len, MADV_SEQUENTIAL);
+#endif
+
+  _unmap_file(self);
+  self->mapping = mapping;
+  self->mapping_offset = mapping_offset;
+  self->mapping_len = mapping_len;
+  return TRUE;
+}
+
+static gboolean
+_copy_from_mapping(gpointer buf, const guchar *data, gsize count)
+{
+  sigjmp_buf fault_jump;
+
+  if (sigsetjmp(fault_jump, 1))
+    {
+      mapping_fault_jump = NULL;
+      return FALSE;
+    }
+
+  mapping_fault_jump = &fault_jump;
+  memcpy(buf, data, count);
+  mapping_fault_jump = NULL;
+  return TRUE;
+}
+
+/* reads the bytes of the file at [offset, offset + count), clipped to the
+ * current size of the file, by copying them out of a mapping of the file.
+ * The data is never referenced in place, so the file being truncated under
+ * the mapping cannot crash the reader: the copy fails with EFAULT instead.
+ * The file position is moved past the returned data, so that it looks the
+ * same as if the data had been read(). */
+gssize
+log_transport_file_read_mapped_method(LogTransport *s, gint64 offset, gpointer buf, gsize count)
+{
+  LogTransportFile *self = (LogTransportFile *) s;
+  struct stat st;
+  gsize avail = 0;
+
+  if (fstat(self->super.fd, &st) < 0)
+    return -1;
+
+  if (!S_ISREG(st.st_mode))
+    {
+      errno = ENODEV;
+      return -1;
+    }
+
+  if (offset < st.st_size)
+    avail = MIN(count, st.st_size - offset);
+
+  if (avail > 0)
+    {
+      if (!_mapping_covers(self, offset, count) && !_remap_file(self, offset, count))
+        return -1;
+
+      if (!_copy_from_mapping(buf, self->mapping + (offset - self->mapping_offset), avail))
+        {
+          /* truncated since fstat(), the mapping is of no use any more */
+          _unmap_file(self);
+          errno = EFAULT;
+          return -1;
+        }
+    }
+
+  if (lseek(self->super.fd, offset + avail, SEEK_SET) < 0)
+    return -1;
+
+  return avail;
+}
+
+void
+log_transport_file_free_method(LogTransport *s)
+{
+  LogTransportFile *self = (LogTransportFile *) s;
+
+  _unmap_file(self);
+  log_transport_free_method(s);
+}
+
 void
 log_transport_file_init_instance(LogTransportFile *self, gint fd)
 {
@@ -87,7 +261,7 @@ log_transport_file_init_instance(LogTransportFile *self, gint fd)
   self->super.read = log_transport_file_read_method;
   self->super.write = log_transport_file_write_method;
   self->super.writev = log_transport_file_writev_method;
-  self->super.free_fn = log_transport_free_method;
+  self->super.free_fn = log_transport_file_free_method;
 }
 
 LogTransport *
@@ -32,12 +32,19 @@ typedef struct _LogTransportFile LogTransportFile;
 struct _LogTransportFile
 {
   LogTransport super;
+
+  /* read-only window of the file used by log_transport_file_read_mapped_method() */
+  guchar *mapping;
+  gint64 mapping_offset;
+  gsize mapping_len;
 };
 
 gssize log_transport_file_read_method(LogTransport *self, gpointer buf, gsize buflen, LogTransportAuxData *aux);
 gssize log_transport_file_read_and_ignore_eof_method(LogTransport *self, gpointer buf, gsize buflen,
                                                      LogTransportAuxData *aux);
 gssize log_transport_file_write_method(LogTransport *self, const gpointer buf, gsize buflen);
+gssize log_transport_file_read_mapped_method(LogTransport *self, gint64 offset, gpointer buf, gsize count);
+void log_transport_file_free_method(LogTransport *self);
 
 void log_transport_file_init_instance(LogTransportFile *self, gint fd);
 LogTransport *log_transport_file_new(gint fd);
@@ -25,6 +25,8 @@
 
 #include <errno.h>
 #include <unistd.h>
+#include <string.h>
+#include <sys/uio.h>
 
 static gint
 _determine_address_family(gint fd)
@@ -151,12 +153,57 @@ log_transport_dgram_socket_write_method(LogTransport *s, const gpointer buf, gsi
   return rc;
 }
 
+#if SYSLOG_NG_HAVE_SENDMMSG
+
+#define DGRAM_SENDMMSG_MAX_BATCH 64
+
+/* every iovec item is sent as a separate datagram, the return value is the
+ * number of bytes in the datagrams that were sent, so the caller can treat
+ * it the same way as the return value of writev() */
+static gssize
+log_transport_dgram_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  struct mmsghdr msgs[DGRAM_SENDMMSG_MAX_BATCH];
+  gssize sum = 0;
+  gint rc, i;
+
+  iov_count = MIN(iov_count, DGRAM_SENDMMSG_MAX_BATCH);
+  memset(msgs, 0, sizeof(msgs[0]) * iov_count);
+  for (i = 0; i < iov_count; i++)
+    {
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+  do
+    {
+      rc = sendmmsg(self->super.fd, msgs, iov_count, 0);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  /* see the note on ENOBUFS in log_transport_dgram_socket_write_method() */
+  if (rc < 0 && errno == ENOBUFS)
+    return iov[0].iov_len;
+  if (rc < 0)
+    return rc;
+
+  for (i = 0; i < rc; i++)
+    sum += iov[i].iov_len;
+  return sum;
+}
+
+#endif
+
 void
 log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_socket_init_instance(self, fd);
   self->super.read = log_transport_dgram_socket_read_method;
   self->super.write = log_transport_dgram_socket_write_method;
+#if SYSLOG_NG_HAVE_SENDMMSG
+  self->super.writev = log_transport_dgram_socket_writev_method;
+#endif
 }
 
 LogTransport *
@@ -198,6 +245,20 @@ log_transport_stream_socket_write_method(LogTransport *s, const gpointer buf, gs
   return rc;
 }
 
+static gssize
+log_transport_stream_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  gint rc;
+
+  do
+    {
+      rc = writev(self->super.fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
 void
 log_transport_stream_socket_free_method(LogTransport *s)
 {
@@ -212,6 +273,7 @@ log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd)
   log_transport_socket_init_instance(self, fd);
   self->super.read = log_transport_stream_socket_read_method;
   self->super.write = log_transport_stream_socket_write_method;
+  self->super.writev = log_transport_stream_socket_writev_method;
   self->super.free_fn = log_transport_stream_socket_free_method;
 }
 
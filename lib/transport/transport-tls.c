@@ -239,6 +239,8 @@ log_transport_tls_new(TLSSession *tls_session, gint fd)
   self->super.super.cond = 0;
   self->super.super.read = log_transport_tls_read_method;
   self->super.super.write = log_transport_tls_write_method;
+  /* writev() on the socket would bypass TLS */
+  self->super.super.writev = log_transport_writev_method;
   self->super.super.free_fn = log_transport_tls_free_method;
   self->tls_session = tls_session;
 
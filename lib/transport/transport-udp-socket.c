@@ -30,12 +30,42 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <errno.h>
+#include <string.h>
+
+#if SYSLOG_NG_HAVE_RECVMMSG
+
+/* number of datagrams fetched by a single recvmmsg() call, the total size
+ * of the receive buffers is capped by UDP_RECV_BATCH_BUFFER_MAX */
+#define UDP_RECV_BATCH_SIZE 32
+#define UDP_RECV_BATCH_BUFFER_MAX (1024 * 1024)
+
+typedef struct _LogTransportUDPBatch
+{
+  struct mmsghdr msgs[UDP_RECV_BATCH_SIZE];
+  struct iovec iov[UDP_RECV_BATCH_SIZE];
+  struct sockaddr_storage peer_addrs[UDP_RECV_BATCH_SIZE];
+#if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
+  gchar ctlbufs[UDP_RECV_BATCH_SIZE][64];
+#endif
+  guchar *buffers;
+  gsize buffer_size;
+  gint size;
+
+  /* datagrams in the range of [pos, count) were received but not yet
+   * returned by read() */
+  gint pos, count;
+} LogTransportUDPBatch;
+
+#endif
 
 typedef struct _LogTransportUDP LogTransportUDP;
 struct _LogTransportUDP
 {
   LogTransportSocket super;
   GSockAddr *bind_addr;
+#if SYSLOG_NG_HAVE_RECVMMSG
+  LogTransportUDPBatch batch;
+#endif
 };
 
 #if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
@@ -136,6 +166,125 @@ _feed_aux_from_cmsg(LogTransportUDP *self, LogTransportAuxData *aux, struct msgh
 #endif
 
 
+static void
+_feed_aux_from_msghdr(LogTransportUDP *self, LogTransportAuxData *aux, struct msghdr *msg)
+{
+  if (!aux)
+    return;
+
+  if (msg->msg_namelen)
+    log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) msg->msg_name, msg->msg_namelen));
+  aux->proto = self->super.proto;
+  _feed_aux_from_cmsg(self, aux, msg);
+}
+
+#if SYSLOG_NG_HAVE_RECVMMSG
+
+static void
+_allocate_batch_buffers(LogTransportUDPBatch *batch, gsize buflen)
+{
+  g_free(batch->buffers);
+
+  batch->size = CLAMP(UDP_RECV_BATCH_BUFFER_MAX / buflen, 1, UDP_RECV_BATCH_SIZE);
+  batch->buffers = g_malloc(batch->size * buflen);
+  batch->buffer_size = buflen;
+}
+
+static void
+_prepare_batch_msghdr(LogTransportUDPBatch *batch, gint i)
+{
+  struct msghdr *msg = &batch->msgs[i].msg_hdr;
+
+  batch->iov[i].iov_base = batch->buffers + i * batch->buffer_size;
+  batch->iov[i].iov_len = batch->buffer_size;
+
+  memset(msg, 0, sizeof(*msg));
+  msg->msg_name = (struct sockaddr *) &batch->peer_addrs[i];
+  msg->msg_namelen = sizeof(batch->peer_addrs[i]);
+  msg->msg_iov = &batch->iov[i];
+  msg->msg_iovlen = 1;
+#if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
+  msg->msg_control = batch->ctlbufs[i];
+  msg->msg_controllen = sizeof(batch->ctlbufs[i]);
+#endif
+  batch->msgs[i].msg_len = 0;
+}
+
+/* fetch as many datagrams as are available (up to the batch size) with a
+ * single syscall */
+static gint
+_receive_batch(LogTransportUDP *self, gsize buflen)
+{
+  LogTransportUDPBatch *batch = &self->batch;
+  gint rc;
+
+  if (!batch->buffers || batch->buffer_size != buflen)
+    _allocate_batch_buffers(batch, buflen);
+
+  for (gint i = 0; i < batch->size; i++)
+    _prepare_batch_msghdr(batch, i);
+
+  batch->pos = batch->count = 0;
+  do
+    {
+      rc = recvmmsg(self->super.super.fd, batch->msgs, batch->size, 0, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  if (rc > 0)
+    batch->count = rc;
+  return rc;
+}
+
+static gssize
+_return_datagram_from_batch(LogTransportUDP *self, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportUDPBatch *batch = &self->batch;
+
+  while (batch->pos < batch->count)
+    {
+      struct mmsghdr *mmsg = &batch->msgs[batch->pos++];
+      gsize len = MIN(mmsg->msg_len, buflen);
+
+      /* DGRAM sockets should never return EOF, empty datagrams are skipped */
+      if (len == 0)
+        continue;
+
+      memcpy(buf, mmsg->msg_hdr.msg_iov[0].iov_base, len);
+      _feed_aux_from_msghdr(self, aux, &mmsg->msg_hdr);
+      return len;
+    }
+
+  errno = EAGAIN;
+  return -1;
+}
+
+static gssize
+log_transport_udp_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportUDP *self = (LogTransportUDP *) s;
+
+  if (self->batch.pos >= self->batch.count)
+    {
+      gint rc = _receive_batch(self, buflen);
+
+      if (rc < 0)
+        return rc;
+    }
+
+  return _return_datagram_from_batch(self, buf, buflen, aux);
+}
+
+static gboolean
+log_transport_udp_socket_has_pending_input(LogTransport *s)
+{
+  LogTransportUDP *self = (LogTransportUDP *) s;
+
+  return self->batch.pos < self->batch.count;
+}
+
+#else
+
 static gssize
 log_transport_udp_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
@@ -171,16 +320,14 @@ log_transport_udp_socket_read_method(LogTransport *s, gpointer buf, gsize buflen
     }
   else if (rc > 0)
     {
-      if (msg.msg_namelen && aux)
-        log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) &ss, msg.msg_namelen));
-      if (aux)
-        aux->proto = self->super.proto;
-      _feed_aux_from_cmsg(self, aux, &msg);
+      _feed_aux_from_msghdr(self, aux, &msg);
     }
   return rc;
 
 }
 
+#endif
+
 static void
 log_transport_udp_setup_fd(LogTransportUDP *self, gint fd)
 {
@@ -210,6 +357,9 @@ log_transport_udp_socket_free(LogTransport *s)
 {
   LogTransportUDP *self = (LogTransportUDP *)s;
   g_sockaddr_unref(self->bind_addr);
+#if SYSLOG_NG_HAVE_RECVMMSG
+  g_free(self->batch.buffers);
+#endif
   log_transport_free_method(s);
 }
 
@@ -220,6 +370,9 @@ log_transport_udp_socket_new(gint fd)
 
   log_transport_dgram_socket_init_instance(&self->super, fd);
   self->super.super.read = log_transport_udp_socket_read_method;
+#if SYSLOG_NG_HAVE_RECVMMSG
+  self->super.super.has_pending_input = log_transport_udp_socket_has_pending_input;
+#endif
   self->super.super.free_fn = log_transport_udp_socket_free;
 
   log_transport_udp_setup_fd(self, fd);
@@ -24,6 +24,19 @@
 #include "utf8utils.h"
 #include "str-utils.h"
 
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define UTF8UTILS_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define UTF8UTILS_HAVE_X86_SIMD 0
+#endif
+
+/* the SIMD scanners compare against this many characters: the backslash
+ * and up to three unsafe characters, longer lists use the scalar scanner */
+#define SAFE_RUN_MAX_UNSAFE_CHARS 4
+
 static inline gboolean
 _is_character_unsafe(gunichar uchar, const gchar *unsafe_chars)
 {
@@ -41,6 +54,146 @@ _is_character_unsafe(gunichar uchar, const gchar *unsafe_chars)
   return _strchr_optimized_for_single_char_haystack(unsafe_chars, (gchar) uchar) != NULL;
 }
 
+/*
+ * Most of the input is printable ASCII that is copied as is, so instead of
+ * decoding it character by character, we look for the first byte that may
+ * need escaping and copy everything before it in one go.  A byte may need
+ * escaping if it is a control character, the backslash, one of the unsafe
+ * characters or if it is not ASCII, in which case the utf8 sequence it
+ * starts needs to be validated.
+ */
+typedef struct _SafeRunScanner
+{
+  const gchar *unsafe_chars;
+  /* the unsafe characters padded with backslashes, valid if simd is set */
+  guchar unsafe[SAFE_RUN_MAX_UNSAFE_CHARS];
+  gboolean simd;
+} SafeRunScanner;
+
+static inline gboolean
+_is_byte_safe(guchar c, const gchar *unsafe_chars)
+{
+  if (c < 0x20 || c >= 0x80 || c == '\\')
+    return FALSE;
+  return !unsafe_chars || !strchr(unsafe_chars, c);
+}
+
+static gsize
+_find_safe_run_scalar(const guchar *s, gsize n, const gchar *unsafe_chars)
+{
+  gsize i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (!_is_byte_safe(s[i], unsafe_chars))
+        break;
+    }
+  return i;
+}
+
+#if UTF8UTILS_HAVE_X86_SIMD
+
+/* signed comparison against 0x20 catches the control characters and the
+ * bytes with the high bit set at the same time */
+static gsize
+_find_safe_run_sse2(const guchar *s, gsize n, const SafeRunScanner *scanner)
+{
+  const __m128i space = _mm_set1_epi8(0x20);
+  const __m128i u0 = _mm_set1_epi8(scanner->unsafe[0]);
+  const __m128i u1 = _mm_set1_epi8(scanner->unsafe[1]);
+  const __m128i u2 = _mm_set1_epi8(scanner->unsafe[2]);
+  const __m128i u3 = _mm_set1_epi8(scanner->unsafe[3]);
+  gsize i;
+
+  for (i = 0; i + sizeof(__m128i) <= n; i += sizeof(__m128i))
+    {
+      __m128i chunk = _mm_loadu_si128((const __m128i *) (s + i));
+      __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi8(chunk, space),
+                                                _mm_or_si128(_mm_cmpeq_epi8(chunk, u0),
+                                                             _mm_cmpeq_epi8(chunk, u1))),
+                                   _mm_or_si128(_mm_cmpeq_epi8(chunk, u2),
+                                                _mm_cmpeq_epi8(chunk, u3)));
+      guint32 mask = _mm_movemask_epi8(match);
+
+      if (mask)
+        return i + __builtin_ctz(mask);
+    }
+  return i + _find_safe_run_scalar(s + i, n - i, scanner->unsafe_chars);
+}
+
+__attribute__((target("avx2")))
+static gsize
+_find_safe_run_avx2(const guchar *s, gsize n, const SafeRunScanner *scanner)
+{
+  const __m256i space = _mm256_set1_epi8(0x20);
+  const __m256i u0 = _mm256_set1_epi8(scanner->unsafe[0]);
+  const __m256i u1 = _mm256_set1_epi8(scanner->unsafe[1]);
+  const __m256i u2 = _mm256_set1_epi8(scanner->unsafe[2]);
+  const __m256i u3 = _mm256_set1_epi8(scanner->unsafe[3]);
+  gsize i;
+
+  for (i = 0; i + sizeof(__m256i) <= n; i += sizeof(__m256i))
+    {
+      __m256i chunk = _mm256_loadu_si256((const __m256i *) (s + i));
+      __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi8(space, chunk),
+                                                      _mm256_or_si256(_mm256_cmpeq_epi8(chunk, u0),
+                                                                      _mm256_cmpeq_epi8(chunk, u1))),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(chunk, u2),
+                                                      _mm256_cmpeq_epi8(chunk, u3)));
+      guint32 mask = _mm256_movemask_epi8(match);
+
+      if (mask)
+        return i + __builtin_ctz(mask);
+    }
+  return i + _find_safe_run_sse2(s + i, n - i, scanner);
+}
+
+typedef gsize (*FindSafeRunFunc)(const guchar *s, gsize n, const SafeRunScanner *scanner);
+
+static FindSafeRunFunc find_safe_run;
+
+/* NOTE: the selection is idempotent, so it does not matter if multiple
+ * threads happen to run it concurrently */
+static void
+_select_implementation(void)
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    find_safe_run = _find_safe_run_avx2;
+  else
+    find_safe_run = _find_safe_run_sse2;
+}
+
+#endif
+
+static void
+_safe_run_scanner_init(SafeRunScanner *self, const gchar *unsafe_chars)
+{
+  gsize unsafe_len = unsafe_chars ? strlen(unsafe_chars) : 0;
+
+  self->unsafe_chars = unsafe_chars;
+  self->simd = UTF8UTILS_HAVE_X86_SIMD && unsafe_len < SAFE_RUN_MAX_UNSAFE_CHARS;
+
+  /* the backslash is always unsafe, it also pads the unused slots */
+  memset(self->unsafe, '\\', sizeof(self->unsafe));
+  if (self->simd)
+    memcpy(self->unsafe + 1, unsafe_chars, unsafe_len);
+}
+
+static inline gsize
+_find_safe_run(const SafeRunScanner *self, const gchar *s, gsize n)
+{
+#if UTF8UTILS_HAVE_X86_SIMD
+  if (self->simd)
+    {
+      if (G_UNLIKELY(!find_safe_run))
+        _select_implementation();
+      return find_safe_run((const guchar *) s, n, self);
+    }
+#endif
+  return _find_safe_run_scalar((const guchar *) s, n, self->unsafe_chars);
+}
+
 /**
  * This function escapes an unsanitized input (e.g. that can contain binary
  * characters, and produces an escaped format that can be deescaped in need,
@@ -117,10 +270,23 @@ _append_unsafe_utf8_as_escaped_with_specific_length(GString *escaped_output, con
                                                     const gchar *invalid_format)
 {
   const gchar *raw_end = raw + raw_len;
+  SafeRunScanner scanner;
 
+  _safe_run_scanner_init(&scanner, unsafe_chars);
   while (raw < raw_end)
-    _append_escaped_utf8_character(escaped_output, &raw, raw_end - raw, unsafe_chars,
-                                   control_format, invalid_format);
+    {
+      gsize safe_len = _find_safe_run(&scanner, raw, raw_end - raw);
+
+      if (safe_len > 0)
+        {
+          g_string_append_len(escaped_output, raw, safe_len);
+          raw += safe_len;
+          if (raw == raw_end)
+            break;
+        }
+      _append_escaped_utf8_character(escaped_output, &raw, raw_end - raw, unsafe_chars,
+                                     control_format, invalid_format);
+    }
 }
 
 static void
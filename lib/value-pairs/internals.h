@@ -28,6 +28,8 @@
 #include "syslog-ng.h"
 #include "atomic.h"
 
+typedef struct _VPNameCache VPNameCache;
+
 struct _ValuePairs
 {
   GAtomicCounter ref_cnt;
@@ -40,6 +42,9 @@ struct _ValuePairs
 
   /* guint32 as CfgFlagHandler only supports 32 bit integers */
   guint32 scopes;
+
+  /* per NVHandle decisions and the names produced, see value-pairs.c */
+  VPNameCache *name_cache;
 };
 
 
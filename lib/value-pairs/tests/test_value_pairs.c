@@ -285,6 +285,81 @@ Test(value_pairs, test_transformer_shift_levels)
   g_ptr_array_free(transformers, TRUE);
 }
 
+static gboolean
+vp_keys_concat(const gchar *name, TypeHint type, const gchar *value,
+               gsize value_len, gpointer user_data)
+{
+  cat_keys_foreach(name, user_data);
+  return FALSE;
+}
+
+static void
+assert_foreach_order(ValuePairs *vp, LogMessage *msg, const gchar *expected)
+{
+  GString *keys = g_string_new("");
+  LogTemplateEvalOptions options = {&template_options, LTZ_LOCAL, 11, NULL};
+
+  value_pairs_foreach(vp, vp_keys_concat, msg, &options, keys);
+  cr_assert_str_eq(keys->str, expected);
+  g_string_free(keys, TRUE);
+}
+
+Test(value_pairs, test_names_registered_after_first_use_are_sorted_in)
+{
+  ValuePairs *vp = value_pairs_new();
+  LogMessage *msg = create_message();
+  LogMessage *msg_with_new_names = create_message();
+
+  value_pairs_add_scope(vp, "nv-pairs");
+  value_pairs_add_glob_pattern(vp, "MSGID", FALSE);
+
+  assert_foreach_order(vp, msg, "HOST,MESSAGE,PID,PROGRAM");
+
+  log_msg_set_value_by_name(msg_with_new_names, "AAA", "first", -1);
+  log_msg_set_value_by_name(msg_with_new_names, "NEW", "middle", -1);
+  log_msg_set_value_by_name(msg_with_new_names, "zzz", "last", -1);
+  assert_foreach_order(vp, msg_with_new_names, "AAA,HOST,MESSAGE,NEW,PID,PROGRAM,zzz");
+
+  /* the names seen earlier keep their place after the insertions */
+  assert_foreach_order(vp, msg, "HOST,MESSAGE,PID,PROGRAM");
+
+  log_msg_unref(msg_with_new_names);
+  log_msg_unref(msg);
+  value_pairs_unref(vp);
+}
+
+static gboolean
+vp_host_value(const gchar *name, TypeHint type, const gchar *value,
+              gsize value_len, gpointer user_data)
+{
+  GString *host = (GString *) user_data;
+
+  if (strcmp(name, "HOST") == 0)
+    g_string_append_len(host, value, value_len);
+  return FALSE;
+}
+
+Test(value_pairs, test_explicit_pair_overrides_nvpair_with_the_same_name)
+{
+  ValuePairs *vp = value_pairs_new();
+  LogMessage *msg = create_message();
+  LogTemplate *template = create_template("string", "overridden");
+  LogTemplateEvalOptions options = {&template_options, LTZ_LOCAL, 11, NULL};
+  GString *host = g_string_new("");
+
+  value_pairs_add_scope(vp, "nv-pairs");
+  value_pairs_add_pair(vp, "HOST", template);
+  log_template_unref(template);
+
+  assert_foreach_order(vp, msg, "HOST,MESSAGE,MSGID,PID,PROGRAM");
+  value_pairs_foreach(vp, vp_host_value, msg, &options, host);
+  cr_assert_str_eq(host->str, "overridden");
+
+  g_string_free(host, TRUE);
+  log_msg_unref(msg);
+  value_pairs_unref(vp);
+}
+
 GlobalConfig *cfg;
 
 void
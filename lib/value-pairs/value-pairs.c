@@ -47,24 +47,110 @@ typedef struct
   LogTemplate *template;
 } VPPairConf;
 
+/*
+ * VPNameCache
+ *
+ * Whether a name-value pair of a message gets included, the name it is
+ * transformed to and the way value_pairs_walk() splits that name into
+ * tokens only depend on the configuration and on the name behind the
+ * NVHandle. These are worked out the first time a handle shows up in a
+ * message and are reused for every later message, the cache only grows
+ * when new handles get registered. It is dropped whenever the
+ * configuration of the ValuePairs instance changes.
+ *
+ * All the names are also kept in sorted order, results are sorted by their
+ * rank in this order instead of comparing the names themselves.
+ *
+ * VPName instances are neither changed nor freed while the cache is
+ * alive, except for their rank, which is protected by the lock along with
+ * the rest of the cache.
+ *
+ * Once the handles of a message are known, resolving its names only needs
+ * the lock for reading, the lock is taken for writing when a new handle
+ * has to be added.
+ */
+typedef struct
+{
+  gchar *name;
+  guint32 rank;
+  /* the name split at the dots, NULL if it has no tokens at all */
+  GPtrArray *tokens;
+} VPName;
+
+enum
+{
+  VPH_UNKNOWN = 0,
+  VPH_EXCLUDED,
+  VPH_INCLUDED,
+};
+
+typedef struct
+{
+  gint state;
+  VPName *name;
+} VPHandleDecision;
+
+struct _VPNameCache
+{
+  GStaticRWLock lock;
+  gboolean initialized;
+
+  /* VPHandleDecision instances indexed by NVHandle */
+  GArray *handles;
+  GHashTable *names;
+  GPtrArray *sorted_names;
+
+  /* VPName instances in the same order as vp->builtins and vp->vpairs */
+  GPtrArray *builtin_names;
+  GPtrArray *vpair_names;
+};
+
+enum
+{
+  VPR_NVPAIR,
+  VPR_BUILTIN,
+  VPR_PAIR,
+};
+
 typedef struct
 {
   /* we don't own any of the fields here, it is assumed that allocations are
    * managed by the caller */
 
-  GString *name;
-  GString *value;
+  VPName *name;
+  const gchar *value;
+  gsize value_len;
   TypeHint type_hint;
+
+  /* copy of name->rank taken with the cache locked, the results are
+   * sorted by it after the lock is released */
+  guint32 rank;
+
+  /* where the value comes from and the NVHandle or the index in the
+   * builtins/vpairs array that identifies its name */
+  gint source;
+  guint32 source_id;
+
+  /* the later one wins if the same name is inserted multiple times */
+  guint32 seq;
 } VPResultValue;
 
 typedef struct
 {
-  GTree *result_tree;
+  ValuePairs *vp;
 
   /* array of VPResultValue instances */
   GArray *values;
 } VPResults;
 
+typedef enum
+{
+  VPO_ASCENDING,
+  VPO_DESCENDING,
+  VPO_CUSTOM,
+} VPResultOrder;
+
+typedef gboolean (*VPResultFunc)(VPResultValue *rv, gpointer user_data);
 
 typedef enum
 {
@@ -180,40 +266,44 @@ vp_pair_conf_free(VPPairConf *vpc)
   g_free(vpc);
 }
 
-static void
-vp_result_value_init(VPResultValue *rv, GString *name, TypeHint type_hint, GString *value)
-{
-  rv->type_hint = type_hint;
-  rv->name = name;
-  rv->value = value;
-}
+static GPtrArray *vp_walker_split_name_to_tokens(const gchar *name);
 
 static void
-vp_results_init(VPResults *results, GCompareFunc compare_func)
+vp_name_free(VPName *self)
 {
-  results->values = g_array_sized_new(FALSE, FALSE, sizeof(VPResultValue), 16);
-  results->result_tree = g_tree_new_full((GCompareDataFunc) compare_func, NULL,
-                                         NULL, NULL);
+  if (self->tokens)
+    {
+      g_ptr_array_foreach(self->tokens, (GFunc) g_free, NULL);
+      g_ptr_array_free(self->tokens, TRUE);
+    }
+  g_free(self->name);
+  g_free(self);
 }
 
-static void
-vp_results_deinit(VPResults *results)
+static VPNameCache *
+vp_name_cache_new(void)
 {
-  g_tree_destroy(results->result_tree);
-  g_array_free(results->values, TRUE);
+  VPNameCache *self = g_new0(VPNameCache, 1);
+
+  g_static_rw_lock_init(&self->lock);
+  self->handles = g_array_new(FALSE, TRUE, sizeof(VPHandleDecision));
+  self->names = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) vp_name_free);
+  self->sorted_names = g_ptr_array_new();
+  self->builtin_names = g_ptr_array_new();
+  self->vpair_names = g_ptr_array_new();
+  return self;
 }
 
 static void
-vp_results_insert(VPResults *results, GString *name, TypeHint type_hint, GString *value)
-{
-  VPResultValue *rv;
-  gint ndx = results->values->len;
-
-  g_array_set_size(results->values, ndx + 1);
-  rv = &g_array_index(results->values, VPResultValue, ndx);
-  vp_result_value_init(rv, name, type_hint, value);
-  /* GTree takes over ownership of name */
-  g_tree_insert(results->result_tree, name->str, GINT_TO_POINTER(ndx));
+vp_name_cache_free(VPNameCache *self)
+{
+  g_ptr_array_free(self->vpair_names, TRUE);
+  g_ptr_array_free(self->builtin_names, TRUE);
+  g_ptr_array_free(self->sorted_names, TRUE);
+  g_hash_table_destroy(self->names);
+  g_array_free(self->handles, TRUE);
+  g_static_rw_lock_free(&self->lock);
+  g_free(self);
 }
 
 static GString *
@@ -237,38 +327,56 @@ vp_transform_apply (ValuePairs *vp, const gchar *key)
   return result;
 }
 
-/* runs over the name-value pairs requested by the user (e.g. with value_pairs_add_pair) */
 static void
-vp_pairs_foreach(gpointer data, gpointer user_data)
+vp_name_cache_insert_sorted(VPNameCache *self, VPName *name)
 {
-  ValuePairs *vp = ((gpointer *)user_data)[0];
-  LogMessage *msg = ((gpointer *)user_data)[2];
-  LogTemplateEvalOptions *options = ((gpointer *)user_data)[3];
-  VPResults *results = ((gpointer *)user_data)[5];
-  GString *sb = scratch_buffers_alloc();
-  VPPairConf *vpc = (VPPairConf *)data;
+  GPtrArray *sorted = self->sorted_names;
+  guint lo = 0, hi = sorted->len;
+  guint i;
 
-  log_template_append_format((LogTemplate *)vpc->template, msg, options, sb);
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
 
-  if (vp->omit_empty_values && sb->len == 0)
-    return;
-  vp_results_insert(results, vp_transform_apply(vp, vpc->name), vpc->template->type_hint, sb);
+      if (strcmp(((VPName *) g_ptr_array_index(sorted, mid))->name, name->name) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  g_ptr_array_add(sorted, NULL);
+  memmove(&sorted->pdata[lo + 1], &sorted->pdata[lo], (sorted->len - lo - 1) * sizeof(gpointer));
+  sorted->pdata[lo] = name;
+
+  for (i = lo; i < sorted->len; i++)
+    ((VPName *) g_ptr_array_index(sorted, i))->rank = i;
+}
+
+/* must be called with the cache locked for writing */
+static VPName *
+vp_name_cache_lookup_name(ValuePairs *vp, const gchar *key)
+{
+  VPNameCache *self = vp->name_cache;
+  GString *transformed = vp_transform_apply(vp, key);
+  VPName *name;
+
+  name = g_hash_table_lookup(self->names, transformed->str);
+  if (name)
+    return name;
+
+  name = g_new0(VPName, 1);
+  name->name = g_strndup(transformed->str, transformed->len);
+  name->tokens = vp_walker_split_name_to_tokens(name->name);
+  g_hash_table_insert(self->names, name->name, name);
+  vp_name_cache_insert_sorted(self, name);
+  return name;
 }
 
-/* runs over the LogMessage nv-pairs, and inserts them unless excluded */
 static gboolean
-vp_msg_nvpairs_foreach(NVHandle handle, gchar *name,
-                       const gchar *value, gssize value_len,
-                       gpointer user_data)
+vp_is_nvpair_included(ValuePairs *vp, NVHandle handle, const gchar *name)
 {
-  ValuePairs *vp = ((gpointer *)user_data)[0];
-  VPResults *results = ((gpointer *)user_data)[5];
   guint j;
   gboolean inc;
-  GString *sb;
-
-  if (vp->omit_empty_values && value_len == 0)
-    return FALSE;
 
   inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
         (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
@@ -280,15 +388,285 @@ vp_msg_nvpairs_foreach(NVHandle handle, gchar *name,
       if (vp_pattern_spec_eval(vps, name))
         inc = vps->include;
     }
+  return inc;
+}
+
+/* must be called with the cache locked for writing, returns NULL if the
+ * handle is excluded */
+static VPName *
+vp_name_cache_lookup_handle(ValuePairs *vp, NVHandle handle)
+{
+  VPNameCache *self = vp->name_cache;
+  VPHandleDecision *decision;
+
+  if (handle >= self->handles->len)
+    g_array_set_size(self->handles, handle + 1);
+
+  decision = &g_array_index(self->handles, VPHandleDecision, handle);
+  if (decision->state == VPH_UNKNOWN)
+    {
+      const gchar *name = log_msg_get_value_name(handle, NULL);
+
+      if (vp_is_nvpair_included(vp, handle, name))
+        {
+          decision->name = vp_name_cache_lookup_name(vp, name);
+          decision->state = VPH_INCLUDED;
+        }
+      else
+        {
+          decision->state = VPH_EXCLUDED;
+        }
+    }
+  return decision->name;
+}
+
+/* the transformations may be added after the last change that reset the
+ * cache (see ValuePairsTransformSet), so the names of the builtins and the
+ * explicit pairs are looked up on first use */
+static void
+vp_name_cache_prepare(ValuePairs *vp)
+{
+  VPNameCache *self = vp->name_cache;
+  gint i;
+
+  if (self->initialized)
+    return;
+
+  for (i = 0; i < vp->builtins->len; i++)
+    {
+      ValuePairSpec *spec = (ValuePairSpec *) g_ptr_array_index(vp->builtins, i);
+      g_ptr_array_add(self->builtin_names, vp_name_cache_lookup_name(vp, spec->name));
+    }
+  for (i = 0; i < vp->vpairs->len; i++)
+    {
+      VPPairConf *vpc = (VPPairConf *) g_ptr_array_index(vp->vpairs, i);
+      g_ptr_array_add(self->vpair_names, vp_name_cache_lookup_name(vp, vpc->name));
+    }
+  self->initialized = TRUE;
+}
+
+static void
+vp_name_cache_invalidate(ValuePairs *vp)
+{
+  if (vp->name_cache)
+    vp_name_cache_free(vp->name_cache);
+  vp->name_cache = vp_name_cache_new();
+}
+
+static void
+vp_results_init(VPResults *results, ValuePairs *vp)
+{
+  results->vp = vp;
+  results->values = g_array_sized_new(FALSE, FALSE, sizeof(VPResultValue), 16);
+}
+
+static void
+vp_results_deinit(VPResults *results)
+{
+  g_array_free(results->values, TRUE);
+}
+
+static void
+vp_results_insert(VPResults *results, gint source, guint32 source_id, TypeHint type_hint,
+                  const gchar *value, gsize value_len)
+{
+  VPResultValue *rv;
+  gint ndx = results->values->len;
+
+  g_array_set_size(results->values, ndx + 1);
+  rv = &g_array_index(results->values, VPResultValue, ndx);
+  rv->name = NULL;
+  rv->value = value;
+  rv->value_len = value_len;
+  rv->type_hint = type_hint;
+  rv->source = source;
+  rv->source_id = source_id;
+  rv->seq = ndx;
+}
+
+static void
+vp_result_set_name(VPResultValue *rv, VPName *name)
+{
+  rv->name = name;
+  if (name)
+    rv->rank = name->rank;
+}
+
+/* looks up the names of the values without changing the cache, returns
+ * FALSE if any of them is missing, must be called with the cache locked
+ * for reading */
+static gboolean
+vp_results_lookup_cached_names(VPResults *results)
+{
+  VPNameCache *cache = results->vp->name_cache;
+  guint i;
 
-  if (!inc)
+  if (!cache->initialized)
     return FALSE;
 
-  sb = scratch_buffers_alloc();
+  for (i = 0; i < results->values->len; i++)
+    {
+      VPResultValue *rv = &g_array_index(results->values, VPResultValue, i);
+      VPHandleDecision *decision;
+
+      switch (rv->source)
+        {
+        case VPR_NVPAIR:
+          if (rv->source_id >= cache->handles->len)
+            return FALSE;
+
+          decision = &g_array_index(cache->handles, VPHandleDecision, rv->source_id);
+          if (decision->state == VPH_UNKNOWN)
+            return FALSE;
+          vp_result_set_name(rv, decision->name);
+          break;
+        case VPR_BUILTIN:
+          vp_result_set_name(rv, g_ptr_array_index(cache->builtin_names, rv->source_id));
+          break;
+        case VPR_PAIR:
+          vp_result_set_name(rv, g_ptr_array_index(cache->vpair_names, rv->source_id));
+          break;
+        default:
+          g_assert_not_reached();
+        }
+    }
+  return TRUE;
+}
+
+/* looks up the names of the values, adding the missing ones to the cache,
+ * must be called with the cache locked for writing */
+static void
+vp_results_resolve_names(VPResults *results)
+{
+  ValuePairs *vp = results->vp;
+  VPNameCache *cache = vp->name_cache;
+  guint i;
+
+  vp_name_cache_prepare(vp);
+  for (i = 0; i < results->values->len; i++)
+    {
+      VPResultValue *rv = &g_array_index(results->values, VPResultValue, i);
+
+      switch (rv->source)
+        {
+        case VPR_NVPAIR:
+          rv->name = vp_name_cache_lookup_handle(vp, (NVHandle) rv->source_id);
+          break;
+        case VPR_BUILTIN:
+          rv->name = g_ptr_array_index(cache->builtin_names, rv->source_id);
+          break;
+        case VPR_PAIR:
+          rv->name = g_ptr_array_index(cache->vpair_names, rv->source_id);
+          break;
+        default:
+          g_assert_not_reached();
+        }
+    }
+
+  /* inserting a name renumbers the ones after it, so the ranks are only
+   * taken once every name is in place */
+  for (i = 0; i < results->values->len; i++)
+    {
+      VPResultValue *rv = &g_array_index(results->values, VPResultValue, i);
+
+      if (rv->name)
+        rv->rank = rv->name->rank;
+    }
+}
+
+static void
+vp_results_drop_excluded(VPResults *results)
+{
+  guint i, kept = 0;
+
+  for (i = 0; i < results->values->len; i++)
+    {
+      VPResultValue *rv = &g_array_index(results->values, VPResultValue, i);
+
+      if (!rv->name)
+        continue;
+
+      if (kept != i)
+        g_array_index(results->values, VPResultValue, kept) = *rv;
+      kept++;
+    }
+  g_array_set_size(results->values, kept);
+}
+
+static gint
+vp_result_seq_cmp(const VPResultValue *a, const VPResultValue *b)
+{
+  return a->seq < b->seq ? -1 : (a->seq > b->seq ? 1 : 0);
+}
 
-  g_string_append_len(sb, value, value_len);
-  vp_results_insert(results, vp_transform_apply(vp, name), TYPE_HINT_STRING, sb);
+static gint
+vp_result_rank_cmp(gconstpointer a, gconstpointer b)
+{
+  const VPResultValue *ra = (const VPResultValue *) a;
+  const VPResultValue *rb = (const VPResultValue *) b;
+
+  if (ra->rank != rb->rank)
+    return ra->rank < rb->rank ? -1 : 1;
+  return vp_result_seq_cmp(ra, rb);
+}
 
+static gint
+vp_result_rank_reverse_cmp(gconstpointer a, gconstpointer b)
+{
+  const VPResultValue *ra = (const VPResultValue *) a;
+  const VPResultValue *rb = (const VPResultValue *) b;
+
+  if (ra->rank != rb->rank)
+    return ra->rank > rb->rank ? -1 : 1;
+  return vp_result_seq_cmp(ra, rb);
+}
+
+static gint
+vp_result_custom_cmp(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const VPResultValue *ra = (const VPResultValue *) a;
+  const VPResultValue *rb = (const VPResultValue *) b;
+  GCompareFunc compare_func = *(GCompareFunc *) user_data;
+  gint r;
+
+  r = compare_func(ra->name->name, rb->name->name);
+  if (r != 0)
+    return r;
+  return vp_result_seq_cmp(ra, rb);
+}
+
+/* runs over the name-value pairs requested by the user (e.g. with value_pairs_add_pair) */
+static void
+vp_merge_pairs(ValuePairs *vp, VPResults *results, LogMessage *msg, LogTemplateEvalOptions *options)
+{
+  gint i;
+
+  for (i = 0; i < vp->vpairs->len; i++)
+    {
+      VPPairConf *vpc = (VPPairConf *) g_ptr_array_index(vp->vpairs, i);
+      GString *sb = scratch_buffers_alloc();
+
+      log_template_append_format(vpc->template, msg, options, sb);
+
+      if (vp->omit_empty_values && sb->len == 0)
+        continue;
+      vp_results_insert(results, VPR_PAIR, i, vpc->template->type_hint, sb->str, sb->len);
+    }
+}
+
+/* runs over the LogMessage nv-pairs, the decision whether they are
+ * included is made later, by looking up their handle in the cache */
+static gboolean
+vp_msg_nvpairs_foreach(NVHandle handle, gchar *name,
+                       const gchar *value, gssize value_len,
+                       gpointer user_data)
+{
+  VPResults *results = (VPResults *) user_data;
+
+  if (results->vp->omit_empty_values && value_len == 0)
+    return FALSE;
+
+  vp_results_insert(results, VPR_NVPAIR, handle, TYPE_HINT_STRING, value, value_len);
   return FALSE;
 }
 
@@ -341,6 +719,7 @@ vp_merge_set(ValuePairs *vp, ValuePairSpec *set)
 static void
 vp_update_builtin_list_of_values(ValuePairs *vp)
 {
+  vp_name_cache_invalidate(vp);
   g_ptr_array_set_size(vp->builtins, 0);
 
   if (vp->patterns->len > 0)
@@ -394,42 +773,45 @@ vp_merge_builtins(ValuePairs *vp, VPResults *results, LogMessage *msg, LogTempla
           continue;
         }
 
-      vp_results_insert(results, vp_transform_apply(vp, spec->name), TYPE_HINT_STRING, sb);
+      vp_results_insert(results, VPR_BUILTIN, i, TYPE_HINT_STRING, sb->str, sb->len);
     }
 }
 
-static gboolean
-vp_foreach_helper(const gchar *name, gpointer ndx_as_pointer, gpointer data)
+/* values of name-value pairs point into the LogMessage, which may not be
+ * NUL terminated (indirect values), copy them as the callbacks expect
+ * proper strings */
+static void
+vp_results_copy_nvpair_values(VPResults *results)
 {
-  VPResults *results = ((gpointer *)data)[0];
-  gint ndx = GPOINTER_TO_INT(ndx_as_pointer);
-  VPResultValue *rv = &g_array_index(results->values, VPResultValue, ndx);
-  VPForeachFunc func = ((gpointer *)data)[1];
-  gpointer user_data = ((gpointer *)data)[2];
-  gboolean *r = ((gpointer *)data)[3];
+  guint i;
 
-  *r &= !func(name, rv->type_hint,
-              rv->value->str,
-              rv->value->len, user_data);
-  return !*r;
-}
+  for (i = 0; i < results->values->len; i++)
+    {
+      VPResultValue *rv = &g_array_index(results->values, VPResultValue, i);
+      GString *sb;
 
+      if (rv->source != VPR_NVPAIR)
+        continue;
 
-gboolean
-value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
-                            GCompareFunc compare_func,
-                            LogMessage *msg, LogTemplateEvalOptions *options,
-                            gpointer user_data)
+      sb = scratch_buffers_alloc();
+      g_string_append_len(sb, rv->value, rv->value_len);
+      rv->value = sb->str;
+    }
+}
+
+static gboolean
+vp_foreach_results(ValuePairs *vp, VPResultOrder order, GCompareFunc compare_func,
+                   LogMessage *msg, LogTemplateEvalOptions *options,
+                   VPResultFunc func, gpointer user_data)
 {
-  gpointer args[] = { vp, func, msg, options, user_data, NULL};
-  gboolean result = TRUE;
   VPResults results;
-  gpointer helper_args[] = { &results, func, user_data, &result };
+  gboolean result = TRUE;
+  gboolean resolved;
   ScratchBuffersMarker mark;
+  guint i;
 
   scratch_buffers_mark(&mark);
-  vp_results_init(&results, compare_func);
-  args[5] = &results;
+  vp_results_init(&results, vp);
 
   /*
    * Build up the base set
@@ -437,21 +819,74 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
   if (vp->scopes & (VPS_NV_PAIRS + VPS_DOT_NV_PAIRS + VPS_SDATA + VPS_RFC5424) ||
       vp->patterns->len > 0)
     nv_table_foreach(msg->payload, logmsg_registry,
-                     (NVTableForeachFunc) vp_msg_nvpairs_foreach, args);
+                     (NVTableForeachFunc) vp_msg_nvpairs_foreach, &results);
 
   vp_merge_builtins(vp, &results, msg, options);
 
   /* Merge the explicit key-value pairs too */
-  g_ptr_array_foreach(vp->vpairs, (GFunc)vp_pairs_foreach, args);
+  vp_merge_pairs(vp, &results, msg, options);
+
+  g_static_rw_lock_reader_lock(&vp->name_cache->lock);
+  resolved = vp_results_lookup_cached_names(&results);
+  g_static_rw_lock_reader_unlock(&vp->name_cache->lock);
+
+  if (!resolved)
+    {
+      g_static_rw_lock_writer_lock(&vp->name_cache->lock);
+      vp_results_resolve_names(&results);
+      g_static_rw_lock_writer_unlock(&vp->name_cache->lock);
+    }
+  vp_results_drop_excluded(&results);
+
+  if (order == VPO_ASCENDING)
+    g_array_sort(results.values, vp_result_rank_cmp);
+  else if (order == VPO_DESCENDING)
+    g_array_sort(results.values, vp_result_rank_reverse_cmp);
+  else if (order == VPO_CUSTOM)
+    g_array_sort_with_data(results.values, vp_result_custom_cmp, &compare_func);
+
+  vp_results_copy_nvpair_values(&results);
+
+  /* Aaand we run it through the callback! Equal names are next to each
+   * other in insertion order, only the last one of them is used. */
+  for (i = 0; i < results.values->len && result; i++)
+    {
+      VPResultValue *rv = &g_array_index(results.values, VPResultValue, i);
+
+      if (i + 1 < results.values->len &&
+          g_array_index(results.values, VPResultValue, i + 1).name == rv->name)
+        continue;
+
+      result = !func(rv, user_data);
+    }
 
-  /* Aaand we run it through the callback! */
-  g_tree_foreach(results.result_tree, (GTraverseFunc)vp_foreach_helper, helper_args);
   vp_results_deinit(&results);
   scratch_buffers_reclaim_marked(mark);
 
   return result;
 }
 
+static gboolean
+vp_foreach_helper(VPResultValue *rv, gpointer data)
+{
+  VPForeachFunc func = ((gpointer *)data)[0];
+  gpointer user_data = ((gpointer *)data)[1];
+
+  return func(rv->name->name, rv->type_hint, rv->value, rv->value_len, user_data);
+}
+
+gboolean
+value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
+                            GCompareFunc compare_func,
+                            LogMessage *msg, LogTemplateEvalOptions *options,
+                            gpointer user_data)
+{
+  gpointer helper_args[] = { func, user_data };
+  VPResultOrder order = compare_func == (GCompareFunc) strcmp ? VPO_ASCENDING : VPO_CUSTOM;
+
+  return vp_foreach_results(vp, order, compare_func, msg, options, vp_foreach_helper, helper_args);
+}
+
 gboolean
 value_pairs_foreach(ValuePairs *vp, VPForeachFunc func,
                     LogMessage *msg, LogTemplateEvalOptions *options,
@@ -633,7 +1068,7 @@ vp_walker_skip_sdata_enterprise_id(const gchar *name)
 }
 
 static GPtrArray *
-vp_walker_split_name_to_tokens(vp_walk_state_t *state, const gchar *name)
+vp_walker_split_name_to_tokens(const gchar *name)
 {
   const gchar *token_start = name;
   const gchar *token_end = name;
@@ -693,16 +1128,12 @@ vp_walker_name_combine_prefix(GPtrArray *tokens, gint until)
   return str;
 }
 
-static gchar *
+static const gchar *
 vp_walker_start_containers_for_name(vp_walk_state_t *state,
-                                    const gchar *name)
+                                    GPtrArray *tokens)
 {
-  GPtrArray *tokens;
-  gchar *key = NULL;
   guint i, start;
 
-  tokens = vp_walker_split_name_to_tokens(state, name);
-
   start = vp_stack_height(&state->stack);
   for (i = start; i < tokens->len - 1; i++)
     {
@@ -722,28 +1153,27 @@ vp_walker_start_containers_for_name(vp_walk_state_t *state,
                          NULL, NULL, state->user_data);
     }
 
-  /* The last token is the key (well, second to last, last being
-     NULL), so treat that normally. */
-  key = g_ptr_array_index(tokens, tokens->len - 1);
-  g_ptr_array_index(tokens, tokens->len - 1) = NULL;
-
-  g_ptr_array_foreach(tokens, (GFunc)g_free, NULL);
-  g_ptr_array_free(tokens, TRUE);
-
-  return key;
+  /* The last token is the key, so treat that normally. */
+  return g_ptr_array_index(tokens, tokens->len - 1);
 }
 
 static gboolean
-value_pairs_walker(const gchar *name, TypeHint type, const gchar *value, gsize value_len,
-                   gpointer user_data)
+value_pairs_walker(VPResultValue *rv, gpointer user_data)
 {
   vp_walk_state_t *state = (vp_walk_state_t *)user_data;
   vp_walk_stack_data_t *data;
-  gchar *key;
+  const gchar *key;
+  TypeHint type = rv->type_hint;
+  const gchar *value = rv->value;
+  gsize value_len = rv->value_len;
   gboolean result;
 
-  vp_walker_stack_unwind_containers_until(state, name);
-  key = vp_walker_start_containers_for_name(state, name);
+  /* names without tokens cannot be placed in the tree */
+  if (!rv->name->tokens)
+    return FALSE;
+
+  vp_walker_stack_unwind_containers_until(state, rv->name->name);
+  key = vp_walker_start_containers_for_name(state, rv->name->tokens);
   data = vp_walker_stack_peek(&state->stack);
 
   if (data != NULL)
@@ -757,17 +1187,9 @@ value_pairs_walker(const gchar *name, TypeHint type, const gchar *value, gsize v
                                   NULL,
                                   state->user_data);
 
-  g_free(key);
-
   return result;
 }
 
-static gint
-vp_walk_cmp(const gchar *s1, const gchar *s2)
-{
-  return strcmp(s2, s1);
-}
-
 /*******************************************************************************
  * Public API
  *******************************************************************************/
@@ -790,9 +1212,8 @@ value_pairs_walk(ValuePairs *vp,
   vp_stack_init(&state.stack);
 
   state.obj_start(NULL, NULL, NULL, NULL, NULL, user_data);
-  result = value_pairs_foreach_sorted(vp, value_pairs_walker,
-                                      (GCompareFunc)vp_walk_cmp, msg,
-                                      options, &state);
+  result = vp_foreach_results(vp, VPO_DESCENDING, NULL, msg, options,
+                              value_pairs_walker, &state);
   vp_walker_stack_unwind_all_containers(&state);
   state.obj_end(NULL, NULL, NULL, NULL, NULL, user_data);
   vp_stack_destroy(&state.stack);
@@ -866,6 +1287,7 @@ value_pairs_new(void)
   vp->vpairs = g_ptr_array_new();
   vp->patterns = g_ptr_array_new();
   vp->transforms = g_ptr_array_new();
+  vp->name_cache = vp_name_cache_new();
 
   return vp;
 }
@@ -905,6 +1327,7 @@ value_pairs_free (ValuePairs *vp)
     }
   g_ptr_array_free(vp->transforms, TRUE);
   g_ptr_array_free(vp->builtins, TRUE);
+  vp_name_cache_free(vp->name_cache);
   g_free(vp);
 }
 
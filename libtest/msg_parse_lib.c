@@ -26,6 +26,7 @@
 #include "plugin.h"
 
 #include <criterion/criterion.h>
+#include <string.h>
 
 void
 init_parse_options_and_load_syslogformat(MsgFormatOptions *parse_options)
@@ -64,13 +65,16 @@ assert_log_message_value(LogMessage *self, NVHandle handle, const gchar *expecte
   const gchar *key_name = log_msg_get_value_name(handle, &key_name_length);
   const gchar *actual_value = log_msg_get_value(self, handle, &value_length);
 
+  /* indirect values are not NUL terminated, compare them by length */
   if (expected_value)
     {
-      cr_assert_str_eq(actual_value, expected_value, "Invalid value for key %s; actual: %s, expected: %s", key_name,
-                       actual_value, expected_value);
+      cr_assert(value_length == strlen(expected_value) && strncmp(actual_value, expected_value, value_length) == 0,
+                "Invalid value for key %s; actual: %.*s, expected: %s", key_name,
+                (gint) value_length, actual_value, expected_value);
     }
   else
-    cr_assert_str_eq(actual_value, "", "No value is expected for key %s but its value is %s", key_name, actual_value);
+    cr_assert(value_length == 0, "No value is expected for key %s but its value is %.*s", key_name,
+              (gint) value_length, actual_value);
 }
 
 void
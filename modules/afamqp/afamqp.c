@@ -812,6 +812,7 @@ afamqp_dd_new(GlobalConfig *cfg)
   self->entries = g_new(amqp_table_entry_t, self->max_entries);
 
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
   afamqp_dd_set_value_pairs(&self->super.super.super, value_pairs_new_default(cfg));
   afamqp_dd_set_peer_verify((LogDriver *) self, TRUE);
   IV_TIMER_INIT(&self->heartbeat_timer);
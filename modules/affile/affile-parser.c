@@ -54,6 +54,7 @@ static CfgLexerKeyword affile_keywords[] =
   { "multi_line_suffix",  KW_MULTI_LINE_GARBAGE },
   { "multi_line_timeout", KW_MULTI_LINE_TIMEOUT },
   { "time_reap",          KW_TIME_REAP },
+  { "use_mmap",           KW_USE_MMAP },
   { NULL }
 };
 
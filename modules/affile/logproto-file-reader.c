@@ -40,6 +40,7 @@ log_proto_file_reader_options_defaults(LogProtoFileReaderOptions *options)
 {
   log_proto_multi_line_server_options_defaults(&options->super);
   options->pad_size = 0;
+  options->use_mmap = FALSE;
 }
 
 static gboolean
@@ -68,6 +69,11 @@ log_proto_file_reader_options_validate(LogProtoFileReaderOptions *options)
       return FALSE;
     }
 
+  if (options->use_mmap && (options->pad_size > 0 || options->super.super.encoding))
+    {
+      msg_warning("use-mmap() is ignored when pad-size() or encoding() is set, the file is read instead");
+    }
+
   return TRUE;
 }
 
@@ -30,6 +30,7 @@ typedef struct _LogProtoFileReaderOptions
 {
   LogProtoMultiLineServerOptions super;
   gint pad_size;
+  gboolean use_mmap;
 } LogProtoFileReaderOptions;
 
 LogProtoServer *log_proto_file_reader_new(LogTransport *transport, const LogProtoFileReaderOptions *options);
@@ -61,6 +61,9 @@ _construct_src_transport(FileOpener *self, gint fd)
 static LogProtoServer *
 _construct_src_proto(FileOpener *s, LogTransport *transport, LogProtoFileReaderOptions *proto_options)
 {
+  if (proto_options->use_mmap)
+    transport->read_mapped = log_transport_file_read_mapped_method;
+
   log_proto_server_options_set_ack_tracker_factory(&proto_options->super.super,
                                                    consecutive_ack_tracker_factory_new());
   return log_proto_file_reader_new(transport, proto_options);
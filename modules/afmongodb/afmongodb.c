@@ -325,6 +325,7 @@ afmongodb_dd_new(GlobalConfig *cfg)
   afmongodb_dd_set_collection(&self->super.super.super, template);
 
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
   afmongodb_dd_set_value_pairs(&self->super.super.super, value_pairs_new_default(cfg));
 
   return &self->super.super.super;
@@ -679,6 +679,7 @@ afsmtp_dd_new(GlobalConfig *cfg)
   self->mail_from = g_new0(AFSMTPRecipient, 1);
 
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
 
   return (LogDriver *)self;
 }
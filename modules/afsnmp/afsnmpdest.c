@@ -759,6 +759,7 @@ snmpdest_dd_new(GlobalConfig *cfg)
   self->transport = g_strdup("UDP");
 
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
   self->worker_options.is_output_thread = TRUE;
 
   return (LogDriver *)self;
@@ -75,6 +75,8 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "so_sndbuf",          KW_SO_SNDBUF },
   { "so_keepalive",       KW_SO_KEEPALIVE },
   { "so_reuseport",       KW_SO_REUSEPORT },
+  { "reuseport_shards",   KW_REUSEPORT_SHARDS },
+  { "reuseport_cpu_affinity", KW_REUSEPORT_CPU_AFFINITY },
   { "tcp_keep_alive",     KW_SO_KEEPALIVE }, /* old, once deprecated form, but revived in 3.4 */
   { "tcp_keepalive",      KW_SO_KEEPALIVE }, /* alias for so-keepalive, as tcp is the only option actually using it */
   { "tcp_keepalive_time", KW_TCP_KEEPALIVE_TIME },
@@ -35,6 +35,10 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
+
 #if SYSLOG_NG_ENABLE_TCP_WRAPPER
 #include <tcpd.h>
 int allow_severity = 0;
@@ -52,6 +56,8 @@ typedef struct _AFSocketSourceConnection
   int sock;
   GSockAddr *peer_addr;
   GSockAddr *local_addr;
+  /* index of the reuseport shard for sharded dgram sources, -1 otherwise */
+  gint shard;
 } AFSocketSourceConnection;
 
 static void afsocket_sd_close_connection(AFSocketSourceDriver *self, AFSocketSourceConnection *sc);
@@ -92,6 +98,11 @@ _format_sc_name(AFSocketSourceConnection *self, gint format_type)
       if (self->owner->bind_addr)
         {
           g_sockaddr_format(self->owner->bind_addr, buf, sizeof(buf), format_type);
+          if (self->shard >= 0)
+            {
+              gsize len = strlen(buf);
+              g_snprintf(buf + len, sizeof(buf) - len, "#%d", self->shard);
+            }
           return buf;
         }
       else
@@ -249,6 +260,7 @@ afsocket_sc_new(GSockAddr *peer_addr, GSockAddr *local_addr, int fd, GlobalConfi
   self->peer_addr = g_sockaddr_ref(peer_addr);
   self->local_addr = g_sockaddr_ref(local_addr);
   self->sock = fd;
+  self->shard = -1;
   return self;
 }
 
@@ -319,6 +331,22 @@ afsocket_sd_set_listen_backlog(LogDriver *s, gint listen_backlog)
   self->listen_backlog = listen_backlog;
 }
 
+void
+afsocket_sd_set_reuseport_shards(LogDriver *s, gint shards)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->reuseport_shards = shards;
+}
+
+void
+afsocket_sd_set_reuseport_cpu_affinity(LogDriver *s, gboolean enable)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->reuseport_cpu_affinity = enable;
+}
+
 void
 afsocket_sd_set_dynamic_window_size(LogDriver *s, gint dynamic_window_size)
 {
@@ -865,23 +893,144 @@ _sd_open_stream(AFSocketSourceDriver *self)
   return transport_mapper_async_init(self->transport_mapper, _finalize_init, self);
 }
 
+/* Each shard gets a connection with a LogReader of its own.  The readers
+ * are not pinned to threads: like every other reader, they are run by the
+ * shared I/O worker pool when their socket becomes readable.  A reader is
+ * never run by two workers at once, so busy shards are processed by as
+ * many workers in parallel.  Stream sources are not sharded, as each
+ * accepted connection has a reader of its own already. */
+static gboolean
+_is_reuseport_sharded(AFSocketSourceDriver *self)
+{
+  return self->transport_mapper->sock_type == SOCK_DGRAM && self->reuseport_shards > 1;
+}
+
+static gint
+_dgram_connections_expected(AFSocketSourceDriver *self)
+{
+  return _is_reuseport_sharded(self) ? self->reuseport_shards : 1;
+}
+
+static gboolean
+_sd_add_dgram_connection(AFSocketSourceDriver *self, gint fd, gint shard)
+{
+  AFSocketSourceConnection *conn;
+
+  conn = afsocket_sc_new(NULL, self->bind_addr, fd, self->super.super.super.cfg);
+  conn->shard = shard;
+  afsocket_sc_set_owner(conn, self);
+  if (!log_pipe_init(&conn->super))
+    {
+      log_pipe_unref(&conn->super);
+      return FALSE;
+    }
+
+  afsocket_sd_add_connection(self, conn);
+  _connections_count_inc(self);
+  log_pipe_append(&conn->super, &self->super.super.super);
+  return TRUE;
+}
+
+/* Distribute datagrams between the sockets of the reuseport group based on
+ * the CPU that received them, so that each shard is fed by a stable set
+ * of CPUs. The filter applies to the whole group. */
+static void
+_attach_reuseport_cpu_affinity_filter(AFSocketSourceDriver *self, gint fd)
+{
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+  struct sock_filter code[] =
+  {
+    { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+    { BPF_ALU | BPF_MOD | BPF_K, 0, 0, self->reuseport_shards },
+    { BPF_RET | BPF_A, 0, 0, 0 },
+  };
+  struct sock_fprog prog = { .len = G_N_ELEMENTS(code), .filter = code };
+
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0)
+    msg_warning("Error attaching CPU affinity filter to SO_REUSEPORT sockets, using the default hash based balancing",
+                evt_tag_error(EVT_TAG_OSERROR),
+                log_pipe_location_tag(&self->super.super.super));
+#else
+  msg_warning("reuseport-cpu-affinity() is not supported on this platform, using the default hash based balancing",
+              log_pipe_location_tag(&self->super.super.super));
+#endif
+}
+
+static gboolean
+_sd_open_dgram_shards(AFSocketSourceDriver *self)
+{
+  gint *socks = g_new(gint, self->reuseport_shards);
+  gboolean success = TRUE;
+  gint i, opened;
+
+  for (opened = 0; opened < self->reuseport_shards; opened++)
+    {
+      if (!transport_mapper_open_socket(self->transport_mapper, self->socket_options, self->bind_addr,
+                                        self->bind_addr, AFSOCKET_DIR_RECV, &socks[opened]))
+        {
+          for (i = 0; i < opened; i++)
+            close(socks[i]);
+          g_free(socks);
+          return self->super.super.optional;
+        }
+    }
+
+  if (self->reuseport_cpu_affinity)
+    _attach_reuseport_cpu_affinity_filter(self, socks[0]);
+
+  for (i = 0; i < self->reuseport_shards; i++)
+    {
+      if (!_sd_add_dgram_connection(self, socks[i], i))
+        {
+          /* socks[i] was handed over to the failed connection, which closes
+           * it along with its transport, only the unused ones are ours */
+          for (i++; i < self->reuseport_shards; i++)
+            close(socks[i]);
+          afsocket_sd_kill_connection_list(self->connections);
+          self->connections = NULL;
+          _connections_count_set(self, 0);
+          success = FALSE;
+          break;
+        }
+    }
+
+  g_free(socks);
+  return success;
+}
+
 static gboolean
 _sd_open_dgram(AFSocketSourceDriver *self)
 {
   gint sock = -1;
-  if (!self->connections)
+
+  self->fd = -1;
+
+  /* the number of shards changed since the connections were kept alive */
+  if (self->connections && (gint) g_list_length(self->connections) != _dgram_connections_expected(self))
     {
-      if (!afsocket_sd_acquire_socket(self, &sock))
-        return self->super.super.optional;
-      if (sock == -1
-          && !transport_mapper_open_socket(self->transport_mapper, self->socket_options, self->bind_addr,
-                                           self->bind_addr, AFSOCKET_DIR_RECV, &sock))
-        return self->super.super.optional;
+      afsocket_sd_kill_connection_list(self->connections);
+      self->connections = NULL;
+      _connections_count_set(self, 0);
     }
-  self->fd = -1;
 
-  /* we either have self->connections != NULL, or sock contains a new fd */
-  if (self->connections || afsocket_sd_process_connection(self, NULL, self->bind_addr, sock))
+  if (self->connections)
+    return transport_mapper_init(self->transport_mapper);
+
+  if (_is_reuseport_sharded(self))
+    {
+      if (!_sd_open_dgram_shards(self))
+        return FALSE;
+      return self->connections ? transport_mapper_init(self->transport_mapper) : TRUE;
+    }
+
+  if (!afsocket_sd_acquire_socket(self, &sock))
+    return self->super.super.optional;
+  if (sock == -1
+      && !transport_mapper_open_socket(self->transport_mapper, self->socket_options, self->bind_addr,
+                                       self->bind_addr, AFSOCKET_DIR_RECV, &sock))
+    return self->super.super.optional;
+
+  if (_sd_add_dgram_connection(self, sock, -1))
     return transport_mapper_init(self->transport_mapper);
   return FALSE;
 }
@@ -1048,6 +1197,16 @@ afsocket_sd_init_method(LogPipe *s)
   if (!afsocket_sd_setup_transport(self) || !afsocket_sd_setup_addresses(self))
     return FALSE;
 
+  if (self->reuseport_shards > 1)
+    {
+      if (self->transport_mapper->sock_type == SOCK_DGRAM)
+        self->socket_options->so_reuseport = TRUE;
+      else
+        msg_warning("WARNING: reuseport-shards() is only supported by datagram based transports, ignoring. "
+                    "Connections of stream based transports are read in parallel without it",
+                    log_pipe_location_tag(&self->super.super.super));
+    }
+
   if (!afsocket_sd_restore_dynamic_window_pool(self))
     {
       if (self->dynamic_window_size != 0)
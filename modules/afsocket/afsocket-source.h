@@ -55,6 +55,11 @@ struct _AFSocketSourceDriver
   gint max_connections;
   atomic_gssize num_connections;
   gint listen_backlog;
+
+  /* number of SO_REUSEPORT sockets (and readers) opened on the same
+   * address for datagram sources */
+  gint reuseport_shards;
+  gboolean reuseport_cpu_affinity;
   GList *connections;
   SocketOptions *socket_options;
   TransportMapper *transport_mapper;
@@ -78,6 +83,8 @@ struct _AFSocketSourceDriver
 void afsocket_sd_set_keep_alive(LogDriver *self, gint enable);
 void afsocket_sd_set_max_connections(LogDriver *self, gint max_connections);
 void afsocket_sd_set_listen_backlog(LogDriver *self, gint listen_backlog);
+void afsocket_sd_set_reuseport_shards(LogDriver *self, gint shards);
+void afsocket_sd_set_reuseport_cpu_affinity(LogDriver *self, gboolean enable);
 void afsocket_sd_set_dynamic_window_size(LogDriver *self, gint dynamic_window_size);
 void afsocket_sd_set_dynamic_window_stats_freq(LogDriver *self, gdouble stats_freq);
 void afsocket_sd_set_dynamic_window_realloc_ticks(LogDriver *self, gint realloc_ticks);
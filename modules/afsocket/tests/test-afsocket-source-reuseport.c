@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "afinet-source.h"
+#include "afsocket-source.h"
+#include "stats/stats-registry.h"
+#include "cfg.h"
+#include "apphook.h"
+
+#include <criterion/criterion.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define NUM_SHARDS 4
+
+static StatsOptions stats_options = { .level = 1 };
+static gchar local_port[16];
+
+static void
+_find_free_udp_port(void)
+{
+  struct sockaddr_in sin = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t len = sizeof(sin);
+  gint fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  cr_assert(fd >= 0);
+  cr_assert(bind(fd, (struct sockaddr *) &sin, sizeof(sin)) == 0);
+  cr_assert(getsockname(fd, (struct sockaddr *) &sin, &len) == 0);
+  close(fd);
+
+  g_snprintf(local_port, sizeof(local_port), "%d", ntohs(sin.sin_port));
+}
+
+static GlobalConfig *
+_create_config(void)
+{
+  GlobalConfig *cfg = cfg_new_snippet();
+
+  cfg->persist = persist_config_new();
+  return cfg;
+}
+
+static void
+_free_config(GlobalConfig *cfg)
+{
+  /* releases the connections kept alive by the last deinit */
+  if (cfg->persist)
+    {
+      persist_config_free(cfg->persist);
+      cfg->persist = NULL;
+    }
+  cfg_free(cfg);
+}
+
+static AFSocketSourceDriver *
+_create_udp_source(GlobalConfig *cfg, gint shards)
+{
+  AFInetSourceDriver *driver = afinet_sd_new_udp(cfg);
+  LogDriver *d = &driver->super.super.super;
+
+  d->id = g_strdup("s_udp");
+  afinet_sd_set_localip(d, "127.0.0.1");
+  afinet_sd_set_localport(d, local_port);
+  afsocket_sd_set_reuseport_shards(d, shards);
+
+  cr_assert(log_pipe_init(&d->super), "udp source failed to initialize");
+  return &driver->super;
+}
+
+static void
+_destroy_udp_source(AFSocketSourceDriver *self)
+{
+  log_pipe_deinit(&self->super.super.super);
+  log_pipe_unref(&self->super.super.super);
+}
+
+static gboolean
+_shard_counter_exists(const gchar *instance)
+{
+  StatsClusterKey sc_key;
+  gboolean result;
+
+  stats_lock();
+  stats_cluster_logpipe_key_set(&sc_key, stats_register_type("udp") | SCS_SOURCE, "s_udp", instance);
+  result = stats_contains_counter(&sc_key, SC_TYPE_PROCESSED);
+  stats_unlock();
+
+  return result;
+}
+
+Test(afsocket_source_reuseport, test_each_shard_gets_its_own_connection)
+{
+  GlobalConfig *cfg = _create_config();
+  AFSocketSourceDriver *source = _create_udp_source(cfg, NUM_SHARDS);
+
+  cr_assert_eq(g_list_length(source->connections), NUM_SHARDS);
+  cr_assert(source->socket_options->so_reuseport);
+
+  _destroy_udp_source(source);
+  _free_config(cfg);
+}
+
+Test(afsocket_source_reuseport, test_stats_instance_is_suffixed_by_the_shard_index)
+{
+  GlobalConfig *cfg = _create_config();
+  AFSocketSourceDriver *source = _create_udp_source(cfg, NUM_SHARDS);
+  gchar instance[64];
+
+  for (gint i = 0; i < NUM_SHARDS; i++)
+    {
+      g_snprintf(instance, sizeof(instance), "127.0.0.1#%d", i);
+      cr_assert(_shard_counter_exists(instance), "missing counter for shard %s", instance);
+    }
+  g_snprintf(instance, sizeof(instance), "127.0.0.1#%d", NUM_SHARDS);
+  cr_assert_not(_shard_counter_exists(instance));
+  cr_assert_not(_shard_counter_exists("127.0.0.1"));
+
+  _destroy_udp_source(source);
+  _free_config(cfg);
+}
+
+Test(afsocket_source_reuseport, test_unsharded_source_has_a_single_connection)
+{
+  GlobalConfig *cfg = _create_config();
+  AFSocketSourceDriver *source = _create_udp_source(cfg, 1);
+
+  cr_assert_eq(g_list_length(source->connections), 1);
+  cr_assert(_shard_counter_exists("127.0.0.1"));
+
+  _destroy_udp_source(source);
+  _free_config(cfg);
+}
+
+/* the extra references keep the old connections from being freed, so their
+ * addresses cannot be reused by the connections opened after the reload */
+static GList *
+_ref_connections(AFSocketSourceDriver *self)
+{
+  GList *connections = g_list_copy(self->connections);
+
+  g_list_foreach(connections, (GFunc) log_pipe_ref, NULL);
+  return connections;
+}
+
+static void
+_unref_connections(GList *connections)
+{
+  g_list_free_full(connections, (GDestroyNotify) log_pipe_unref);
+}
+
+static AFSocketSourceDriver *
+_reload_udp_source(AFSocketSourceDriver *old_source, GlobalConfig *old_cfg, GlobalConfig *new_cfg, gint shards)
+{
+  _destroy_udp_source(old_source);
+  cfg_persist_config_move(old_cfg, new_cfg);
+  return _create_udp_source(new_cfg, shards);
+}
+
+Test(afsocket_source_reuseport, test_connections_are_kept_alive_across_reload)
+{
+  GlobalConfig *old_cfg = _create_config();
+  GlobalConfig *new_cfg = cfg_new_snippet();
+  AFSocketSourceDriver *source = _create_udp_source(old_cfg, NUM_SHARDS);
+  GList *old_connections = _ref_connections(source);
+
+  source = _reload_udp_source(source, old_cfg, new_cfg, NUM_SHARDS);
+
+  cr_assert_eq(g_list_length(source->connections), NUM_SHARDS);
+  for (GList *l = old_connections; l; l = l->next)
+    cr_assert(g_list_find(source->connections, l->data), "kept-alive shard connection was not reused");
+
+  _unref_connections(old_connections);
+  _destroy_udp_source(source);
+  _free_config(old_cfg);
+  _free_config(new_cfg);
+}
+
+Test(afsocket_source_reuseport, test_connections_are_reopened_when_the_number_of_shards_changes)
+{
+  GlobalConfig *old_cfg = _create_config();
+  GlobalConfig *new_cfg = cfg_new_snippet();
+  AFSocketSourceDriver *source = _create_udp_source(old_cfg, NUM_SHARDS);
+  GList *old_connections = _ref_connections(source);
+
+  source = _reload_udp_source(source, old_cfg, new_cfg, NUM_SHARDS / 2);
+
+  cr_assert_eq(g_list_length(source->connections), NUM_SHARDS / 2);
+  for (GList *l = old_connections; l; l = l->next)
+    cr_assert_not(g_list_find(source->connections, l->data), "connection of the old shard layout was reused");
+
+  _unref_connections(old_connections);
+  _destroy_udp_source(source);
+  _free_config(old_cfg);
+  _free_config(new_cfg);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  stats_reinit(&stats_options);
+  _find_free_udp_port();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(afsocket_source_reuseport, .init = setup, .fini = teardown);
@@ -1221,6 +1221,7 @@ afsql_dd_new(GlobalConfig *cfg)
   self->dbd_options_numeric = g_hash_table_new_full(g_str_hash, g_int_equal, g_free, NULL);
 
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
   self->super.stats_source = stats_register_type("sql");
 
   return &self->super.super.super;
@@ -400,6 +400,7 @@ afstomp_dd_new(GlobalConfig *cfg)
   afstomp_dd_set_ack((LogDriver *) self, FALSE);
 
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
   afstomp_dd_set_value_pairs(&self->super.super.super, value_pairs_new_default(cfg));
 
   return (LogDriver *) self;
@@ -150,14 +150,23 @@ csv_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_o
   if (self->prefix)
     g_string_assign(key_scratch, self->prefix);
 
+  LogParserInput parser_input;
+  log_parser_input_init(&parser_input, s, msg, input, input_len);
+
   key_formatter_t _key_formatter = dispatch_key_formatter(self->prefix);
   while (csv_scanner_scan_next(&scanner))
     {
-
-      log_msg_set_value_by_name(msg,
-                                _key_formatter(key_scratch, csv_scanner_get_current_name(&scanner), self->prefix_len),
-                                csv_scanner_get_current_value(&scanner),
-                                csv_scanner_get_current_value_len(&scanner));
+      NVHandle handle = log_msg_get_value_handle(_key_formatter(key_scratch, csv_scanner_get_current_name(&scanner),
+                                                                self->prefix_len));
+      gsize ofs, len;
+
+      /* columns that were not unescaped are passed as parts of the input */
+      if (csv_scanner_get_current_value_slice(&scanner, &ofs, &len))
+        log_parser_input_set_value(&parser_input, msg, handle, input + ofs, len);
+      else
+        log_parser_input_set_value(&parser_input, msg, handle,
+                                   csv_scanner_get_current_value(&scanner),
+                                   csv_scanner_get_current_value_len(&scanner));
     }
 
   gboolean result = TRUE;
@@ -944,6 +944,40 @@ ParameterizedTest(CsvParserTestParam *param, parser, test_csv_parser)
   log_msg_unref(logmsg);
 }
 
+static void
+_assert_value_equals(LogMessage *logmsg, const gchar *name, const gchar *expected_value)
+{
+  gssize value_len;
+  const gchar *value = log_msg_get_value_by_name(logmsg, name, &value_len);
+
+  cr_assert(value_len == strlen(expected_value) && strncmp(value, expected_value, value_len) == 0,
+            "value mismatch; name=%s, value=%.*s, expected_value=%s", name, (int) value_len, value, expected_value);
+}
+
+Test(parser, columns_referencing_message_survive_when_message_is_a_column)
+{
+  const gchar *columns[] = { "C1", "MESSAGE", "C3", NULL };
+  const gchar *msg = "<15> openvpn[2499]: foo,bar,\"baz\"";
+  LogMessage *logmsg;
+  LogParser *p;
+
+  logmsg = log_msg_new(msg, strlen(msg), &parse_options);
+
+  p = csv_parser_new(NULL);
+  csv_scanner_options_set_delimiters(csv_parser_get_scanner_options(p), ",");
+  csv_scanner_options_set_quote_pairs(csv_parser_get_scanner_options(p), "\"\"");
+  csv_scanner_options_set_columns(csv_parser_get_scanner_options(p), string_array_to_list(columns));
+
+  cr_assert(log_parser_process(p, &logmsg, NULL, log_msg_get_value(logmsg, LM_V_MESSAGE, NULL), -1));
+
+  _assert_value_equals(logmsg, "C1", "foo");
+  _assert_value_equals(logmsg, "MESSAGE", "bar");
+  _assert_value_equals(logmsg, "C3", "baz");
+
+  log_pipe_unref(&p->super);
+  log_msg_unref(logmsg);
+}
+
 void setup(void)
 {
   app_startup();
@@ -94,3 +94,32 @@ Test(test_filters_statistics, filter_stastistics)
   cfg_free(configuration);
   app_shutdown();
 }
+
+Test(test_filters_statistics, indirect_bytes_saved_counts_columns_referencing_the_message)
+{
+  const gchar *column_array[] = { "header1", "header2", NULL };
+
+  app_startup();
+  configuration = cfg_new_snippet();
+  configuration->stats_options.level = 1;
+  cr_assert(cfg_init(configuration));
+
+  LogParser *parser = csv_parser_new(configuration);
+  csv_scanner_options_set_delimiters(csv_parser_get_scanner_options(parser), ",");
+  csv_scanner_options_set_columns(csv_parser_get_scanner_options(parser), string_array_to_list(column_array));
+  cr_assert(log_pipe_init(&parser->super));
+
+  cr_assert_eq(stats_counter_get(parser->indirect_bytes_saved), 0);
+  _parse_msg(parser, "column1,\"column2\"");
+  cr_assert_eq(stats_counter_get(parser->indirect_bytes_saved), 14);
+
+  /* the second column is not a verbatim part of the message */
+  _parse_msg(parser, "column1,\"col\"\"umn2\"");
+  cr_assert_eq(stats_counter_get(parser->indirect_bytes_saved), 21);
+
+  log_pipe_deinit(&parser->super);
+  log_pipe_unref(&parser->super);
+  cfg_deinit(configuration);
+  cfg_free(configuration);
+  app_shutdown();
+}
@@ -48,6 +48,10 @@ static NVHandle context_id_handle = 0;
 
 #define EXPECTED_NUMBER_OF_MESSAGES_EMITTED 32
 
+/* the correlation state is split into this many independently locked partitions */
+#define PATTERN_DB_SHARD_BITS 4
+#define PATTERN_DB_NUM_SHARDS (1 << PATTERN_DB_SHARD_BITS)
+
 typedef struct _PDBProcessParams
 {
   PDBRule *rule;
@@ -57,16 +61,38 @@ typedef struct _PDBProcessParams
   gpointer emitted_messages[EXPECTED_NUMBER_OF_MESSAGES_EMITTED];
   GPtrArray *emitted_messages_overflow;
   gint num_emitted_messages;
+  /* contexts created by create-context actions, stored once no shard is locked */
+  GPtrArray *created_contexts;
 } PDBProcessParams;
 
+/* Correlation contexts, their timers and the rate limit states are
+ * partitioned by the hash of their CorrelationKey, each partition has its
+ * own lock.  The rate limits have a separate lock, as they are looked up
+ * while the shard of the context is already locked.
+ *
+ * A thread never holds the lock of more than one shard at a time. */
+typedef struct _PDBCorrelationShard
+{
+  GStaticMutex lock;
+  CorrelationState correlation;
+  TimerWheel *timer_wheel;
+
+  GStaticMutex rate_limits_lock;
+  GHashTable *rate_limits;
+} PDBCorrelationShard;
+
 struct _PatternDB
 {
+  /* protects the ruleset */
   GStaticRWLock lock;
   PDBRuleSet *ruleset;
-  CorrelationState correlation;
+  PDBCorrelationShard shards[PATTERN_DB_NUM_SHARDS];
   LogTemplate *program_template;
-  GHashTable *rate_limits;
-  TimerWheel *timer_wheel;
+
+  /* the current time of the correlation engine, the timer wheels of the
+   * shards are moved to this time one by one */
+  GStaticMutex time_lock;
+  guint64 now;
   GTimeVal last_tick;
 
   PatternDBEmitFunc emit;
@@ -191,40 +217,50 @@ _flush_emitted_messages(PatternDB *self, PDBProcessParams *process_params)
 
 
 /*********************************************
- * Rule evaluation
+ * Correlation state
  *********************************************/
 
-static gboolean
-_is_action_within_rate_limit(PatternDB *db, PDBProcessParams *process_params)
+static PDBCorrelationShard *
+_get_shard(PatternDB *self, CorrelationKey *key)
 {
-  PDBRule *rule = process_params->rule;
-  PDBAction *action = process_params->action;
-  LogMessage *msg = process_params->msg;
-  GString *buffer = g_string_sized_new(256);
+  /* the upper bits of the multiplicative hash are mixed best */
+  guint32 hash = correlation_key_hash(key) * 2654435761U;
 
-  CorrelationKey key;
-  PDBRateLimit *rl;
+  return &self->shards[hash >> (32 - PATTERN_DB_SHARD_BITS)];
+}
+
+static guint64
+_get_time(PatternDB *self)
+{
   guint64 now;
 
-  if (action->rate == 0)
-    return TRUE;
+  g_static_mutex_lock(&self->time_lock);
+  now = self->now;
+  g_static_mutex_unlock(&self->time_lock);
+  return now;
+}
 
-  g_string_printf(buffer, "%s:%d", rule->rule_id, action->id);
-  correlation_key_init(&key, rule->context.scope, msg, buffer->str);
+/* The timer wheel of a shard lags behind the time of the correlation
+ * engine until the thread advancing the time gets to it, timeouts are
+ * extended by this lag, so that they are measured from the current time. */
+static gint
+_get_shard_timeout(PatternDB *self, PDBCorrelationShard *shard, gint timeout)
+{
+  guint64 now = _get_time(self);
+  guint64 shard_now = timer_wheel_get_time(shard->timer_wheel);
 
-  rl = g_hash_table_lookup(db->rate_limits, &key);
-  if (!rl)
-    {
-      rl = pdb_rate_limit_new(&key);
-      g_hash_table_insert(db->rate_limits, &rl->key, rl);
-      g_string_free(buffer, FALSE);
-    }
-  else
-    {
-      g_string_free(buffer, TRUE);
-    }
+  if (now > shard_now)
+    timeout += now - shard_now;
+  return timeout;
+}
 
-  now = timer_wheel_get_time(db->timer_wheel);
+/*********************************************
+ * Rule evaluation
+ *********************************************/
+
+static gboolean
+_consume_rate_limit_credit(PDBRateLimit *rl, PDBAction *action, guint64 now)
+{
   if (rl->last_check == 0)
     {
       rl->last_check = now;
@@ -253,6 +289,46 @@ _is_action_within_rate_limit(PatternDB *db, PDBProcessParams *process_params)
   return FALSE;
 }
 
+static gboolean
+_is_action_within_rate_limit(PatternDB *db, PDBProcessParams *process_params)
+{
+  PDBRule *rule = process_params->rule;
+  PDBAction *action = process_params->action;
+  LogMessage *msg = process_params->msg;
+  PDBCorrelationShard *shard;
+  GString *buffer;
+  CorrelationKey key;
+  PDBRateLimit *rl;
+  guint64 now;
+  gboolean result;
+
+  if (action->rate == 0)
+    return TRUE;
+
+  buffer = g_string_sized_new(256);
+  g_string_printf(buffer, "%s:%d", rule->rule_id, action->id);
+  correlation_key_init(&key, rule->context.scope, msg, buffer->str);
+
+  now = _get_time(db);
+  shard = _get_shard(db, &key);
+  g_static_mutex_lock(&shard->rate_limits_lock);
+  rl = g_hash_table_lookup(shard->rate_limits, &key);
+  if (!rl)
+    {
+      rl = pdb_rate_limit_new(&key);
+      g_hash_table_insert(shard->rate_limits, &rl->key, rl);
+      g_string_free(buffer, FALSE);
+    }
+  else
+    {
+      g_string_free(buffer, TRUE);
+    }
+
+  result = _consume_rate_limit_credit(rl, action, now);
+  g_static_mutex_unlock(&shard->rate_limits_lock);
+  return result;
+}
+
 static gboolean
 _is_action_triggered(PatternDB *db, PDBProcessParams *process_params, PDBActionTrigger trigger)
 {
@@ -339,19 +415,53 @@ _execute_action_create_context(PatternDB *db, PDBProcessParams *process_params)
             evt_tag_str("rule", rule->rule_id),
             evt_tag_str("context", buffer->str),
             evt_tag_int("context_timeout", syn_context->timeout),
-            evt_tag_int("context_expiration", timer_wheel_get_time(db->timer_wheel) + syn_context->timeout));
+            evt_tag_int("context_expiration", _get_time(db) + syn_context->timeout));
 
   correlation_key_init(&key, syn_context->scope, context_msg, buffer->str);
   new_context = pdb_context_new(&key);
-  g_hash_table_insert(db->correlation.state, &new_context->super.key, new_context);
   g_string_free(buffer, FALSE);
 
   g_ptr_array_add(new_context->super.messages, context_msg);
+  new_context->rule = pdb_rule_ref(rule);
 
-  new_context->super.timer = timer_wheel_add_timer(db->timer_wheel, rule->context.timeout, pattern_db_expire_entry,
-                                                   correlation_context_ref(&new_context->super),
+  /* the new context may belong to a different shard than the one locked
+   * right now, it is stored by _store_created_contexts() */
+  if (!process_params->created_contexts)
+    process_params->created_contexts = g_ptr_array_new();
+  g_ptr_array_add(process_params->created_contexts, new_context);
+}
+
+/* must be called without holding the lock of any of the shards */
+static void
+_store_created_contexts(PatternDB *self, PDBProcessParams *process_params)
+{
+  if (!process_params->created_contexts)
+    return;
+
+  for (gint i = 0; i < process_params->created_contexts->len; i++)
+    {
+      PDBContext *context = g_ptr_array_index(process_params->created_contexts, i);
+      PDBCorrelationShard *shard = _get_shard(self, &context->super.key);
+
+      g_static_mutex_lock(&shard->lock);
+      g_hash_table_insert(shard->correlation.state, &context->super.key, context);
+      context->super.timer = timer_wheel_add_timer(shard->timer_wheel,
+                                                   _get_shard_timeout(self, shard, context->rule->context.timeout),
+                                                   pattern_db_expire_entry,
+                                                   correlation_context_ref(&context->super),
                                                    (GDestroyNotify) correlation_context_unref);
-  new_context->rule = pdb_rule_ref(rule);
+      g_static_mutex_unlock(&shard->lock);
+    }
+  g_ptr_array_free(process_params->created_contexts, TRUE);
+  process_params->created_contexts = NULL;
+}
+
+/* This is called at the end of processing, once all the locks are released. */
+static void
+_finish_processing(PatternDB *self, PDBProcessParams *process_params)
+{
+  _store_created_contexts(self, process_params);
+  _flush_emitted_messages(self, process_params);
 }
 
 static void
@@ -403,8 +513,8 @@ _execute_rule_actions(PatternDB *db, PDBProcessParams *process_params, PDBAction
  * PatternDB
  *********************************************************/
 
-/* NOTE: this function requires PatternDB reader/writer lock to be
- * write-locked.
+/* NOTE: this function requires the shard owning the timer wheel to be
+ * locked.
  *
  * Currently, it is, as timer_wheel_set_time() is only called with that
  * precondition, and timer-wheel callbacks are only called from within
@@ -421,19 +531,48 @@ pattern_db_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data, gpoi
 
   msg_debug("Expiring patterndb correlation context",
             evt_tag_str("last_rule", context->rule->rule_id),
-            evt_tag_long("utc", timer_wheel_get_time(pdb->timer_wheel)));
+            evt_tag_long("utc", now));
   process_params->context = context;
   process_params->rule = context->rule;
   process_params->msg = msg;
 
   _execute_rule_actions(pdb, process_params, RAT_TIMEOUT);
-  g_hash_table_remove(pdb->correlation.state, &context->super.key);
+  g_hash_table_remove(_get_shard(pdb, &context->super.key)->correlation.state, &context->super.key);
 
   /* pdb_context_free is automatically called when returning from
      this function by the timerwheel code as a destroy notify
      callback. */
 }
 
+/* Moves the timer wheels of all shards to the current time, expiring the
+ * contexts that timed out.  Must be called without holding any locks. */
+static void
+_advance_shards(PatternDB *self, PDBProcessParams *process_params)
+{
+  guint64 now = _get_time(self);
+
+  for (gint i = 0; i < PATTERN_DB_NUM_SHARDS; i++)
+    {
+      PDBCorrelationShard *shard = &self->shards[i];
+
+      g_static_mutex_lock(&shard->lock);
+      timer_wheel_set_time(shard->timer_wheel, now, process_params);
+      g_static_mutex_unlock(&shard->lock);
+    }
+}
+
+/* must be called with time_lock held, returns TRUE if the time was moved forward */
+static gboolean
+_set_time(PatternDB *self, guint64 new_now)
+{
+  /* time is not allowed to go backwards */
+  if (new_now <= self->now)
+    return FALSE;
+
+  self->now = new_now;
+  return TRUE;
+}
+
 /*
  * This function can be called any time when pattern-db is not processing
  * messages, but we expect the correlation timer to move forward.  It
@@ -447,9 +586,10 @@ pattern_db_timer_tick(PatternDB *self)
 {
   GTimeVal now;
   glong diff;
+  gboolean advanced = FALSE;
   PDBProcessParams process_params = {0};
 
-  g_static_rw_lock_writer_lock(&self->lock);
+  g_static_mutex_lock(&self->time_lock);
   cached_g_current_time(&now);
   diff = g_time_val_diff(&now, &self->last_tick);
 
@@ -457,9 +597,9 @@ pattern_db_timer_tick(PatternDB *self)
     {
       glong diff_sec = (glong) (diff / 1e6);
 
-      timer_wheel_set_time(self->timer_wheel, timer_wheel_get_time(self->timer_wheel) + diff_sec, &process_params);
+      advanced = _set_time(self, self->now + diff_sec);
       msg_debug("Advancing patterndb current time because of timer tick",
-                evt_tag_long("utc", timer_wheel_get_time(self->timer_wheel)));
+                evt_tag_long("utc", self->now));
       /* update last_tick, take the fraction of the seconds not calculated into this update into account */
 
       self->last_tick = now;
@@ -474,15 +614,20 @@ pattern_db_timer_tick(PatternDB *self)
       self->last_tick = now;
     }
 
-  g_static_rw_lock_writer_unlock(&self->lock);
-  _flush_emitted_messages(self, &process_params);
+  g_static_mutex_unlock(&self->time_lock);
+
+  if (advanced)
+    _advance_shards(self, &process_params);
+  _finish_processing(self, &process_params);
 }
 
-/* NOTE: lock should be acquired for writing before calling this function. */
-static void
-_advance_time_based_on_message(PatternDB *self, PDBProcessParams *process_params, const UnixTime *ls)
+/* NOTE: time_lock should be acquired before calling this function, returns
+ * TRUE if the time of the correlation engine was moved forward. */
+static gboolean
+_advance_time_based_on_message(PatternDB *self, const UnixTime *ls)
 {
   GTimeVal now;
+  gboolean advanced;
 
   /* clamp the current time between the timestamp of the current message
    * (low limit) and the current system time (high limit).  This ensures
@@ -495,23 +640,26 @@ _advance_time_based_on_message(PatternDB *self, PDBProcessParams *process_params
   if (ls->ut_sec < now.tv_sec)
     now.tv_sec = ls->ut_sec;
 
-  timer_wheel_set_time(self->timer_wheel, now.tv_sec, process_params);
+  advanced = _set_time(self, now.tv_sec);
 
   msg_debug("Advancing patterndb current time because of an incoming message",
-            evt_tag_long("utc", timer_wheel_get_time(self->timer_wheel)));
+            evt_tag_long("utc", self->now));
+  return advanced;
 }
 
 void
 pattern_db_advance_time(PatternDB *self, gint timeout)
 {
   PDBProcessParams process_params= {0};
-  time_t new_time;
+  gboolean advanced;
+
+  g_static_mutex_lock(&self->time_lock);
+  advanced = _set_time(self, self->now + timeout);
+  g_static_mutex_unlock(&self->time_lock);
 
-  g_static_rw_lock_writer_lock(&self->lock);
-  new_time = timer_wheel_get_time(self->timer_wheel) + timeout;
-  timer_wheel_set_time(self->timer_wheel, new_time, &process_params);
-  g_static_rw_lock_writer_unlock(&self->lock);
-  _flush_emitted_messages(self, &process_params);
+  if (advanced)
+    _advance_shards(self, &process_params);
+  _finish_processing(self, &process_params);
 }
 
 gboolean
@@ -575,33 +723,40 @@ _pattern_db_is_empty(PatternDB *self)
   return (G_UNLIKELY(!self->ruleset) || self->ruleset->is_empty);
 }
 
+/* Rules without a context don't touch the correlation state, only the
+ * shard of the context is locked while a rule with a context is processed. */
 static void
 _pattern_db_process_matching_rule(PatternDB *self, PDBProcessParams *process_params)
 {
+  PDBCorrelationShard *shard = NULL;
   PDBContext *context = NULL;
   PDBRule *rule = process_params->rule;
   LogMessage *msg = process_params->msg;
   GString *buffer = g_string_sized_new(32);
 
-  g_static_rw_lock_writer_lock(&self->lock);
   if (rule->context.id_template)
     {
       CorrelationKey key;
+      gint timeout;
 
       log_template_format(rule->context.id_template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer);
       log_msg_set_value(msg, context_id_handle, buffer->str, -1);
 
       correlation_key_init(&key, rule->context.scope, msg, buffer->str);
-      context = g_hash_table_lookup(self->correlation.state, &key);
+      shard = _get_shard(self, &key);
+
+      g_static_mutex_lock(&shard->lock);
+      timeout = _get_shard_timeout(self, shard, rule->context.timeout);
+      context = g_hash_table_lookup(shard->correlation.state, &key);
       if (!context)
         {
           msg_debug("Correlation context lookup failure, starting a new context",
                     evt_tag_str("rule", rule->rule_id),
                     evt_tag_str("context", buffer->str),
                     evt_tag_int("context_timeout", rule->context.timeout),
-                    evt_tag_int("context_expiration", timer_wheel_get_time(self->timer_wheel) + rule->context.timeout));
+                    evt_tag_int("context_expiration", timer_wheel_get_time(shard->timer_wheel) + timeout));
           context = pdb_context_new(&key);
-          g_hash_table_insert(self->correlation.state, &context->super.key, context);
+          g_hash_table_insert(shard->correlation.state, &context->super.key, context);
           g_string_steal(buffer);
         }
       else
@@ -610,7 +765,7 @@ _pattern_db_process_matching_rule(PatternDB *self, PDBProcessParams *process_par
                     evt_tag_str("rule", rule->rule_id),
                     evt_tag_str("context", buffer->str),
                     evt_tag_int("context_timeout", rule->context.timeout),
-                    evt_tag_int("context_expiration", timer_wheel_get_time(self->timer_wheel) + rule->context.timeout),
+                    evt_tag_int("context_expiration", timer_wheel_get_time(shard->timer_wheel) + timeout),
                     evt_tag_int("num_messages", context->super.messages->len));
         }
 
@@ -618,11 +773,11 @@ _pattern_db_process_matching_rule(PatternDB *self, PDBProcessParams *process_par
 
       if (context->super.timer)
         {
-          timer_wheel_mod_timer(self->timer_wheel, context->super.timer, rule->context.timeout);
+          timer_wheel_mod_timer(shard->timer_wheel, context->super.timer, timeout);
         }
       else
         {
-          context->super.timer = timer_wheel_add_timer(self->timer_wheel, rule->context.timeout, pattern_db_expire_entry,
+          context->super.timer = timer_wheel_add_timer(shard->timer_wheel, timeout, pattern_db_expire_entry,
                                                        correlation_context_ref(&context->super),
                                                        (GDestroyNotify) correlation_context_unref);
         }
@@ -645,8 +800,9 @@ _pattern_db_process_matching_rule(PatternDB *self, PDBProcessParams *process_par
   _emit_message(self, process_params, FALSE, msg);
   _execute_rule_actions(self, process_params, RAT_MATCH);
 
+  if (shard)
+    g_static_mutex_unlock(&shard->lock);
   pdb_rule_unref(rule);
-  g_static_rw_lock_writer_unlock(&self->lock);
 
   if (context)
     log_msg_write_protect(msg);
@@ -658,11 +814,16 @@ static void
 _pattern_db_advance_time_and_flush_expired(PatternDB *self, LogMessage *msg)
 {
   PDBProcessParams process_params = {0};
+  gboolean advanced;
+
+  g_static_mutex_lock(&self->time_lock);
+  advanced = _advance_time_based_on_message(self, &msg->timestamps[LM_TS_STAMP]);
+  g_static_mutex_unlock(&self->time_lock);
 
-  g_static_rw_lock_writer_lock(&self->lock);
-  _advance_time_based_on_message(self, &process_params, &msg->timestamps[LM_TS_STAMP]);
-  g_static_rw_lock_writer_unlock(&self->lock);
-  _flush_emitted_messages(self, &process_params);
+  /* the shards only need to be visited when the time moves to the next second */
+  if (advanced)
+    _advance_shards(self, &process_params);
+  _finish_processing(self, &process_params);
 }
 
 static void
@@ -696,7 +857,7 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
   else
     _pattern_db_process_unmatching_rule(self, process_params);
 
-  _flush_emitted_messages(self, process_params);
+  _finish_processing(self, process_params);
 
   return process_params->rule != NULL;
 }
@@ -734,40 +895,52 @@ pattern_db_expire_state(PatternDB *self)
 {
   PDBProcessParams process_params = {0};
 
-  g_static_rw_lock_writer_lock(&self->lock);
-  timer_wheel_expire_all(self->timer_wheel, &process_params);
-  g_static_rw_lock_writer_unlock(&self->lock);
-  _flush_emitted_messages(self, &process_params);
+  for (gint i = 0; i < PATTERN_DB_NUM_SHARDS; i++)
+    {
+      PDBCorrelationShard *shard = &self->shards[i];
 
+      g_static_mutex_lock(&shard->lock);
+      timer_wheel_expire_all(shard->timer_wheel, &process_params);
+      g_static_mutex_unlock(&shard->lock);
+    }
+  _finish_processing(self, &process_params);
 }
 
 static void
-_init_state(PatternDB *self)
+_init_shard_state(PatternDB *self, PDBCorrelationShard *shard)
 {
-  self->rate_limits = g_hash_table_new_full(correlation_key_hash, correlation_key_equal, NULL,
-                                            (GDestroyNotify) pdb_rate_limit_free);
-  correlation_state_init_instance(&self->correlation);
-  self->timer_wheel = timer_wheel_new();
-  timer_wheel_set_associated_data(self->timer_wheel, self, NULL);
+  shard->rate_limits = g_hash_table_new_full(correlation_key_hash, correlation_key_equal, NULL,
+                                             (GDestroyNotify) pdb_rate_limit_free);
+  correlation_state_init_instance(&shard->correlation);
+  shard->timer_wheel = timer_wheel_new();
+  timer_wheel_set_associated_data(shard->timer_wheel, self, NULL);
+  timer_wheel_set_time(shard->timer_wheel, _get_time(self), NULL);
 }
 
 static void
-_destroy_state(PatternDB *self)
+_destroy_shard_state(PDBCorrelationShard *shard)
 {
-  if (self->timer_wheel)
-    timer_wheel_free(self->timer_wheel);
+  if (shard->timer_wheel)
+    timer_wheel_free(shard->timer_wheel);
 
-  g_hash_table_destroy(self->rate_limits);
-  correlation_state_deinit_instance(&self->correlation);
+  g_hash_table_destroy(shard->rate_limits);
+  correlation_state_deinit_instance(&shard->correlation);
 }
 
 void
 pattern_db_forget_state(PatternDB *self)
 {
-  g_static_rw_lock_writer_lock(&self->lock);
-  _destroy_state(self);
-  _init_state(self);
-  g_static_rw_lock_writer_unlock(&self->lock);
+  for (gint i = 0; i < PATTERN_DB_NUM_SHARDS; i++)
+    {
+      PDBCorrelationShard *shard = &self->shards[i];
+
+      g_static_mutex_lock(&shard->lock);
+      g_static_mutex_lock(&shard->rate_limits_lock);
+      _destroy_shard_state(shard);
+      _init_shard_state(self, shard);
+      g_static_mutex_unlock(&shard->rate_limits_lock);
+      g_static_mutex_unlock(&shard->lock);
+    }
 }
 
 PatternDB *
@@ -776,8 +949,16 @@ pattern_db_new(void)
   PatternDB *self = g_new0(PatternDB, 1);
 
   self->ruleset = pdb_rule_set_new();
-  _init_state(self);
+  g_static_mutex_init(&self->time_lock);
   cached_g_current_time(&self->last_tick);
+  for (gint i = 0; i < PATTERN_DB_NUM_SHARDS; i++)
+    {
+      PDBCorrelationShard *shard = &self->shards[i];
+
+      g_static_mutex_init(&shard->lock);
+      g_static_mutex_init(&shard->rate_limits_lock);
+      _init_shard_state(self, shard);
+    }
   g_static_rw_lock_init(&self->lock);
   return self;
 }
@@ -788,7 +969,15 @@ pattern_db_free(PatternDB *self)
   log_template_unref(self->program_template);
   if (self->ruleset)
     pdb_rule_set_free(self->ruleset);
-  _destroy_state(self);
+  for (gint i = 0; i < PATTERN_DB_NUM_SHARDS; i++)
+    {
+      PDBCorrelationShard *shard = &self->shards[i];
+
+      _destroy_shard_state(shard);
+      g_static_mutex_free(&shard->rate_limits_lock);
+      g_static_mutex_free(&shard->lock);
+    }
+  g_static_mutex_free(&self->time_lock);
   g_static_rw_lock_free(&self->lock);
   g_free(self);
 }
@@ -46,6 +46,8 @@ pdb_action_set_condition(PDBAction *self, GlobalConfig *cfg, const gchar *filter
       self->condition = NULL;
       return;
     }
+  g_free(self->condition_source);
+  self->condition_source = g_strdup(filter_string);
 }
 
 void
@@ -103,6 +105,7 @@ pdb_action_free(PDBAction *self)
 {
   if (self->condition)
     filter_expr_unref(self->condition);
+  g_free(self->condition_source);
   switch (self->content_type)
     {
     case RAC_MESSAGE:
@@ -47,6 +47,8 @@ typedef enum
 typedef struct _PDBAction
 {
   FilterExprNode *condition;
+  /* the expression the condition was compiled from, stored in the cache */
+  gchar *condition_source;
   PDBActionTrigger trigger;
   PDBActionContentType content_type;
   guint32 rate_quantum;
@@ -0,0 +1,861 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "pdb-cache.h"
+#include "pdb-program.h"
+#include "pdb-error.h"
+#include "logmsg/tags.h"
+
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+/*
+ * File layout, all integers are stored in native byte order:
+ *
+ *   PDBCacheHeader, with the SHA-1 of the XML file and of the payload
+ *   string version, string pub_date, guint32 is_empty
+ *   guint32 num_rules, num_rules * rule
+ *   guint32 num_programs, num_programs * (string pdb_location, tree of rules)
+ *   tree of programs
+ *
+ * rule:    string rule_id, string class, context, message,
+ *          guint32 num_actions, num_actions * action
+ * action:  guint32 id, guint32 trigger, guint32 rate, guint32 rate_quantum,
+ *          string condition, guint32 content_type, message,
+ *          context (RAC_CREATE_CONTEXT only)
+ * message: guint32 inherit_mode, guint32 num_tags, num_tags * string tag,
+ *          guint32 num_values, num_values * (string name, string template)
+ * context: guint32 timeout, guint32 scope, string id_template
+ * tree:    string key, guint32 parser_type,
+ *          string value_name, string param (parser nodes only),
+ *          string pdb_location, guint32 value,
+ *          guint32 num_children, num_children * tree,
+ *          guint32 num_pchildren, num_pchildren * tree
+ *
+ * A string is a guint32 length followed by the characters and a
+ * terminating NUL, so that it can be used right from the mapped file, a
+ * NULL string is stored as a length of G_MAXUINT32.  The value of a tree
+ * node is the index of a rule or a program plus one, 0 if the node has no
+ * value.
+ */
+
+#define PDB_CACHE_MAGIC "PDBCACHE"
+#define PDB_CACHE_VERSION 3
+#define PDB_CACHE_BYTE_ORDER 0x01020304
+#define PDB_CACHE_NULL_STRING G_MAXUINT32
+#define PDB_CACHE_NO_PARSER G_MAXUINT32
+
+typedef struct _PDBCacheHeader
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 byte_order;
+  /* the XML file the cache was compiled from */
+  guint64 source_size;
+  gint64 source_mtime;
+  guint64 payload_size;
+  /* SHA-1 of the XML file and of the rest of the cache, in hex, NUL terminated */
+  gchar source_checksum[48];
+  gchar payload_checksum[48];
+} PDBCacheHeader;
+
+/* parser types as r_new_pnode() expects them, indexed by RPT_* */
+static const gchar *parser_type_names[] =
+{
+  [RPT_STRING] = "STRING",
+  [RPT_QSTRING] = "QSTRING",
+  [RPT_ESTRING] = "ESTRING",
+  [RPT_IPV4] = "IPv4",
+  [RPT_NUMBER] = "NUMBER",
+  [RPT_ANYSTRING] = "ANYSTRING",
+  [RPT_IPV6] = "IPv6",
+  [RPT_IP] = "IPvANY",
+  [RPT_FLOAT] = "FLOAT",
+  [RPT_SET] = "SET",
+  [RPT_MACADDR] = "MACADDR",
+  [RPT_PCRE] = "PCRE",
+  [RPT_EMAIL] = "EMAIL",
+  [RPT_HOSTNAME] = "HOSTNAME",
+  [RPT_LLADDR] = "LLADDR",
+  [RPT_NLSTRING] = "NLSTRING",
+  [RPT_OPTIONALSET] = "OPTIONALSET",
+};
+
+gchar *
+pdb_cache_get_filename(const gchar *source_filename)
+{
+  return g_strdup_printf("%s.cache", source_filename);
+}
+
+static gboolean
+_stat_source(const gchar *source_filename, struct stat *st, GError **error)
+{
+  if (stat(source_filename, st) < 0)
+    {
+      g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Error accessing %s: %s", source_filename, g_strerror(errno));
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static gchar *
+_compute_source_checksum(const gchar *source_filename, GError **error)
+{
+  GMappedFile *file = g_mapped_file_new(source_filename, FALSE, error);
+  gchar *checksum;
+
+  if (!file)
+    return NULL;
+
+  checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1,
+                                         (const guchar *) (g_mapped_file_get_contents(file) ? : ""),
+                                         g_mapped_file_get_length(file));
+  g_mapped_file_unref(file);
+  return checksum;
+}
+
+static gchar *
+_compute_payload_checksum(const gchar *payload, gsize payload_size)
+{
+  return g_compute_checksum_for_data(G_CHECKSUM_SHA1, (const guchar *) payload, payload_size);
+}
+
+/*********************************************************
+ * Writer
+ *********************************************************/
+
+typedef struct _PDBCacheWriter
+{
+  GString *buffer;
+  GPtrArray *rules;
+  GPtrArray *programs;
+  /* rule or program -> its index plus one */
+  GHashTable *indices;
+} PDBCacheWriter;
+
+static void
+_write_uint32(PDBCacheWriter *self, guint32 value)
+{
+  g_string_append_len(self->buffer, (const gchar *) &value, sizeof(value));
+}
+
+static void
+_write_string(PDBCacheWriter *self, const gchar *str)
+{
+  gsize len;
+
+  if (!str)
+    {
+      _write_uint32(self, PDB_CACHE_NULL_STRING);
+      return;
+    }
+
+  len = strlen(str);
+  _write_uint32(self, len);
+  g_string_append_len(self->buffer, str, len);
+  g_string_append_c(self->buffer, 0);
+}
+
+static void
+_collect_values(PDBCacheWriter *self, RNode *node, GPtrArray *values)
+{
+  if (node->value && !g_hash_table_lookup(self->indices, node->value))
+    {
+      g_ptr_array_add(values, node->value);
+      g_hash_table_insert(self->indices, node->value, GUINT_TO_POINTER(values->len));
+    }
+
+  for (gint i = 0; i < node->num_children; i++)
+    _collect_values(self, node->children[i], values);
+  for (gint i = 0; i < node->num_pchildren; i++)
+    _collect_values(self, node->pchildren[i], values);
+}
+
+static void
+_write_tree(PDBCacheWriter *self, RNode *node)
+{
+  _write_string(self, node->key);
+  if (node->parser)
+    {
+      _write_uint32(self, node->parser->type);
+      _write_string(self, node->parser->handle ? log_msg_get_value_name(node->parser->handle, NULL) : NULL);
+      _write_string(self, node->parser->param);
+    }
+  else
+    {
+      _write_uint32(self, PDB_CACHE_NO_PARSER);
+    }
+  _write_string(self, node->pdb_location);
+  _write_uint32(self, node->value ? GPOINTER_TO_UINT(g_hash_table_lookup(self->indices, node->value)) : 0);
+
+  _write_uint32(self, node->num_children);
+  for (gint i = 0; i < node->num_children; i++)
+    _write_tree(self, node->children[i]);
+  _write_uint32(self, node->num_pchildren);
+  for (gint i = 0; i < node->num_pchildren; i++)
+    _write_tree(self, node->pchildren[i]);
+}
+
+static void
+_write_message(PDBCacheWriter *self, SyntheticMessage *message)
+{
+  _write_uint32(self, message->inherit_mode);
+
+  _write_uint32(self, message->tags ? message->tags->len : 0);
+  for (gint i = 0; message->tags && i < message->tags->len; i++)
+    _write_string(self, log_tags_get_by_id(g_array_index(message->tags, LogTagId, i)));
+
+  _write_uint32(self, message->values ? message->values->len : 0);
+  for (gint i = 0; message->values && i < message->values->len; i++)
+    {
+      LogTemplate *value = (LogTemplate *) g_ptr_array_index(message->values, i);
+
+      _write_string(self, value->name);
+      _write_string(self, value->template);
+    }
+}
+
+static void
+_write_context(PDBCacheWriter *self, SyntheticContext *context)
+{
+  _write_uint32(self, context->timeout);
+  _write_uint32(self, context->scope);
+  _write_string(self, context->id_template ? context->id_template->template : NULL);
+}
+
+static void
+_write_action(PDBCacheWriter *self, PDBAction *action)
+{
+  _write_uint32(self, action->id);
+  _write_uint32(self, action->trigger);
+  _write_uint32(self, action->rate);
+  _write_uint32(self, action->rate_quantum);
+  _write_string(self, action->condition_source);
+  _write_uint32(self, action->content_type);
+
+  switch (action->content_type)
+    {
+    case RAC_MESSAGE:
+      _write_message(self, &action->content.message);
+      break;
+    case RAC_CREATE_CONTEXT:
+      _write_message(self, &action->content.create_context.message);
+      _write_context(self, &action->content.create_context.context);
+      break;
+    default:
+      break;
+    }
+}
+
+static void
+_write_rule(PDBCacheWriter *self, PDBRule *rule)
+{
+  _write_string(self, rule->rule_id);
+  _write_string(self, rule->class);
+  _write_context(self, &rule->context);
+  _write_message(self, &rule->msg);
+
+  _write_uint32(self, rule->actions ? rule->actions->len : 0);
+  for (gint i = 0; rule->actions && i < rule->actions->len; i++)
+    _write_action(self, (PDBAction *) g_ptr_array_index(rule->actions, i));
+}
+
+static void
+_write_ruleset(PDBCacheWriter *self, PDBRuleSet *rule_set)
+{
+  _collect_values(self, rule_set->programs, self->programs);
+  for (gint i = 0; i < self->programs->len; i++)
+    {
+      PDBProgram *program = (PDBProgram *) g_ptr_array_index(self->programs, i);
+
+      _collect_values(self, program->rules, self->rules);
+    }
+
+  _write_string(self, rule_set->version);
+  _write_string(self, rule_set->pub_date);
+  _write_uint32(self, rule_set->is_empty);
+
+  _write_uint32(self, self->rules->len);
+  for (gint i = 0; i < self->rules->len; i++)
+    _write_rule(self, (PDBRule *) g_ptr_array_index(self->rules, i));
+
+  _write_uint32(self, self->programs->len);
+  for (gint i = 0; i < self->programs->len; i++)
+    {
+      PDBProgram *program = (PDBProgram *) g_ptr_array_index(self->programs, i);
+
+      _write_string(self, program->pdb_location);
+      _write_tree(self, program->rules);
+    }
+
+  _write_tree(self, rule_set->programs);
+}
+
+gboolean
+pdb_cache_save(PDBRuleSet *rule_set, const gchar *source_filename, const gchar *cache_filename,
+               GError **error)
+{
+  PDBCacheWriter writer;
+  PDBCacheHeader header = { 0 };
+  struct stat st;
+  gchar *checksum;
+  gboolean success;
+
+  if (!_stat_source(source_filename, &st, error))
+    return FALSE;
+
+  checksum = _compute_source_checksum(source_filename, error);
+  if (!checksum)
+    return FALSE;
+  g_strlcpy(header.source_checksum, checksum, sizeof(header.source_checksum));
+  g_free(checksum);
+
+  writer.buffer = g_string_sized_new(65536);
+  writer.rules = g_ptr_array_new();
+  writer.programs = g_ptr_array_new();
+  writer.indices = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  g_string_set_size(writer.buffer, sizeof(header));
+  _write_ruleset(&writer, rule_set);
+
+  memcpy(header.magic, PDB_CACHE_MAGIC, sizeof(header.magic));
+  header.version = PDB_CACHE_VERSION;
+  header.byte_order = PDB_CACHE_BYTE_ORDER;
+  header.source_size = st.st_size;
+  header.source_mtime = st.st_mtime;
+  header.payload_size = writer.buffer->len - sizeof(header);
+
+  checksum = _compute_payload_checksum(writer.buffer->str + sizeof(header), header.payload_size);
+  g_strlcpy(header.payload_checksum, checksum, sizeof(header.payload_checksum));
+  g_free(checksum);
+
+  memcpy(writer.buffer->str, &header, sizeof(header));
+
+  success = g_file_set_contents(cache_filename, writer.buffer->str, writer.buffer->len, error);
+
+  g_hash_table_unref(writer.indices);
+  g_ptr_array_free(writer.programs, TRUE);
+  g_ptr_array_free(writer.rules, TRUE);
+  g_string_free(writer.buffer, TRUE);
+  return success;
+}
+
+/*********************************************************
+ * Reader
+ *********************************************************/
+
+typedef gpointer (*PDBCacheRefFunc)(gpointer value);
+
+/* The read functions return FALSE if the cache is damaged.  They only set
+ * the error if something fails to compile, so that the caller can tell
+ * the two apart. */
+typedef struct _PDBCacheReader
+{
+  const gchar *pos;
+  const gchar *end;
+  GlobalConfig *cfg;
+  GPtrArray *rules;
+  GPtrArray *programs;
+} PDBCacheReader;
+
+static gboolean
+_read_uint32(PDBCacheReader *self, guint32 *value)
+{
+  if ((gsize) (self->end - self->pos) < sizeof(*value))
+    return FALSE;
+
+  memcpy(value, self->pos, sizeof(*value));
+  self->pos += sizeof(*value);
+  return TRUE;
+}
+
+/* each counted item takes at least a byte, which keeps a damaged count
+ * from allocating huge arrays */
+static gboolean
+_read_count(PDBCacheReader *self, guint32 *count)
+{
+  return _read_uint32(self, count) && *count <= (gsize) (self->end - self->pos);
+}
+
+static gboolean
+_read_string(PDBCacheReader *self, const gchar **str)
+{
+  guint32 len;
+
+  if (!_read_uint32(self, &len))
+    return FALSE;
+
+  if (len == PDB_CACHE_NULL_STRING)
+    {
+      *str = NULL;
+      return TRUE;
+    }
+
+  if ((gsize) (self->end - self->pos) < (gsize) len + 1 || self->pos[len] != '\0')
+    return FALSE;
+
+  *str = self->pos;
+  self->pos += len + 1;
+  return TRUE;
+}
+
+static RParserNode *
+_new_parser_node(guint32 type, const gchar *value_name, const gchar *param)
+{
+  RParserNode *parser;
+  gchar *key;
+
+  if (type >= G_N_ELEMENTS(parser_type_names) || !parser_type_names[type])
+    return NULL;
+
+  /* the same description r_insert_node() creates the parser node from */
+  if (param)
+    key = g_strdup_printf("%s:%s:%s", parser_type_names[type], value_name ? : "", param);
+  else
+    key = g_strdup_printf("%s:%s", parser_type_names[type], value_name ? : "");
+  parser = r_new_pnode(key);
+  g_free(key);
+  return parser;
+}
+
+static void
+_free_tree(RNode *node, GDestroyNotify free_value)
+{
+  if (node->parser)
+    r_free_pnode(node, free_value);
+  else
+    r_free_node(node, free_value);
+}
+
+static RNode *_read_tree(PDBCacheReader *self, GPtrArray *values, PDBCacheRefFunc ref_value,
+                         GDestroyNotify free_value);
+
+static gboolean
+_read_children(PDBCacheReader *self, RNode ***children, guint *num_children, gboolean parsers,
+               GPtrArray *values, PDBCacheRefFunc ref_value, GDestroyNotify free_value)
+{
+  guint32 count;
+
+  if (!_read_count(self, &count))
+    return FALSE;
+
+  if (count)
+    *children = g_new0(RNode *, count);
+
+  /* the children were stored in their sorted order */
+  for (gint i = 0; i < count; i++)
+    {
+      RNode *child = _read_tree(self, values, ref_value, free_value);
+
+      if (!child)
+        return FALSE;
+
+      if (!!child->parser != parsers)
+        {
+          _free_tree(child, free_value);
+          return FALSE;
+        }
+      (*children)[(*num_children)++] = child;
+    }
+  return TRUE;
+}
+
+static RNode *
+_read_tree(PDBCacheReader *self, GPtrArray *values, PDBCacheRefFunc ref_value, GDestroyNotify free_value)
+{
+  const gchar *key, *value_name, *param, *pdb_location;
+  guint32 parser_type, value;
+  RNode *node;
+
+  if (!_read_string(self, &key) || !_read_uint32(self, &parser_type))
+    return NULL;
+
+  /* parser nodes have no key, literal ones always have one */
+  if ((parser_type == PDB_CACHE_NO_PARSER) != (key != NULL))
+    return NULL;
+
+  node = r_new_node(key, NULL);
+  if (parser_type != PDB_CACHE_NO_PARSER)
+    {
+      if (!_read_string(self, &value_name) || !_read_string(self, &param))
+        goto error;
+
+      node->parser = _new_parser_node(parser_type, value_name, param);
+      if (!node->parser)
+        goto error;
+    }
+
+  if (!_read_string(self, &pdb_location) || !_read_uint32(self, &value) || value > values->len)
+    goto error;
+
+  node->pdb_location = g_strdup(pdb_location);
+  if (value)
+    node->value = ref_value(g_ptr_array_index(values, value - 1));
+
+  if (!_read_children(self, &node->children, &node->num_children, FALSE, values, ref_value, free_value) ||
+      !_read_children(self, &node->pchildren, &node->num_pchildren, TRUE, values, ref_value, free_value))
+    goto error;
+
+  return node;
+
+error:
+  _free_tree(node, free_value);
+  return NULL;
+}
+
+static gboolean
+_read_message(PDBCacheReader *self, SyntheticMessage *message, GError **error)
+{
+  guint32 inherit_mode, num_tags, num_values;
+
+  if (!_read_uint32(self, &inherit_mode) || inherit_mode > RAC_MSG_INHERIT_CONTEXT)
+    return FALSE;
+  synthetic_message_set_inherit_mode(message, inherit_mode);
+
+  if (!_read_count(self, &num_tags))
+    return FALSE;
+  for (gint i = 0; i < num_tags; i++)
+    {
+      const gchar *tag;
+
+      if (!_read_string(self, &tag) || !tag)
+        return FALSE;
+      synthetic_message_add_tag(message, tag);
+    }
+
+  if (!_read_count(self, &num_values))
+    return FALSE;
+  for (gint i = 0; i < num_values; i++)
+    {
+      const gchar *name, *value;
+
+      if (!_read_string(self, &name) || !_read_string(self, &value) || !name || !value)
+        return FALSE;
+      if (!synthetic_message_add_value_template_string(message, self->cfg, name, value, error))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_read_context(PDBCacheReader *self, SyntheticContext *context, GError **error)
+{
+  guint32 timeout, scope;
+  const gchar *id_template;
+
+  if (!_read_uint32(self, &timeout) || !_read_uint32(self, &scope) || scope > RCS_PROCESS ||
+      !_read_string(self, &id_template))
+    return FALSE;
+
+  synthetic_context_set_context_timeout(context, (gint) timeout);
+  context->scope = scope;
+
+  if (id_template)
+    {
+      LogTemplate *template = log_template_new(self->cfg, NULL);
+
+      if (!log_template_compile(template, id_template, error))
+        {
+          log_template_unref(template);
+          return FALSE;
+        }
+      synthetic_context_set_context_id_template(context, template);
+    }
+  return TRUE;
+}
+
+static PDBAction *
+_read_action(PDBCacheReader *self, GError **error)
+{
+  guint32 id, trigger, rate, rate_quantum, content_type;
+  const gchar *condition;
+  PDBAction *action;
+
+  if (!_read_uint32(self, &id) || !_read_uint32(self, &trigger) ||
+      !_read_uint32(self, &rate) || !_read_uint32(self, &rate_quantum) ||
+      !_read_string(self, &condition) || !_read_uint32(self, &content_type))
+    return NULL;
+
+  /* an action is only valid with some content, see pdb_action_free() */
+  if ((trigger != RAT_MATCH && trigger != RAT_TIMEOUT) ||
+      (content_type != RAC_MESSAGE && content_type != RAC_CREATE_CONTEXT))
+    return NULL;
+
+  action = pdb_action_new(id);
+  action->trigger = trigger;
+  action->rate = rate;
+  action->rate_quantum = rate_quantum;
+  action->content_type = content_type;
+
+  if (condition)
+    {
+      pdb_action_set_condition(action, self->cfg, condition, error);
+      if (!action->condition)
+        goto error;
+    }
+
+  if (content_type == RAC_MESSAGE)
+    {
+      if (!_read_message(self, &action->content.message, error))
+        goto error;
+    }
+  else
+    {
+      synthetic_context_init(&action->content.create_context.context);
+      if (!_read_message(self, &action->content.create_context.message, error) ||
+          !_read_context(self, &action->content.create_context.context, error))
+        goto error;
+    }
+  return action;
+
+error:
+  pdb_action_free(action);
+  return NULL;
+}
+
+static PDBRule *
+_read_rule(PDBCacheReader *self, GError **error)
+{
+  const gchar *rule_id, *class;
+  guint32 num_actions;
+  PDBRule *rule = pdb_rule_new();
+
+  if (!_read_string(self, &rule_id) || !_read_string(self, &class))
+    goto error;
+
+  pdb_rule_set_rule_id(rule, rule_id);
+  /* not pdb_rule_set_class(), the class tag is restored with the other tags */
+  rule->class = g_strdup(class);
+
+  if (!_read_context(self, &rule->context, error) ||
+      !_read_message(self, &rule->msg, error) ||
+      !_read_count(self, &num_actions))
+    goto error;
+
+  for (gint i = 0; i < num_actions; i++)
+    {
+      PDBAction *action = _read_action(self, error);
+
+      if (!action)
+        goto error;
+      pdb_rule_add_action(rule, action);
+    }
+  return rule;
+
+error:
+  pdb_rule_unref(rule);
+  return NULL;
+}
+
+static PDBProgram *
+_read_program(PDBCacheReader *self)
+{
+  const gchar *pdb_location;
+  PDBProgram *program;
+  RNode *rules;
+
+  if (!_read_string(self, &pdb_location))
+    return NULL;
+
+  rules = _read_tree(self, self->rules, (PDBCacheRefFunc) pdb_rule_ref, (GDestroyNotify) pdb_rule_unref);
+  if (!rules)
+    return NULL;
+
+  program = pdb_program_new();
+  r_free_node(program->rules, NULL);
+  program->rules = rules;
+  program->pdb_location = g_strdup(pdb_location);
+  return program;
+}
+
+static gboolean
+_read_ruleset(PDBCacheReader *self, PDBRuleSet *rule_set, GError **error)
+{
+  const gchar *version, *pub_date;
+  guint32 is_empty, num_rules, num_programs;
+  RNode *programs;
+
+  if (!_read_string(self, &version) || !_read_string(self, &pub_date) ||
+      !_read_uint32(self, &is_empty) || !_read_count(self, &num_rules))
+    return FALSE;
+
+  for (gint i = 0; i < num_rules; i++)
+    {
+      PDBRule *rule = _read_rule(self, error);
+
+      if (!rule)
+        return FALSE;
+      g_ptr_array_add(self->rules, rule);
+    }
+
+  if (!_read_count(self, &num_programs))
+    return FALSE;
+
+  for (gint i = 0; i < num_programs; i++)
+    {
+      PDBProgram *program = _read_program(self);
+
+      if (!program)
+        return FALSE;
+      g_ptr_array_add(self->programs, program);
+    }
+
+  programs = _read_tree(self, self->programs, (PDBCacheRefFunc) pdb_program_ref,
+                        (GDestroyNotify) pdb_program_unref);
+  if (!programs)
+    return FALSE;
+
+  if (self->pos != self->end)
+    {
+      r_free_node(programs, (GDestroyNotify) pdb_program_unref);
+      return FALSE;
+    }
+
+  rule_set->programs = programs;
+  rule_set->version = g_strdup(version);
+  rule_set->pub_date = g_strdup(pub_date);
+  rule_set->is_empty = is_empty;
+  return TRUE;
+}
+
+static gboolean
+_validate_source(const PDBCacheHeader *header, const gchar *source_filename, GError **error)
+{
+  struct stat st;
+  gchar *checksum;
+  gboolean matches;
+
+  if (!_stat_source(source_filename, &st, error))
+    return FALSE;
+
+  /* size and modification time are checked first, as they are cheap */
+  if (header->source_size != st.st_size || header->source_mtime != st.st_mtime)
+    goto mismatch;
+
+  checksum = _compute_source_checksum(source_filename, error);
+  if (!checksum)
+    return FALSE;
+
+  matches = strncmp(checksum, header->source_checksum, sizeof(header->source_checksum)) == 0;
+  g_free(checksum);
+  if (matches)
+    return TRUE;
+
+mismatch:
+  g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Patterndb cache was compiled from a different version of %s",
+              source_filename);
+  return FALSE;
+}
+
+static gboolean
+_validate_payload(const PDBCacheHeader *header, const gchar *payload, GError **error)
+{
+  gchar *checksum = _compute_payload_checksum(payload, header->payload_size);
+  gboolean matches = strncmp(checksum, header->payload_checksum, sizeof(header->payload_checksum)) == 0;
+
+  g_free(checksum);
+  if (!matches)
+    {
+      g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Damaged patterndb cache");
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_validate_header(const PDBCacheHeader *header, gsize file_size, GError **error)
+{
+
+  if (memcmp(header->magic, PDB_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != PDB_CACHE_VERSION ||
+      header->byte_order != PDB_CACHE_BYTE_ORDER)
+    {
+      g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Unsupported patterndb cache format");
+      return FALSE;
+    }
+
+  if (header->payload_size != file_size - sizeof(*header))
+    {
+      g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Truncated patterndb cache");
+      return FALSE;
+    }
+  return TRUE;
+}
+
+/* Loads the ruleset stored in the cache into an empty @rule_set, the XML
+ * file is only read to check that it is the one the cache was compiled
+ * from. */
+gboolean
+pdb_cache_load(PDBRuleSet *rule_set, GlobalConfig *cfg, const gchar *source_filename,
+               const gchar *cache_filename, GError **error)
+{
+  PDBCacheReader reader;
+  PDBCacheHeader header;
+  GMappedFile *file;
+  GError *local_error = NULL;
+  gsize file_size;
+  gboolean success = FALSE;
+
+  g_assert(rule_set->programs == NULL);
+
+  file = g_mapped_file_new(cache_filename, FALSE, error);
+  if (!file)
+    return FALSE;
+
+  file_size = g_mapped_file_get_length(file);
+  if (file_size < sizeof(header))
+    {
+      g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Truncated patterndb cache");
+      goto exit;
+    }
+
+  /* the header is copied out, as the mapping is not necessarily aligned */
+  memcpy(&header, g_mapped_file_get_contents(file), sizeof(header));
+  if (!_validate_header(&header, file_size, error) ||
+      !_validate_source(&header, source_filename, error) ||
+      !_validate_payload(&header, g_mapped_file_get_contents(file) + sizeof(header), error))
+    goto exit;
+
+  reader.pos = g_mapped_file_get_contents(file) + sizeof(header);
+  reader.end = reader.pos + header.payload_size;
+  reader.cfg = cfg;
+  reader.rules = g_ptr_array_new_with_free_func((GDestroyNotify) pdb_rule_unref);
+  reader.programs = g_ptr_array_new_with_free_func((GDestroyNotify) pdb_program_unref);
+
+  success = _read_ruleset(&reader, rule_set, &local_error);
+  if (!success)
+    {
+      if (local_error)
+        g_propagate_error(error, local_error);
+      else
+        g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Damaged patterndb cache");
+    }
+
+  /* the trees hold their own references */
+  g_ptr_array_free(reader.programs, TRUE);
+  g_ptr_array_free(reader.rules, TRUE);
+
+exit:
+  g_mapped_file_unref(file);
+  return success;
+}
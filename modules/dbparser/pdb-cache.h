@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef DBPARSER_PDB_CACHE_H_INCLUDED
+#define DBPARSER_PDB_CACHE_H_INCLUDED 1
+
+#include "syslog-ng.h"
+#include "pdb-ruleset.h"
+#include "cfg.h"
+
+/*
+ * Precompiled patterndb cache.
+ *
+ * The cache stores a compiled ruleset: the radix trees of programs and
+ * patterns along with the rules and their actions.  Templates, filter
+ * expressions, tags and value names are stored by their source text and
+ * are compiled against the running configuration when the cache is
+ * loaded, everything else is restored as is, without going through the
+ * XML file.
+ *
+ * A cache is only used if the XML file has the same size, modification
+ * time and SHA-1 checksum as when the cache was compiled from it, and the
+ * checksum of the cache itself matches.
+ */
+
+gboolean pdb_cache_save(PDBRuleSet *rule_set, const gchar *source_filename, const gchar *cache_filename,
+                        GError **error);
+gboolean pdb_cache_load(PDBRuleSet *rule_set, GlobalConfig *cfg, const gchar *source_filename,
+                        const gchar *cache_filename, GError **error);
+
+gchar *pdb_cache_get_filename(const gchar *source_filename);
+
+#endif
@@ -27,6 +27,7 @@
 #include "pdb-example.h"
 #include "pdb-ruleset.h"
 #include "pdb-error.h"
+#include "pdb-cache.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -1149,8 +1150,31 @@ GMarkupParser db_parser =
   .error = NULL
 };
 
-gboolean
-pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples)
+static void
+_freeze_program_rules(RNode *node)
+{
+  PDBProgram *program = (PDBProgram *) node->value;
+
+  if (program && !program->rules->frozen)
+    r_freeze_node(program->rules);
+
+  for (gint i = 0; i < node->num_children; i++)
+    _freeze_program_rules(node->children[i]);
+  for (gint i = 0; i < node->num_pchildren; i++)
+    _freeze_program_rules(node->pchildren[i]);
+}
+
+/* the radix trees are not modified once the ruleset is loaded, compile
+ * them into the flattened form used for lookups */
+static void
+_freeze_ruleset(PDBRuleSet *self)
+{
+  _freeze_program_rules(self->programs);
+  r_freeze_node(self->programs);
+}
+
+static gboolean
+_load_xml(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples)
 {
   PDBLoader state;
   GMarkupParseContext *parse_ctx = NULL;
@@ -1204,6 +1228,7 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
   if (state.load_examples)
     *examples = state.examples;
 
+  _freeze_ruleset(self);
   success = TRUE;
 
 error:
@@ -1216,3 +1241,66 @@ error:
     g_error_free(error);
   return success;
 }
+
+/* Loads the precompiled cache of the XML file, without opening the XML
+ * file itself.  Returns FALSE if there's no usable cache. */
+static gboolean
+_load_cache(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config)
+{
+  gchar *cache_filename = pdb_cache_get_filename(config);
+  GError *error = NULL;
+  gboolean success = FALSE;
+
+  if (g_file_test(cache_filename, G_FILE_TEST_EXISTS))
+    {
+      success = pdb_cache_load(self, cfg, config, cache_filename, &error);
+      if (success)
+        {
+          msg_debug("Pattern database loaded from its precompiled cache",
+                    evt_tag_str(EVT_TAG_FILENAME, config),
+                    evt_tag_str("cache", cache_filename));
+          _freeze_ruleset(self);
+        }
+      else
+        {
+          msg_notice("Ignoring precompiled pattern database cache, loading the XML file instead",
+                     evt_tag_str(EVT_TAG_FILENAME, config),
+                     evt_tag_str("cache", cache_filename),
+                     evt_tag_str("reason", error->message));
+          g_error_free(error);
+        }
+    }
+  g_free(cache_filename);
+  return success;
+}
+
+gboolean
+pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples)
+{
+  /* examples are not part of the cache, only the XML file has them */
+  if (!examples && _load_cache(self, cfg, config))
+    return TRUE;
+
+  return _load_xml(self, cfg, config, examples);
+}
+
+/* Loads the XML file and stores the compiled ruleset in a cache that
+ * subsequent pdb_rule_set_load() calls use instead of the XML file. */
+gboolean
+pdb_rule_set_compile(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, const gchar *cache_filename)
+{
+  GError *error = NULL;
+
+  if (!_load_xml(self, cfg, config, NULL))
+    return FALSE;
+
+  if (!pdb_cache_save(self, config, cache_filename, &error))
+    {
+      msg_error("Error storing precompiled pattern database",
+                evt_tag_str(EVT_TAG_FILENAME, cache_filename),
+                evt_tag_str("error", error->message));
+      g_error_free(error);
+      return FALSE;
+    }
+  return TRUE;
+}
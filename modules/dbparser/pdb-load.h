@@ -28,5 +28,6 @@
 #include "cfg.h"
 
 gboolean pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples);
+gboolean pdb_rule_set_compile(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, const gchar *cache_filename);
 
 #endif
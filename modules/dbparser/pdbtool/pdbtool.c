@@ -34,6 +34,7 @@
 #include "pdb-example.h"
 #include "pdb-program.h"
 #include "pdb-load.h"
+#include "pdb-cache.h"
 #include "pdb-file.h"
 #include "apphook.h"
 #include "transport/transport-file.h"
@@ -1046,6 +1047,31 @@ pdbtool_dictionary(int argc, char *argv[])
   return 0;
 }
 
+static gint
+pdbtool_compile(int argc, char *argv[])
+{
+  PDBRuleSet *rule_set = pdb_rule_set_new();
+  gchar *cache_filename = pdb_cache_get_filename(patterndb_file);
+  gboolean success;
+
+  success = pdb_rule_set_compile(rule_set, configuration, patterndb_file, cache_filename);
+  if (success && verbose_flag)
+    printf("Pattern database compiled; file='%s'\n", cache_filename);
+
+  pdb_rule_set_free(rule_set);
+  g_free(cache_filename);
+  return success ? 0 : 1;
+}
+
+static GOptionEntry compile_options[] =
+{
+  {
+    "pdb",       'p', 0, G_OPTION_ARG_STRING, &patterndb_file,
+    "Name of the patterndb file to compile", "<patterndb_file>"
+  },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
+};
+
 static gboolean
 pdbtool_load_module(const gchar *option_name, const gchar *value, gpointer data, GError **error)
 {
@@ -1196,6 +1222,7 @@ static struct
   { "test", test_options, "Test pattern databases", pdbtool_test },
   { "patternize", patternize_options, "Create a pattern database from logs", pdbtool_patternize },
   { "dictionary", dictionary_options, "Dump pattern dictionary", pdbtool_dictionary },
+  { "compile", compile_options, "Compile a pattern database into a binary cache", pdbtool_compile },
   { NULL, NULL },
 };
 
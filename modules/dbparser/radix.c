@@ -590,9 +590,9 @@ r_parser_number(gchar *str, gint *len, const gchar *param, gpointer state, RPars
 /**
  * r_new_pnode:
  *
- * Create a new parsing node.
+ * Create a new parsing node from its "TYPE:name:param" description.
  **/
-static RParserNode *
+RParserNode *
 r_new_pnode(gchar *key)
 {
   RParserNode *parser_node = g_new0(RParserNode, 1);
@@ -819,6 +819,80 @@ r_free_pnode(RNode *node, void (*free_fn)(gpointer data))
   r_free_node(node, free_fn);
 }
 
+/**************************************************************
+ * Frozen trees.
+ *
+ * Once a tree is fully loaded, r_freeze_node() compiles it into a
+ * flattened, read-only form: all nodes are stored in a single array in
+ * breadth-first order with the children of a node adjacent to each other,
+ * short literal keys are stored inline and the literal children of nodes
+ * with many children are located using a bitmap of their first
+ * characters.  r_find_node() uses this form when it is available, so a
+ * lookup touches a few adjacent cache lines per level instead of chasing
+ * pointers across the heap.
+ *
+ * Inserting into a frozen tree drops the frozen form.
+ **************************************************************/
+
+#define R_FROZEN_INLINE_KEY_LEN 8
+/* literal children of nodes with more children than this are located using a bitmap */
+#define R_FROZEN_BITMAP_MIN_CHILDREN 8
+#define R_FROZEN_NONE G_MAXUINT32
+
+typedef struct _RFrozenNode
+{
+  union
+  {
+    gchar chars[R_FROZEN_INLINE_KEY_LEN];
+    guint32 ofs;
+  } key;
+  gint32 keylen;
+  guint32 first_child;
+  guint32 num_children;
+  guint32 first_pchild;
+  guint32 num_pchildren;
+  /* index into bitmaps or R_FROZEN_NONE */
+  guint32 child_bitmap;
+  /* index into parsers, for parser nodes */
+  guint32 parser;
+  gpointer value;
+  /* the original node, this is what a lookup returns */
+  RNode *node;
+} RFrozenNode;
+
+typedef struct _RFrozenBitmap
+{
+  guint64 bits[4];
+} RFrozenBitmap;
+
+struct _RFrozenTree
+{
+  RFrozenNode *nodes;
+  /* the first character of the key of each node, parallel to nodes, so
+   * that the first characters of siblings can be scanned in one go */
+  gchar *first_chars;
+  RFrozenBitmap *bitmaps;
+  RParserNode *parsers;
+  gchar *keys;
+};
+
+static void
+_thaw_node(RNode *root)
+{
+  RFrozenTree *tree = root->frozen;
+
+  if (!tree)
+    return;
+
+  g_free(tree->nodes);
+  g_free(tree->first_chars);
+  g_free(tree->bitmaps);
+  g_free(tree->parsers);
+  g_free(tree->keys);
+  g_free(tree);
+  root->frozen = NULL;
+}
+
 /**************************************************************
  * Literal string nodes.
  **************************************************************/
@@ -952,6 +1026,8 @@ r_insert_node(RNode *root, gchar *key, gpointer value, RNodeGetValueFunc value_f
   gint nodelen = root->keylen;
   gint i = 0;
 
+  _thaw_node(root);
+
   if (key[0] == '@')
     {
       gchar *end;
@@ -1196,11 +1272,11 @@ _truncate_debug_info(RFindNodeState *state, gint truncated_size)
 }
 
 static void
-_find_matching_literal_prefix(RNode *root, gchar *key, gint keylen,
+_find_matching_literal_prefix(const gchar *node_key, gint node_keylen, gchar *key, gint keylen,
                               gint *literal_prefix_inputlen,
                               gint *literal_prefix_radixlen)
 {
-  gint current_node_key_length = root->keylen;
+  gint current_node_key_length = node_keylen;
   gint input_length;
   gint radix_length;
 
@@ -1219,12 +1295,12 @@ _find_matching_literal_prefix(RNode *root, gchar *key, gint keylen,
       input_length = radix_length = 0;
       while (input_length < keylen && radix_length < current_node_key_length)
         {
-          if (key[input_length] == '\r' && root->key[radix_length] == '\n')
+          if (key[input_length] == '\r' && node_key[radix_length] == '\n')
             {
               /* skip CR from input if the radix contains a newline */
               input_length++;
             }
-          if (key[input_length] != root->key[radix_length])
+          if (key[input_length] != node_key[radix_length])
             break;
 
           input_length++;
@@ -1342,6 +1418,24 @@ _clear_match_content(RParserMatch *match)
     }
 }
 
+static void
+_finish_match_slot(RFindNodeState *state, RParserNode *parser_node, gint matches_slot_index,
+                   gint extracted_match_len, gchar *remaining_key, gboolean matched)
+{
+  /* we have to look up "match_slot" again as the GArray may have
+   * moved the data in case r_find_node() expanded it while matching the
+   * rest of the key */
+  RParserMatch *match_slot = _get_match_slot(state, matches_slot_index);
+
+  if (match_slot)
+    {
+      if (matched)
+        _fixup_match_offsets(state, parser_node, extracted_match_len, remaining_key, match_slot);
+      else
+        _clear_match_content(match_slot);
+    }
+}
+
 static RNode *
 _try_parse_with_a_given_child(RFindNodeState *state, RNode *root, gint parser_ndx, gint matches_slot_index,
                               gchar *remaining_key, gint remaining_keylen)
@@ -1369,17 +1463,7 @@ _try_parse_with_a_given_child(RFindNodeState *state, RNode *root, gint parser_nd
       _add_parser_match_debug_info(state, root, parser_node, remaining_key, extracted_match_len, match_slot);
       ret = _find_node_recursively(state, root->pchildren[parser_ndx], remaining_key + extracted_match_len,
                                    remaining_keylen - extracted_match_len);
-
-      /* we have to look up "match_slot" again as the GArray may have
-       * moved the data in case r_find_node() expanded it above */
-      match_slot = _get_match_slot(state, matches_slot_index);
-      if (match_slot)
-        {
-          if (ret)
-            _fixup_match_offsets(state, parser_node, extracted_match_len, remaining_key, match_slot);
-          else
-            _clear_match_content(match_slot);
-        }
+      _finish_match_slot(state, parser_node, matches_slot_index, extracted_match_len, remaining_key, ret != NULL);
     }
   return ret;
 
@@ -1412,7 +1496,7 @@ _find_node_recursively(RFindNodeState *state, RNode *root, gchar *key, gint keyl
 {
   gint literal_prefix_inputlen, literal_prefix_radixlen;
 
-  _find_matching_literal_prefix(root, key, keylen,
+  _find_matching_literal_prefix(root->key, root->keylen, key, keylen,
                                 &literal_prefix_inputlen,
                                 &literal_prefix_radixlen);
   _add_literal_match_to_debug_info(state, root, literal_prefix_inputlen);
@@ -1482,6 +1566,155 @@ _find_node_with_state(RFindNodeState *state, RNode *root, gchar *key, gint keyle
   return ret;
 }
 
+/* lookups in frozen trees, these mirror the functions above, except that
+ * they don't collect debug information */
+
+static RNode *_find_frozen_node_recursively(RFindNodeState *state, RFrozenTree *tree, RFrozenNode *root,
+                                            gchar *key, gint keylen);
+
+static inline const gchar *
+_frozen_node_key(RFrozenTree *tree, RFrozenNode *node)
+{
+  if (node->keylen <= R_FROZEN_INLINE_KEY_LEN)
+    return node->key.chars;
+  return &tree->keys[node->key.ofs];
+}
+
+static RFrozenNode *
+_find_frozen_child_by_first_character(RFrozenTree *tree, RFrozenNode *root, gchar key)
+{
+  if (root->child_bitmap != R_FROZEN_NONE)
+    {
+      RFrozenBitmap *bitmap = &tree->bitmaps[root->child_bitmap];
+      guint8 c = (guint8) key;
+      guint64 word = bitmap->bits[c >> 6];
+      guint64 bit = G_GUINT64_CONSTANT(1) << (c & 63);
+      gint rank = 0;
+
+      if (!(word & bit))
+        return NULL;
+
+      /* children are ordered by their first character, so the child is
+       * preceded by as many siblings as there are bits set below its own */
+      for (gint i = 0; i < (c >> 6); i++)
+        rank += __builtin_popcountll(bitmap->bits[i]);
+      rank += __builtin_popcountll(word & (bit - 1));
+      return &tree->nodes[root->first_child + rank];
+    }
+
+  const gchar *first_chars = &tree->first_chars[root->first_child];
+  for (guint32 i = 0; i < root->num_children; i++)
+    {
+      if (first_chars[i] == key)
+        return &tree->nodes[root->first_child + i];
+    }
+  return NULL;
+}
+
+static RNode *
+_find_frozen_child_by_remaining_key(RFindNodeState *state, RFrozenTree *tree, RFrozenNode *root,
+                                    gchar *remaining_key, gint remaining_keylen)
+{
+  RFrozenNode *candidate;
+
+  if (remaining_keylen >= 2 && remaining_key[0] == '\r' && remaining_key[1] == '\n')
+    {
+      remaining_key++;
+      remaining_keylen--;
+    }
+  candidate = _find_frozen_child_by_first_character(tree, root, remaining_key[0]);
+  if (candidate)
+    return _find_frozen_node_recursively(state, tree, candidate, remaining_key, remaining_keylen);
+  return NULL;
+}
+
+static RNode *
+_find_frozen_child_by_parser(RFindNodeState *state, RFrozenTree *tree, RFrozenNode *root,
+                             gchar *remaining_key, gint remaining_keylen)
+{
+  gint matches_slot_index = _alloc_slot_in_matches(state);
+  RNode *ret = NULL;
+
+  for (guint32 i = 0; !ret && i < root->num_pchildren; i++)
+    {
+      RFrozenNode *child = &tree->nodes[root->first_pchild + i];
+      RParserNode *parser_node = &tree->parsers[child->parser];
+      RParserMatch *match_slot = _clear_match_slot(state, matches_slot_index);
+      gint extracted_match_len;
+
+      if (!_pnode_try_parse(parser_node, remaining_key, &extracted_match_len, match_slot))
+        continue;
+
+      ret = _find_frozen_node_recursively(state, tree, child, remaining_key + extracted_match_len,
+                                          remaining_keylen - extracted_match_len);
+      _finish_match_slot(state, parser_node, matches_slot_index, extracted_match_len, remaining_key, ret != NULL);
+    }
+  if (!ret && state->stored_matches)
+    {
+      /* the values in the stored_matches array has already been freed if we come here */
+      _reset_matches_to_original_state(state, matches_slot_index);
+    }
+  return ret;
+}
+
+static RNode *
+_find_frozen_node_recursively(RFindNodeState *state, RFrozenTree *tree, RFrozenNode *root, gchar *key, gint keylen)
+{
+  gint literal_prefix_inputlen, literal_prefix_radixlen;
+
+  _find_matching_literal_prefix(_frozen_node_key(tree, root), root->keylen, key, keylen,
+                                &literal_prefix_inputlen,
+                                &literal_prefix_radixlen);
+
+  if (literal_prefix_inputlen == keylen && (literal_prefix_radixlen == root->keylen || root->keylen == -1))
+    {
+      /* key completely consumed by the literal */
+      if (root->value)
+        return root->node;
+    }
+  else if ((root->keylen < 1) || (literal_prefix_inputlen < keylen && literal_prefix_radixlen >= root->keylen))
+    {
+      /* we matched the key partially, go on with child nodes */
+      RNode *ret;
+      gchar *remaining_key = key + literal_prefix_inputlen;
+      gint remaining_keylen = keylen - literal_prefix_inputlen;
+
+      /* prefer a literal match over parsers */
+      ret = _find_frozen_child_by_remaining_key(state, tree, root, remaining_key, remaining_keylen);
+
+      /* then try parsers in order */
+      if (!ret)
+        ret = _find_frozen_child_by_parser(state, tree, root, remaining_key, remaining_keylen);
+
+      if (!ret && root->value)
+        {
+          if (!state->require_complete_match)
+            return root->node;
+          state->partial_match_found = TRUE;
+        }
+
+      return ret;
+    }
+
+  return NULL;
+}
+
+static RNode *
+_find_frozen_node_with_state(RFindNodeState *state, RFrozenTree *tree, gchar *key, gint keylen)
+{
+  RNode *ret;
+
+  state->require_complete_match = TRUE;
+  state->partial_match_found = FALSE;
+  ret = _find_frozen_node_recursively(state, tree, &tree->nodes[0], key, keylen);
+  if (!ret && state->partial_match_found)
+    {
+      state->require_complete_match = FALSE;
+      ret = _find_frozen_node_recursively(state, tree, &tree->nodes[0], key, keylen);
+    }
+  return ret;
+}
+
 RNode *
 r_find_node(RNode *root, gchar *key, gint keylen, GArray *stored_matches)
 {
@@ -1491,6 +1724,8 @@ r_find_node(RNode *root, gchar *key, gint keylen, GArray *stored_matches)
     .stored_matches = stored_matches,
   };
 
+  if (root->frozen)
+    return _find_frozen_node_with_state(&state, root->frozen, key, keylen);
   return _find_node_with_state(&state, root, key, keylen);
 }
 
@@ -1579,5 +1814,141 @@ r_free_node(RNode *node, void (*free_fn)(gpointer data))
   if (node->value && free_fn)
     free_fn(node->value);
 
+  _thaw_node(node);
   g_free(node);
 }
+
+static gint
+_frozen_child_cmp(const void *ap, const void *bp)
+{
+  RNode *a = *(RNode * const *) ap;
+  RNode *b = *(RNode * const *) bp;
+
+  /* bitmap lookups index the children in unsigned character order */
+  return (gint) (guint8) a->key[0] - (gint) (guint8) b->key[0];
+}
+
+static void
+_frozen_tree_append_node(GArray *nodes, RNode *node)
+{
+  RFrozenNode frozen_node =
+  {
+    .keylen = node->keylen,
+    .child_bitmap = R_FROZEN_NONE,
+    .parser = R_FROZEN_NONE,
+    .value = node->value,
+    .node = node,
+  };
+
+  g_array_append_val(nodes, frozen_node);
+}
+
+static void
+_frozen_tree_store_key(RFrozenNode *frozen_node, GString *keys)
+{
+  RNode *node = frozen_node->node;
+
+  if (node->keylen <= 0)
+    return;
+
+  if (node->keylen <= R_FROZEN_INLINE_KEY_LEN)
+    {
+      memcpy(frozen_node->key.chars, node->key, node->keylen);
+    }
+  else
+    {
+      frozen_node->key.ofs = keys->len;
+      g_string_append_len(keys, node->key, node->keylen);
+    }
+}
+
+static void
+_frozen_tree_store_child_bitmap(RFrozenNode *frozen_node, RNode **children, guint num_children, GArray *bitmaps)
+{
+  RFrozenBitmap bitmap = {{ 0 }};
+
+  for (gint i = 0; i < num_children; i++)
+    {
+      guint8 c = (guint8) children[i]->key[0];
+      guint64 bit = G_GUINT64_CONSTANT(1) << (c & 63);
+
+      /* the rank of a bit is only usable as an index if first characters are unique */
+      if (bitmap.bits[c >> 6] & bit)
+        return;
+      bitmap.bits[c >> 6] |= bit;
+    }
+
+  frozen_node->child_bitmap = bitmaps->len;
+  g_array_append_val(bitmaps, bitmap);
+}
+
+/**
+ * r_freeze_node:
+ *
+ * Compiles the tree rooted at @root into its flattened, read-only form,
+ * used by subsequent r_find_node() calls.  The tree still owns the
+ * parser states and values, these are shared by the frozen form.
+ */
+void
+r_freeze_node(RNode *root)
+{
+  GArray *nodes = g_array_new(FALSE, FALSE, sizeof(RFrozenNode));
+  GArray *bitmaps = g_array_new(FALSE, FALSE, sizeof(RFrozenBitmap));
+  GArray *parsers = g_array_new(FALSE, FALSE, sizeof(RParserNode));
+  GString *keys = g_string_sized_new(256);
+  RFrozenTree *tree = g_new0(RFrozenTree, 1);
+
+  _thaw_node(root);
+
+  /* breadth first traversal, the queue being the node array itself */
+  _frozen_tree_append_node(nodes, root);
+  for (guint32 i = 0; i < nodes->len; i++)
+    {
+      RFrozenNode frozen_node = g_array_index(nodes, RFrozenNode, i);
+      RNode *node = frozen_node.node;
+
+      _frozen_tree_store_key(&frozen_node, keys);
+      if (node->parser)
+        {
+          frozen_node.parser = parsers->len;
+          g_array_append_vals(parsers, node->parser, 1);
+        }
+
+      if (node->num_children)
+        {
+          RNode **children = g_memdup(node->children, node->num_children * sizeof(RNode *));
+
+          qsort(children, node->num_children, sizeof(RNode *), _frozen_child_cmp);
+          frozen_node.first_child = nodes->len;
+          frozen_node.num_children = node->num_children;
+          for (gint c = 0; c < node->num_children; c++)
+            _frozen_tree_append_node(nodes, children[c]);
+
+          if (node->num_children > R_FROZEN_BITMAP_MIN_CHILDREN)
+            _frozen_tree_store_child_bitmap(&frozen_node, children, node->num_children, bitmaps);
+          g_free(children);
+        }
+
+      frozen_node.first_pchild = nodes->len;
+      frozen_node.num_pchildren = node->num_pchildren;
+      for (gint c = 0; c < node->num_pchildren; c++)
+        _frozen_tree_append_node(nodes, node->pchildren[c]);
+
+      g_array_index(nodes, RFrozenNode, i) = frozen_node;
+    }
+
+  tree->first_chars = g_new0(gchar, nodes->len);
+  for (guint32 i = 0; i < nodes->len; i++)
+    {
+      RNode *node = g_array_index(nodes, RFrozenNode, i).node;
+
+      if (node->keylen > 0)
+        tree->first_chars[i] = node->key[0];
+    }
+
+  tree->nodes = (RFrozenNode *) g_array_free(nodes, FALSE);
+  tree->bitmaps = (RFrozenBitmap *) g_array_free(bitmaps, FALSE);
+  tree->parsers = (RParserNode *) g_array_free(parsers, FALSE);
+  tree->keys = g_string_free(keys, FALSE);
+  root->frozen = tree;
+}
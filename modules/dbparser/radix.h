@@ -86,6 +86,7 @@ typedef struct _RParserNode
 typedef gchar *(*RNodeGetValueFunc) (gpointer value);
 
 typedef struct _RNode RNode;
+typedef struct _RFrozenTree RFrozenTree;
 
 struct _RNode
 {
@@ -99,6 +100,9 @@ struct _RNode
 
   guint num_pchildren;
   RNode **pchildren;
+
+  /* flattened, read-only copy of the tree rooted here, see r_freeze_node() */
+  RFrozenTree *frozen;
 };
 
 typedef struct _RDebugInfo
@@ -152,9 +156,12 @@ r_parser_type_name(guint8 type)
     }
 }
 
+RParserNode *r_new_pnode(gchar *key);
 RNode *r_new_node(const gchar *key, gpointer value);
 void r_free_node(RNode *node, void (*free_fn)(gpointer data));
+void r_free_pnode(RNode *node, void (*free_fn)(gpointer data));
 void r_insert_node(RNode *root, gchar *key, gpointer value, RNodeGetValueFunc value_func, const gchar *location);
+void r_freeze_node(RNode *root);
 RNode *r_find_node(RNode *root, gchar *key, gint keylen, GArray *matches);
 RNode *r_find_node_dbg(RNode *root, gchar *key, gint keylen, GArray *matches, GArray *dbg_list);
 gchar **r_find_all_applicable_nodes(RNode *root, gchar *key, gint keylen, RNodeGetValueFunc value_func);
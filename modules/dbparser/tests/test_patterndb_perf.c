@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "apphook.h"
+#include "cfg.h"
+#include "logmsg/logmsg.h"
+#include "mainloop-worker.h"
+#include "patterndb.h"
+#include "plugin.h"
+#include "libtest/stopwatch.h"
+
+#include <criterion/criterion.h>
+#include <glib/gstdio.h>
+#include <iv.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* enough to show lock contention without overloading the build hosts, set
+ * PATTERNDB_PERF_MAX_THREADS to measure with up to MAX_THREADS threads */
+#define DEFAULT_MAX_THREADS 8
+#define MAX_THREADS 32
+#define MESSAGES_PER_THREAD 20000
+#define NUM_CONTEXTS 1024
+
+#define pdb_perf_skeleton "<patterndb version='4' pub_date='2010-02-22'>\
+ <ruleset name='testset' id='1'>\
+  <patterns>\
+   <pattern>prog</pattern>\
+  </patterns>\
+  <rules>\
+    <rule provider='test' id='1' class='system'>\
+     <patterns>\
+      <pattern>plain-message @NUMBER:id@</pattern>\
+     </patterns>\
+    </rule>\
+    <rule provider='test' id='2' class='system' context-scope='global' context-id='$id' context-timeout='60'>\
+     <patterns>\
+      <pattern>correlated-message @NUMBER:id@</pattern>\
+     </patterns>\
+     <actions>\
+       <action trigger='timeout'>\
+         <message>\
+           <values>\
+             <value name='CONTEXT_LENGTH'>$(context-length)</value>\
+           </values>\
+         </message>\
+       </action>\
+     </actions>\
+    </rule>\
+  </rules>\
+ </ruleset>\
+</patterndb>"
+
+typedef struct _ProcessContext
+{
+  PatternDB *patterndb;
+  gint thread_index;
+  gint matches;
+} ProcessContext;
+
+static gint num_synthetic_messages;
+static gint sum_context_length;
+
+static void
+_emit_func(LogMessage *msg, gboolean synthetic, gpointer user_data)
+{
+  if (!synthetic)
+    return;
+
+  g_atomic_int_inc(&num_synthetic_messages);
+  g_atomic_int_add(&sum_context_length, atoi(log_msg_get_value_by_name(msg, "CONTEXT_LENGTH", NULL)));
+}
+
+static LogMessage *
+_construct_message(const gchar *message)
+{
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value(msg, LM_V_MESSAGE, message, -1);
+  log_msg_set_value(msg, LM_V_PROGRAM, "prog", -1);
+  log_msg_set_value(msg, LM_V_HOST, "host", -1);
+  msg->timestamps[LM_TS_STAMP].ut_sec = msg->timestamps[LM_TS_RECVD].ut_sec;
+  return msg;
+}
+
+/* every second message belongs to a rule without a context, the others are
+ * spread over NUM_CONTEXTS contexts shared by all threads */
+static gpointer
+_process_thread(gpointer user_data)
+{
+  ProcessContext *ctx = (ProcessContext *) user_data;
+  gchar message[64];
+
+  iv_init();
+  main_loop_worker_thread_start(NULL);
+
+  for (gint i = 0; i < MESSAGES_PER_THREAD; i++)
+    {
+      if (i % 2)
+        g_snprintf(message, sizeof(message), "plain-message %d", i);
+      else
+        g_snprintf(message, sizeof(message), "correlated-message %d", (ctx->thread_index + i / 2) % NUM_CONTEXTS);
+
+      LogMessage *msg = _construct_message(message);
+      if (pattern_db_process(ctx->patterndb, msg))
+        ctx->matches++;
+      log_msg_unref(msg);
+    }
+
+  main_loop_worker_thread_stop();
+  iv_deinit();
+  return NULL;
+}
+
+static PatternDB *
+_create_pattern_db(gchar **filename)
+{
+  PatternDB *patterndb = pattern_db_new();
+
+  pattern_db_set_emit_func(patterndb, _emit_func, NULL);
+  g_file_open_tmp("patterndbXXXXXX.xml", filename, NULL);
+  g_file_set_contents(*filename, pdb_perf_skeleton, strlen(pdb_perf_skeleton), NULL);
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, *filename));
+  return patterndb;
+}
+
+static void
+_measure_scaling(gint num_threads)
+{
+  GThread *threads[MAX_THREADS];
+  ProcessContext contexts[MAX_THREADS];
+  gint num_messages = num_threads * MESSAGES_PER_THREAD;
+  gint num_correlated_messages = num_messages / 2;
+  gchar *filename;
+  gint matches = 0;
+
+  PatternDB *patterndb = _create_pattern_db(&filename);
+  num_synthetic_messages = 0;
+  sum_context_length = 0;
+
+  start_stopwatch();
+  for (gint i = 0; i < num_threads; i++)
+    {
+      contexts[i].patterndb = patterndb;
+      contexts[i].thread_index = i;
+      contexts[i].matches = 0;
+      threads[i] = g_thread_create(_process_thread, &contexts[i], TRUE, NULL);
+    }
+  for (gint i = 0; i < num_threads; i++)
+    {
+      g_thread_join(threads[i]);
+      matches += contexts[i].matches;
+    }
+  stop_stopwatch_and_display_result(num_messages, "correlating %d messages on %d threads", num_messages, num_threads);
+
+  /* no context may get lost or duplicated by concurrent updates */
+  pattern_db_expire_state(patterndb);
+  cr_assert_eq(matches, num_messages);
+  cr_assert_eq(num_synthetic_messages, NUM_CONTEXTS);
+  cr_assert_eq(sum_context_length, num_correlated_messages);
+
+  pattern_db_free(patterndb);
+  g_unlink(filename);
+  g_free(filename);
+}
+
+static gint
+_get_max_threads(void)
+{
+  const gchar *max_threads = g_getenv("PATTERNDB_PERF_MAX_THREADS");
+
+  if (!max_threads)
+    return DEFAULT_MAX_THREADS;
+  return CLAMP(atoi(max_threads), 1, MAX_THREADS);
+}
+
+Test(patterndb_perf, test_correlation_scales_with_the_number_of_threads)
+{
+  gint max_threads = _get_max_threads();
+
+  for (gint num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+    _measure_scaling(num_threads);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  cfg_load_module(configuration, "basicfuncs");
+  cfg_load_module(configuration, "syslogformat");
+  pattern_db_global_init();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(patterndb_perf, .init = setup, .fini = teardown);
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "apphook.h"
+#include "cfg.h"
+#include "logmsg/logmsg.h"
+#include "patterndb.h"
+#include "pdb-cache.h"
+#include "pdb-load.h"
+#include "plugin.h"
+
+#include <criterion/criterion.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#define pdb_cache_skeleton(value) "<patterndb version='4' pub_date='2010-02-22'>\
+ <ruleset name='testset' id='1'>\
+  <patterns>\
+   <pattern>prog</pattern>\
+  </patterns>\
+  <rules>\
+    <rule provider='test' id='1' class='system' context-id='$HOST' context-timeout='30' context-scope='host'>\
+     <patterns>\
+      <pattern>user @STRING:user@ logged in</pattern>\
+     </patterns>\
+     <values>\
+       <value name='origin'>" value "</value>\
+     </values>\
+     <tags>\
+       <tag>login</tag>\
+     </tags>\
+     <actions>\
+       <action trigger='match' condition='\"${user}\" eq \"bob\"' rate='1/60'>\
+         <message>\
+           <values>\
+             <value name='MESSAGE'>${user} logged in</value>\
+           </values>\
+         </message>\
+       </action>\
+     </actions>\
+    </rule>\
+  </rules>\
+ </ruleset>\
+</patterndb>"
+
+static gchar *pdb_filename;
+static gchar *cache_filename;
+
+static void
+_write_pattern_db(const gchar *pdb)
+{
+  cr_assert(g_file_set_contents(pdb_filename, pdb, strlen(pdb), NULL));
+}
+
+static void
+_compile_pattern_db(void)
+{
+  PDBRuleSet *rule_set = pdb_rule_set_new();
+
+  cr_assert(pdb_rule_set_compile(rule_set, configuration, pdb_filename, cache_filename));
+  pdb_rule_set_free(rule_set);
+}
+
+static gboolean
+_is_cache_usable(void)
+{
+  PDBRuleSet *rule_set = pdb_rule_set_new();
+  gboolean usable;
+
+  usable = pdb_cache_load(rule_set, configuration, pdb_filename, cache_filename, NULL);
+  pdb_rule_set_free(rule_set);
+  return usable;
+}
+
+static void
+_set_pattern_db_mtime(time_t mtime)
+{
+  struct utimbuf times = { .actime = mtime, .modtime = mtime };
+
+  cr_assert(utime(pdb_filename, &times) == 0);
+}
+
+static time_t
+_get_pattern_db_mtime(void)
+{
+  struct stat st;
+
+  cr_assert(stat(pdb_filename, &st) == 0);
+  return st.st_mtime;
+}
+
+static PDBRule *
+_lookup_login_rule(PDBRuleSet *rule_set)
+{
+  LogMessage *msg = log_msg_new_empty();
+  PDBLookupParams lookup;
+  PDBRule *rule;
+
+  log_msg_set_value(msg, LM_V_PROGRAM, "prog", -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, "user bob logged in", -1);
+  pdb_lookup_params_init(&lookup, msg, NULL);
+  rule = pdb_ruleset_lookup(rule_set, &lookup, NULL);
+  log_msg_unref(msg);
+  return rule;
+}
+
+static void
+assert_login_message_is_classified(const gchar *expected_origin)
+{
+  PatternDB *patterndb = pattern_db_new();
+  LogMessage *msg = log_msg_new_empty();
+
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, pdb_filename));
+
+  log_msg_set_value(msg, LM_V_PROGRAM, "prog", -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, "user bob logged in", -1);
+  cr_assert(pattern_db_process(patterndb, msg));
+
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "user", NULL), "bob");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "origin", NULL), expected_origin);
+  cr_assert(log_msg_is_tag_by_name(msg, "login"));
+
+  log_msg_unref(msg);
+  pattern_db_free(patterndb);
+}
+
+Test(pdb_cache, test_ruleset_is_loaded_from_the_compiled_cache)
+{
+  _write_pattern_db(pdb_cache_skeleton("compiled"));
+  _compile_pattern_db();
+
+  cr_assert(_is_cache_usable());
+  assert_login_message_is_classified("compiled");
+}
+
+Test(pdb_cache, test_cache_is_ignored_when_the_pattern_db_changes_with_the_same_size_and_mtime)
+{
+  time_t mtime;
+
+  _write_pattern_db(pdb_cache_skeleton("compiled"));
+  mtime = _get_pattern_db_mtime();
+  _compile_pattern_db();
+
+  /* same size and modification time, only the contents tell them apart */
+  _write_pattern_db(pdb_cache_skeleton("modified"));
+  _set_pattern_db_mtime(mtime);
+  cr_assert_not(_is_cache_usable());
+  assert_login_message_is_classified("modified");
+}
+
+Test(pdb_cache, test_rules_and_actions_are_restored_from_the_cache)
+{
+  PDBRuleSet *rule_set = pdb_rule_set_new();
+  PDBRule *rule;
+  PDBAction *action;
+  LogTemplate *value;
+
+  _write_pattern_db(pdb_cache_skeleton("compiled"));
+  _compile_pattern_db();
+  cr_assert(pdb_cache_load(rule_set, configuration, pdb_filename, cache_filename, NULL));
+
+  cr_assert_str_eq(rule_set->version, "4");
+  cr_assert_str_eq(rule_set->pub_date, "2010-02-22");
+
+  rule = _lookup_login_rule(rule_set);
+  cr_assert_not_null(rule);
+  cr_assert_str_eq(rule->rule_id, "1");
+  cr_assert_str_eq(rule->class, "system");
+  cr_assert_eq(rule->msg.tags->len, 2);
+  cr_assert_str_eq(rule->context.id_template->template, "$HOST");
+  cr_assert_eq(rule->context.timeout, 30);
+  cr_assert_eq(rule->context.scope, RCS_HOST);
+
+  cr_assert_eq(rule->actions->len, 1);
+  action = (PDBAction *) g_ptr_array_index(rule->actions, 0);
+  cr_assert_not_null(action->condition);
+  cr_assert_str_eq(action->condition_source, "\"${user}\" eq \"bob\"");
+  cr_assert_eq(action->rate, 1);
+  cr_assert_eq(action->rate_quantum, 60);
+  cr_assert_eq(action->content_type, RAC_MESSAGE);
+
+  value = (LogTemplate *) g_ptr_array_index(action->content.message.values, 0);
+  cr_assert_str_eq(value->name, "MESSAGE");
+  cr_assert_str_eq(value->template, "${user} logged in");
+
+  pdb_rule_unref(rule);
+  pdb_rule_set_free(rule_set);
+}
+
+Test(pdb_cache, test_cache_is_ignored_when_the_pattern_db_changes)
+{
+  _write_pattern_db(pdb_cache_skeleton("compiled"));
+  _compile_pattern_db();
+
+  _write_pattern_db(pdb_cache_skeleton("changed"));
+  cr_assert_not(_is_cache_usable());
+  assert_login_message_is_classified("changed");
+}
+
+Test(pdb_cache, test_cache_is_ignored_when_the_pattern_db_is_touched)
+{
+  _write_pattern_db(pdb_cache_skeleton("compiled"));
+  _compile_pattern_db();
+
+  _set_pattern_db_mtime(1000000000);
+  cr_assert_not(_is_cache_usable());
+  assert_login_message_is_classified("compiled");
+}
+
+Test(pdb_cache, test_damaged_cache_is_ignored)
+{
+  gchar *contents;
+  gsize length;
+
+  _write_pattern_db(pdb_cache_skeleton("compiled"));
+  _compile_pattern_db();
+
+  cr_assert(g_file_get_contents(cache_filename, &contents, &length, NULL));
+  cr_assert(g_file_set_contents(cache_filename, contents, length / 2, NULL));
+  g_free(contents);
+
+  cr_assert_not(_is_cache_usable());
+  assert_login_message_is_classified("compiled");
+}
+
+Test(pdb_cache, test_corrupted_cache_is_ignored)
+{
+  gchar *contents;
+  gsize length;
+
+  _write_pattern_db(pdb_cache_skeleton("compiled"));
+  _compile_pattern_db();
+
+  /* the size is intact, only the payload checksum catches this */
+  cr_assert(g_file_get_contents(cache_filename, &contents, &length, NULL));
+  contents[length - 1] ^= 0x55;
+  cr_assert(g_file_set_contents(cache_filename, contents, length, NULL));
+  g_free(contents);
+
+  cr_assert_not(_is_cache_usable());
+  assert_login_message_is_classified("compiled");
+}
+
+static void
+setup(void)
+{
+  gint fd;
+
+  app_startup();
+  configuration = cfg_new_snippet();
+  cfg_load_module(configuration, "basicfuncs");
+  cfg_load_module(configuration, "syslogformat");
+  pattern_db_global_init();
+
+  fd = g_file_open_tmp("patterndbXXXXXX.xml", &pdb_filename, NULL);
+  close(fd);
+  cache_filename = pdb_cache_get_filename(pdb_filename);
+}
+
+static void
+teardown(void)
+{
+  g_unlink(pdb_filename);
+  g_unlink(cache_filename);
+  g_free(pdb_filename);
+  g_free(cache_filename);
+  app_shutdown();
+}
+
+TestSuite(pdb_cache, .init = setup, .fini = teardown);
@@ -1064,6 +1064,56 @@ ParameterizedTest(RadixTestParam *param, dbparser, test_radix_search_matches, .i
     insert_node(root, param->node_to_insert[i]);
 
   test_search_matches(root, param->key, param->expected_pattern);
+
+  r_freeze_node(root);
+  test_search_matches(root, param->key, param->expected_pattern);
+  r_free_node(root, NULL);
+}
+
+Test(dbparser, test_frozen_tree, .init = test_setup, .fini = test_teardown)
+{
+  RNode *root = r_new_node("", NULL);
+
+  /* enough literal children to be looked up via a bitmap, including
+   * characters above 0x7f and keys not fitting inline */
+  insert_node(root, "alma");
+  insert_node(root, "almafa-with-a-long-key");
+  insert_node(root, "barack");
+  insert_node(root, "citrom");
+  insert_node(root, "dinnye");
+  insert_node(root, "eper");
+  insert_node(root, "fuge");
+  insert_node(root, "grapefruit");
+  insert_node(root, "hagyma");
+  insert_node(root, "\xc3\xa9des");
+  insert_node(root, "korte @NUMBER:num@ darab");
+  insert_node(root, "korte @STRING:name@ fajta");
+  insert_node(root, "uj\nsor");
+
+  r_freeze_node(root);
+  cr_assert(root->frozen);
+
+  test_search(root, "alma", TRUE);
+  test_search(root, "almafa-with-a-long-key", TRUE);
+  test_search(root, "dinnye", TRUE);
+  test_search(root, "hagyma", TRUE);
+  test_search(root, "\xc3\xa9des", TRUE);
+  test_search_value(root, "uj\r\nsor", "uj\nsor");
+  test_search_value(root, "almafa", "alma");
+  test_search(root, "mmm", FALSE);
+  test_search(root, "\xc3\xa9", FALSE);
+
+  const gchar *number_pattern[] = {"num", "12", NULL};
+  test_search_matches(root, "korte 12 darab", number_pattern);
+  const gchar *string_pattern[] = {"name", "vilmos", NULL};
+  test_search_matches(root, "korte vilmos fajta", string_pattern);
+
+  /* inserting drops the frozen form */
+  insert_node(root, "meggy");
+  cr_assert_not(root->frozen);
+  test_search(root, "meggy", TRUE);
+  test_search(root, "alma", TRUE);
+
   r_free_node(root, NULL);
 }
 
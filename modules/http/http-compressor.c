@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "http-compressor.h"
+
+#include <string.h>
+#include <zlib.h>
+#if SYSLOG_NG_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/* the compressed data is written directly into the output GString, it is
+ * grown by at least this much whenever it runs out of space */
+#define HTTP_COMPRESSOR_OUTPUT_CHUNK 16384
+
+/* windowBits of deflateInit2(), adding 16 selects the gzip wrapper */
+#define HTTP_COMPRESSOR_ZLIB_WINDOW_BITS 15
+#define HTTP_COMPRESSOR_GZIP_WINDOW_BITS (HTTP_COMPRESSOR_ZLIB_WINDOW_BITS + 16)
+
+struct _HTTPCompressor
+{
+  HTTPCompressionType type;
+  /* set if any of the compression steps failed since the last reset,
+   * reported by http_compressor_finish() */
+  gboolean failed;
+  z_stream zlib;
+#if SYSLOG_NG_HAVE_ZSTD
+  ZSTD_CCtx *zstd;
+#endif
+};
+
+gboolean
+http_compression_type_from_name(const gchar *name, HTTPCompressionType *type)
+{
+  if (strcmp(name, "none") == 0)
+    *type = HTTP_COMPRESSION_NONE;
+  else if (strcmp(name, "gzip") == 0)
+    *type = HTTP_COMPRESSION_GZIP;
+  else if (strcmp(name, "deflate") == 0)
+    *type = HTTP_COMPRESSION_DEFLATE;
+#if SYSLOG_NG_HAVE_ZSTD
+  else if (strcmp(name, "zstd") == 0)
+    *type = HTTP_COMPRESSION_ZSTD;
+#endif
+  else
+    return FALSE;
+  return TRUE;
+}
+
+const gchar *
+http_compression_type_get_content_encoding(HTTPCompressionType type)
+{
+  switch (type)
+    {
+    case HTTP_COMPRESSION_GZIP:
+      return "gzip";
+    case HTTP_COMPRESSION_DEFLATE:
+      return "deflate";
+    case HTTP_COMPRESSION_ZSTD:
+      return "zstd";
+    default:
+      return NULL;
+    }
+}
+
+static guchar *
+_reserve_output(GString *output, gsize *available)
+{
+  gsize len = output->len;
+
+  if (output->allocated_len - len <= HTTP_COMPRESSOR_OUTPUT_CHUNK)
+    {
+      /* grows the allocation while keeping the content */
+      g_string_set_size(output, len + HTTP_COMPRESSOR_OUTPUT_CHUNK);
+      g_string_truncate(output, len);
+    }
+
+  /* leave room for the terminating NUL */
+  *available = output->allocated_len - len - 1;
+  return (guchar *) output->str + len;
+}
+
+static void
+_commit_output(GString *output, gsize produced)
+{
+  output->len += produced;
+  output->str[output->len] = 0;
+}
+
+static void
+_deflate(HTTPCompressor *self, const gchar *data, gsize data_len, gint flush, GString *output)
+{
+  z_stream *stream = &self->zlib;
+  gint rc;
+
+  stream->next_in = (Bytef *) data;
+  stream->avail_in = data_len;
+  do
+    {
+      gsize available;
+
+      stream->next_out = _reserve_output(output, &available);
+      stream->avail_out = MIN(available, G_MAXUINT);
+      available = stream->avail_out;
+
+      rc = deflate(stream, flush);
+      _commit_output(output, available - stream->avail_out);
+
+      if (rc == Z_STREAM_ERROR)
+        {
+          self->failed = TRUE;
+          return;
+        }
+    }
+  while (flush == Z_FINISH ? rc != Z_STREAM_END : stream->avail_out == 0);
+}
+
+#if SYSLOG_NG_HAVE_ZSTD
+
+static void
+_zstd_compress(HTTPCompressor *self, const gchar *data, gsize data_len, ZSTD_EndDirective mode, GString *output)
+{
+  ZSTD_inBuffer input = { data, data_len, 0 };
+  gsize remaining;
+
+  do
+    {
+      ZSTD_outBuffer out = { 0 };
+
+      out.dst = _reserve_output(output, &out.size);
+      remaining = ZSTD_compressStream2(self->zstd, &out, &input, mode);
+      _commit_output(output, out.pos);
+
+      if (ZSTD_isError(remaining))
+        {
+          self->failed = TRUE;
+          return;
+        }
+    }
+  while (mode == ZSTD_e_end ? remaining != 0 : input.pos < input.size);
+}
+
+#endif
+
+void
+http_compressor_reset(HTTPCompressor *self)
+{
+  self->failed = FALSE;
+  switch (self->type)
+    {
+    case HTTP_COMPRESSION_GZIP:
+    case HTTP_COMPRESSION_DEFLATE:
+      deflateReset(&self->zlib);
+      break;
+#if SYSLOG_NG_HAVE_ZSTD
+    case HTTP_COMPRESSION_ZSTD:
+      ZSTD_CCtx_reset(self->zstd, ZSTD_reset_session_only);
+      break;
+#endif
+    default:
+      g_assert_not_reached();
+    }
+}
+
+void
+http_compressor_compress(HTTPCompressor *self, const gchar *data, gsize data_len, GString *output)
+{
+  if (data_len == 0 || self->failed)
+    return;
+
+  switch (self->type)
+    {
+    case HTTP_COMPRESSION_GZIP:
+    case HTTP_COMPRESSION_DEFLATE:
+      _deflate(self, data, data_len, Z_NO_FLUSH, output);
+      break;
+#if SYSLOG_NG_HAVE_ZSTD
+    case HTTP_COMPRESSION_ZSTD:
+      _zstd_compress(self, data, data_len, ZSTD_e_continue, output);
+      break;
+#endif
+    default:
+      g_assert_not_reached();
+    }
+}
+
+/* flushes the data buffered by the compressor and closes the stream,
+ * returns FALSE if the compressed output is incomplete */
+gboolean
+http_compressor_finish(HTTPCompressor *self, GString *output)
+{
+  if (self->failed)
+    return FALSE;
+
+  switch (self->type)
+    {
+    case HTTP_COMPRESSION_GZIP:
+    case HTTP_COMPRESSION_DEFLATE:
+      _deflate(self, NULL, 0, Z_FINISH, output);
+      break;
+#if SYSLOG_NG_HAVE_ZSTD
+    case HTTP_COMPRESSION_ZSTD:
+      _zstd_compress(self, NULL, 0, ZSTD_e_end, output);
+      break;
+#endif
+    default:
+      g_assert_not_reached();
+    }
+  return !self->failed;
+}
+
+HTTPCompressor *
+http_compressor_new(HTTPCompressionType type)
+{
+  HTTPCompressor *self = g_new0(HTTPCompressor, 1);
+  gint rc;
+
+  self->type = type;
+  switch (type)
+    {
+    case HTTP_COMPRESSION_GZIP:
+    case HTTP_COMPRESSION_DEFLATE:
+      rc = deflateInit2(&self->zlib, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                        type == HTTP_COMPRESSION_GZIP ? HTTP_COMPRESSOR_GZIP_WINDOW_BITS : HTTP_COMPRESSOR_ZLIB_WINDOW_BITS,
+                        8, Z_DEFAULT_STRATEGY);
+      if (rc != Z_OK)
+        {
+          g_free(self);
+          return NULL;
+        }
+      break;
+#if SYSLOG_NG_HAVE_ZSTD
+    case HTTP_COMPRESSION_ZSTD:
+      if (!(self->zstd = ZSTD_createCCtx()))
+        {
+          g_free(self);
+          return NULL;
+        }
+      break;
+#endif
+    default:
+      g_assert_not_reached();
+    }
+  return self;
+}
+
+void
+http_compressor_free(HTTPCompressor *self)
+{
+  switch (self->type)
+    {
+    case HTTP_COMPRESSION_GZIP:
+    case HTTP_COMPRESSION_DEFLATE:
+      deflateEnd(&self->zlib);
+      break;
+#if SYSLOG_NG_HAVE_ZSTD
+    case HTTP_COMPRESSION_ZSTD:
+      ZSTD_freeCCtx(self->zstd);
+      break;
+#endif
+    default:
+      g_assert_not_reached();
+    }
+  g_free(self);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef HTTP_COMPRESSOR_H_INCLUDED
+#define HTTP_COMPRESSOR_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/*
+ * HTTPCompressor compresses a request body as a stream: data is fed in
+ * as it is appended to the batch and the compressed output is appended to
+ * the body right away, so the uncompressed batch is never kept in memory
+ * as a whole.
+ */
+typedef enum
+{
+  HTTP_COMPRESSION_NONE,
+  HTTP_COMPRESSION_GZIP,
+  HTTP_COMPRESSION_DEFLATE,
+  HTTP_COMPRESSION_ZSTD,
+} HTTPCompressionType;
+
+typedef struct _HTTPCompressor HTTPCompressor;
+
+gboolean http_compression_type_from_name(const gchar *name, HTTPCompressionType *type);
+const gchar *http_compression_type_get_content_encoding(HTTPCompressionType type);
+
+void http_compressor_reset(HTTPCompressor *self);
+void http_compressor_compress(HTTPCompressor *self, const gchar *data, gsize data_len, GString *output);
+gboolean http_compressor_finish(HTTPCompressor *self, GString *output);
+
+HTTPCompressor *http_compressor_new(HTTPCompressionType type);
+void http_compressor_free(HTTPCompressor *self);
+
+#endif
@@ -57,6 +57,8 @@ static CfgLexerKeyword http_keywords[] =
   { "tls",              KW_TLS },
   { "flush_bytes",      KW_BATCH_BYTES, KWS_OBSOLETE, "The flush-bytes option is deprecated. Use batch-bytes instead." },
   { "batch_bytes",      KW_BATCH_BYTES },
+  { "max_in_flight_requests", KW_MAX_IN_FLIGHT_REQUESTS },
+  { "compression",      KW_COMPRESSION },
   { "flush_lines",      KW_BATCH_LINES, KWS_OBSOLETE, "The flush-lines option is deprecated. Use batch-lines instead."},
   { "flush_timeout",    KW_BATCH_TIMEOUT, KWS_OBSOLETE, "The flush-timeout option is deprecated. Use batch-timeout instead."},
   { "body_prefix",      KW_BODY_PREFIX },
@@ -27,6 +27,9 @@
 #include "syslog-names.h"
 #include "scratch-buffers.h"
 #include "http-signals.h"
+#include "timeutils/misc.h"
+
+#include <poll.h>
 
 #define HTTP_HEADER_FORMAT_ERROR http_header_format_error_quark()
 
@@ -101,62 +104,62 @@ _curl_write_function(char *ptr, size_t size, size_t nmemb, void *userdata)
  * request specific options will be set separately
  */
 static void
-_setup_static_options_in_curl(HTTPDestinationWorker *self)
+_setup_static_options_in_curl(HTTPDestinationWorker *self, CURL *curl)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
-  curl_easy_reset(self->curl);
+  curl_easy_reset(curl);
 
-  curl_easy_setopt(self->curl, CURLOPT_WRITEFUNCTION, _curl_write_function);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _curl_write_function);
 
-  curl_easy_setopt(self->curl, CURLOPT_URL, owner->url);
+  curl_easy_setopt(curl, CURLOPT_URL, owner->url);
 
   if (owner->user)
-    curl_easy_setopt(self->curl, CURLOPT_USERNAME, owner->user);
+    curl_easy_setopt(curl, CURLOPT_USERNAME, owner->user);
 
   if (owner->password)
-    curl_easy_setopt(self->curl, CURLOPT_PASSWORD, owner->password);
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, owner->password);
 
   if (owner->user_agent)
-    curl_easy_setopt(self->curl, CURLOPT_USERAGENT, owner->user_agent);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, owner->user_agent);
 
   if (owner->ca_dir)
-    curl_easy_setopt(self->curl, CURLOPT_CAPATH, owner->ca_dir);
+    curl_easy_setopt(curl, CURLOPT_CAPATH, owner->ca_dir);
 
   if (owner->ca_file)
-    curl_easy_setopt(self->curl, CURLOPT_CAINFO, owner->ca_file);
+    curl_easy_setopt(curl, CURLOPT_CAINFO, owner->ca_file);
 
   if (owner->cert_file)
-    curl_easy_setopt(self->curl, CURLOPT_SSLCERT, owner->cert_file);
+    curl_easy_setopt(curl, CURLOPT_SSLCERT, owner->cert_file);
 
   if (owner->key_file)
-    curl_easy_setopt(self->curl, CURLOPT_SSLKEY, owner->key_file);
+    curl_easy_setopt(curl, CURLOPT_SSLKEY, owner->key_file);
 
   if (owner->ciphers)
-    curl_easy_setopt(self->curl, CURLOPT_SSL_CIPHER_LIST, owner->ciphers);
+    curl_easy_setopt(curl, CURLOPT_SSL_CIPHER_LIST, owner->ciphers);
 
   if (owner->proxy)
-    curl_easy_setopt(self->curl, CURLOPT_PROXY, owner->proxy);
+    curl_easy_setopt(curl, CURLOPT_PROXY, owner->proxy);
 
-  curl_easy_setopt(self->curl, CURLOPT_SSLVERSION, owner->ssl_version);
-  curl_easy_setopt(self->curl, CURLOPT_SSL_VERIFYHOST, owner->peer_verify ? 2L : 0L);
-  curl_easy_setopt(self->curl, CURLOPT_SSL_VERIFYPEER, owner->peer_verify ? 1L : 0L);
+  curl_easy_setopt(curl, CURLOPT_SSLVERSION, owner->ssl_version);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, owner->peer_verify ? 2L : 0L);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, owner->peer_verify ? 1L : 0L);
 
-  curl_easy_setopt(self->curl, CURLOPT_DEBUGFUNCTION, _curl_debug_function);
-  curl_easy_setopt(self->curl, CURLOPT_DEBUGDATA, self);
-  curl_easy_setopt(self->curl, CURLOPT_VERBOSE, 1L);
+  curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, _curl_debug_function);
+  curl_easy_setopt(curl, CURLOPT_DEBUGDATA, self);
+  curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
 
   if (owner->accept_redirects)
     {
-      curl_easy_setopt(self->curl, CURLOPT_FOLLOWLOCATION, 1);
-      curl_easy_setopt(self->curl, CURLOPT_POSTREDIR, CURL_REDIR_POST_ALL);
-      curl_easy_setopt(self->curl, CURLOPT_REDIR_PROTOCOLS, CURLPROTO_HTTP | CURLPROTO_HTTPS);
-      curl_easy_setopt(self->curl, CURLOPT_MAXREDIRS, 3);
+      curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
+      curl_easy_setopt(curl, CURLOPT_POSTREDIR, CURL_REDIR_POST_ALL);
+      curl_easy_setopt(curl, CURLOPT_REDIR_PROTOCOLS, CURLPROTO_HTTP | CURLPROTO_HTTPS);
+      curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 3);
     }
-  curl_easy_setopt(self->curl, CURLOPT_TIMEOUT, owner->timeout);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT, owner->timeout);
 
   if (owner->method_type == METHOD_TYPE_PUT)
-    curl_easy_setopt(self->curl, CURLOPT_CUSTOMREQUEST, "PUT");
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
 }
 
 
@@ -246,6 +249,9 @@ _add_common_headers(HTTPDestinationWorker *self)
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   _add_header(self->request_headers, "Expect", "");
+  if (self->compressor)
+    _add_header(self->request_headers, "Content-Encoding",
+                http_compression_type_get_content_encoding(owner->compression));
   for (GList *l = owner->headers; l; l = l->next)
     list_append(self->request_headers, l->data);
 }
@@ -260,6 +266,18 @@ _try_format_request_headers(HTTPDestinationWorker *self, GError **error)
   return (*error == NULL);
 }
 
+/* with compression() the data is compressed right as it is added to the
+ * batch, request_body only holds the compressed stream */
+static void
+_append_to_request_body(HTTPDestinationWorker *self, const gchar *data, gsize data_len)
+{
+  self->request_body_len += data_len;
+  if (self->compressor)
+    http_compressor_compress(self->compressor, data, data_len, self->request_body);
+  else
+    g_string_append_len(self->request_body, data, data_len);
+}
+
 static void
 _add_message_to_batch(HTTPDestinationWorker *self, LogMessage *msg)
 {
@@ -267,18 +285,34 @@ _add_message_to_batch(HTTPDestinationWorker *self, LogMessage *msg)
 
   if (self->super.batch_size > 1)
     {
-      g_string_append_len(self->request_body, owner->delimiter->str, owner->delimiter->len);
+      _append_to_request_body(self, owner->delimiter->str, owner->delimiter->len);
     }
   if (owner->body_template)
     {
       LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND,
                                         self->super.seq_num, NULL
                                        };
-      log_template_append_format(owner->body_template, msg, &options, self->request_body);
+      if (self->compressor)
+        {
+          GString *formatted = scratch_buffers_alloc();
+
+          log_template_format(owner->body_template, msg, &options, formatted);
+          _append_to_request_body(self, formatted->str, formatted->len);
+        }
+      else
+        {
+          gsize orig_len = self->request_body->len;
+
+          log_template_append_format(owner->body_template, msg, &options, self->request_body);
+          self->request_body_len += self->request_body->len - orig_len;
+        }
     }
   else
     {
-      g_string_append(self->request_body, log_msg_get_value(msg, LM_V_MESSAGE, NULL));
+      gssize value_len;
+      const gchar *value = log_msg_get_value(msg, LM_V_MESSAGE, &value_len);
+
+      _append_to_request_body(self, value, value_len);
     }
 }
 
@@ -408,35 +442,51 @@ _reinit_request_body(HTTPDestinationWorker *self)
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   g_string_truncate(self->request_body, 0);
+  self->request_body_len = 0;
+  if (self->compressor)
+    http_compressor_reset(self->compressor);
   if (owner->body_prefix->len > 0)
-    g_string_append_len(self->request_body, owner->body_prefix->str, owner->body_prefix->len);
+    _append_to_request_body(self, owner->body_prefix->str, owner->body_prefix->len);
 
 }
 
-static void
+static gboolean
 _finish_request_body(HTTPDestinationWorker *self)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   if (owner->body_suffix->len > 0)
-    g_string_append_len(self->request_body, owner->body_suffix->str, owner->body_suffix->len);
+    _append_to_request_body(self, owner->body_suffix->str, owner->body_suffix->len);
+
+  if (self->compressor && !http_compressor_finish(self->compressor, self->request_body))
+    {
+      msg_error("http: error compressing request body, dropping batch",
+                evt_tag_str("compression", http_compression_type_get_content_encoding(owner->compression)),
+                evt_tag_int("batch_size", self->super.batch_size),
+                evt_tag_int("worker_index", self->super.worker_index),
+                evt_tag_str("driver", owner->super.super.super.id),
+                log_pipe_location_tag(&owner->super.super.super.super));
+      return FALSE;
+    }
+  return TRUE;
 }
 
 static void
-_debug_response_info(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target, glong http_code)
+_debug_response_info(HTTPDestinationWorker *self, CURL *curl, HTTPLoadBalancerTarget *target, glong http_code,
+                     gsize body_size, gint batch_size)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   gdouble total_time = 0;
   glong redirect_count = 0;
 
-  curl_easy_getinfo(self->curl, CURLINFO_TOTAL_TIME, &total_time);
-  curl_easy_getinfo(self->curl, CURLINFO_REDIRECT_COUNT, &redirect_count);
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time);
+  curl_easy_getinfo(curl, CURLINFO_REDIRECT_COUNT, &redirect_count);
   msg_debug("curl: HTTP response received",
             evt_tag_str("url", target->url),
             evt_tag_int("status_code", http_code),
-            evt_tag_int("body_size", self->request_body->len),
-            evt_tag_int("batch_size", self->super.batch_size),
+            evt_tag_int("body_size", body_size),
+            evt_tag_int("batch_size", batch_size),
             evt_tag_int("redirected", redirect_count != 0),
             evt_tag_printf("total_time", "%.3f", total_time),
             evt_tag_int("worker_index", self->super.worker_index),
@@ -508,6 +558,7 @@ _curl_perform_request(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *targe
   curl_easy_setopt(self->curl, CURLOPT_URL, target->url);
   curl_easy_setopt(self->curl, CURLOPT_HTTPHEADER, http_curl_header_list_as_slist(self->request_headers));
   curl_easy_setopt(self->curl, CURLOPT_POSTFIELDS, self->request_body->str);
+  curl_easy_setopt(self->curl, CURLOPT_POSTFIELDSIZE, (long) self->request_body->len);
 
   CURLcode ret = curl_easy_perform(self->curl);
   if (ret != CURLE_OK)
@@ -525,10 +576,10 @@ _curl_perform_request(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *targe
 }
 
 static gboolean
-_curl_get_status_code(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target, glong *http_code)
+_curl_get_status_code(HTTPDestinationWorker *self, CURL *curl, HTTPLoadBalancerTarget *target, glong *http_code)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
-  CURLcode ret = curl_easy_getinfo(self->curl, CURLINFO_RESPONSE_CODE, http_code);
+  CURLcode ret = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_code);
 
   if (ret != CURLE_OK)
     {
@@ -568,21 +619,19 @@ _map_http_status_code(HTTPDestinationWorker *self, const gchar *url, glong http_
   return default_map_http_status_to_worker_status(self, url, http_code);
 }
 
+/* maps the response of a completed transfer to the result of the batch it delivered */
 static LogThreadedResult
-_flush_on_target(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
+_map_http_response(HTTPDestinationWorker *self, CURL *curl, HTTPLoadBalancerTarget *target,
+                   gsize body_size, gint batch_size)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
-
-  if (!_curl_perform_request(self, target))
-    return LTR_NOT_CONNECTED;
-
   glong http_code = 0;
 
-  if (!_curl_get_status_code(self, target, &http_code))
+  if (!_curl_get_status_code(self, curl, target, &http_code))
     return LTR_NOT_CONNECTED;
 
   if (debug_flag)
-    _debug_response_info(self, target, http_code);
+    _debug_response_info(self, curl, target, http_code, body_size, batch_size);
 
   HttpResponseReceivedSignalData signal_data =
   {
@@ -602,6 +651,15 @@ _flush_on_target(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
   return _map_http_status_code(self, target->url, http_code);
 }
 
+static LogThreadedResult
+_flush_on_target(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
+{
+  if (!_curl_perform_request(self, target))
+    return LTR_NOT_CONNECTED;
+
+  return _map_http_response(self, self->curl, target, self->request_body->len, self->super.batch_size);
+}
+
 static gboolean
 _format_request_headers_error_is_critical(GError *error)
 {
@@ -657,12 +715,21 @@ _flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
   if (mode == LTF_FLUSH_EXPEDITE)
     return LTR_RETRY;
 
-  _finish_request_body(self);
+  if (!_finish_request_body(self))
+    {
+      _reinit_request_headers(self);
+      _reinit_request_body(self);
+      return LTR_DROP;
+    }
 
   if (!_try_format_request_headers(self, &error))
     {
       if (!_format_request_headers_catch_error(&error))
-        return LTR_NOT_CONNECTED;
+        {
+          _reinit_request_headers(self);
+          _reinit_request_body(self);
+          return LTR_NOT_CONNECTED;
+        }
     }
 
   target = http_load_balancer_choose_target(owner->load_balancer, &self->lbc);
@@ -712,7 +779,7 @@ _should_initiate_flush(HTTPDestinationWorker *self)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
-  return (owner->batch_bytes && self->request_body->len + owner->body_suffix->len >= owner->batch_bytes);
+  return (owner->batch_bytes && self->request_body_len + owner->body_suffix->len >= owner->batch_bytes);
 
 }
 
@@ -721,9 +788,9 @@ _insert_batched(LogThreadedDestWorker *s, LogMessage *msg)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
 
-  gsize orig_msg_len = self->request_body->len;
+  gsize orig_msg_len = self->request_body_len;
   _add_message_to_batch(self, msg);
-  gsize diff_msg_len = self->request_body->len - orig_msg_len;
+  gsize diff_msg_len = self->request_body_len - orig_msg_len;
   log_threaded_dest_driver_insert_msg_length_stats(self->super.owner, diff_msg_len);
 
   if (_should_initiate_flush(self))
@@ -738,9 +805,9 @@ _insert_single(LogThreadedDestWorker *s, LogMessage *msg)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
 
-  gsize orig_msg_len = self->request_body->len;
+  gsize orig_msg_len = self->request_body_len;
   _add_message_to_batch(self, msg);
-  gsize diff_msg_len = self->request_body->len - orig_msg_len;
+  gsize diff_msg_len = self->request_body_len - orig_msg_len;
   log_threaded_dest_driver_insert_msg_length_stats(self->super.owner, diff_msg_len);
 
   _add_msg_specific_headers(self, msg);
@@ -748,23 +815,633 @@ _insert_single(LogThreadedDestWorker *s, LogMessage *msg)
   return log_threaded_dest_worker_flush(&self->super, LTF_FLUSH_NORMAL);
 }
 
+/* Asynchronous mode
+ *
+ * With max-in-flight-requests() larger than 1, flush() hands the batch
+ * over to a curl multi handle and returns without waiting for the
+ * response.  Transfers are driven by ivykis watches on the sockets curl
+ * uses, so a single worker keeps several requests in flight, either on
+ * parallel keep-alive connections or multiplexed over HTTP/2.
+ *
+ * The messages of in-flight batches are kept on the backlog of the queue,
+ * but they are not accounted in batch_size anymore.  As batches are added
+ * to the backlog in the order they were submitted, responses are resolved
+ * in the same order: a completed request is only acked once all the
+ * requests in front of it have been acked.  A failed request is sent again
+ * to an alternative target of the load balancer, the same way as in the
+ * synchronous case.  If there is none left, everything behind it is
+ * rewound and the result is processed for the failed batch alone.
+ */
+
+typedef struct _HTTPInFlightRequest
+{
+  CURL *curl;
+  GString *body;
+  List *headers;
+  HTTPLoadBalancerTarget *target;
+  /* number of alternative targets the request may still be sent to */
+  gint retry_attempts;
+  gint batch_size;
+  gboolean completed;
+  CURLcode result;
+} HTTPInFlightRequest;
+
+typedef struct _HTTPSocketWatch
+{
+  HTTPDestinationWorker *worker;
+  struct iv_fd fd;
+  gint what;
+} HTTPSocketWatch;
+
+static HTTPInFlightRequest *
+_in_flight_request_new(HTTPDestinationWorker *self)
+{
+  HTTPInFlightRequest *request = g_new0(HTTPInFlightRequest, 1);
+
+  request->body = g_string_sized_new(32768);
+  request->headers = http_curl_header_list_new();
+  request->curl = curl_easy_init();
+  if (request->curl)
+    {
+      _setup_static_options_in_curl(self, request->curl);
+      curl_easy_setopt(request->curl, CURLOPT_PRIVATE, request);
+    }
+  return request;
+}
+
+static void
+_in_flight_request_free(HTTPInFlightRequest *request)
+{
+  if (request->curl)
+    curl_easy_cleanup(request->curl);
+  g_string_free(request->body, TRUE);
+  list_free(request->headers);
+  g_free(request);
+}
+
+static void
+_send_in_flight_request(HTTPDestinationWorker *self, HTTPInFlightRequest *request, HTTPLoadBalancerTarget *target)
+{
+  request->target = target;
+  request->completed = FALSE;
+  request->result = CURLE_OK;
+
+  curl_easy_setopt(request->curl, CURLOPT_URL, target->url);
+  curl_multi_add_handle(self->multi, request->curl);
+}
+
+static void
+_socket_watch_event(HTTPSocketWatch *watch, gint ev_bitmask);
+
+static void
+_socket_watch_in(gpointer s)
+{
+  _socket_watch_event((HTTPSocketWatch *) s, CURL_CSELECT_IN);
+}
+
+static void
+_socket_watch_out(gpointer s)
+{
+  _socket_watch_event((HTTPSocketWatch *) s, CURL_CSELECT_OUT);
+}
+
+static void
+_socket_watch_err(gpointer s)
+{
+  _socket_watch_event((HTTPSocketWatch *) s, CURL_CSELECT_ERR);
+}
+
+static HTTPSocketWatch *
+_socket_watch_new(HTTPDestinationWorker *self, curl_socket_t sock)
+{
+  HTTPSocketWatch *watch = g_new0(HTTPSocketWatch, 1);
+
+  watch->worker = self;
+  IV_FD_INIT(&watch->fd);
+  watch->fd.fd = sock;
+  watch->fd.cookie = watch;
+  watch->fd.handler_err = _socket_watch_err;
+  iv_fd_register(&watch->fd);
+  g_ptr_array_add(self->socket_watches, watch);
+  return watch;
+}
+
+static void
+_socket_watch_free(HTTPSocketWatch *watch)
+{
+  iv_fd_unregister(&watch->fd);
+  g_ptr_array_remove_fast(watch->worker->socket_watches, watch);
+  g_free(watch);
+}
+
+static gint
+_curl_socket_function(CURL *easy, curl_socket_t sock, gint what, gpointer userp, gpointer socketp)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) userp;
+  HTTPSocketWatch *watch = (HTTPSocketWatch *) socketp;
+
+  if (what == CURL_POLL_REMOVE)
+    {
+      if (watch)
+        _socket_watch_free(watch);
+      return 0;
+    }
+
+  if (!watch)
+    {
+      watch = _socket_watch_new(self, sock);
+      curl_multi_assign(self->multi, sock, watch);
+    }
+
+  watch->what = what;
+  iv_fd_set_handler_in(&watch->fd, (what & CURL_POLL_IN) ? _socket_watch_in : NULL);
+  iv_fd_set_handler_out(&watch->fd, (what & CURL_POLL_OUT) ? _socket_watch_out : NULL);
+  return 0;
+}
+
+static gint
+_curl_timer_function(CURLM *multi, glong timeout_ms, gpointer userp)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) userp;
+
+  if (iv_timer_registered(&self->multi_timer))
+    iv_timer_unregister(&self->multi_timer);
+
+  if (timeout_ms < 0)
+    return 0;
+
+  iv_validate_now();
+  self->multi_timer.expires = iv_now;
+  timespec_add_msec(&self->multi_timer.expires, timeout_ms);
+  iv_timer_register(&self->multi_timer);
+  return 0;
+}
+
+static void
+_collect_completed_transfers(HTTPDestinationWorker *self)
+{
+  CURLMsg *msg;
+  gint msgs_left;
+
+  while ((msg = curl_multi_info_read(self->multi, &msgs_left)))
+    {
+      HTTPInFlightRequest *request = NULL;
+      CURL *curl = msg->easy_handle;
+
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      curl_easy_getinfo(curl, CURLINFO_PRIVATE, (gchar **) &request);
+      request->result = msg->data.result;
+      request->completed = TRUE;
+
+      /* msg is invalidated by removing the handle */
+      curl_multi_remove_handle(self->multi, curl);
+    }
+}
+
+static void
+_multi_socket_action(HTTPDestinationWorker *self, curl_socket_t sock, gint ev_bitmask)
+{
+  gint running_handles;
+
+  curl_multi_socket_action(self->multi, sock, ev_bitmask, &running_handles);
+  _collect_completed_transfers(self);
+}
+
+/* in-flight batches are not accounted in the worker's batch_size, take
+ * them back before acking or rewinding them */
+static void
+_take_back_batch(HTTPDestinationWorker *self, gint batch_size)
+{
+  self->super.batch_size += batch_size;
+}
+
+static LogThreadedResult
+_fail_in_flight_requests(HTTPDestinationWorker *self, HTTPInFlightRequest *failed_request, LogThreadedResult result)
+{
+  HTTPInFlightRequest *request;
+
+  /* batches behind the failed one, including the one being collected, are
+   * newer on the backlog: rewind them and leave the failed batch to the
+   * usual result processing */
+  gint rewind_count = self->super.batch_size;
+
+  while ((request = g_queue_pop_head(self->in_flight_requests)))
+    {
+      if (!request->completed)
+        curl_multi_remove_handle(self->multi, request->curl);
+
+      _take_back_batch(self, request->batch_size);
+      rewind_count += request->batch_size;
+      g_queue_push_tail(self->idle_requests, request);
+    }
+
+  if (rewind_count > 0)
+    log_threaded_dest_worker_rewind_messages(&self->super, rewind_count);
+  _reinit_request_headers(self);
+  _reinit_request_body(self);
+
+  _take_back_batch(self, failed_request->batch_size);
+  g_queue_push_tail(self->idle_requests, failed_request);
+  return result;
+}
+
+static LogThreadedResult
+_map_in_flight_request_result(HTTPDestinationWorker *self, HTTPInFlightRequest *request)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+
+  if (request->result != CURLE_OK)
+    {
+      msg_error("curl: error sending HTTP request",
+                evt_tag_str("url", request->target->url),
+                evt_tag_str("error", curl_easy_strerror(request->result)),
+                evt_tag_int("worker_index", self->super.worker_index),
+                evt_tag_str("driver", owner->super.super.super.id),
+                log_pipe_location_tag(&owner->super.super.super.super));
+      return LTR_NOT_CONNECTED;
+    }
+
+  return _map_http_response(self, request->curl, request->target, request->body->len, request->batch_size);
+}
+
 static gboolean
-_thread_init(LogThreadedDestWorker *s)
+_resend_in_flight_request_to_alt_target(HTTPDestinationWorker *self, HTTPInFlightRequest *request)
 {
-  HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+  HTTPLoadBalancerTarget *alt_target;
 
-  self->request_body = g_string_sized_new(32768);
-  self->request_headers = http_curl_header_list_new();
-  if (!(self->curl = curl_easy_init()))
+  if (request->retry_attempts <= 0)
+    return FALSE;
+
+  alt_target = http_load_balancer_choose_target(owner->load_balancer, &self->lbc);
+  if (alt_target == request->target)
     {
-      msg_error("curl: cannot initialize libcurl",
+      msg_debug("Target server down, but no alternative server available. Falling back to retrying after time-reopen()",
+                evt_tag_str("url", request->target->url),
                 evt_tag_int("worker_index", self->super.worker_index),
                 evt_tag_str("driver", owner->super.super.super.id),
                 log_pipe_location_tag(&owner->super.super.super.super));
       return FALSE;
     }
-  _setup_static_options_in_curl(self);
+
+  msg_debug("Target server down, trying an alternative server",
+            evt_tag_str("url", request->target->url),
+            evt_tag_str("alternative_url", alt_target->url),
+            evt_tag_int("worker_index", self->super.worker_index),
+            evt_tag_str("driver", owner->super.super.super.id),
+            log_pipe_location_tag(&owner->super.super.super.super));
+
+  request->retry_attempts--;
+  _send_in_flight_request(self, request, alt_target);
+  return TRUE;
+}
+
+/* Acks completed requests in submission order.  Returns LTR_SUCCESS if
+ * there was no failure, otherwise the result of the failed request, with
+ * batch_size covering the failed batch. */
+static LogThreadedResult
+_resolve_completed_requests(HTTPDestinationWorker *self)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+  HTTPInFlightRequest *request;
+
+  while ((request = g_queue_peek_head(self->in_flight_requests)) && request->completed)
+    {
+      LogThreadedResult result = _map_in_flight_request_result(self, request);
+
+      if (result != LTR_SUCCESS)
+        {
+          http_load_balancer_set_target_failed(owner->load_balancer, request->target);
+
+          /* the request keeps its place in the queue while it is resent */
+          if (_resend_in_flight_request_to_alt_target(self, request))
+            break;
+
+          g_queue_pop_head(self->in_flight_requests);
+          return _fail_in_flight_requests(self, request, result);
+        }
+
+      g_queue_pop_head(self->in_flight_requests);
+      log_threaded_dest_driver_insert_batch_length_stats(self->super.owner, request->body->len);
+      http_load_balancer_set_target_successful(owner->load_balancer, request->target);
+
+      _take_back_batch(self, request->batch_size);
+      log_threaded_dest_worker_ack_messages(&self->super, request->batch_size);
+      g_queue_push_tail(self->idle_requests, request);
+    }
+  return LTR_SUCCESS;
+}
+
+/* NOTE: runs from ivykis callbacks, e.g. outside of insert()/flush() */
+static void
+_resolve_completed_requests_async(HTTPDestinationWorker *self)
+{
+  LogThreadedResult result = _resolve_completed_requests(self);
+
+  if (result != LTR_SUCCESS)
+    log_threaded_dest_worker_process_async_result(&self->super, result);
+}
+
+static void
+_socket_watch_event(HTTPSocketWatch *watch, gint ev_bitmask)
+{
+  HTTPDestinationWorker *self = watch->worker;
+
+  /* watch might be freed by curl from here on */
+  _multi_socket_action(self, watch->fd.fd, ev_bitmask);
+  _resolve_completed_requests_async(self);
+}
+
+static void
+_multi_timer_expired(gpointer s)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
+
+  _multi_socket_action(self, CURL_SOCKET_TIMEOUT, 0);
+  _resolve_completed_requests_async(self);
+}
+
+static gint
+_get_multi_timeout_msec(HTTPDestinationWorker *self)
+{
+  const gint max_timeout = 1000;
+
+  if (!iv_timer_registered(&self->multi_timer))
+    return max_timeout;
+
+  iv_validate_now();
+  glong timeout = timespec_diff_msec(&self->multi_timer.expires, &iv_now);
+  return CLAMP(timeout, 0, max_timeout);
+}
+
+/* Waits for socket events synchronously, bypassing ivykis, used from
+ * flush() when all the requests are in flight or when draining them at
+ * shutdown. */
+static void
+_wait_for_multi_events(HTTPDestinationWorker *self)
+{
+  guint num_fds = self->socket_watches->len;
+  struct pollfd *fds = g_newa(struct pollfd, num_fds + 1);
+
+  for (guint i = 0; i < num_fds; i++)
+    {
+      HTTPSocketWatch *watch = g_ptr_array_index(self->socket_watches, i);
+
+      fds[i].fd = watch->fd.fd;
+      fds[i].events = ((watch->what & CURL_POLL_IN) ? POLLIN : 0) | ((watch->what & CURL_POLL_OUT) ? POLLOUT : 0);
+      fds[i].revents = 0;
+    }
+
+  gint num_ready = poll(fds, num_fds, _get_multi_timeout_msec(self));
+  if (num_ready <= 0)
+    {
+      _multi_socket_action(self, CURL_SOCKET_TIMEOUT, 0);
+      return;
+    }
+
+  for (guint i = 0; i < num_fds; i++)
+    {
+      gint ev_bitmask = 0;
+
+      if (fds[i].revents & (POLLIN | POLLHUP))
+        ev_bitmask |= CURL_CSELECT_IN;
+      if (fds[i].revents & POLLOUT)
+        ev_bitmask |= CURL_CSELECT_OUT;
+      if (fds[i].revents & (POLLERR | POLLNVAL))
+        ev_bitmask |= CURL_CSELECT_ERR;
+
+      if (ev_bitmask)
+        _multi_socket_action(self, fds[i].fd, ev_bitmask);
+    }
+}
+
+static void
+_start_in_flight_request(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+  HTTPInFlightRequest *request = g_queue_pop_head(self->idle_requests);
+  GString *body = request->body;
+  List *headers = request->headers;
+
+  msg_trace("Sending HTTP request",
+            evt_tag_str("url", target->url),
+            evt_tag_int("in_flight_requests", self->in_flight_requests->length + 1));
+
+  /* the request takes over the collected batch, the worker continues
+   * with the emptied buffers of the request */
+  request->body = self->request_body;
+  request->headers = self->request_headers;
+  self->request_body = body;
+  self->request_headers = headers;
+
+  request->retry_attempts = owner->load_balancer->num_targets - 1;
+  request->batch_size = self->super.batch_size;
+  self->super.batch_size = 0;
+
+  curl_easy_setopt(request->curl, CURLOPT_HTTPHEADER, http_curl_header_list_as_slist(request->headers));
+  curl_easy_setopt(request->curl, CURLOPT_POSTFIELDS, request->body->str);
+  curl_easy_setopt(request->curl, CURLOPT_POSTFIELDSIZE, (long) request->body->len);
+
+  g_queue_push_tail(self->in_flight_requests, request);
+  _send_in_flight_request(self, request, target);
+
+  _reinit_request_headers(self);
+  _reinit_request_body(self);
+}
+
+static LogThreadedResult
+_submit_batch(HTTPDestinationWorker *self)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+  LogThreadedResult result;
+  GError *error = NULL;
+
+  if (!_finish_request_body(self))
+    {
+      _reinit_request_headers(self);
+      _reinit_request_body(self);
+      return LTR_DROP;
+    }
+
+  if (!_try_format_request_headers(self, &error))
+    {
+      if (!_format_request_headers_catch_error(&error))
+        {
+          _reinit_request_headers(self);
+          _reinit_request_body(self);
+          return LTR_NOT_CONNECTED;
+        }
+    }
+
+  while (g_queue_is_empty(self->idle_requests))
+    {
+      _wait_for_multi_events(self);
+      result = _resolve_completed_requests(self);
+      if (result != LTR_SUCCESS)
+        return result;
+    }
+
+  _start_in_flight_request(self, http_load_balancer_choose_target(owner->load_balancer, &self->lbc));
+  return LTR_EXPLICIT_ACK_MGMT;
+}
+
+static LogThreadedResult
+_drain_in_flight_requests(HTTPDestinationWorker *self)
+{
+  LogThreadedResult result;
+
+  while (!g_queue_is_empty(self->in_flight_requests))
+    {
+      _wait_for_multi_events(self);
+      result = _resolve_completed_requests(self);
+      if (result != LTR_SUCCESS)
+        return result;
+    }
+  return LTR_EXPLICIT_ACK_MGMT;
+}
+
+static LogThreadedResult
+_flush_async(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
+  LogThreadedResult result = LTR_SUCCESS;
+
+  /* in-flight requests are left behind on expedite, their messages
+   * are rewound with the rest of the backlog */
+  if (mode == LTF_FLUSH_EXPEDITE)
+    return self->super.batch_size == 0 ? LTR_SUCCESS : LTR_RETRY;
+
+  if (self->super.batch_size > 0)
+    {
+      result = _submit_batch(self);
+      if (result != LTR_EXPLICIT_ACK_MGMT)
+        return result;
+    }
+
+  /* this is the final flush, wait for the responses before the backlog gets rewound */
+  if (self->super.owner->under_termination)
+    return _drain_in_flight_requests(self);
+
+  return result;
+}
+
+static gboolean
+_init_multi(HTTPDestinationWorker *self)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+
+  if (!(self->multi = curl_multi_init()))
+    return FALSE;
+
+  curl_multi_setopt(self->multi, CURLMOPT_SOCKETFUNCTION, _curl_socket_function);
+  curl_multi_setopt(self->multi, CURLMOPT_SOCKETDATA, self);
+  curl_multi_setopt(self->multi, CURLMOPT_TIMERFUNCTION, _curl_timer_function);
+  curl_multi_setopt(self->multi, CURLMOPT_TIMERDATA, self);
+#ifdef CURLPIPE_MULTIPLEX
+  curl_multi_setopt(self->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+
+  self->socket_watches = g_ptr_array_new();
+  self->in_flight_requests = g_queue_new();
+  self->idle_requests = g_queue_new();
+  for (gint i = 0; i < owner->max_in_flight_requests; i++)
+    {
+      HTTPInFlightRequest *request = _in_flight_request_new(self);
+
+      g_queue_push_tail(self->idle_requests, request);
+      if (!request->curl)
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+_deinit_multi(HTTPDestinationWorker *self)
+{
+  HTTPInFlightRequest *request;
+
+  /* the messages of requests still in flight have been rewound by now */
+  while (self->in_flight_requests && (request = g_queue_pop_head(self->in_flight_requests)))
+    {
+      curl_multi_remove_handle(self->multi, request->curl);
+      g_queue_push_tail(self->idle_requests, request);
+    }
+
+  /* curl might close the remaining sockets without notifying us */
+  while (self->socket_watches && self->socket_watches->len > 0)
+    {
+      HTTPSocketWatch *watch = g_ptr_array_index(self->socket_watches, 0);
+
+      curl_multi_assign(self->multi, watch->fd.fd, NULL);
+      _socket_watch_free(watch);
+    }
+
+  if (self->multi)
+    curl_multi_cleanup(self->multi);
+  self->multi = NULL;
+
+  if (iv_timer_registered(&self->multi_timer))
+    iv_timer_unregister(&self->multi_timer);
+
+  if (self->idle_requests)
+    g_queue_free_full(self->idle_requests, (GDestroyNotify) _in_flight_request_free);
+  self->idle_requests = NULL;
+
+  if (self->in_flight_requests)
+    g_queue_free(self->in_flight_requests);
+  self->in_flight_requests = NULL;
+
+  if (self->socket_watches)
+    g_ptr_array_free(self->socket_watches, TRUE);
+  self->socket_watches = NULL;
+}
+
+static gboolean
+_thread_init(LogThreadedDestWorker *s)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+
+  self->request_body = g_string_sized_new(32768);
+  self->request_headers = http_curl_header_list_new();
+  if (owner->compression != HTTP_COMPRESSION_NONE)
+    {
+      if (!(self->compressor = http_compressor_new(owner->compression)))
+        {
+          msg_error("http: cannot initialize request body compression",
+                    evt_tag_str("compression", http_compression_type_get_content_encoding(owner->compression)),
+                    evt_tag_int("worker_index", self->super.worker_index),
+                    evt_tag_str("driver", owner->super.super.super.id),
+                    log_pipe_location_tag(&owner->super.super.super.super));
+          return FALSE;
+        }
+    }
+  if (owner->max_in_flight_requests > 1)
+    {
+      if (!_init_multi(self))
+        {
+          msg_error("curl: cannot initialize libcurl multi interface",
+                    evt_tag_int("worker_index", self->super.worker_index),
+                    evt_tag_str("driver", owner->super.super.super.id),
+                    log_pipe_location_tag(&owner->super.super.super.super));
+          _deinit_multi(self);
+          return FALSE;
+        }
+    }
+  else
+    {
+      if (!(self->curl = curl_easy_init()))
+        {
+          msg_error("curl: cannot initialize libcurl",
+                    evt_tag_int("worker_index", self->super.worker_index),
+                    evt_tag_str("driver", owner->super.super.super.id),
+                    log_pipe_location_tag(&owner->super.super.super.super));
+          return FALSE;
+        }
+      _setup_static_options_in_curl(self, self->curl);
+    }
   _reinit_request_headers(self);
   _reinit_request_body(self);
   return log_threaded_dest_worker_init_method(s);
@@ -775,9 +1452,14 @@ _thread_deinit(LogThreadedDestWorker *s)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
 
+  _deinit_multi(self);
   g_string_free(self->request_body, TRUE);
   list_free(self->request_headers);
-  curl_easy_cleanup(self->curl);
+  if (self->compressor)
+    http_compressor_free(self->compressor);
+  self->compressor = NULL;
+  if (self->curl)
+    curl_easy_cleanup(self->curl);
   log_threaded_dest_worker_deinit_method(s);
 }
 
@@ -799,9 +1481,17 @@ http_dw_new(LogThreadedDestDriver *o, gint worker_index)
   log_threaded_dest_worker_init_instance(&self->super, o, worker_index);
   self->super.thread_init = _thread_init;
   self->super.thread_deinit = _thread_deinit;
-  self->super.flush = _flush;
   self->super.free_fn = http_dw_free;
 
+  if (owner->max_in_flight_requests > 1)
+    self->super.flush = _flush_async;
+  else
+    self->super.flush = _flush;
+
+  IV_TIMER_INIT(&self->multi_timer);
+  self->multi_timer.cookie = self;
+  self->multi_timer.handler = _multi_timer_expired;
+
   if (owner->super.batch_lines > 0 || owner->batch_bytes > 0)
     self->super.insert = _insert_batched;
   else
@@ -28,6 +28,7 @@
 #include "logthrdest/logthrdestdrv.h"
 #include "http-loadbalancer.h"
 #include "http-curl-header-list.h"
+#include "http-compressor.h"
 
 typedef struct _HTTPDestinationWorker
 {
@@ -35,7 +36,17 @@ typedef struct _HTTPDestinationWorker
   HTTPLoadBalancerClient lbc;
   CURL *curl;
   GString *request_body;
+  /* the length of the batch before compression */
+  gsize request_body_len;
   List *request_headers;
+  HTTPCompressor *compressor;
+
+  /* used instead of curl if max-in-flight-requests() is larger than 1 */
+  CURLM *multi;
+  struct iv_timer multi_timer;
+  GPtrArray *socket_watches;
+  GQueue *in_flight_requests;
+  GQueue *idle_requests;
 } HTTPDestinationWorker;
 
 LogThreadedResult default_map_http_status_to_worker_status(HTTPDestinationWorker *self, const gchar *url,
@@ -279,6 +279,22 @@ http_dd_set_batch_bytes(LogDriver *d, glong batch_bytes)
   self->batch_bytes = batch_bytes;
 }
 
+void
+http_dd_set_max_in_flight_requests(LogDriver *d, gint max_in_flight_requests)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+
+  self->max_in_flight_requests = max_in_flight_requests;
+}
+
+gboolean
+http_dd_set_compression(LogDriver *d, const gchar *compression)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+
+  return http_compression_type_from_name(compression, &self->compression);
+}
+
 void
 http_dd_set_body_prefix(LogDriver *d, const gchar *body_prefix)
 {
@@ -408,6 +424,7 @@ http_dd_new(GlobalConfig *cfg)
 
   log_threaded_dest_driver_init_instance(&self->super, cfg);
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
 
   self->super.super.super.super.init = http_dd_init;
   self->super.super.super.super.deinit = http_dd_deinit;
@@ -424,6 +441,8 @@ http_dd_new(GlobalConfig *cfg)
   /* disable batching even if the global batch_lines is specified */
   self->super.batch_lines = 0;
   self->batch_bytes = 0;
+  self->max_in_flight_requests = 1;
+  self->compression = HTTP_COMPRESSION_NONE;
   self->body_prefix = g_string_new("");
   self->body_suffix = g_string_new("");
   self->delimiter = g_string_new("\n");
@@ -31,6 +31,7 @@
 #include "logthrdest/logthrdestdrv.h"
 #include "http-loadbalancer.h"
 #include "response-handler.h"
+#include "http-compressor.h"
 
 typedef struct
 {
@@ -60,6 +61,8 @@ typedef struct
   short int method_type;
   glong timeout;
   glong batch_bytes;
+  gint max_in_flight_requests;
+  HTTPCompressionType compression;
   LogTemplate *body_template;
   LogTemplateOptions template_options;
   HttpResponseHandlers *response_handlers;
@@ -87,6 +90,8 @@ gboolean http_dd_set_ssl_version(LogDriver *d, const gchar *value);
 void http_dd_set_peer_verify(LogDriver *d, gboolean verify);
 void http_dd_set_timeout(LogDriver *d, glong timeout);
 void http_dd_set_batch_bytes(LogDriver *d, glong batch_bytes);
+void http_dd_set_max_in_flight_requests(LogDriver *d, gint max_in_flight_requests);
+gboolean http_dd_set_compression(LogDriver *d, const gchar *compression);
 void http_dd_set_body_prefix(LogDriver *d, const gchar *body_prefix);
 void http_dd_set_body_suffix(LogDriver *d, const gchar *body_suffix);
 void http_dd_set_delimiter(LogDriver *d, const gchar *delimiter);
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "mock-http-server.h"
+
+#include <criterion/criterion.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef struct _MockHttpConnection
+{
+  MockHttpServer *server;
+  gint fd;
+} MockHttpConnection;
+
+static gssize
+_find_content_length(const gchar *headers)
+{
+  /* libcurl always sends it capitalized like this */
+  const gchar *header = strstr(headers, "\r\nContent-Length:");
+
+  if (!header)
+    return 0;
+  return strtol(header + strlen("\r\nContent-Length:"), NULL, 10);
+}
+
+static glong
+_find_directive(const gchar *request, gsize request_len, const gchar *name, glong default_value)
+{
+  gchar *value = g_strstr_len(request, request_len, name);
+
+  if (!value)
+    return default_value;
+  return strtol(value + strlen(name), NULL, 10);
+}
+
+static gpointer
+_serve_connection(gpointer user_data)
+{
+  MockHttpConnection *connection = (MockHttpConnection *) user_data;
+  gchar response[128];
+  GString *buffer = g_string_sized_new(65536);
+  gchar chunk[16384];
+
+  while (TRUE)
+    {
+      const gchar *end_of_headers;
+      gssize request_len;
+
+      while (!(end_of_headers = strstr(buffer->str, "\r\n\r\n")))
+        {
+          gssize rc = read(connection->fd, chunk, sizeof(chunk) - 1);
+          if (rc <= 0)
+            goto exit;
+          g_string_append_len(buffer, chunk, rc);
+        }
+
+      request_len = (end_of_headers - buffer->str) + 4 + _find_content_length(buffer->str);
+      while (buffer->len < request_len)
+        {
+          gssize rc = read(connection->fd, chunk, sizeof(chunk) - 1);
+          if (rc <= 0)
+            goto exit;
+          g_string_append_len(buffer, chunk, rc);
+        }
+      g_atomic_int_inc(&connection->server->num_requests);
+
+      glong status = _find_directive(buffer->str, request_len, "mock-status=", 200);
+      glong delay = _find_directive(buffer->str, request_len, "mock-delay=", connection->server->latency_msec);
+      g_string_erase(buffer, 0, request_len);
+
+      g_usleep(delay * 1000);
+      g_snprintf(response, sizeof(response), "HTTP/1.1 %ld Mock\r\nContent-Length: 0\r\n\r\n", status);
+      if (write(connection->fd, response, strlen(response)) < 0)
+        goto exit;
+      g_atomic_int_inc(&connection->server->num_responses);
+    }
+
+exit:
+  close(connection->fd);
+  g_string_free(buffer, TRUE);
+  g_free(connection);
+  return NULL;
+}
+
+static gpointer
+_accept_connections(gpointer user_data)
+{
+  MockHttpServer *server = (MockHttpServer *) user_data;
+  gint fd;
+
+  while ((fd = accept(server->listen_fd, NULL, NULL)) >= 0)
+    {
+      MockHttpConnection *connection = g_new0(MockHttpConnection, 1);
+
+      connection->server = server;
+      connection->fd = fd;
+      g_thread_create(_serve_connection, connection, FALSE, NULL);
+    }
+  return NULL;
+}
+
+void
+mock_http_server_start(MockHttpServer *server, glong latency_msec)
+{
+  struct sockaddr_in addr = { 0 };
+  socklen_t addr_len = sizeof(addr);
+
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  server->latency_msec = latency_msec;
+  server->num_requests = 0;
+  server->num_responses = 0;
+  server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  cr_assert(server->listen_fd >= 0);
+  cr_assert(bind(server->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+  cr_assert(listen(server->listen_fd, 128) == 0);
+  cr_assert(getsockname(server->listen_fd, (struct sockaddr *) &addr, &addr_len) == 0);
+  server->port = ntohs(addr.sin_port);
+
+  server->accept_thread = g_thread_create(_accept_connections, server, TRUE, NULL);
+}
+
+void
+mock_http_server_stop(MockHttpServer *server)
+{
+  shutdown(server->listen_fd, SHUT_RDWR);
+  close(server->listen_fd);
+  g_thread_join(server->accept_thread);
+}
+
+gint
+mock_http_server_get_num_requests(MockHttpServer *server)
+{
+  return g_atomic_int_get(&server->num_requests);
+}
+
+gint
+mock_http_server_get_num_responses(MockHttpServer *server)
+{
+  return g_atomic_int_get(&server->num_responses);
+}
+
+/* a port nobody listens on, connecting to it is refused */
+gint
+mock_http_server_get_closed_port(void)
+{
+  struct sockaddr_in addr = { 0 };
+  socklen_t addr_len = sizeof(addr);
+  gint fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  cr_assert(fd >= 0);
+  cr_assert(bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+  cr_assert(getsockname(fd, (struct sockaddr *) &addr, &addr_len) == 0);
+  close(fd);
+
+  return ntohs(addr.sin_port);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef MOCK_HTTP_SERVER_H_INCLUDED
+#define MOCK_HTTP_SERVER_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/* A minimal HTTP/1.1 server with keep-alive support, answering each request
+ * with 200 OK after the configured latency.  Each connection is served by
+ * its own thread, so concurrent requests are delayed in parallel.
+ *
+ * A request can override the response by including "mock-status=<code>"
+ * and "mock-delay=<msec>" in its body. */
+typedef struct _MockHttpServer
+{
+  gint listen_fd;
+  gint port;
+  glong latency_msec;
+  GThread *accept_thread;
+
+  /* accessed atomically */
+  gint num_requests;
+  gint num_responses;
+} MockHttpServer;
+
+void mock_http_server_start(MockHttpServer *server, glong latency_msec);
+void mock_http_server_stop(MockHttpServer *server);
+gint mock_http_server_get_num_requests(MockHttpServer *server);
+gint mock_http_server_get_num_responses(MockHttpServer *server);
+
+gint mock_http_server_get_closed_port(void);
+
+#endif
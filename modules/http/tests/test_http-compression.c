@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "http-compressor.h"
+
+#include <criterion/criterion.h>
+#include <string.h>
+#include <zlib.h>
+
+#define NUM_LINES 5000
+
+static GString *
+_inflate(GString *compressed, gint window_bits)
+{
+  GString *result = g_string_new("");
+  z_stream stream = { 0 };
+  guchar buffer[4096];
+  gint rc;
+
+  cr_assert_eq(inflateInit2(&stream, window_bits), Z_OK);
+  stream.next_in = (Bytef *) compressed->str;
+  stream.avail_in = compressed->len;
+  do
+    {
+      stream.next_out = buffer;
+      stream.avail_out = sizeof(buffer);
+      rc = inflate(&stream, Z_NO_FLUSH);
+      cr_assert(rc == Z_OK || rc == Z_STREAM_END, "inflate() failed, rc=%d", rc);
+      g_string_append_len(result, (gchar *) buffer, sizeof(buffer) - stream.avail_out);
+    }
+  while (rc != Z_STREAM_END);
+  cr_assert_eq(stream.avail_in, 0, "trailing garbage after the compressed stream");
+  inflateEnd(&stream);
+  return result;
+}
+
+/* feeds the lines one by one, the way the http worker adds messages */
+static void
+_compress_lines(HTTPCompressor *compressor, const gchar *prefix, GString *plain, GString *compressed)
+{
+  for (gint i = 0; i < NUM_LINES; i++)
+    {
+      gchar *line = g_strdup_printf("%s{\"seq\":%d,\"msg\":\"Lorem ipsum dolor sit amet\"}\n", prefix, i);
+
+      g_string_append(plain, line);
+      http_compressor_compress(compressor, line, strlen(line), compressed);
+      g_free(line);
+    }
+  cr_assert(http_compressor_finish(compressor, compressed));
+}
+
+static void
+_assert_zlib_round_trip(HTTPCompressionType type, gint window_bits)
+{
+  HTTPCompressor *compressor = http_compressor_new(type);
+  GString *plain = g_string_new("");
+  GString *compressed = g_string_new("");
+
+  _compress_lines(compressor, "", plain, compressed);
+  cr_assert_lt(compressed->len, plain->len / 4, "compressed=%" G_GSIZE_FORMAT ", plain=%" G_GSIZE_FORMAT,
+               compressed->len, plain->len);
+
+  GString *decompressed = _inflate(compressed, window_bits);
+  cr_assert_eq(decompressed->len, plain->len);
+  cr_assert(memcmp(decompressed->str, plain->str, plain->len) == 0);
+
+  g_string_free(decompressed, TRUE);
+  g_string_free(compressed, TRUE);
+  g_string_free(plain, TRUE);
+  http_compressor_free(compressor);
+}
+
+Test(http_compression, gzip_output_inflates_to_the_appended_data)
+{
+  /* 16 selects the gzip wrapper, so the gzip header and trailer are validated too */
+  _assert_zlib_round_trip(HTTP_COMPRESSION_GZIP, 15 + 16);
+}
+
+Test(http_compression, deflate_output_inflates_to_the_appended_data)
+{
+  _assert_zlib_round_trip(HTTP_COMPRESSION_DEFLATE, 15);
+}
+
+Test(http_compression, compressor_starts_a_new_stream_after_reset)
+{
+  HTTPCompressor *compressor = http_compressor_new(HTTP_COMPRESSION_GZIP);
+  GString *plain = g_string_new("");
+  GString *compressed = g_string_new("");
+
+  _compress_lines(compressor, "first", plain, compressed);
+
+  g_string_truncate(plain, 0);
+  g_string_truncate(compressed, 0);
+  http_compressor_reset(compressor);
+  _compress_lines(compressor, "second", plain, compressed);
+
+  GString *decompressed = _inflate(compressed, 15 + 16);
+  cr_assert_str_eq(decompressed->str, plain->str);
+
+  g_string_free(decompressed, TRUE);
+  g_string_free(compressed, TRUE);
+  g_string_free(plain, TRUE);
+  http_compressor_free(compressor);
+}
+
+Test(http_compression, empty_body_is_a_valid_stream)
+{
+  HTTPCompressor *compressor = http_compressor_new(HTTP_COMPRESSION_GZIP);
+  GString *compressed = g_string_new("");
+
+  cr_assert(http_compressor_finish(compressor, compressed));
+
+  GString *decompressed = _inflate(compressed, 15 + 16);
+  cr_assert_eq(decompressed->len, 0);
+
+  g_string_free(decompressed, TRUE);
+  g_string_free(compressed, TRUE);
+  http_compressor_free(compressor);
+}
+
+Test(http_compression, zstd_output_is_a_zstd_frame_if_supported)
+{
+  const guchar zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+  HTTPCompressionType type;
+
+  if (!http_compression_type_from_name("zstd", &type))
+    return;
+
+  HTTPCompressor *compressor = http_compressor_new(type);
+  GString *plain = g_string_new("");
+  GString *compressed = g_string_new("");
+
+  _compress_lines(compressor, "", plain, compressed);
+  cr_assert_lt(compressed->len, plain->len / 4);
+  cr_assert(memcmp(compressed->str, zstd_magic, sizeof(zstd_magic)) == 0);
+
+  g_string_free(compressed, TRUE);
+  g_string_free(plain, TRUE);
+  http_compressor_free(compressor);
+}
+
+Test(http_compression, compression_names_map_to_content_encodings)
+{
+  HTTPCompressionType type;
+
+  cr_assert(http_compression_type_from_name("none", &type));
+  cr_assert_eq(type, HTTP_COMPRESSION_NONE);
+  cr_assert_null(http_compression_type_get_content_encoding(type));
+
+  cr_assert(http_compression_type_from_name("gzip", &type));
+  cr_assert_str_eq(http_compression_type_get_content_encoding(type), "gzip");
+
+  cr_assert(http_compression_type_from_name("deflate", &type));
+  cr_assert_str_eq(http_compression_type_get_content_encoding(type), "deflate");
+
+  cr_assert_not(http_compression_type_from_name("brotli", &type));
+}
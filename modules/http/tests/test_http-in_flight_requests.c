@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "syslog-ng.h"
+#include <apphook.h>
+#include "http.h"
+#include "mainloop.h"
+#include "mock-http-server.h"
+
+#include <criterion/criterion.h>
+
+#define MAX_IN_FLIGHT_REQUESTS 4
+
+MainLoop *main_loop;
+MainLoopOptions main_loop_options;
+
+static gboolean
+_wait_for_counter_value(StatsCounterItem *counter, gsize expected_value, gint timeout_msec)
+{
+  for (gint i = 0; i < timeout_msec && stats_counter_get(counter) < expected_value; i++)
+    g_usleep(1000);
+  return stats_counter_get(counter) == expected_value;
+}
+
+static gboolean
+_wait_for_responses(MockHttpServer *server, gint expected_value, gint timeout_msec)
+{
+  for (gint i = 0; i < timeout_msec && mock_http_server_get_num_responses(server) < expected_value; i++)
+    g_usleep(1000);
+  return mock_http_server_get_num_responses(server) >= expected_value;
+}
+
+static gchar *
+_format_url(gint port)
+{
+  return g_strdup_printf("http://127.0.0.1:%d/", port);
+}
+
+static LogThreadedDestDriver *
+_start_http_destination(GList *urls, gint time_reopen)
+{
+  LogDriver *driver = http_dd_new(main_loop_get_current_config(main_loop));
+
+  http_dd_set_urls(driver, urls);
+  http_dd_set_max_in_flight_requests(driver, MAX_IN_FLIGHT_REQUESTS);
+  log_threaded_dest_driver_set_time_reopen(driver, time_reopen);
+
+  cr_assert(log_pipe_init(&driver->super));
+  cr_assert(log_pipe_on_config_inited(&driver->super));
+  return (LogThreadedDestDriver *) driver;
+}
+
+static void
+_stop_http_destination(LogThreadedDestDriver *driver)
+{
+  main_loop_sync_worker_startup_and_teardown();
+  log_pipe_deinit(&driver->super.super.super);
+  log_pipe_unref(&driver->super.super.super);
+}
+
+/* without batching, each message is sent in its own request */
+static void
+_send_message(LogThreadedDestDriver *driver, const gchar *message)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value(msg, LM_V_MESSAGE, message, -1);
+  log_pipe_queue(&driver->super.super.super, msg, &path_options);
+}
+
+Test(http_in_flight_requests, test_out_of_order_completions_are_acked_in_submission_order)
+{
+  MockHttpServer server;
+
+  mock_http_server_start(&server, 0);
+  gchar *url = _format_url(server.port);
+  GList *urls = g_list_append(NULL, url);
+  LogThreadedDestDriver *driver = _start_http_destination(urls, 60);
+
+  _send_message(driver, "first mock-delay=500");
+  _send_message(driver, "second");
+
+  /* the response to the second request arrives first, but it can only be
+   * acked together with the first one */
+  cr_assert(_wait_for_responses(&server, 1, 10000));
+  cr_assert_eq(stats_counter_get(driver->written_messages), 0);
+
+  cr_assert(_wait_for_counter_value(driver->written_messages, 2, 10000));
+  cr_assert_eq(mock_http_server_get_num_requests(&server), 2);
+
+  _stop_http_destination(driver);
+  mock_http_server_stop(&server);
+  g_list_free(urls);
+  g_free(url);
+}
+
+Test(http_in_flight_requests, test_failure_in_the_middle_drops_the_failed_batch_and_rewinds_the_newer_ones)
+{
+  MockHttpServer server;
+
+  mock_http_server_start(&server, 0);
+  gchar *url = _format_url(server.port);
+  GList *urls = g_list_append(NULL, url);
+  LogThreadedDestDriver *driver = _start_http_destination(urls, 1);
+
+  /* 410 Gone is mapped to a drop, the requests behind it complete before
+   * the failure is resolved */
+  _send_message(driver, "first mock-delay=300");
+  _send_message(driver, "second mock-status=410 mock-delay=100");
+  _send_message(driver, "third");
+  _send_message(driver, "fourth");
+
+  cr_assert(_wait_for_counter_value(driver->written_messages, 3, 10000));
+  cr_assert_eq(stats_counter_get(driver->dropped_messages), 1);
+
+  /* third and fourth were rewound and sent again */
+  cr_assert_eq(mock_http_server_get_num_requests(&server), 6);
+
+  _stop_http_destination(driver);
+  mock_http_server_stop(&server);
+  g_list_free(urls);
+  g_free(url);
+}
+
+Test(http_in_flight_requests, test_failed_request_is_sent_to_an_alternative_target)
+{
+  MockHttpServer server;
+
+  mock_http_server_start(&server, 0);
+  gchar *dead_url = _format_url(mock_http_server_get_closed_port());
+  gchar *url = _format_url(server.port);
+  GList *urls = g_list_append(g_list_append(NULL, dead_url), url);
+
+  /* without failover, the worker would wait for time-reopen() */
+  LogThreadedDestDriver *driver = _start_http_destination(urls, 60);
+
+  for (gint i = 0; i < 2 * MAX_IN_FLIGHT_REQUESTS; i++)
+    _send_message(driver, "message");
+
+  cr_assert(_wait_for_counter_value(driver->written_messages, 2 * MAX_IN_FLIGHT_REQUESTS, 10000));
+  cr_assert_eq(stats_counter_get(driver->dropped_messages), 0);
+  cr_assert_eq(mock_http_server_get_num_requests(&server), 2 * MAX_IN_FLIGHT_REQUESTS);
+
+  _stop_http_destination(driver);
+  mock_http_server_stop(&server);
+  g_list_free(urls);
+  g_free(dead_url);
+  g_free(url);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+
+  main_loop = main_loop_get_instance();
+  main_loop_init(main_loop, &main_loop_options);
+}
+
+static void
+teardown(void)
+{
+  main_loop_deinit(main_loop);
+  app_shutdown();
+}
+
+TestSuite(http_in_flight_requests, .init = setup, .fini = teardown);
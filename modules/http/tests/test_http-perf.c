@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "syslog-ng.h"
+#include <apphook.h>
+#include "http.h"
+#include "mainloop.h"
+#include "stopwatch.h"
+#include "mock-http-server.h"
+
+#include <criterion/criterion.h>
+
+#define BATCH_LINES 100
+#define NUM_BATCHES 20
+#define NUM_MESSAGES (BATCH_LINES * NUM_BATCHES)
+
+MainLoop *main_loop;
+MainLoopOptions main_loop_options;
+
+static void
+_wait_for_counter_value(StatsCounterItem *counter, gsize expected_value)
+{
+  /* about a minute */
+  for (gint i = 0; i < 60000 && stats_counter_get(counter) < expected_value; i++)
+    g_usleep(1000);
+  cr_assert_eq(stats_counter_get(counter), expected_value, "messages were not delivered in time");
+}
+
+static void
+_measure_eps(glong latency_msec, gint max_in_flight_requests)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+  MockHttpServer server;
+  gchar url[64];
+
+  mock_http_server_start(&server, latency_msec);
+  g_snprintf(url, sizeof(url), "http://127.0.0.1:%d/", server.port);
+
+  LogDriver *driver = http_dd_new(main_loop_get_current_config(main_loop));
+  GList *urls = g_list_append(NULL, url);
+  http_dd_set_urls(driver, urls);
+  g_list_free(urls);
+  http_dd_set_max_in_flight_requests(driver, max_in_flight_requests);
+  log_threaded_dest_driver_set_batch_lines(driver, BATCH_LINES);
+  log_threaded_dest_driver_set_batch_timeout(driver, 1000);
+
+  cr_assert(log_pipe_init(&driver->super));
+  cr_assert(log_pipe_on_config_inited(&driver->super));
+
+  StatsCounterItem *written_messages = ((LogThreadedDestDriver *) driver)->written_messages;
+  gsize written_before = stats_counter_get(written_messages);
+
+  start_stopwatch();
+  for (gint i = 0; i < NUM_MESSAGES; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      log_msg_set_value(msg, LM_V_MESSAGE, "Lorem ipsum dolor sit amet, consectetur adipiscing elit", -1);
+      log_pipe_queue(&driver->super, msg, &path_options);
+    }
+  _wait_for_counter_value(written_messages, written_before + NUM_MESSAGES);
+  stop_stopwatch_and_display_result(NUM_MESSAGES, "      latency: %3ldms, max-in-flight-requests: %2d",
+                                    latency_msec, max_in_flight_requests);
+
+  main_loop_sync_worker_startup_and_teardown();
+  log_pipe_deinit(&driver->super);
+  log_pipe_unref(&driver->super);
+
+  mock_http_server_stop(&server);
+}
+
+Test(http_perf, test_in_flight_requests_against_slow_server)
+{
+  const glong latencies[] = { 1, 10, 100 };
+  const gint max_in_flight_requests[] = { 1, 4, 16 };
+
+  for (gint i = 0; i < G_N_ELEMENTS(latencies); i++)
+    {
+      for (gint j = 0; j < G_N_ELEMENTS(max_in_flight_requests); j++)
+        _measure_eps(latencies[i], max_in_flight_requests[j]);
+    }
+}
+
+static void
+setup(void)
+{
+  app_startup();
+
+  main_loop = main_loop_get_instance();
+  main_loop_init(main_loop, &main_loop_options);
+}
+
+static void
+teardown(void)
+{
+  main_loop_deinit(main_loop);
+  app_shutdown();
+}
+
+TestSuite(http_perf, .init = setup, .fini = teardown);
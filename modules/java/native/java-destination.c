@@ -319,6 +319,7 @@ java_dd_new(GlobalConfig *cfg)
   self->options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
 
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
 
   return (LogDriver *)self;
 }
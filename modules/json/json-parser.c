@@ -23,6 +23,7 @@
 #define JSON_C_VER_013 (13 << 8)
 
 #include "json-parser.h"
+#include "json-scanner.h"
 #include "dot-notation.h"
 #include "scratch-buffers.h"
 
@@ -207,33 +208,35 @@ json_tokener_error_desc(enum json_tokener_error err)
 }
 #endif
 
+/* the single pass scanner covers the common case, input it rejects is
+ * passed on to json-c, which is more lenient and produces the error
+ * messages */
 static gboolean
-json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input,
-                    gsize input_len)
+json_parser_process_with_scanner(JSONParser *self, LogMessage **pmsg, const LogPathOptions *path_options,
+                                 LogParserInput *parser_input, const gchar *input, gsize input_len)
 {
-  JSONParser *self = (JSONParser *) s;
-  struct json_object *jso;
-  struct json_tokener *tok;
+  ScratchBuffersMarker marker;
+  JSONScanner scanner;
+  gboolean success;
 
-  msg_trace("json-parser message processing started",
-            evt_tag_str ("input", input),
-            evt_tag_str ("prefix", self->prefix),
-            evt_tag_str ("marker", self->marker),
-            evt_tag_printf("msg", "%p", *pmsg));
-  if (self->marker)
+  scratch_buffers_mark(&marker);
+  json_scanner_init(&scanner);
+  success = json_scanner_index(&scanner, input, input_len);
+  if (success)
     {
-      if (strncmp(input, self->marker, self->marker_len) != 0)
-        {
-          msg_debug("json-parser(): no marker at the beginning of the message, skipping JSON parsing ",
-                    evt_tag_str ("input", input),
-                    evt_tag_str ("marker", self->marker));
-          return FALSE;
-        }
-      input += self->marker_len;
-
-      while (isspace(*input))
-        input++;
+      log_msg_make_writable(pmsg, path_options);
+      json_scanner_emit(&scanner, self->prefix, *pmsg, parser_input);
     }
+  scratch_buffers_reclaim_marked(marker);
+  return success;
+}
+
+static gboolean
+json_parser_process_with_json_c(JSONParser *self, LogMessage **pmsg, const LogPathOptions *path_options,
+                                const gchar *input, gsize input_len)
+{
+  struct json_object *jso;
+  struct json_tokener *tok;
 
   tok = json_tokener_new();
   jso = json_tokener_parse_ex(tok, input, input_len);
@@ -261,6 +264,49 @@ json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_
   return TRUE;
 }
 
+static gboolean
+json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input,
+                    gsize input_len)
+{
+  JSONParser *self = (JSONParser *) s;
+  LogParserInput parser_input;
+
+  /* initialized before skipping the marker, the JSON payload is still a
+   * part of the input as a whole */
+  log_parser_input_init(&parser_input, s, *pmsg, input, input_len);
+
+  msg_trace("json-parser message processing started",
+            evt_tag_str ("input", input),
+            evt_tag_str ("prefix", self->prefix),
+            evt_tag_str ("marker", self->marker),
+            evt_tag_printf("msg", "%p", *pmsg));
+  if (self->marker)
+    {
+      const gchar *payload;
+
+      if (strncmp(input, self->marker, self->marker_len) != 0)
+        {
+          msg_debug("json-parser(): no marker at the beginning of the message, skipping JSON parsing ",
+                    evt_tag_str ("input", input),
+                    evt_tag_str ("marker", self->marker));
+          return FALSE;
+        }
+      payload = input + self->marker_len;
+
+      while (isspace(*payload))
+        payload++;
+      input_len -= payload - input;
+      input = payload;
+    }
+
+  /* extract-prefix() needs the DOM of json-c */
+  if (!self->extract_prefix &&
+      json_parser_process_with_scanner(self, pmsg, path_options, &parser_input, input, input_len))
+    return TRUE;
+
+  return json_parser_process_with_json_c(self, pmsg, path_options, input, input_len);
+}
+
 static LogPipe *
 json_parser_clone(LogPipe *s)
 {
@@ -0,0 +1,587 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ */
+
+#include "json-scanner.h"
+#include "scratch-buffers.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define JSON_SCANNER_HAVE_SSE2 1
+#include <emmintrin.h>
+#else
+#define JSON_SCANNER_HAVE_SSE2 0
+#endif
+
+/* the default depth limit of json_tokener */
+#define JSON_SCANNER_MAX_DEPTH 32
+
+/* the top bit of the end offset of strings is set if they contain escape
+ * sequences, that of numbers if they are not integers */
+#define JSON_TOKEN_FLAG 0x80000000
+#define JSON_TOKEN_OFFSET_MASK 0x7FFFFFFF
+
+/*
+ * The structural index consists of the tokens of the input in document
+ * order: the opening and closing characters of objects and arrays, keys
+ * and scalar values.  Commas and colons are validated, but not indexed.
+ * For strings, start points to the opening quote and end to the closing
+ * one, for other scalars end points right after the last character.
+ */
+typedef struct _JSONScannerToken
+{
+  guint32 start;
+  guint32 end;
+} JSONScannerToken;
+
+typedef enum
+{
+  JSS_VALUE,
+  JSS_FIRST_VALUE,
+  JSS_KEY,
+  JSS_FIRST_KEY,
+  JSS_COLON,
+  JSS_NEXT,
+} JSONScannerState;
+
+static inline void
+_add_token(JSONScanner *self, gsize start, gsize end)
+{
+  JSONScannerToken token = { .start = start, .end = end };
+
+  g_string_append_len(self->tokens, (const gchar *) &token, sizeof(token));
+}
+
+static inline gsize
+_skip_whitespace(const gchar *input, gsize pos, gsize input_len)
+{
+  while (pos < input_len && (input[pos] == ' ' || input[pos] == '\n' || input[pos] == '\r' || input[pos] == '\t'))
+    pos++;
+  return pos;
+}
+
+/* finds the first closing quote, backslash or control character, as all
+ * the other characters of a string are copied verbatim, this is where
+ * most of the input is spent on */
+static inline gsize
+_find_string_special(const guchar *s, gsize pos, gsize n, guchar quote)
+{
+#if JSON_SCANNER_HAVE_SSE2
+  const __m128i vquote = _mm_set1_epi8(quote);
+  const __m128i vbackslash = _mm_set1_epi8('\\');
+  const __m128i vcontrol = _mm_set1_epi8(0x1F);
+
+  for (; pos + sizeof(__m128i) <= n; pos += sizeof(__m128i))
+    {
+      __m128i chunk = _mm_loadu_si128((const __m128i *) (s + pos));
+      /* max(c, 0x1F) equals 0x1F only for control characters */
+      __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, vquote),
+                                                _mm_cmpeq_epi8(chunk, vbackslash)),
+                                   _mm_cmpeq_epi8(_mm_max_epu8(chunk, vcontrol), vcontrol));
+      guint32 mask = _mm_movemask_epi8(match);
+
+      if (mask)
+        return pos + __builtin_ctz(mask);
+    }
+#endif
+  for (; pos < n; pos++)
+    {
+      if (s[pos] == quote || s[pos] == '\\' || s[pos] < 0x20)
+        break;
+    }
+  return pos;
+}
+
+/* single quoted strings are accepted the same way as json-c does */
+static gboolean
+_index_string(JSONScanner *self, gsize *pos)
+{
+  const guchar *s = (const guchar *) self->input;
+  guchar quote = s[*pos];
+  guint32 flags = 0;
+  gsize i = *pos + 1;
+
+  while (TRUE)
+    {
+      i = _find_string_special(s, i, self->input_len, quote);
+      if (i >= self->input_len || s[i] < 0x20)
+        return FALSE;
+      if (s[i] == quote)
+        break;
+
+      flags = JSON_TOKEN_FLAG;
+      if (i + 1 >= self->input_len)
+        return FALSE;
+
+      switch (s[i + 1])
+        {
+        case '"':
+        case '\\':
+        case '/':
+        case 'b':
+        case 'f':
+        case 'n':
+        case 'r':
+        case 't':
+          i += 2;
+          break;
+        case 'u':
+          if (i + 6 > self->input_len)
+            return FALSE;
+          for (gint j = 2; j < 6; j++)
+            {
+              if (!g_ascii_isxdigit(s[i + j]))
+                return FALSE;
+            }
+          i += 6;
+          break;
+        default:
+          return FALSE;
+        }
+    }
+
+  _add_token(self, *pos, i | flags);
+  *pos = i + 1;
+  return TRUE;
+}
+
+static inline gsize
+_skip_digits(const gchar *input, gsize pos, gsize input_len)
+{
+  while (pos < input_len && g_ascii_isdigit(input[pos]))
+    pos++;
+  return pos;
+}
+
+static gboolean
+_index_number(JSONScanner *self, gsize *pos)
+{
+  const gchar *s = self->input;
+  gsize n = self->input_len;
+  guint32 flags = 0;
+  gsize i = *pos;
+
+  if (s[i] == '-')
+    i++;
+
+  if (i < n && s[i] == '0')
+    i++;
+  else if (i < n && s[i] >= '1' && s[i] <= '9')
+    i = _skip_digits(s, i, n);
+  else
+    return FALSE;
+
+  if (i < n && s[i] == '.')
+    {
+      flags = JSON_TOKEN_FLAG;
+      i++;
+      if (i >= n || !g_ascii_isdigit(s[i]))
+        return FALSE;
+      i = _skip_digits(s, i, n);
+    }
+
+  if (i < n && (s[i] == 'e' || s[i] == 'E'))
+    {
+      flags = JSON_TOKEN_FLAG;
+      i++;
+      if (i < n && (s[i] == '+' || s[i] == '-'))
+        i++;
+      if (i >= n || !g_ascii_isdigit(s[i]))
+        return FALSE;
+      i = _skip_digits(s, i, n);
+    }
+
+  _add_token(self, *pos, i | flags);
+  *pos = i;
+  return TRUE;
+}
+
+static gboolean
+_index_literal(JSONScanner *self, gsize *pos, const gchar *literal, gsize literal_len)
+{
+  if (*pos + literal_len > self->input_len || memcmp(self->input + *pos, literal, literal_len) != 0)
+    return FALSE;
+
+  _add_token(self, *pos, *pos + literal_len);
+  *pos += literal_len;
+  return TRUE;
+}
+
+static gboolean
+_index_scalar(JSONScanner *self, gsize *pos)
+{
+  switch (self->input[*pos])
+    {
+    case '"':
+    case '\'':
+      return _index_string(self, pos);
+    case 't':
+      return _index_literal(self, pos, "true", 4);
+    case 'f':
+      return _index_literal(self, pos, "false", 5);
+    case 'n':
+      return _index_literal(self, pos, "null", 4);
+    default:
+      return _index_number(self, pos);
+    }
+}
+
+/*
+ * Validates the input and builds its structural index.  Only an object at
+ * the top level is accepted, followed by nothing but whitespace.  Syntax
+ * that is only accepted by json-c in its non-strict mode (except for
+ * single quoted strings) is rejected here, so that the caller can fall
+ * back to json-c for such input.
+ */
+gboolean
+json_scanner_index(JSONScanner *self, const gchar *input, gsize input_len)
+{
+  JSONScannerState state = JSS_VALUE;
+  gchar stack[JSON_SCANNER_MAX_DEPTH];
+  gint depth = 0;
+  gsize pos;
+
+  self->input = input;
+  self->input_len = input_len;
+  g_string_truncate(self->tokens, 0);
+
+  if (input_len > JSON_TOKEN_OFFSET_MASK)
+    return FALSE;
+
+  pos = _skip_whitespace(input, 0, input_len);
+  if (pos >= input_len || input[pos] != '{')
+    return FALSE;
+
+  while (TRUE)
+    {
+      pos = _skip_whitespace(input, pos, input_len);
+      if (pos >= input_len)
+        return FALSE;
+
+      gchar c = input[pos];
+      switch (state)
+        {
+        case JSS_FIRST_KEY:
+          if (c == '}')
+            break;
+        /* fallthrough */
+        case JSS_KEY:
+          if ((c != '"' && c != '\'') || !_index_string(self, &pos))
+            return FALSE;
+          state = JSS_COLON;
+          continue;
+
+        case JSS_COLON:
+          if (c != ':')
+            return FALSE;
+          pos++;
+          state = JSS_VALUE;
+          continue;
+
+        case JSS_FIRST_VALUE:
+          if (c == ']')
+            break;
+        /* fallthrough */
+        case JSS_VALUE:
+          if (c == '{' || c == '[')
+            {
+              if (depth == JSON_SCANNER_MAX_DEPTH)
+                return FALSE;
+              stack[depth++] = c;
+              _add_token(self, pos, pos + 1);
+              pos++;
+              state = (c == '{') ? JSS_FIRST_KEY : JSS_FIRST_VALUE;
+              continue;
+            }
+          if (!_index_scalar(self, &pos))
+            return FALSE;
+          state = JSS_NEXT;
+          continue;
+
+        case JSS_NEXT:
+          if (c == ',')
+            {
+              pos++;
+              state = (stack[depth - 1] == '{') ? JSS_KEY : JSS_VALUE;
+              continue;
+            }
+          if (c != (stack[depth - 1] == '{' ? '}' : ']'))
+            return FALSE;
+          break;
+
+        default:
+          g_assert_not_reached();
+        }
+
+      /* closing the innermost object or array */
+      _add_token(self, pos, pos + 1);
+      pos++;
+      if (--depth == 0)
+        return _skip_whitespace(input, pos, input_len) == input_len;
+      state = JSS_NEXT;
+    }
+}
+
+typedef struct _JSONScannerEmitter
+{
+  const gchar *input;
+  const JSONScannerToken *tokens;
+  LogMessage *msg;
+  LogParserInput *parser_input;
+  /* the name of the current value, truncated back to the name of the
+   * enclosing object or array once a member is done */
+  GString *key;
+  GString *value;
+} JSONScannerEmitter;
+
+static gsize _emit_value(JSONScannerEmitter *self, gsize index);
+
+static inline void
+_set_value(JSONScannerEmitter *self, const gchar *value, gsize value_len)
+{
+  log_parser_input_set_value(self->parser_input, self->msg, log_msg_get_value_handle(self->key->str),
+                             value, value_len);
+}
+
+static gunichar
+_parse_hex4(const gchar *s)
+{
+  gunichar c = 0;
+
+  for (gint i = 0; i < 4; i++)
+    c = (c << 4) | g_ascii_xdigit_value(s[i]);
+  return c;
+}
+
+/* the input has already been validated.  Unescaping stops at an escaped
+ * NUL character, like the C string returned by json-c would. */
+static void
+_unescape_string(const gchar *s, const gchar *end, GString *result)
+{
+  while (s < end)
+    {
+      const gchar *backslash = memchr(s, '\\', end - s);
+
+      if (!backslash)
+        {
+          g_string_append_len(result, s, end - s);
+          return;
+        }
+      g_string_append_len(result, s, backslash - s);
+      s = backslash + 1;
+
+      switch (*s)
+        {
+        case 'b':
+          g_string_append_c(result, '\b');
+          s++;
+          break;
+        case 'f':
+          g_string_append_c(result, '\f');
+          s++;
+          break;
+        case 'n':
+          g_string_append_c(result, '\n');
+          s++;
+          break;
+        case 'r':
+          g_string_append_c(result, '\r');
+          s++;
+          break;
+        case 't':
+          g_string_append_c(result, '\t');
+          s++;
+          break;
+        case 'u':
+        {
+          gunichar c = _parse_hex4(s + 1);
+
+          s += 5;
+          if (c >= 0xD800 && c < 0xDC00 && end - s >= 6 && s[0] == '\\' && s[1] == 'u')
+            {
+              gunichar low = _parse_hex4(s + 2);
+
+              if (low >= 0xDC00 && low < 0xE000)
+                {
+                  c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                  s += 6;
+                }
+            }
+          if (c == 0)
+            return;
+          g_string_append_unichar(result, c);
+          break;
+        }
+        default:
+          g_string_append_c(result, *s);
+          s++;
+          break;
+        }
+    }
+}
+
+static void
+_append_string(JSONScannerEmitter *self, const JSONScannerToken *token, GString *result)
+{
+  const gchar *s = self->input + token->start + 1;
+  const gchar *end = self->input + (token->end & JSON_TOKEN_OFFSET_MASK);
+
+  if (token->end & JSON_TOKEN_FLAG)
+    _unescape_string(s, end, result);
+  else
+    g_string_append_len(result, s, end - s);
+}
+
+static void
+_emit_string(JSONScannerEmitter *self, const JSONScannerToken *token)
+{
+  if (token->end & JSON_TOKEN_FLAG)
+    {
+      g_string_truncate(self->value, 0);
+      _append_string(self, token, self->value);
+      _set_value(self, self->value->str, self->value->len);
+    }
+  else
+    {
+      /* straight from the input, without copying it first */
+      _set_value(self, self->input + token->start + 1, token->end - token->start - 1);
+    }
+}
+
+/* numbers are formatted the same way as the json-c based parser does */
+static void
+_emit_number(JSONScannerEmitter *self, const JSONScannerToken *token)
+{
+  const gchar *s = self->input + token->start;
+  gsize len = (token->end & JSON_TOKEN_OFFSET_MASK) - token->start;
+
+  if (token->end & JSON_TOKEN_FLAG)
+    {
+      g_string_printf(self->value, "%f", g_ascii_strtod(s, NULL));
+      _set_value(self, self->value->str, self->value->len);
+    }
+  else if (len <= 18 && !(len == 2 && s[0] == '-' && s[1] == '0'))
+    {
+      /* validated JSON integers of this size are already in canonical form */
+      _set_value(self, s, len);
+    }
+  else
+    {
+      g_string_printf(self->value, "%"PRId64, (gint64) g_ascii_strtoll(s, NULL, 10));
+      _set_value(self, self->value->str, self->value->len);
+    }
+}
+
+static gsize
+_emit_object(JSONScannerEmitter *self, gsize index)
+{
+  gsize base_len = self->key->len;
+
+  for (index++; self->input[self->tokens[index].start] != '}'; )
+    {
+      g_string_truncate(self->key, base_len);
+      _append_string(self, &self->tokens[index], self->key);
+      index = _emit_value(self, index + 1);
+    }
+  g_string_truncate(self->key, base_len);
+  return index + 1;
+}
+
+static gsize
+_emit_array(JSONScannerEmitter *self, gsize index)
+{
+  gsize base_len = self->key->len;
+  gint i = 0;
+
+  for (index++; self->input[self->tokens[index].start] != ']'; i++)
+    {
+      g_string_truncate(self->key, base_len);
+      g_string_append_printf(self->key, "[%d]", i);
+      index = _emit_value(self, index);
+    }
+  g_string_truncate(self->key, base_len);
+  return index + 1;
+}
+
+/* emits the value starting at token @index, returns the index of the
+ * token following it */
+static gsize
+_emit_value(JSONScannerEmitter *self, gsize index)
+{
+  const JSONScannerToken *token = &self->tokens[index];
+
+  switch (self->input[token->start])
+    {
+    case '{':
+      g_string_append_c(self->key, '.');
+      return _emit_object(self, index);
+    case '[':
+      return _emit_array(self, index);
+    case '"':
+    case '\'':
+      _emit_string(self, token);
+      break;
+    case 't':
+      _set_value(self, "true", 4);
+      break;
+    case 'f':
+      _set_value(self, "false", 5);
+      break;
+    case 'n':
+      break;
+    default:
+      _emit_number(self, token);
+      break;
+    }
+  return index + 1;
+}
+
+/*
+ * Sets the leaves of the object indexed by json_scanner_index() as values
+ * of @msg.  As opposed to the json-c DOM, duplicate keys are not merged:
+ * they are set in the order of appearance, so the last one wins.
+ */
+void
+json_scanner_emit(JSONScanner *self, const gchar *prefix, LogMessage *msg, LogParserInput *parser_input)
+{
+  JSONScannerEmitter emitter =
+  {
+    .input = self->input,
+    .tokens = (const JSONScannerToken *) self->tokens->str,
+    .msg = msg,
+    .parser_input = parser_input,
+    .key = scratch_buffers_alloc(),
+    .value = scratch_buffers_alloc(),
+  };
+
+  if (prefix)
+    g_string_assign(emitter.key, prefix);
+  _emit_object(&emitter, 0);
+}
+
+void
+json_scanner_init(JSONScanner *self)
+{
+  self->input = NULL;
+  self->input_len = 0;
+  self->tokens = scratch_buffers_alloc();
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ */
+
+#ifndef JSON_SCANNER_H_INCLUDED
+#define JSON_SCANNER_H_INCLUDED
+
+#include "parser/parser-expr.h"
+
+/*
+ * JSONScanner turns a JSON object into name-value pairs without building a
+ * DOM.  json_scanner_index() validates the input and records the position
+ * of its tokens in a flat structural index, json_scanner_emit() walks the
+ * index and sets the leaves as values of a LogMessage, using the same
+ * naming and formatting as the json-c based parser.  Leaves that appear
+ * verbatim in the input are set through a LogParserInput, so they can be
+ * stored as references.
+ *
+ * The index lives in a scratch buffer, the scanner must be used within a
+ * scratch buffers mark.
+ */
+typedef struct _JSONScanner
+{
+  const gchar *input;
+  gsize input_len;
+  GString *tokens;
+} JSONScanner;
+
+gboolean json_scanner_index(JSONScanner *self, const gchar *input, gsize input_len);
+void json_scanner_emit(JSONScanner *self, const gchar *prefix, LogMessage *msg, LogParserInput *parser_input);
+
+void json_scanner_init(JSONScanner *self);
+
+#endif
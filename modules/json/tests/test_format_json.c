@@ -258,4 +258,10 @@ Test(format_json, test_format_json_performance)
                     "--exclude .SDATA.* "
                     "..RSTAMP='${R_UNIXTIME}${R_TZ}' "
                     "..TAGS=${TAGS})\n");
+
+  /* an sshd login and an rsync command line: long values where nothing needs escaping */
+  perftest_template("$(format-json msg='Accepted publickey for deploy from 10.20.30.40 port 52422 ssh2: "
+                    "RSA SHA256:Zm9vYmFyYmF6cXV4cXV1eGZvb2Jhcg' "
+                    "cmd='/usr/bin/rsync --server -logDtpre.iLsfxC . /srv/backup/' "
+                    "escaping=$escaping)\n");
 }
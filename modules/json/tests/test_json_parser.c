@@ -212,3 +212,60 @@ Test(json_parser, test_json_parser_works_with_templates)
   log_msg_unref(msg);
   log_pipe_unref(&json_parser->super);
 }
+
+Test(json_parser, test_json_parser_unescapes_strings)
+{
+  LogParser *json_parser = json_parser_new(NULL);
+  LogMessage *msg = parse_json_into_log_message("{\"quote\\\"d\": \"a\\\"b\\\\c\\/d\\te\", "
+                                                "\"unicode\": \"\\u00e9\\ud83d\\ude00\", "
+                                                "\"long\": \"a string longer than a vector \\n with an escape\"}",
+                                                json_parser);
+
+  assert_log_message_value(msg, log_msg_get_value_handle("quote\"d"), "a\"b\\c/d\te");
+  assert_log_message_value(msg, log_msg_get_value_handle("unicode"), "\xc3\xa9\xf0\x9f\x98\x80");
+  assert_log_message_value(msg, log_msg_get_value_handle("long"), "a string longer than a vector \n with an escape");
+  log_msg_unref(msg);
+  log_pipe_unref(&json_parser->super);
+}
+
+Test(json_parser, test_json_parser_names_nested_arrays_and_objects)
+{
+  LogParser *json_parser = json_parser_new(NULL);
+
+  json_parser_set_prefix(json_parser, ".prefix.");
+  LogMessage *msg = parse_json_into_log_message("{\"a\": [[1, 2], [{\"b\": {\"c\": \"d\"}}], []], \"e\": {}, \"f\": 1e2, \"g\": -0}",
+                                                json_parser);
+
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.a[0][0]"), "1");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.a[0][1]"), "2");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.a[1][0].b.c"), "d");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.f"), "100.000000");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.g"), "0");
+  log_msg_unref(msg);
+  log_pipe_unref(&json_parser->super);
+}
+
+Test(json_parser, test_json_parser_accepts_input_only_json_c_parses)
+{
+  LogParser *json_parser = json_parser_new(NULL);
+
+  /* trailing data after the object is rejected by the scanner, but json-c ignores it */
+  LogMessage *msg = parse_json_into_log_message("{\"foo\": \"bar\"} trailing", json_parser);
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "bar");
+  log_msg_unref(msg);
+
+  assert_json_parser_fails("{\"foo\": }", json_parser);
+  assert_json_parser_fails("{\"foo\": \"bar\"", json_parser);
+  log_pipe_unref(&json_parser->super);
+}
+
+Test(json_parser, test_json_parser_marker_is_not_counted_in_the_payload)
+{
+  LogParser *json_parser = json_parser_new(NULL);
+
+  json_parser_set_marker(json_parser, "@cee:");
+  LogMessage *msg = parse_json_into_log_message("@cee:   {\"foo\": \"bar\"}", json_parser);
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "bar");
+  log_msg_unref(msg);
+  log_pipe_unref(&json_parser->super);
+}
@@ -719,6 +719,7 @@ kafka_dd_new(GlobalConfig *cfg)
   self->topics_lock = g_mutex_new();
 
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
 
   return (LogDriver *)self;
 }
@@ -114,15 +114,21 @@ _process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, co
             evt_tag_str ("input", input),
             evt_tag_str ("prefix", self->prefix),
             evt_tag_printf("msg", "%p", *pmsg));
+  LogParserInput parser_input;
+  log_parser_input_init(&parser_input, s, *pmsg, input, input_len);
+
   /* FIXME: input length */
   kv_scanner_input(&kv_scanner, input);
   while (kv_scanner_scan_next(&kv_scanner))
     {
-
-      /* FIXME: value length */
-      log_msg_set_value_by_name(*pmsg,
-                                _get_formatted_key(self, kv_scanner_get_current_key(&kv_scanner), formatted_key),
-                                kv_scanner_get_current_value(&kv_scanner), -1);
+      NVHandle handle = log_msg_get_value_handle(_get_formatted_key(self, kv_scanner_get_current_key(&kv_scanner),
+                                                                    formatted_key));
+      gsize ofs, len;
+
+      if (kv_scanner_get_current_value_slice(&kv_scanner, &ofs, &len))
+        log_parser_input_set_value(&parser_input, *pmsg, handle, input + ofs, len);
+      else
+        log_parser_input_set_value(&parser_input, *pmsg, handle, kv_scanner_get_current_value(&kv_scanner), -1);
     }
   if (self->stray_words_value_name)
     log_msg_set_value_by_name(*pmsg,
@@ -71,6 +71,11 @@ Test(format_welf, test_format_welf_performance)
                     "--exclude .SDATA.* "
                     "..RSTAMP='${R_UNIXTIME}${R_TZ}' "
                     "..TAGS=${TAGS})\n");
+
+  /* a long value with spaces, quoted and escaped with '"' as unsafe character */
+  perftest_template("$(format-welf msg='Accepted publickey for deploy from 10.20.30.40 port 52422 ssh2: "
+                    "RSA SHA256:Zm9vYmFyYmF6cXV4cXV1eGZvb2Jhcg' "
+                    "escaping=$escaping)\n");
 }
 
 typedef struct
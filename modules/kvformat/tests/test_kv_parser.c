@@ -160,4 +160,15 @@ Test(kv_parser, test_extract_stray_words)
 
 }
 
+Test(kv_parser, test_values_referencing_the_message_survive_when_it_is_overwritten)
+{
+  LogMessage *msg;
+
+  msg = parse_kv_into_log_message("foo=bar MESSAGE=baz qux=quux");
+  assert_log_message_value_by_name(msg, "foo", "bar");
+  assert_log_message_value(msg, LM_V_MESSAGE, "baz");
+  assert_log_message_value_by_name(msg, "qux", "quux");
+  log_msg_unref(msg);
+}
+
 TestSuite(kv_parser, .init = setup, .fini = teardown);
@@ -366,6 +366,7 @@ mqtt_dd_new(GlobalConfig *cfg)
   self->super.super.super.super.free_fn = _free;
 
   self->super.format_stats_instance = _format_stats_instance;
+  self->super.template_options = &self->template_options;
   self->super.super.super.super.generate_persist_name = _format_persist_name;
   self->super.stats_source = stats_register_type("mqtt-destination");
   self->super.worker.construct = mqtt_dw_new;
@@ -631,6 +631,7 @@ python_dd_new(GlobalConfig *cfg)
 
   log_threaded_dest_driver_init_instance(&self->super, cfg);
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
 
   self->super.super.super.super.init = python_dd_init;
   self->super.super.super.super.deinit = python_dd_deinit;
@@ -206,6 +206,7 @@ redis_dd_new(GlobalConfig *cfg)
   self->command = g_string_sized_new(32);
 
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
 
   return (LogDriver *)self;
 }
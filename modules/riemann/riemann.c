@@ -342,6 +342,7 @@ riemann_dd_new(GlobalConfig *cfg)
   self->super.batch_lines = 0; /* don't inherit global value */
 
   log_template_options_defaults(&self->template_options);
+  self->super.template_options = &self->template_options;
 
   return (LogDriver *)self;
 }
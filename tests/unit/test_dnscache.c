@@ -25,6 +25,7 @@
 
 #include "dnscache.h"
 #include "apphook.h"
+#include "persist-state.h"
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 
@@ -239,3 +240,194 @@ Test(dnscache, test_lru_lists)
   _fill_dns_cache(cache, cache_size);
   dns_cache_free(cache);
 }
+
+static PersistState *
+_start_persist_state(const gchar *persist_file)
+{
+  PersistState *state = persist_state_new(persist_file);
+
+  cr_assert(persist_state_start(state));
+  return state;
+}
+
+static void
+_assert_shared_cache_contains(gint cache_size)
+{
+  gchar hn[256];
+  gsize hn_len;
+  gboolean positive;
+
+  for (gint i = 0; i < cache_size; i++)
+    {
+      guint32 ni = htonl(i);
+
+      cr_assert(dns_caching_lookup(AF_INET, (void *) &ni, hn, sizeof(hn), &hn_len, &positive),
+                "shared cache forgot an entry, i=%d\n", i);
+      cr_assert_str_eq(hn, i < cache_size / 2 ? positive_hostname : negative_hostname);
+      cr_assert_eq(hn_len, strlen(hn));
+      cr_assert_eq(positive, i < cache_size / 2);
+    }
+}
+
+Test(dnscache, test_shared_cache_is_restored_from_the_persist_file)
+{
+  const gchar *persist_file = "test_dnscache.persist";
+  DNSCacheOptions options =
+  {
+    .cache_size = 5000,
+    .expire = 600,
+    .expire_failed = 300,
+    .hosts = NULL
+  };
+  gint cache_size = 1000;
+  PersistState *state;
+  gchar hn[256];
+  gsize hn_len;
+  gboolean positive;
+
+  unlink(persist_file);
+  dns_caching_update_options(&options);
+  state = _start_persist_state(persist_file);
+  dns_caching_init(state);
+
+  for (gint i = 0; i < cache_size; i++)
+    {
+      guint32 ni = htonl(i);
+      gboolean positive_entry = i < (cache_size / 2);
+
+      dns_caching_store(AF_INET, (void *) &ni, positive_entry ? positive_hostname : negative_hostname, positive_entry);
+    }
+  _assert_shared_cache_contains(cache_size);
+
+  /* the cache is only persisted on shutdown */
+  app_pre_shutdown();
+  dns_caching_deinit();
+  cr_assert(persist_state_commit(state));
+  persist_state_free(state);
+
+  /* start over with an empty cache */
+  dns_caching_global_deinit();
+  dns_caching_global_init();
+  dns_caching_update_options(&options);
+
+  guint32 ni = htonl(0);
+  cr_assert_not(dns_caching_lookup(AF_INET, (void *) &ni, hn, sizeof(hn), &hn_len, &positive));
+
+  state = _start_persist_state(persist_file);
+  dns_caching_init(state);
+  _assert_shared_cache_contains(cache_size);
+  dns_caching_deinit();
+  cr_assert(persist_state_commit(state));
+  persist_state_free(state);
+
+  unlink(persist_file);
+}
+
+Test(dnscache, test_hosts_file_entries_are_found_in_every_shard)
+{
+  gchar *hosts_file;
+  gint fd = g_file_open_tmp("dnscache-hostsXXXXXX", &hosts_file, NULL);
+  const gchar *hosts = "# comment\n"
+                       "10.0.0.1 host1\n"
+                       "10.0.0.2 host2\n"
+                       "192.168.1.1 router\n"
+                       "172.16.0.17 seventeen\n";
+  DNSCacheOptions options =
+  {
+    .cache_size = 5000,
+    .expire = 600,
+    .expire_failed = 300,
+    .hosts = hosts_file
+  };
+  const gchar *addresses[] = { "10.0.0.1", "10.0.0.2", "192.168.1.1", "172.16.0.17" };
+  const gchar *hostnames[] = { "host1", "host2", "router", "seventeen" };
+  gchar hn[256];
+  gsize hn_len;
+  gboolean positive;
+
+  cr_assert(fd >= 0);
+  close(fd);
+  cr_assert(g_file_set_contents(hosts_file, hosts, -1, NULL));
+  dns_caching_update_options(&options);
+
+  for (gint i = 0; i < G_N_ELEMENTS(addresses); i++)
+    {
+      struct in_addr ia;
+
+      inet_pton(AF_INET, addresses[i], &ia);
+      cr_assert(dns_caching_lookup(AF_INET, (void *) &ia, hn, sizeof(hn), &hn_len, &positive),
+                "hosts file entry not found: %s", addresses[i]);
+      cr_assert_str_eq(hn, hostnames[i]);
+      cr_assert(positive);
+    }
+
+  unlink(hosts_file);
+  g_free(hosts_file);
+}
+
+static GMutex *resolve_lock;
+
+/* blocks until the test releases resolve_lock */
+static const gchar *
+_blocking_resolve(GSockAddr *saddr, gchar *buf, gsize buf_len)
+{
+  g_mutex_lock(resolve_lock);
+  g_mutex_unlock(resolve_lock);
+  return NULL;
+}
+
+Test(dnscache, test_pending_lookups_are_not_persisted)
+{
+  const gchar *persist_file = "test_dnscache_pending.persist";
+  DNSCacheOptions options =
+  {
+    .cache_size = 5000,
+    .expire = 600,
+    .expire_failed = 300,
+    .hosts = NULL,
+    .resolvers = 1
+  };
+  GSockAddr *saddr = g_sockaddr_inet_new("10.1.2.3", 0);
+  struct in_addr ia;
+  PersistState *state;
+  gchar hn[256];
+  gsize hn_len;
+  gboolean positive;
+
+  unlink(persist_file);
+  resolve_lock = g_mutex_new();
+  g_mutex_lock(resolve_lock);
+
+  dns_caching_update_options(&options);
+  state = _start_persist_state(persist_file);
+  dns_caching_init(state);
+
+  inet_pton(AF_INET, "10.1.2.3", &ia);
+  cr_assert(dns_caching_resolve_async(saddr, &ia, "10.1.2.3", _blocking_resolve));
+  cr_assert(dns_caching_lookup(AF_INET, (void *) &ia, hn, sizeof(hn), &hn_len, &positive));
+  cr_assert_str_eq(hn, "10.1.2.3");
+  cr_assert_not(positive);
+
+  /* persisted while the resolver is still busy with the address */
+  app_pre_shutdown();
+  dns_caching_deinit();
+  cr_assert(persist_state_commit(state));
+  persist_state_free(state);
+
+  g_mutex_unlock(resolve_lock);
+  dns_caching_global_deinit();
+  dns_caching_global_init();
+  options.resolvers = 0;
+  dns_caching_update_options(&options);
+
+  state = _start_persist_state(persist_file);
+  dns_caching_init(state);
+  cr_assert_not(dns_caching_lookup(AF_INET, (void *) &ia, hn, sizeof(hn), &hn_len, &positive));
+  dns_caching_deinit();
+  cr_assert(persist_state_commit(state));
+  persist_state_free(state);
+
+  g_sockaddr_unref(saddr);
+  g_mutex_free(resolve_lock);
+  unlink(persist_file);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2021 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "logmatcher.h"
+#include "apphook.h"
+#include "libtest/stopwatch.h"
+#include "compat/pcre.h"
+
+#include <string.h>
+
+#define BENCHMARK_COUNT 100000
+
+static const gchar *sample_value =
+  "Accepted publickey for bazsi from 10.110.1.12 port 58318 ssh2: RSA SHA256:xR5kN3lTq0N8p0dkVPxvc9sjK0U4C0Hg";
+
+/* the matching code of LogMatcherPcreRe as it was on top of libpcre: the
+ * capture count is queried and the offset vector sized for each match.  The
+ * vector itself lives outside the loop, as alloca() memory is only released
+ * when the function returns. */
+static void
+_perftest_legacy_pcre(const gchar *re)
+{
+  const gchar *errptr;
+  gint erroffset;
+  gint value_len = strlen(sample_value);
+  pcre *pattern;
+  pcre_extra *extra;
+  gint matches[3 * (RE_MAX_MATCHES + 1)];
+  gint i;
+
+  pattern = pcre_compile2(re, 0, NULL, &errptr, &erroffset, NULL);
+  cr_assert_not_null(pattern, "legacy pcre failed to compile regexp: %s", re);
+  extra = pcre_study(pattern, PCRE_STUDY_JIT_COMPILE, &errptr);
+
+  start_stopwatch();
+  for (i = 0; i < BENCHMARK_COUNT; i++)
+    {
+      gint num_matches;
+      gsize matches_size;
+
+      pcre_fullinfo(pattern, extra, PCRE_INFO_CAPTURECOUNT, &num_matches);
+      matches_size = 3 * (MIN(num_matches, RE_MAX_MATCHES) + 1);
+      pcre_exec(pattern, extra, sample_value, value_len, 0, 0, matches, matches_size);
+    }
+  stop_stopwatch_and_display_result(BENCHMARK_COUNT, "      pcre  %-60s", re);
+
+  pcre_free_study(extra);
+  pcre_free(pattern);
+}
+
+static void
+_perftest_log_matcher(const gchar *re, gint flags)
+{
+  LogMatcherOptions matcher_options;
+  LogMatcher *matcher;
+  LogMessage *msg = log_msg_new_empty();
+  gint i;
+
+  log_matcher_options_defaults(&matcher_options);
+  matcher_options.flags = flags;
+  matcher = log_matcher_pcre_re_new(&matcher_options);
+  cr_assert(log_matcher_compile(matcher, re, NULL), "LogMatcher failed to compile regexp: %s", re);
+
+  start_stopwatch();
+  for (i = 0; i < BENCHMARK_COUNT; i++)
+    log_matcher_match(matcher, msg, LM_V_NONE, sample_value, -1);
+  stop_stopwatch_and_display_result(BENCHMARK_COUNT, "      pcre2 %-60s", re);
+
+  log_matcher_unref(matcher);
+  log_matcher_options_destroy(&matcher_options);
+  log_msg_unref(msg);
+}
+
+static void
+_perftest_regexp(const gchar *re)
+{
+  _perftest_legacy_pcre(re);
+  _perftest_log_matcher(re, 0);
+  _perftest_log_matcher(re, LMF_STORE_MATCHES);
+}
+
+Test(matcher_speed, test_pcre_matcher_speed)
+{
+  _perftest_regexp("publickey");
+  _perftest_regexp("^Accepted (\\S+) for (\\S+) from (\\S+) port (\\d+)");
+  _perftest_regexp("^Accepted (?<method>\\S+) for (?<user>\\S+) from (?<addr>\\S+) port (?<port>\\d+)");
+  _perftest_regexp("(foo|bar|baz|qux)[0-9]+$");
+  _perftest_regexp("SHA256:[A-Za-z0-9+/]{32}");
+}
+
+TestSuite(matcher_speed, .init = app_startup, .fini = app_shutdown);